@@ -90,8 +90,28 @@ int linkkit_start(int max_buffered_msg, int get_tsl_from_cloud, linkkit_loglevel
  * @return int, 0 when success, -1 when fail.
  */
 int linkkit_fota_init(handle_service_fota_callback_fp_t callback_fp);
+
+/**
+ * @brief set the digest the next image is checked against as it is written.
+ *
+ * @param sign_method, "Md5" or "Sha256".
+ * @param digest, hex string of the digest.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_fota_set_digest(const char* sign_method, const char* digest);
 #ifdef SERVICE_COTA_ENABLED
 int linkkit_cota_init(handle_service_cota_callback_fp_t callback_fp);
+
+/**
+ * @brief set the callback told the keys a new config adds, changes or removes, instead of the whole config.
+ *        a config with the digest of the one applied last is not fetched again.
+ *
+ * @param change_fp, called once a key, with value NULL for a key removed.
+ *
+ * @return int, 0 when success, -1 when fail.
+ */
+int linkkit_cota_set_change_callback(handle_service_cota_change_fp_t change_fp);
 #endif /**< SERVICE_COTA_ENABLED*/
 #endif /* SERVICE_OTA_ENABLED */
 
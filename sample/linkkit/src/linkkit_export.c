@@ -190,6 +190,16 @@ int linkkit_fota_init(handle_service_fota_callback_fp_t callback_fp)
 
     return ret;
 }
+
+int linkkit_fota_set_digest(const char* sign_method, const char* digest)
+{
+    fota_t** ota = fota_object;
+
+    if (ota == NULL || *ota == NULL || (*ota)->set_digest == NULL) return -1;
+
+    return (*ota)->set_digest(ota, sign_method, digest);
+}
+
 #ifdef SERVICE_COTA_ENABLED
 int linkkit_cota_init(handle_service_cota_callback_fp_t callback_fp)
 {
@@ -365,6 +375,17 @@ int linkkit_invoke_cota_get_config(const char* config_scope, const char* get_typ
 
     return ret;
 }
+
+int linkkit_cota_set_change_callback(handle_service_cota_change_fp_t change_fp)
+{
+    cota_t** ota = cota_object;
+
+    if (ota == NULL || *ota == NULL || (*ota)->install_change_callback == NULL) return -1;
+
+    (*ota)->install_change_callback(ota, change_fp);
+
+    return 0;
+}
 #endif /* SERVICE_COTA_ENABLED*/
 #endif /* SERVICE_OTA_ENABLED */
 
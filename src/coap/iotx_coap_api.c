@@ -27,6 +27,8 @@
 #include "json_parser.h"
 #include "CoAPMessage.h"
 #include "CoAPExport.h"
+#include "CoAPBlock.h"
+#include "CoAPObserve.h"
 #include "lite-system.h"
 
 #define IOTX_SIGN_LENGTH         (40+1)
@@ -43,6 +45,12 @@
 #define IOTX_COAP_ONLINE_DTLS_SERVER_URL "coaps://%s.iot-as-coap.cn-shanghai.aliyuncs.com:5684"
 
 
+typedef struct {
+    void                  *p_iotx_coap;
+    char                  *p_path;
+    iotx_block_message_t  *p_message;
+} iotx_coap_block_t;
+
 typedef struct {
     char                *p_auth_token;
     int                  auth_token_len;
@@ -51,10 +59,11 @@ typedef struct {
     CoAPContext         *p_coap_ctx;
     unsigned int         coap_token;
     iotx_event_handle_t  event_handle;
+    utils_hmac_t         hmac;          /* key schedule of the device secret, made once at init */
 } iotx_coap_t;
 
 
-int iotx_calc_sign(const char *p_device_secret, const char *p_client_id,
+int iotx_calc_sign(const utils_hmac_t *p_hmac, const char *p_client_id,
                    const char *p_device_name, const char *p_product_key, char sign[IOTX_SIGN_LENGTH])
 {
     char *p_msg = NULL;
@@ -71,7 +80,7 @@ int iotx_calc_sign(const char *p_device_secret, const char *p_client_id,
                  p_client_id,
                  p_device_name,
                  p_product_key);
-    utils_hmac_md5(p_msg, strlen(p_msg), sign, p_device_secret, strlen(p_device_secret));
+    utils_hmac_sign(p_hmac, p_msg, strlen(p_msg), sign);
 
     coap_free(p_msg);
     COAP_DEBUG("The device name sign: %s", sign);
@@ -141,17 +150,20 @@ static void iotx_device_name_auth_callback(void *user, void *p_message)
 
 }
 
-static unsigned int iotx_get_coap_token(iotx_coap_t       *p_iotx_coap, unsigned char *p_encoded_data)
+static unsigned int iotx_encode_coap_token(unsigned int value, unsigned char *p_encoded_data)
 {
-    unsigned int value = p_iotx_coap->coap_token;
     p_encoded_data[0] = (unsigned char)((value & 0x00FF) >> 0);
     p_encoded_data[1] = (unsigned char)((value & 0xFF00) >> 8);
     p_encoded_data[2] = (unsigned char)((value & 0xFF0000) >> 16);
     p_encoded_data[3] = (unsigned char)((value & 0xFF000000) >> 24);
-    p_iotx_coap->coap_token++;
     return sizeof(unsigned int);
 }
 
+static unsigned int iotx_get_coap_token(iotx_coap_t       *p_iotx_coap, unsigned char *p_encoded_data)
+{
+    return iotx_encode_coap_token(p_iotx_coap->coap_token++, p_encoded_data);
+}
+
 void iotx_event_notifyer(unsigned int code, CoAPMessage *message)
 {
     if (NULL == message) {
@@ -367,7 +379,7 @@ int IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context)
         CoAPMessage_destory(&message);
         return IOTX_ERR_NO_MEM;
     }
-    iotx_calc_sign(p_iotx_coap->p_devinfo->device_secret, p_iotx_coap->p_devinfo->device_id,
+    iotx_calc_sign(&p_iotx_coap->hmac, p_iotx_coap->p_devinfo->device_id,
                    p_iotx_coap->p_devinfo->device_name, p_iotx_coap->p_devinfo->product_key, sign);
     HAL_Snprintf((char *)p_payload, COAP_MSG_MAX_PDU_LEN,
                  IOTX_AUTH_DEVICENAME_STR,
@@ -465,7 +477,7 @@ int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_mess
 
 
     if (p_message->payload_len >= COAP_MSG_MAX_PDU_LEN) {
-        COAP_ERR("The payload length %d is too loog", p_message->payload_len);
+        COAP_ERR("The payload length %d is too loog, use IOT_CoAP_SendMessageBlockwise()", p_message->payload_len);
         return IOTX_ERR_MSG_TOO_LOOG;
     }
 
@@ -509,6 +521,217 @@ int IOT_CoAP_SendMessage(iotx_coap_context_t *p_context, char *p_path, iotx_mess
         return IOTX_ERR_NOT_AUTHED;
     }
 }
+static int iotx_coap_observe_prepare(void *user, void *message)
+{
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)user;
+
+    if (!p_iotx_coap->is_authed) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+    return CoAPStrOption_add((CoAPMessage *)message, COAP_OPTION_AUTH_TOKEN,
+                             (unsigned char *)p_iotx_coap->p_auth_token, strlen(p_iotx_coap->p_auth_token));
+}
+
+static int iotx_coap_observe_send(iotx_coap_t *p_iotx_coap, char *p_path, unsigned int observe_id,
+                                  unsigned int observe, iotx_response_callback_t callback, void *user_data)
+{
+    int               ret = IOTX_SUCCESS;
+    CoAPContext      *p_coap_ctx = (CoAPContext *)p_iotx_coap->p_coap_ctx;
+    CoAPMessage       message;
+    unsigned char     token[sizeof(unsigned int)] = {0};
+
+    iotx_encode_coap_token(observe_id, token);
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
+    CoAPMessageCode_set(&message, COAP_MSG_CODE_GET);
+    CoAPMessageId_set(&message, CoAPMessageId_gen(p_coap_ctx));
+    CoAPMessageToken_set(&message, token, sizeof(token));
+    if (NULL != user_data) {
+        CoAPMessageUserData_set(&message, user_data);
+    }
+    CoAPMessageHandler_set(&message, callback);
+
+    /* Observe is numbered below Uri-Path, so it goes first */
+    CoAPUintOption_add(&message, COAP_OPTION_OBSERVE, observe);
+    ret = iotx_split_path_2_option(p_path, &message);
+    if (IOTX_SUCCESS != ret) {
+        CoAPMessage_destory(&message);
+        return ret;
+    }
+    CoAPUintOption_add(&message, COAP_OPTION_ACCEPT, COAP_CT_APP_OCTET_STREAM);
+
+    if (COAP_OBSERVE_REGISTER == observe) {
+        /* the auth token is renewed by re-auth, re-registrations take the current one */
+        ret = CoAPObserve_register(p_coap_ctx, &message, iotx_coap_observe_prepare, p_iotx_coap);
+    } else {
+        ret = iotx_coap_observe_prepare(p_iotx_coap, &message);
+        if (COAP_SUCCESS == ret) {
+            ret = CoAPMessage_send(p_coap_ctx, &message);
+        }
+    }
+    CoAPMessage_destory(&message);
+
+    return (COAP_SUCCESS == ret) ? IOTX_SUCCESS : IOTX_ERR_SEND_MSG_FAILED;
+}
+
+int IOT_CoAP_Observe(iotx_coap_context_t *p_context, char *p_path, iotx_response_callback_t callback,
+                     void *user_data, unsigned int *p_observe_id)
+{
+    int          ret = IOTX_SUCCESS;
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_iotx_coap || NULL == p_path || NULL == callback || NULL == p_observe_id
+        || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter p_context %p, p_uri %p, callback %p",
+                 p_context, p_path, callback);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+    if (!p_iotx_coap->is_authed) {
+        return IOTX_ERR_NOT_AUTHED;
+    }
+
+    /* the token identifies the observation for its whole life */
+    *p_observe_id = p_iotx_coap->coap_token++;
+    ret = iotx_coap_observe_send(p_iotx_coap, p_path, *p_observe_id, COAP_OBSERVE_REGISTER, callback, user_data);
+    COAP_INFO("Observe %s, id %u, ret %d", p_path, *p_observe_id, ret);
+
+    return ret;
+}
+
+int IOT_CoAP_CancelObserve(iotx_coap_context_t *p_context, char *p_path, unsigned int observe_id)
+{
+    unsigned char  token[sizeof(unsigned int)] = {0};
+    iotx_coap_t   *p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_iotx_coap || NULL == p_path || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter p_context %p, p_uri %p", p_context, p_path);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    iotx_encode_coap_token(observe_id, token);
+    if (COAP_SUCCESS != CoAPObserve_deregister(p_iotx_coap->p_coap_ctx, token, sizeof(token))) {
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    /* tell the server proactively, a late notification is rejected with RST anyway */
+    if (p_iotx_coap->is_authed) {
+        iotx_coap_observe_send(p_iotx_coap, p_path, observe_id, COAP_OBSERVE_DEREGISTER, NULL, NULL);
+    }
+    return IOTX_SUCCESS;
+}
+
+static int iotx_coap_block_prepare(void *user, CoAPMessage *message, CoAPBlockPhase phase)
+{
+    int                len = 0;
+    unsigned char      token[8] = {0};
+    iotx_coap_block_t *p_block = (iotx_coap_block_t *)user;
+    iotx_coap_t       *p_iotx_coap = (iotx_coap_t *)p_block->p_iotx_coap;
+
+    if (COAP_BLOCK_PREPARE_TAIL == phase) {
+        return CoAPStrOption_add(message,  COAP_OPTION_AUTH_TOKEN,
+                                 (unsigned char *)p_iotx_coap->p_auth_token, strlen(p_iotx_coap->p_auth_token));
+    }
+
+    len = iotx_get_coap_token(p_iotx_coap, token);
+    CoAPMessageToken_set(message, token, len);
+
+    if (IOTX_SUCCESS != iotx_split_path_2_option(p_block->p_path, message)) {
+        return COAP_ERROR_INVALID_URI;
+    }
+
+    if (COAP_MSG_CODE_GET != message->header.code) {
+        if (IOTX_CONTENT_TYPE_CBOR == p_block->p_message->content_type) {
+            CoAPUintOption_add(message, COAP_OPTION_CONTENT_FORMAT, COAP_CT_APP_CBOR);
+        } else {
+            CoAPUintOption_add(message, COAP_OPTION_CONTENT_FORMAT, COAP_CT_APP_JSON);
+        }
+    }
+    CoAPUintOption_add(message, COAP_OPTION_ACCEPT, COAP_CT_APP_OCTET_STREAM);
+
+    return COAP_SUCCESS;
+}
+
+static int iotx_coap_block_read(void *user, unsigned int offset, unsigned char *buf, unsigned int len)
+{
+    iotx_block_message_t *p_message = ((iotx_coap_block_t *)user)->p_message;
+
+    return p_message->read_callback(p_message->user_data, offset, buf, len);
+}
+
+static int iotx_coap_block_write(void *user, unsigned int offset, unsigned char *data, unsigned int len)
+{
+    iotx_block_message_t *p_message = ((iotx_coap_block_t *)user)->p_message;
+
+    return p_message->write_callback(p_message->user_data, offset, data, len);
+}
+
+static void iotx_coap_block_rsphdl(void *user, void *p_response)
+{
+    iotx_block_message_t *p_message = ((iotx_coap_block_t *)user)->p_message;
+
+    if (NULL != p_message->resp_callback) {
+        p_message->resp_callback(p_message->user_data, p_response);
+    }
+}
+
+static int iotx_coap_block_transfer(iotx_coap_context_t *p_context, char *p_path,
+                                    iotx_block_message_t *p_message, unsigned short blockopt, int err_code)
+{
+    int                ret = COAP_SUCCESS;
+    iotx_coap_t       *p_iotx_coap = (iotx_coap_t *)p_context;
+    iotx_coap_block_t  block;
+    CoAPBlockTransfer  transfer;
+
+    if (NULL == p_iotx_coap || NULL == p_path || NULL == p_message || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter p_context %p, p_uri %p, p_message %p",
+                 p_context, p_path, p_message);
+        return IOTX_ERR_INVALID_PARAM;
+    }
+    if ((COAP_OPTION_BLOCK1 == blockopt && NULL == p_message->read_callback)
+        || (COAP_OPTION_BLOCK2 == blockopt && NULL == p_message->write_callback)) {
+        COAP_ERR("Invalid paramter, missing block callback");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+    if (!p_iotx_coap->is_authed) {
+        return IOTX_ERR_NOT_AUTHED;
+    }
+
+    ret = CoAPBlockTransfer_init(&transfer, (CoAPContext *)p_iotx_coap->p_coap_ctx, blockopt,
+                                 (unsigned char)p_message->block_size, p_message->window);
+    if (COAP_ERROR_INVALID_PARAM == ret) {
+        COAP_ERR("Invalid block size %d or window %d", p_message->block_size, p_message->window);
+        return IOTX_ERR_INVALID_PARAM;
+    } else if (COAP_SUCCESS != ret) {
+        return IOTX_ERR_NO_MEM;
+    }
+
+    block.p_iotx_coap = p_iotx_coap;
+    block.p_path      = p_path;
+    block.p_message   = p_message;
+
+    transfer.total_len = p_message->total_len;
+    transfer.prepare   = iotx_coap_block_prepare;
+    transfer.read      = iotx_coap_block_read;
+    transfer.write     = iotx_coap_block_write;
+    transfer.handler   = iotx_coap_block_rsphdl;
+    transfer.user      = &block;
+
+    ret = CoAPBlockTransfer_run(&transfer);
+    CoAPBlockTransfer_deinit(&transfer);
+
+    return (COAP_SUCCESS == ret) ? IOTX_SUCCESS : err_code;
+}
+
+int IOT_CoAP_SendMessageBlockwise(iotx_coap_context_t *p_context, char *p_path, iotx_block_message_t *p_message)
+{
+    return iotx_coap_block_transfer(p_context, p_path, p_message, COAP_OPTION_BLOCK1, IOTX_ERR_SEND_MSG_FAILED);
+}
+
+int IOT_CoAP_GetMessageBlockwise(iotx_coap_context_t *p_context, char *p_path, iotx_block_message_t *p_message)
+{
+    return iotx_coap_block_transfer(p_context, p_path, p_message, COAP_OPTION_BLOCK2, IOTX_ERR_RECV_MSG_TIMEOUT);
+}
 
 
 int IOT_CoAP_GetMessagePayload(void *p_message, unsigned char **pp_payload, int *p_len)
@@ -593,6 +816,13 @@ iotx_coap_context_t *IOT_CoAP_Init(iotx_coap_config_t *p_config)
         strncpy(p_iotx_coap->p_devinfo->device_name,  p_config->p_devinfo->device_name, IOTX_DEVICE_NAME_LEN);
     }
 
+    /* the secret is fixed, so each auth only hashes the sign source */
+    if (0 != utils_hmac_init(&p_iotx_coap->hmac, UTILS_HMAC_MD5, p_iotx_coap->p_devinfo->device_secret,
+                             strlen(p_iotx_coap->p_devinfo->device_secret))) {
+        COAP_ERR(" Invalid device secret");
+        goto err;
+    }
+
     /*Init coap token*/
     p_iotx_coap->coap_token = IOTX_COAP_INIT_TOKEN;
 
@@ -664,6 +894,7 @@ void IOT_CoAP_Deinit(iotx_coap_context_t **pp_context)
             CoAPContext_free(p_iotx_coap->p_coap_ctx);
             p_iotx_coap->p_coap_ctx = NULL;
         }
+        utils_hmac_free(&p_iotx_coap->hmac);
         coap_free(p_iotx_coap);
         *pp_context = NULL;
     }
@@ -681,3 +912,33 @@ int IOT_CoAP_Yield(iotx_coap_context_t *p_context)
     return CoAPMessage_cycle(p_iotx_coap->p_coap_ctx);
 }
 
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+int IOT_CoAP_Attach(iotx_coap_context_t *p_context, void *loop)
+{
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_iotx_coap || NULL == p_iotx_coap->p_coap_ctx || NULL == loop) {
+        COAP_ERR("Invalid paramter");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    if (COAP_SUCCESS != CoAPContext_attach(p_iotx_coap->p_coap_ctx, loop)) {
+        return IOTX_ERR_INVALID_PARAM;
+    }
+    return IOTX_SUCCESS;
+}
+
+int IOT_CoAP_Detach(iotx_coap_context_t *p_context)
+{
+    iotx_coap_t *p_iotx_coap = (iotx_coap_t *)p_context;
+
+    if (NULL == p_iotx_coap || NULL == p_iotx_coap->p_coap_ctx) {
+        COAP_ERR("Invalid paramter");
+        return IOTX_ERR_INVALID_PARAM;
+    }
+
+    CoAPContext_detach(p_iotx_coap->p_coap_ctx);
+    return IOTX_SUCCESS;
+}
+#endif
+
@@ -18,6 +18,107 @@
 #include "iot_export_cmp.h"
 #include "iot_export_errno.h"
 #include "lite-utils.h"
+#include "utils_digest.h"
+#include "utils_jsondiff.h"
+
+#define CONFIG_OTA_DEFAULT_SCOPE "product"
+
+typedef struct config_ota_cache_s {
+    char*       scope;
+    char*       sign;
+    char*       content;        /* NULL if too large to be kept. */
+    uint32_t    content_len;
+    struct config_ota_cache_s* next;
+} config_ota_cache_t;
+
+static char* config_ota_strdup(const char* str)
+{
+    char* copy = config_ota_lite_malloc(strlen(str) + 1);
+
+    if (copy) strcpy(copy, str);
+
+    return copy;
+}
+
+/* configs pushed by the cloud are of the product. */
+static const char* config_ota_scope(config_ota_t* self)
+{
+    return self->_rsp_configscope ? self->_rsp_configscope : CONFIG_OTA_DEFAULT_SCOPE;
+}
+
+static config_ota_cache_t* config_ota_cache_find(config_ota_t* self)
+{
+    const char* scope = config_ota_scope(self);
+    config_ota_cache_t* cache;
+
+    for (cache = self->_cache; cache; cache = cache->next) {
+        if (strcmp(cache->scope, scope) == 0) return cache;
+    }
+
+    return NULL;
+}
+
+/* the config announced has the digest of the one applied last. */
+static int config_ota_unchanged(config_ota_t* self)
+{
+    config_ota_cache_t* cache = config_ota_cache_find(self);
+
+    return cache && self->_rsp_sign && strcmp(cache->sign, self->_rsp_sign) == 0;
+}
+
+/* keep the config applied, its content moves to the cache. */
+static void config_ota_cache_update(config_ota_t* self)
+{
+    config_ota_cache_t* cache = config_ota_cache_find(self);
+    char* sign = config_ota_strdup(self->_rsp_sign);
+
+    if (sign == NULL) return;
+
+    if (cache == NULL) {
+        cache = config_ota_lite_calloc(1, sizeof(config_ota_cache_t));
+        if (cache == NULL) {
+            config_ota_lite_free(sign);
+            return;
+        }
+        cache->scope = config_ota_strdup(config_ota_scope(self));
+        if (cache->scope == NULL) {
+            config_ota_lite_free(sign);
+            config_ota_lite_free(cache);
+            return;
+        }
+        cache->next = self->_cache;
+        self->_cache = cache;
+    }
+
+    if (cache->sign) config_ota_lite_free(cache->sign);
+    if (cache->content) config_ota_lite_free(cache->content);
+
+    cache->sign = sign;
+    cache->content = self->_content;
+    cache->content_len = self->_content_len;
+    self->_content = NULL;
+}
+
+static void config_ota_cache_free(config_ota_t* self)
+{
+    config_ota_cache_t* cache;
+
+    while (self->_cache) {
+        cache = self->_cache;
+        self->_cache = cache->next;
+        if (cache->scope) config_ota_lite_free(cache->scope);
+        if (cache->sign) config_ota_lite_free(cache->sign);
+        if (cache->content) config_ota_lite_free(cache->content);
+        config_ota_lite_free(cache);
+    }
+}
+
+static void config_ota_notify_key(void* user, const char* key, int key_len, const char* value, int value_len)
+{
+    config_ota_t* self = user;
+
+    ((handle_service_cota_change_fp_t)self->_change_callback_fp)(key, key_len, value, value_len);
+}
 
 static void config_ota_handler(void* pcontext, iotx_cmp_cota_parameter_t* ota_parameter, void* user_data)
 {
@@ -63,6 +164,11 @@ static void config_ota_handler(void* pcontext, iotx_cmp_cota_parameter_t* ota_pa
     strcpy(config_ota->_rsp_signMethod, iotx_cmp_ota_parameter->signMethod);
     strcpy(config_ota->_rsp_url, iotx_cmp_ota_parameter->url);
     config_ota->_rsp_configSize = ota_parameter->configSize;
+
+    /* a reply to get() is of the scope asked for, any other config is pushed. */
+    if (config_ota->_rsp_configscope) config_ota_lite_free(config_ota->_rsp_configscope);
+    config_ota->_rsp_configscope = config_ota->_req_configscope;
+    config_ota->_req_configscope = NULL;
     /**< end*/
 
 
@@ -73,6 +179,11 @@ static void config_ota_handler(void* pcontext, iotx_cmp_cota_parameter_t* ota_pa
     log_debug("_rsp_signMethod %s", config_ota->_rsp_signMethod);
     log_debug("_rsp_url %s", config_ota->_rsp_url);
 
+    if (config_ota_unchanged(config_ota)) {
+        log_info("config %s is the one applied, not fetched", config_ota->_rsp_configId);
+        return;
+    }
+
     /* invoke callback funtions. */
     if (config_ota->_linkkit_callback_fp) {
         ((handle_service_cota_callback_fp_t)config_ota->_linkkit_callback_fp)(service_cota_callback_type_new_version_detected,
@@ -124,6 +235,14 @@ static void* config_ota_ctor(void* _self, va_list* params)
 	self->_data_buf = NULL;
 	self->_data_buf_length = 0;
 	self->_ota_inited = 0;
+	self->_change_callback_fp = NULL;
+	self->_req_configscope = NULL;
+	self->_rsp_configscope = NULL;
+	self->_cache = NULL;
+	self->_digest = NULL;
+	self->_digest_type = -1;
+	self->_content = NULL;
+	self->_content_len = 0;
 	self->_current_verison = config_ota_lite_malloc(FIRMWARE_VERSION_MAXLEN);
 	if (self->_current_verison == NULL) return NULL;
 	memset(self->_current_verison, 0x0, FIRMWARE_VERSION_MAXLEN);
@@ -155,6 +274,11 @@ static void* config_ota_dtor(void* _self)
     if (self->_rsp_signMethod) config_ota_lite_free(self->_rsp_signMethod);
     if (self->_rsp_url) config_ota_lite_free(self->_rsp_url);
     if (self->_current_verison) config_ota_lite_free(self->_current_verison);
+    if (self->_req_configscope) config_ota_lite_free(self->_req_configscope);
+    if (self->_rsp_configscope) config_ota_lite_free(self->_rsp_configscope);
+    if (self->_digest) config_ota_lite_free(self->_digest);
+    if (self->_content) config_ota_lite_free(self->_content);
+    config_ota_cache_free(self);
 
     return self;
 }
@@ -162,14 +286,27 @@ static void* config_ota_dtor(void* _self)
 static int config_ota_get(void* _self,const char* configScope, const char* getType, const char* attributeKeys, void* option)
 {
 	config_ota_t* self = _self;
-	self = self;
+
+	/* the config returned next is cached as of this scope. */
+	if (self->_req_configscope) config_ota_lite_free(self->_req_configscope);
+	self->_req_configscope = configScope ? config_ota_strdup(configScope) : NULL;
+
 	return IOT_CMP_OTA_Get_Config(configScope,getType,attributeKeys,option);
 }
 static void config_ota_start(void* _self)
 {
     config_ota_t* self = _self;
 
-    self = self;
+    self->_digest_type = self->_rsp_signMethod ? utils_digest_type(self->_rsp_signMethod) : -1;
+    if (self->_digest_type >= 0) {
+        if (self->_digest == NULL) self->_digest = config_ota_lite_malloc(sizeof(utils_digest_t));
+        if (self->_digest) utils_digest_starts(self->_digest, self->_digest_type);
+    }
+
+    /* a config small enough is kept whole to be compared with the next one. */
+    if (self->_content) config_ota_lite_free(self->_content);
+    self->_content_len = 0;
+    if (self->_rsp_configSize <= CONFIG_COTA_CACHE_MAX_SIZE) self->_content = config_ota_lite_malloc(self->_rsp_configSize + 1);
 
     HAL_Firmware_Persistence_Start();
 }
@@ -185,21 +322,51 @@ static int config_ota_write(void* _self, void* data, int data_length)
 
     ret = HAL_Firmware_Persistence_Write(self->_data_buf, data_length);
 
+    if (ret == 0 && self->_digest_type >= 0 && self->_digest) utils_digest_update(self->_digest, data, data_length);
+
+    if (ret == 0 && self->_content) {
+        if (self->_content_len + data_length <= self->_rsp_configSize) {
+            memcpy(self->_content + self->_content_len, data, data_length);
+            self->_content_len += data_length;
+            self->_content[self->_content_len] = '\0';
+        } else {
+            config_ota_lite_free(self->_content);
+        }
+    }
+
     return ret;
 }
 
 static int config_ota_end(void* _self)
 {
     config_ota_t* self = _self;
+    config_ota_cache_t* cache;
     int ret;
 
-    self = self;
+    /* checked before the config is committed. */
+    if (self->_digest_type >= 0 && self->_digest && utils_digest_verify(self->_digest, self->_rsp_sign, NULL)) {
+        log_err("config %s digest mismatch", self->_rsp_configId);
+        return -1;
+    }
 
     /* this function should not return... */
     ret = HAL_Firmware_Persistence_Stop();
 
     log_emerg("OTA end");
-    /* update config*/
+    if (ret) return ret;
+
+    /* update config, tell the keys changed from the config applied last. */
+    cache = config_ota_cache_find(self);
+    if (self->_change_callback_fp) {
+        if (self->_content == NULL
+            || utils_json_diff(cache ? cache->content : NULL, cache ? cache->content_len : 0,
+                               self->_content, self->_content_len, config_ota_notify_key, self) < 0) {
+            config_ota_notify_key(self, NULL, 0, self->_content, self->_content ? self->_content_len : 0);
+        }
+    }
+
+    config_ota_cache_update(self);
+
     return ret;
 }
 
@@ -211,6 +378,11 @@ static int config_ota_perform_ota_service(void* _self, void* _data_buf, int _dat
 
     assert(_data_buf && _data_buf_length);
 
+    if (config_ota_unchanged(self)) {
+        log_info("config %s is the one applied, not fetched", self->_rsp_configId);
+        return 0;
+    }
+
     self->_data_buf = _data_buf;
     self->_data_buf_length = _data_buf_length;
 
@@ -282,6 +454,13 @@ static void config_ota_install_callback_function(void* _self, handle_service_cot
     self->_linkkit_callback_fp = linkkit_callback_fp;
 }
 
+static void config_ota_install_change_callback(void* _self, handle_service_cota_change_fp_t change_callback_fp)
+{
+    config_ota_t* self = _self;
+
+    self->_change_callback_fp = change_callback_fp;
+}
+
 void* config_ota_lite_calloc(size_t nmemb, size_t size)
 {
 #ifdef CMP_SUPPORT_MEMORY_MAGIC
@@ -315,7 +494,8 @@ static const cota_t _service_cota_class = {
 		config_ota_write,
 		config_ota_end,
 		config_ota_perform_ota_service,
-		config_ota_install_callback_function
+		config_ota_install_callback_function,
+		config_ota_install_change_callback
 };
 const void* get_config_ota_class()
 {
@@ -18,6 +18,10 @@ extern "C" {
 typedef struct {
     const void* _;
     int         cmp_inited;
+#ifdef IOTX_SPOOL_SUPPORT
+    void*       spool;      /* events sent while offline, NULL if CONFIG_DM_SPOOL_DIR is not set. */
+    int         connected;
+#endif
 } cmp_abstract_impl_t;
 
 extern const void* get_cmp_impl_class();
@@ -28,6 +28,9 @@ typedef struct {
 #ifndef CMP_SUPPORT_MULTI_THREAD
     int   (*yield)(void* _self, int timeout_ms);
 #endif
+#ifdef IOTX_SPOOL_SUPPORT
+    int   (*set_connected)(void* _self, int connected);  /* replay spooled messages once connected. */
+#endif
 } cmp_abstract_t;
 
 #ifdef __cplusplus
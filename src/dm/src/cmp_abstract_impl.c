@@ -10,6 +10,10 @@
 
 #include "dm_import.h"
 
+#ifdef IOTX_SPOOL_SUPPORT
+#include "utils_spool.h"
+#endif
+
 #define CMP_IMPL_EXTENTED_ROOM_FOR_STRING_MALLOC 1
 static int cmp_impl_deinit(void* _self, const void* option);
 
@@ -19,12 +23,29 @@ static const char string_down_raw_reply[] __DM_READ_ONLY__ = "down_raw_reply";
 static const char string_up_raw[] __DM_READ_ONLY__ = "up_raw";
 static const char string_up_raw_reply[] __DM_READ_ONLY__ = "up_raw_reply";
 static const char string__reply[] __DM_READ_ONLY__ = "_reply";
+#ifdef IOTX_SPOOL_SUPPORT
+static const char string_thing_event_[] __DM_READ_ONLY__ = "thing.event.";
+
+/* a spooled message is this header, then URI, method, product key, device name
+ * and parameter, each followed by '\0'. */
+typedef struct {
+    int32_t     id;
+    uint32_t    code;
+    int32_t     message_type;
+    uint32_t    parameter_length;
+    uint16_t    string_len[4];  /* URI, method, product key and device name with their '\0'. */
+} cmp_spool_record_t;
+#endif
 
 static void* cmp_impl_ctor(void* _self, va_list* params)
 {
     cmp_abstract_impl_t* self = _self;
 
     self->cmp_inited = 0;
+#ifdef IOTX_SPOOL_SUPPORT
+    self->spool = NULL;
+    self->connected = 0;
+#endif
 
     return self;
 }
@@ -43,6 +64,9 @@ static int cmp_impl_init(void* _self, const char* _product_key, const char* _dev
 {
     cmp_abstract_impl_t* self = _self;
     iotx_cmp_init_param_t init_param;
+#ifdef IOTX_SPOOL_SUPPORT
+    utils_spool_param_t spool_param = {CONFIG_DM_SPOOL_DIR, CONFIG_DM_SPOOL_SIZE, CONFIG_DM_SPOOL_SEGMENT, UTILS_SPOOL_DROP_OLDEST};
+#endif
 
     int ret = SUCCESS_RETURN;
 
@@ -66,6 +90,13 @@ static int cmp_impl_init(void* _self, const char* _product_key, const char* _dev
         self->cmp_inited = 1;
     }
 
+#ifdef IOTX_SPOOL_SUPPORT
+    if (self->cmp_inited && spool_param.dir) {
+        self->spool = utils_spool_open(&spool_param);
+        if (self->spool) dm_log_info("%u messages spooled in %s", utils_spool_count(self->spool), spool_param.dir);
+    }
+#endif
+
     return ret;
 }
 
@@ -76,6 +107,11 @@ static int cmp_impl_deinit(void* _self, const void* option)
     (void)option; /* prevent build warning. */
 
     self->cmp_inited = 0;
+#ifdef IOTX_SPOOL_SUPPORT
+    utils_spool_close(self->spool);
+    self->spool = NULL;
+    self->connected = 0;
+#endif
 
     return IOT_CMP_Deinit(NULL);;
 }
@@ -147,8 +183,120 @@ void recycle_memory(void* _user_data)
 }
 #endif
 
+#ifdef IOTX_SPOOL_SUPPORT
+/* only events and property posts are spooled, a reply would be stale once connected again. */
+static int cmp_impl_spooled(cmp_abstract_impl_t* self, iotx_cmp_message_info_t* message_info)
+{
+    return self->spool && IOTX_CMP_MESSAGE_REQUEST == message_info->message_type && message_info->method
+           && 0 == strncmp(message_info->method, string_thing_event_, strlen(string_thing_event_));
+}
+
+static int cmp_impl_spool(cmp_abstract_impl_t* self, iotx_cmp_send_peer_t* send_peer, iotx_cmp_message_info_t* message_info)
+{
+    cmp_spool_record_t record;
+    hal_iovec_t iov[6];
+    char* strings[4];
+    int i;
+
+    strings[0] = message_info->URI;
+    strings[1] = message_info->method;
+    strings[2] = send_peer->product_key;
+    strings[3] = send_peer->device_name;
+
+    record.id = message_info->id;
+    record.code = message_info->code;
+    record.message_type = message_info->message_type;
+    record.parameter_length = message_info->parameter_length;
+    iov[0].buf = (const char*)&record;
+    iov[0].len = sizeof(record);
+    for (i = 0; i < 4; i++) {
+        record.string_len[i] = strlen(strings[i]) + 1;
+        iov[i + 1].buf = strings[i];
+        iov[i + 1].len = record.string_len[i];
+    }
+    iov[5].buf = message_info->parameter;
+    iov[5].len = message_info->parameter_length + 1;
+
+    if (0 != utils_spool_append(self->spool, iov, 6)) {
+        dm_log_err("spool message %d failed", message_info->id);
+        return FAIL_RETURN;
+    }
+    return SUCCESS_RETURN;
+}
+
+static int cmp_impl_replay(const hal_iovec_t* records, uint32_t count, void* user)
+{
+    iotx_cmp_message_info_t message_info = {0};
+    iotx_cmp_send_peer_t send_peer;
+    cmp_spool_record_t record;
+    const char* p;
+    uint32_t i;
+
+    (void)user; /* prevent build warning. */
+
+    for (i = 0; i < count; i++) {
+        memcpy(&record, records[i].buf, sizeof(record));
+        if (sizeof(record) + record.string_len[0] + record.string_len[1] + record.string_len[2] + record.string_len[3]
+            + record.parameter_length + 1 != records[i].len) {
+            dm_log_err("skip malformed spooled message");
+            continue;
+        }
+        p = (const char*)records[i].buf + sizeof(record);
+
+        message_info.id = record.id;
+        message_info.code = record.code;
+        message_info.message_type = (iotx_cmp_message_types_t)record.message_type;
+        message_info.URI_type = IOTX_CMP_URI_UNDEFINE;
+        message_info.URI = (char*)p;
+        p += record.string_len[0];
+        message_info.method = (char*)p;
+        p += record.string_len[1];
+        memset(&send_peer, 0, sizeof(iotx_cmp_send_peer_t));
+        strncpy(send_peer.product_key, p, sizeof(send_peer.product_key) - 1);
+        p += record.string_len[2];
+        strncpy(send_peer.device_name, p, sizeof(send_peer.device_name) - 1);
+        p += record.string_len[3];
+        message_info.parameter_length = record.parameter_length;
+#ifdef MEMORY_NO_COPY
+        /* the parameter is released by cmp once sent. */
+        message_info.parameter = dm_lite_calloc(1, record.parameter_length + 1);
+        if (NULL == message_info.parameter) break;
+        memcpy(message_info.parameter, p, record.parameter_length);
+        message_info.recycle_memory_fp = recycle_memory;
+        message_info.user_data = message_info.parameter;
+#else
+        message_info.parameter = (void*)p;
+#endif
+
+        if (SUCCESS_RETURN != IOT_CMP_Send(&send_peer, &message_info, NULL)) break;
+    }
+
+    return i;
+}
+
+static int cmp_impl_set_connected(void* _self, int connected)
+{
+    cmp_abstract_impl_t* self = _self;
+    int ret;
+
+    self->connected = connected;
+
+    if (!connected || !self->spool || 0 == utils_spool_count(self->spool)) return SUCCESS_RETURN;
+
+    ret = utils_spool_replay(self->spool, cmp_impl_replay, self);
+
+    dm_log_info("replayed %d spooled messages, %u left, %u dropped", ret,
+                utils_spool_count(self->spool), utils_spool_dropped(self->spool));
+
+    return ret < 0 ? FAIL_RETURN : SUCCESS_RETURN;
+}
+#endif
+
 static int cmp_impl_send(void* _self, message_info_t** msg, void* option)
 {
+#ifdef IOTX_SPOOL_SUPPORT
+    cmp_abstract_impl_t* self = _self;
+#endif
     message_info_t** message_info = msg;
     iotx_cmp_message_info_t iotx_cmp_message_info = {0};
     iotx_cmp_send_peer_t send_peer;
@@ -185,10 +333,32 @@ static int cmp_impl_send(void* _self, message_info_t** msg, void* option)
     strncpy(send_peer.device_name, device_name, sizeof(send_peer.device_name));
     strncpy(send_peer.product_key, product_key, sizeof(send_peer.product_key));
 
+#ifdef IOTX_SPOOL_SUPPORT
+    /* kept while offline, and queued behind the spooled ones to keep their order. */
+    if (cmp_impl_spooled(self, &iotx_cmp_message_info) && (!self->connected || utils_spool_count(self->spool) > 0)) {
+        ret = cmp_impl_spool(self, &send_peer, &iotx_cmp_message_info);
+#ifdef MEMORY_NO_COPY
+        recycle_memory(iotx_cmp_message_info.user_data);
+#endif
+        if (SUCCESS_RETURN == ret && self->connected) cmp_impl_set_connected(self, 1);
+
+        (*message_info)->clear(message_info);
+
+        return ret;
+    }
+#endif
+
     ret = IOT_CMP_Send(&send_peer, &iotx_cmp_message_info, NULL);
 
     dm_log_debug("ret = IOT_CMP_Send() = %d\n", ret);
 
+#if defined(IOTX_SPOOL_SUPPORT) && !defined(MEMORY_NO_COPY)
+    /* a message cmp could not send is retried once connected again. */
+    if (SUCCESS_RETURN != ret && cmp_impl_spooled(self, &iotx_cmp_message_info)) {
+        ret = cmp_impl_spool(self, &send_peer, &iotx_cmp_message_info);
+    }
+#endif
+
     (*message_info)->clear(message_info);
 
     return ret;
@@ -214,6 +384,9 @@ static const cmp_abstract_t _cmp_impl_class = {
 #ifndef CMP_SUPPORT_MULTI_THREAD
     cmp_impl_yield,
 #endif
+#ifdef IOTX_SPOOL_SUPPORT
+    cmp_impl_set_connected,
+#endif
 };
 
 const void* get_cmp_impl_class()
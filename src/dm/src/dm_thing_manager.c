@@ -138,6 +138,9 @@ static void cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* msg, void* u
     iotx_cmp_event_result_t* cmp_event_result;
     dm_thing_manager_t* dm_thing_manager = user_data;
     const char* event_str = NULL;
+#ifdef IOTX_SPOOL_SUPPORT
+    cmp_abstract_t** cmp = dm_thing_manager->_cmp;
+#endif
 
     dm_printf("%s", string_cmp_event_handler_prompt_start);
     if (IOTX_CMP_EVENT_REGISTER_RESULT == msg->event_id) {
@@ -160,12 +163,18 @@ static void cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* msg, void* u
     } else if (IOTX_CMP_EVENT_CLOUD_DISCONNECT == msg->event_id) {
         if (dm_thing_manager->_cloud_connected) {
             dm_thing_manager->_cloud_connected = 0;
+#ifdef IOTX_SPOOL_SUPPORT
+            (*cmp)->set_connected(cmp, 0);
+#endif
             invoke_callback_list(dm_thing_manager, dm_callback_type_cloud_disconnected);
         }
         event_str = string_cmp_event_type_cloud_disconnect;
     } else if (IOTX_CMP_EVENT_CLOUD_RECONNECT == msg->event_id) {
         if (dm_thing_manager->_cloud_connected == 0) {
             dm_thing_manager->_cloud_connected = 1;
+#ifdef IOTX_SPOOL_SUPPORT
+            (*cmp)->set_connected(cmp, 1);
+#endif
             invoke_callback_list(dm_thing_manager, dm_callback_type_cloud_connected);
         }
         event_str = string_cmp_event_type_cloud_reconnect;
@@ -184,6 +193,10 @@ static void cmp_event_handler(void* pcontext, iotx_cmp_event_msg_t* msg, void* u
 
             local_thing_list_iterator(dm_thing_manager, local_thing_generate_subscribe_uri);
 
+#ifdef IOTX_SPOOL_SUPPORT
+            (*cmp)->set_connected(cmp, 1);
+#endif
+
             invoke_callback_list(dm_thing_manager, dm_callback_type_cloud_connected);
         }
         event_str = string_cmp_event_type_cloud_connected;
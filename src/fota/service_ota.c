@@ -10,6 +10,9 @@
 #include "iot_export_cmp.h"
 #include "iot_export_errno.h"
 #include "lite-utils.h"
+#include "utils_digest.h"
+#include "utils_delta.h"
+#include "utils_bwriter.h"
 
 
 static void service_ota_handler(void* pcontext, iotx_cmp_fota_parameter_t* ota_parameter, void* user_data)
@@ -73,6 +76,11 @@ static void* service_ota_ctor(void* _self, va_list* params)
     self->_data_buf = NULL;
     self->_data_buf_length = 0;
     self->_ota_inited = 0;
+    self->_digest = NULL;
+    self->_digest_type = UTILS_DIGEST_MD5;
+    self->_digest_expected = NULL;
+    self->_delta = NULL;
+    self->_writer = NULL;
     self->_current_verison = service_ota_lite_malloc(FIRMWARE_VERSION_MAXLEN);
     if (self->_current_verison == NULL) return NULL;
     memset(self->_current_verison, 0x0, FIRMWARE_VERSION_MAXLEN);
@@ -100,15 +108,62 @@ static void* service_ota_dtor(void* _self)
     self->_data_buf_length = 0;
     if (self->_ota_version) service_ota_lite_free(self->_ota_version);
     if (self->_current_verison) service_ota_lite_free(self->_current_verison);
+    if (self->_digest) service_ota_lite_free(self->_digest);
+    if (self->_digest_expected) service_ota_lite_free(self->_digest_expected);
+    if (self->_delta) service_ota_lite_free(self->_delta);
+    if (self->_writer) service_ota_lite_free(self->_writer);
 
     return self;
 }
 
+/* write the next piece of the new image, hashing it while it is still in cache. */
+static int service_ota_persist(void* user, const char* buf, uint32_t len)
+{
+    service_ota_t* self = user;
+    int ret;
+
+    if (self->_writer) {
+        ret = utils_bwriter_write(self->_writer, buf, len);
+    } else {
+        ret = HAL_Firmware_Persistence_Write((char*)buf, len);
+    }
+
+    if (ret == 0 && self->_digest) utils_digest_update(self->_digest, buf, len);
+
+    return ret;
+}
+
+static int service_ota_write_async(void* user, char* buf, uint32_t len)
+{
+    return HAL_Firmware_Persistence_WriteAsync(buf, len);
+}
+
+static int service_ota_write_wait(void* user)
+{
+    return HAL_Firmware_Persistence_Wait();
+}
+
+static int service_ota_read_running(void* user, uint32_t offset, char* buf, uint32_t len)
+{
+    return HAL_Firmware_Persistence_Read(offset, buf, len);
+}
+
 static void service_ota_start(void* _self)
 {
     service_ota_t* self = _self;
 
-    self = self;
+    if (self->_digest == NULL) self->_digest = service_ota_lite_malloc(sizeof(utils_digest_t));
+    if (self->_digest) utils_digest_starts(self->_digest, self->_digest_type);
+
+    /* the delta buffer follows the delta state. */
+    if (self->_delta == NULL) self->_delta = service_ota_lite_malloc(sizeof(utils_delta_t) + CONFIG_FOTA_DELTA_BUFFER_SIZE);
+    if (self->_delta) utils_delta_init(self->_delta, (char*)self->_delta + sizeof(utils_delta_t), CONFIG_FOTA_DELTA_BUFFER_SIZE,
+                                       service_ota_read_running, service_ota_persist, self);
+
+    /* the two blocks follow the writer state. */
+    if (self->_writer == NULL) self->_writer = service_ota_lite_malloc(sizeof(utils_bwriter_t) + 2 * CONFIG_FOTA_WRITE_BLOCK_SIZE);
+    if (self->_writer) utils_bwriter_init(self->_writer, (char*)self->_writer + sizeof(utils_bwriter_t), CONFIG_FOTA_WRITE_BLOCK_SIZE,
+                                          service_ota_write_async, service_ota_write_wait, self);
 
     HAL_Firmware_Persistence_Start();
 }
@@ -116,23 +171,50 @@ static void service_ota_start(void* _self)
 static int service_ota_write(void* _self, void* data, int data_length)
 {
     service_ota_t* self = _self;
-    int ret;
 
     assert(self->_data_buf_length >= data_length && data_length  && self->_data_buf == data);
 
     self->_data_buf = data;
 
-    ret = HAL_Firmware_Persistence_Write(self->_data_buf, data_length);
+    if (self->_delta) return utils_delta_feed(self->_delta, self->_data_buf, data_length);
 
-    return ret;
+    return service_ota_persist(self, self->_data_buf, data_length);
 }
 
 static int service_ota_end(void* _self)
 {
     service_ota_t* self = _self;
+    utils_delta_t* delta = self->_delta;
+    char digest[UTILS_DIGEST_HEX_MAXLEN];
+    int written = self->_total_len;
     int ret;
 
-    self = self;
+    if (delta) {
+        if (utils_delta_finish(delta)) return -1;
+
+        if (delta->is_delta) log_info("delta applied: %d bytes fetched", self->_total_len);
+        written = delta->written;
+
+        /* a delta builds the image out of the running one, it is only taken once the result is checked. */
+        if (delta->is_delta && (self->_digest == NULL || self->_digest_expected == NULL)) {
+            log_err("no digest set to check the image built by the delta");
+            return -1;
+        }
+    }
+
+    if (self->_writer && utils_bwriter_flush(self->_writer)) return -1;
+
+    if (self->_digest) {
+        ret = utils_digest_verify(self->_digest, self->_digest_expected, digest);
+
+        log_info("image written: %d bytes, %s %s", written,
+                 self->_digest_type == UTILS_DIGEST_SHA256 ? "sha256" : "md5", digest);
+
+        if (ret && self->_digest_expected) {
+            log_err("image digest mismatch, expected %s", self->_digest_expected);
+            return -1;
+        }
+    }
 
     /* this function should not return... */
     ret = HAL_Firmware_Persistence_Stop();
@@ -211,11 +293,40 @@ err_handler:
         ret = -1;
     }
 
+    /* no block may be left in writing, its buffer is reused by the next image, and nothing more of
+     * a failed image is written, not even the block being filled. */
+    if (ret && self->_writer) utils_bwriter_abort(self->_writer);
+
     if (iotx_cmp_ota) service_ota_lite_free(iotx_cmp_ota);
 
+    /* the digest set belongs to this image only. */
+    if (self->_digest_expected) service_ota_lite_free(self->_digest_expected);
+    self->_digest_type = UTILS_DIGEST_MD5;
+
     return ret;
 }
 
+static int service_ota_set_digest(void* _self, const char* sign_method, const char* digest)
+{
+    service_ota_t* self = _self;
+    int type = utils_digest_type(sign_method);
+
+    if (type < 0 || digest == NULL || strlen(digest) >= UTILS_DIGEST_HEX_MAXLEN) {
+        log_err("unsupported digest %s", sign_method ? sign_method : "");
+        return -1;
+    }
+
+    if (self->_digest_expected) service_ota_lite_free(self->_digest_expected);
+
+    self->_digest_expected = service_ota_lite_calloc(1, strlen(digest) + 1);
+    if (self->_digest_expected == NULL) return -1;
+
+    strcpy(self->_digest_expected, digest);
+    self->_digest_type = type;
+
+    return 0;
+}
+
 static void service_ota_install_callback_function(void* _self, handle_service_fota_callback_fp_t linkkit_callback_fp)
 {
     service_ota_t* self = _self;
@@ -258,6 +369,7 @@ static const fota_t _service_ota_class = {
     service_ota_end,
     service_ota_perform_ota_service,
     service_ota_install_callback_function,
+    service_ota_set_digest,
 };
 
 const void* get_service_ota_class()
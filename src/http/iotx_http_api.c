@@ -103,15 +103,14 @@ static iotx_http_t *iotx_http_context_bak = NULL;
   body: {"version":"default","clientId":"xxxxx","signmethod":"hmacsha1","sign":"xxxxxxxxxx","productKey":"xxxxxx","deviceName":"xxxxxxx","timestamp":"xxxxxxx"}
 */
 
-static int iotx_calc_sign(const char *p_device_secret, const char *p_msg, char *sign)
+static int iotx_calc_sign(const utils_hmac_t *p_hmac, const char *p_msg, char *sign)
 {
 #if USING_SHA1_IN_HMAC
     log_info("| method: %s", IOTX_SHA_METHOD);
-    utils_hmac_sha1(p_msg, strlen(p_msg), sign, p_device_secret, strlen(p_device_secret));
 #else
     log_info("| method: %s", IOTX_MD5_METHOD);
-    utils_hmac_md5(p_msg, strlen(p_msg), sign, p_device_secret, strlen(p_device_secret));
 #endif
+    utils_hmac_sign(p_hmac, p_msg, strlen(p_msg), sign);
     return IOTX_SUCCESS;
 }
 
@@ -244,6 +243,29 @@ static int iotx_http_report_mid(iotx_http_t *handle)
 
 }
 
+/* The upstream header only changes with the token, render it once instead of per message */
+static int iotx_http_render_header(iotx_http_t *iotx_http_context)
+{
+    int len = 0;
+
+    if (NULL != iotx_http_context->p_upstream_header) {
+        LITE_free(iotx_http_context->p_upstream_header);
+        iotx_http_context->p_upstream_header = NULL;
+    }
+
+    len = strlen(IOTX_HTTP_HEADER_PASSWORD_STR) + strlen(iotx_http_context->p_auth_token) + strlen(
+                      IOTX_HTTP_HEADER_KEEPALIVE_STR) + strlen(IOTX_HTTP_HEADER_END_STR);
+    iotx_http_context->p_upstream_header = LITE_malloc(len + 1);
+    if (NULL == iotx_http_context->p_upstream_header) {
+        log_err("Allocate memory for p_upstream_header failed");
+        return FAIL_RETURN;
+    }
+    LITE_snprintf(iotx_http_context->p_upstream_header, len + 1,
+                  IOTX_HTTP_UPSTREAM_HEADER_STR, iotx_http_context->p_auth_token);
+
+    return SUCCESS_RETURN;
+}
+
 static void *verify_iotx_http_context(void *handle)
 {
     iotx_http_t *iotx_http_context = (iotx_http_t *)handle;
@@ -263,6 +285,7 @@ void *IOT_HTTP_Init(iotx_http_param_t *pInitParams)
 {
     iotx_device_info_t *p_devinfo;
     iotx_http_t        *iotx_http_context;
+    int                 ret;
 
     /* currently http is singleton, init twice not allowed. */
     if (NULL != iotx_http_context_bak) {
@@ -323,6 +346,24 @@ void *IOT_HTTP_Init(iotx_http_param_t *pInitParams)
     }
     memset(iotx_http_context->httpc, 0x00, sizeof(httpclient_t));
 
+    /* the secret is fixed, so each auth only hashes the sign source */
+    iotx_http_context->p_hmac = LITE_malloc(sizeof(utils_hmac_t));
+    if (NULL == iotx_http_context->p_hmac) {
+        log_err("Allocate memory for iotx_http_context->p_hmac failed");
+        goto err;
+    }
+#if USING_SHA1_IN_HMAC
+    ret = utils_hmac_init(iotx_http_context->p_hmac, UTILS_HMAC_SHA1,
+                          iotx_http_context->p_devinfo->device_secret, strlen(iotx_http_context->p_devinfo->device_secret));
+#else
+    ret = utils_hmac_init(iotx_http_context->p_hmac, UTILS_HMAC_MD5,
+                          iotx_http_context->p_devinfo->device_secret, strlen(iotx_http_context->p_devinfo->device_secret));
+#endif
+    if (0 != ret) {
+        log_err("Invalid device secret");
+        goto err;
+    }
+
     iotx_http_context_bak = iotx_http_context;
 
     return iotx_http_context;
@@ -335,6 +376,12 @@ err:
         if (NULL != iotx_http_context->p_auth_token) {
             LITE_free(iotx_http_context->p_auth_token);
         }
+        if (NULL != iotx_http_context->httpc) {
+            LITE_free(iotx_http_context->httpc);
+        }
+        if (NULL != iotx_http_context->p_hmac) {
+            LITE_free(iotx_http_context->p_hmac);
+        }
 
         iotx_http_context->auth_token_len = 0;
         LITE_free(iotx_http_context);
@@ -360,8 +407,16 @@ void IOT_HTTP_DeInit(void **handle)
         LITE_free(iotx_http_context->p_auth_token);
     }
     if (NULL != iotx_http_context->httpc) {
+        httpclient_close(iotx_http_context->httpc);
         LITE_free(iotx_http_context->httpc);
     }
+    if (NULL != iotx_http_context->p_upstream_header) {
+        LITE_free(iotx_http_context->p_upstream_header);
+    }
+    if (NULL != iotx_http_context->p_hmac) {
+        utils_hmac_free(iotx_http_context->p_hmac);
+        LITE_free(iotx_http_context->p_hmac);
+    }
 
     iotx_http_context->auth_token_len = 0;
     LITE_free(iotx_http_context);
@@ -422,7 +477,7 @@ int IOT_HTTP_DeviceNameAuth(void *handle)
 #endif
                  );
 
-    iotx_calc_sign(iotx_http_context->p_devinfo->device_secret, p_msg_unsign, sign);
+    iotx_calc_sign(iotx_http_context->p_hmac, p_msg_unsign, sign);
 
     /* to save stack memory*/
     len = calc_snprintf_string_length(IOTX_HTTP_AUTH_DEVICENAME_STR,
@@ -567,10 +622,14 @@ int IOT_HTTP_DeviceNameAuth(void *handle)
     }
 
     strcpy(iotx_http_context->p_auth_token, pvalue);
-    iotx_http_context->is_authed = 1;
     LITE_free(pvalue);
     pvalue = NULL;
 
+    if (SUCCESS_RETURN != iotx_http_render_header(iotx_http_context)) {
+        goto do_exit;
+    }
+    iotx_http_context->is_authed = 1;
+
     //log_info("iotToken: %s", iotx_http_context->p_auth_token);
 
     /* report module id */
@@ -599,111 +658,117 @@ do_exit:
     return ret;
 }
 
-int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
+static int iotx_http_check_message(iotx_http_message_param_t *msg_param)
 {
-    int                 ret = -1;
-    int                 response_code = 0;
-    char               *pvalue = NULL;
-    char                http_url[IOTX_HTTP_URL_LEN_MAX] = {0};
-    httpclient_t       *httpc = NULL;
-    httpclient_data_t   httpc_data = {0};
-    char               *messageId = NULL;
-    char               *user_data = NULL;
-    char               *response_message = NULL;
-    int                 len = 0;
     uint32_t            payload_len = 0;
-    iotx_time_t         timer;
-    iotx_http_t        *iotx_http_context;
-    /*
-        POST /topic/${topic} HTTP/1.1
-        Host: iot-as-http.cn-shanghai.aliyuncs.com
-        password:${token}
-        Content-Type: application/octet-stream
-        body: ${your_data}
-    */
-    if (NULL == (iotx_http_context = verify_iotx_http_context(handle))) {
-        goto do_exit;
-    }
 
     if (NULL == msg_param) {
         log_err("iotx_http_context or msg_param NULL pointer!");
-        goto do_exit;
-    }
-
-    httpc = (httpclient_t *)iotx_http_context->httpc;
-
-    if (NULL == httpc) {
-        log_err("httpc null pointer");
-        goto do_exit;
-    }
-
-    if (0 == iotx_http_context->is_authed) {
-        log_err("Device is not authed");
-        goto do_exit;
+        return FAIL_RETURN;
     }
 
     if (NULL == msg_param->request_payload) {
         log_err("IOT_HTTP_SendMessage request_payload NULL!");
-        goto do_exit;
+        return FAIL_RETURN;
     }
 
     if (NULL == msg_param->response_payload) {
         log_err("IOT_HTTP_SendMessage response_payload NULL!");
-        goto do_exit;
+        return FAIL_RETURN;
     }
 
     if (NULL == msg_param->topic_path) {
         log_err("IOT_HTTP_SendMessage topic_path NULL!");
-        goto do_exit;
+        return FAIL_RETURN;
     }
 
     payload_len = strlen(msg_param->request_payload) + 1;
     msg_param->request_payload_len = msg_param->request_payload_len > payload_len \
                                      ? payload_len : msg_param->request_payload_len;
 
+    return SUCCESS_RETURN;
+}
+
+/* Write the request without waiting for its response, a reused keep-alive connection may have been
+ * closed by server while idle, so the request is sent once more on a new connection if allowed */
+static int iotx_http_send_request(iotx_http_t *iotx_http_context, iotx_http_message_param_t *msg_param,
+                                  httpclient_data_t *httpc_data, int retry)
+{
+    int                 ret = -1;
+    char                http_url[IOTX_HTTP_URL_LEN_MAX] = {0};
+    httpclient_t       *httpc = (httpclient_t *)iotx_http_context->httpc;
+    /*
+        POST /topic/${topic} HTTP/1.1
+        Host: iot-as-http.cn-shanghai.aliyuncs.com
+        password:${token}
+        Content-Type: application/octet-stream
+        body: ${your_data}
+    */
+
     /* Construct Auth Url */
     construct_full_http_upstream_url(http_url, msg_param->topic_path);
 
-    len = strlen(IOTX_HTTP_HEADER_PASSWORD_STR) + strlen(iotx_http_context->p_auth_token) + strlen(
-                      IOTX_HTTP_HEADER_KEEPALIVE_STR) + strlen(IOTX_HTTP_HEADER_END_STR);
-    httpc->header = LITE_malloc(len + 1);
-    if (NULL == httpc->header) {
-        log_err("Allocate memory for httpc->header failed");
-        goto do_exit;
-    }
-    LITE_snprintf(httpc->header, len + 1,
-                  IOTX_HTTP_UPSTREAM_HEADER_STR, iotx_http_context->p_auth_token);
+    httpc->header = iotx_http_context->p_upstream_header;
     log_info("httpc->header = %s", httpc->header);
 
-    httpc_data.post_content_type = "application/octet-stream";
-    httpc_data.post_buf = msg_param->request_payload;
-    httpc_data.post_buf_len = msg_param->request_payload_len;
-    httpc_data.response_buf = msg_param->response_payload;
-    httpc_data.response_buf_len = msg_param->response_payload_len;
+    memset(httpc_data, 0, sizeof(httpclient_data_t));
+    httpc_data->post_content_type = "application/octet-stream";
+    httpc_data->post_buf = msg_param->request_payload;
+    httpc_data->post_buf_len = msg_param->request_payload_len;
+    httpc_data->response_buf = msg_param->response_payload;
+    httpc_data->response_buf_len = msg_param->response_payload_len;
+
+    log_info("request_payload: \r\n\r\n%s\r\n", httpc_data->post_buf);
+
+    retry = retry && (0 != httpc->net.handle);
+    ret = iotx_post(httpc,
+                    http_url,
+                    IOTX_HTTP_ONLINE_SERVER_PORT,
+                    IOTX_HTTP_CA_GET,
+                    httpc_data);
+    if (0 != ret && retry) {
+        log_info("keep-alive connection lost, send on a new connection");
+        ret = iotx_post(httpc,
+                        http_url,
+                        IOTX_HTTP_ONLINE_SERVER_PORT,
+                        IOTX_HTTP_CA_GET,
+                        httpc_data);
+    }
 
-    log_info("request_payload: \r\n\r\n%s\r\n", httpc_data.post_buf);
+    return ret;
+}
+
+/* Read the response of the oldest request in flight, it clears is_authed if the token expired */
+static int iotx_http_recv_response(iotx_http_t *iotx_http_context, iotx_http_message_param_t *msg_param,
+                                   httpclient_data_t *httpc_data)
+{
+    int                 ret = -1;
+    int                 response_code = 0;
+    char               *pvalue = NULL;
+    char               *messageId = NULL;
+    char               *user_data = NULL;
+    char               *response_message = NULL;
+    httpclient_t       *httpc = (httpclient_t *)iotx_http_context->httpc;
+    iotx_time_t         timer;
 
-    /* Send Request and Get Response */
-    if (iotx_post(httpc,
-                  http_url,
-                  IOTX_HTTP_ONLINE_SERVER_PORT,
-                  IOTX_HTTP_CA_GET,
-                  &httpc_data)) {
-        goto do_exit_pre;
-    }
     iotx_time_init(&timer);
     utils_time_countdown_ms(&timer, msg_param->timeout_ms);
 
-    ret = httpclient_recv_response(httpc, iotx_time_left(&timer), &httpc_data);
+    ret = httpclient_recv_response(httpc, iotx_time_left(&timer), httpc_data);
     if (ret < 0) {
         log_err("httpclient_recv_response error, ret = %d", ret);
         httpclient_close(httpc);
-        goto do_exit_pre;
+        return FAIL_RETURN;
     }
-
-    if (0 == iotx_http_context->keep_alive) {
+    if (ret > 0) {
+        /* the rest of the body is still unread, the connection can not carry another response */
+        log_err("response_payload_len %d too small", msg_param->response_payload_len);
+        httpclient_close(httpc);
+    } else if (httpc->conn_close) {
+        log_info("connection closed by server");
         httpclient_close(httpc);
     }
+    ret = FAIL_RETURN;
 
     /*
         body:
@@ -716,11 +781,11 @@ int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
           }
         }
     */
-    log_info("http response: \r\n\r\n%s\r\n", httpc_data.response_buf);
+    log_info("http response: \r\n\r\n%s\r\n", httpc_data->response_buf);
 
-    pvalue = LITE_json_value_of("code", httpc_data.response_buf);
+    pvalue = LITE_json_value_of("code", httpc_data->response_buf);
     if (!pvalue) {
-        goto do_exit_pre;
+        goto do_exit;
     }
 
     response_code = atoi(pvalue);
@@ -728,9 +793,9 @@ int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
     pvalue = NULL;
     log_info("response code: %d", response_code);
 
-    pvalue = LITE_json_value_of("message", httpc_data.response_buf);
+    pvalue = LITE_json_value_of("message", httpc_data->response_buf);
     if (NULL == pvalue) {
-        goto do_exit_pre;
+        goto do_exit;
     }
     response_message = LITE_strdup(pvalue);
     log_info("response_message: %s", response_message);
@@ -742,7 +807,6 @@ int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
             break;
         case IOTX_HTTP_TOKEN_EXPIRED_ERROR:
             iotx_http_context->is_authed = IOT_FALSE;
-            IOT_HTTP_DeviceNameAuth((iotx_http_t *)iotx_http_context);
         case IOTX_HTTP_COMMON_ERROR:
         case IOTX_HTTP_PARAM_ERROR:
         case IOTX_HTTP_AUTH_CHECK_ERROR:
@@ -752,14 +816,14 @@ int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
         case IOTX_HTTP_PUBLISH_MESSAGE_ERROR:
         case IOTX_HTTP_REQUEST_TOO_MANY_ERROR:
         default:
-            goto do_exit_pre;
+            goto do_exit;
     }
 
     /* info.messageId */
-    pvalue = LITE_json_value_of("info.messageId", httpc_data.response_buf);
+    pvalue = LITE_json_value_of("info.messageId", httpc_data->response_buf);
     if (NULL == pvalue) {
         log_err("messageId: NULL");
-        goto do_exit_pre;
+        goto do_exit;
     }
     messageId = pvalue;
     log_info("messageId: %s", messageId);
@@ -767,7 +831,7 @@ int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
     pvalue = NULL;
 
     /* info.data */
-    pvalue = LITE_json_value_of("info.data", httpc_data.response_buf);
+    pvalue = LITE_json_value_of("info.data", httpc_data->response_buf);
     user_data = pvalue;
 
     /* Maybe NULL */
@@ -781,10 +845,9 @@ int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
     }
     pvalue = NULL;
 
-    ret = 0;
-
-do_exit_pre:
+    ret = SUCCESS_RETURN;
 
+do_exit:
     if (pvalue) {
         LITE_free(pvalue);
     }
@@ -793,16 +856,110 @@ do_exit_pre:
         LITE_free(response_message);
     }
 
+    return ret;
+}
+
+static void iotx_http_request_done(iotx_http_t *iotx_http_context)
+{
+    if (0 == iotx_http_context->keep_alive) {
+        httpclient_close(iotx_http_context->httpc);
+    }
+
+    if (IOT_FALSE == iotx_http_context->is_authed) {
+        IOT_HTTP_DeviceNameAuth((iotx_http_t *)iotx_http_context);
+    }
+}
+
+int IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param)
+{
+    int                 ret = -1;
+    httpclient_data_t   httpc_data = {0};
+    iotx_http_t        *iotx_http_context;
+
+    if (NULL == (iotx_http_context = verify_iotx_http_context(handle))) {
+        goto do_exit;
+    }
+
+    if (NULL == iotx_http_context->httpc) {
+        log_err("httpc null pointer");
+        goto do_exit;
+    }
+
+    if (0 == iotx_http_context->is_authed) {
+        log_err("Device is not authed");
+        goto do_exit;
+    }
 
-    if (httpc != NULL && httpc->header) {
-        LITE_free(httpc->header);
+    if (SUCCESS_RETURN != iotx_http_check_message(msg_param)) {
+        goto do_exit;
     }
 
+    /* Send Request and Get Response */
+    if (0 != iotx_http_send_request(iotx_http_context, msg_param, &httpc_data, 1)) {
+        goto do_exit;
+    }
+
+    ret = iotx_http_recv_response(iotx_http_context, msg_param, &httpc_data);
+    iotx_http_request_done(iotx_http_context);
+
 do_exit:
 
     return ret;
 }
 
+int IOT_HTTP_SendMessages(void *handle, iotx_http_message_param_t *msg_params, int count)
+{
+    int                 sent = 0;
+    int                 done = 0;
+    httpclient_data_t   httpc_data[IOTX_HTTP_PIPELINE_DEPTH];
+    iotx_http_t        *iotx_http_context;
+
+    if (NULL == (iotx_http_context = verify_iotx_http_context(handle))) {
+        return FAIL_RETURN;
+    }
+
+    if (NULL == iotx_http_context->httpc || NULL == msg_params || count <= 0) {
+        log_err("Invalid argument: httpc, msg_params or count");
+        return FAIL_RETURN;
+    }
+
+    if (0 == iotx_http_context->is_authed) {
+        log_err("Device is not authed");
+        return FAIL_RETURN;
+    }
+
+    while (done < count) {
+        /* keep the pipeline full, the responses come back in request order */
+        while (sent < count && sent - done < IOTX_HTTP_PIPELINE_DEPTH) {
+            if (SUCCESS_RETURN != iotx_http_check_message(&msg_params[sent])
+                || 0 != iotx_http_send_request(iotx_http_context, &msg_params[sent],
+                                               &httpc_data[sent % IOTX_HTTP_PIPELINE_DEPTH], sent == done)) {
+                break;
+            }
+            sent++;
+        }
+        if (sent == done) {
+            break;
+        }
+
+        if (SUCCESS_RETURN != iotx_http_recv_response(iotx_http_context, &msg_params[done],
+                                                      &httpc_data[done % IOTX_HTTP_PIPELINE_DEPTH])) {
+            break;
+        }
+        done++;
+    }
+
+    if (done < sent) {
+        /* responses still in flight can not be matched to the requests any more */
+        log_err("%d pipelined requests dropped", sent - done);
+        httpclient_close(iotx_http_context->httpc);
+    }
+    iotx_http_request_done(iotx_http_context);
+
+    log_debug("%d of %d messages sent", done, count);
+    return done;
+}
+
 void IOT_HTTP_Disconnect(void *handle)
 {
     iotx_http_t *iotx_http_context;
@@ -0,0 +1,1232 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "iot_export.h"
+#include "lite-list.h"
+#include "utils_net.h"
+#include "utils_timer.h"
+#include "utils_topic_trie.h"
+#include "sdk-impl_internal.h"
+
+#include "MQTTPacket/MQTTPacket.h"
+
+#define IOTX_MQTT_MGR_KEEPALIVE_DEFAULT_MS  (60 * 1000)
+#define IOTX_MQTT_MGR_TIMEOUT_DEFAULT_MS    (2000)
+#define IOTX_MQTT_MGR_BUF_SIZE_DEFAULT      (1024)
+#define IOTX_MQTT_MGR_BATCH_MAX             (64)    /* queued messages gathered into one write */
+#define IOTX_MQTT_MGR_MATCH_MAX             (16)    /* handlers of a message collected on the stack */
+
+/* The publish queue is shared with other threads, the rest of the manager is not */
+#define IOTX_MQTT_MGR_LOAD(p)               __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define IOTX_MQTT_MGR_STORE(p, v)           __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define IOTX_MQTT_MGR_ADD(p, v)             __atomic_add_fetch((p), (v), __ATOMIC_RELAXED)
+#define IOTX_MQTT_MGR_CAS(p, e, v)          __atomic_compare_exchange_n((p), (e), (v), 1, \
+                                                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#define IOTX_MQTT_MGR_FENCE()               __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+typedef enum {
+    IOTX_MQTT_MGR_STATE_DISCONNECTED = 0,
+    IOTX_MQTT_MGR_STATE_CONNECTING,         /* CONNECT sent, waiting for CONNACK */
+    IOTX_MQTT_MGR_STATE_CONNECTED,
+} iotx_mqtt_mgr_state_t;
+
+typedef struct {
+    char                               *topic_filter;
+    iotx_mqtt_qos_t                     qos;
+    iotx_mqtt_event_handle_t            handle;
+    struct list_head                    linked;
+} iotx_mqtt_mgr_sub_t;
+
+typedef struct iotx_mqtt_mgr_st iotx_mqtt_mgr_t;
+
+/* A message of IOT_MQTT_Mgr_PublishTracked() waiting for PUBACK, the packet follows it */
+typedef struct iotx_mqtt_mgr_inflight_st iotx_mqtt_mgr_inflight_t;
+struct iotx_mqtt_mgr_inflight_st {
+    struct list_head                    linked;         /* in s->inflight, in the order published */
+    iotx_mqtt_mgr_inflight_t           *hnext;          /* next in the same bucket of s->inflight_index */
+    uint16_t                            packet_id;
+    uint8_t                             sent;           /* written once, so it is sent again with DUP */
+    iotx_mqtt_mgr_complete_func_fpt     complete;
+    void                               *pcontext;
+    uint32_t                            len;
+};
+
+typedef struct {
+    iotx_mqtt_mgr_t                    *mgr;
+    struct list_head                    linked;         /* in mgr->sessions */
+    struct list_head                    timer;          /* in the schedule list of the state, see iotx_mqtt_mgr_st */
+    uint64_t                            timer_ms;       /* when it was put in that list */
+    iotx_mqtt_mgr_state_t               state;
+    uint8_t                             ping_sent;      /* waiting for PINGRESP */
+    uint8_t                             connected_once;
+    uint8_t                             removed;        /* waits in mgr->removed to be freed */
+    uint32_t                            packet_seq;     /* packet ids are taken by other threads too */
+    MQTTPacket_connectData              connect_data;
+    utils_network_t                     net;
+    iotx_mqtt_event_handle_t            handle_event;
+    struct list_head                    subs;           /* in the order subscribed, to resubscribe */
+    utils_topic_trie_t                 *subs_trie;      /* the same subscriptions, to match topics */
+    char                               *buf_read;
+    uint32_t                            read_len;       /* bytes of incomplete packets in buf_read */
+    struct list_head                    inflight;       /* QoS1 messages waiting for PUBACK */
+    iotx_mqtt_mgr_inflight_t          **inflight_index; /* the same messages by packet id, see inflight_mask */
+    uint32_t                            inflight_num;
+} iotx_mqtt_mgr_session_t;
+
+/* A PUBLISH serialized by IOT_MQTT_Mgr_PublishAsync(), the packet follows it */
+typedef struct {
+    iotx_mqtt_mgr_session_t            *session;
+    uint64_t                            enqueue_ms;
+    uint32_t                            len;
+} iotx_mqtt_mgr_msg_t;
+
+/* A slot is free for the producer at position 'pos' if seq == pos, and holds
+ * a message for the consumer if seq == pos + 1. */
+typedef struct {
+    uint32_t                            seq;
+    iotx_mqtt_mgr_msg_t                *msg;
+} iotx_mqtt_mgr_slot_t;
+
+/* A session is in one of the schedule lists but while it is connected and
+ * idle. Each list has one interval, so appending at the tail keeps it in
+ * expiry order and only the head has to be checked. */
+struct iotx_mqtt_mgr_st {
+    void                               *loop;
+    struct list_head                    sessions;
+    struct list_head                    idle;           /* connected, ordered by the last packet sent */
+    struct list_head                    wait;           /* CONNACK or PINGRESP outstanding */
+    struct list_head                    retry;          /* disconnected, waiting to reconnect */
+    uint32_t                            keepalive_interval_ms;
+    uint32_t                            request_timeout_ms;
+    uint32_t                            reconnect_interval_ms;
+    char                               *buf_send;
+    uint32_t                            buf_size_send;
+    uint32_t                            buf_size_read;
+    uint32_t                            inflight_window;
+    uint32_t                            inflight_mask;  /* buckets of inflight_index minus 1 */
+    struct list_head                    removed;        /* freed once no queued message refers to them */
+
+    /* bounded MPSC publish queue, the manager thread is the consumer */
+    iotx_mqtt_mgr_slot_t               *queue;
+    uint32_t                            queue_mask;
+    uint32_t                            dequeue_pos;
+    uint32_t                            enqueue_pos;
+    uint32_t                            producers;      /* IOT_MQTT_Mgr_PublishAsync() calls in progress */
+    uint32_t                            sleeping;       /* the manager thread waits in HAL_EventLoop_Run() */
+    iotx_mqtt_mgr_stats_t               stats;
+};
+
+/* bucket 0 counts 0, bucket i counts [2^(i-1), 2^i), the last one counts the rest */
+static void iotx_mqtt_mgr_hist_add(uint32_t *hist, uint32_t value)
+{
+    int i = 0;
+
+    while (value > 0 && i < IOTX_MQTT_MGR_HIST_NUM - 1) {
+        value >>= 1;
+        i++;
+    }
+    IOTX_MQTT_MGR_ADD(&hist[i], 1);
+}
+
+static int iotx_mqtt_mgr_connect(iotx_mqtt_mgr_session_t *s);
+static int iotx_mqtt_mgr_sent(iotx_mqtt_mgr_session_t *s, int ret, int len);
+
+static iotx_mqtt_mgr_inflight_t **iotx_mqtt_mgr_inflight_find(iotx_mqtt_mgr_session_t *s, uint16_t packet_id)
+{
+    iotx_mqtt_mgr_inflight_t **pp = &s->inflight_index[packet_id & s->mgr->inflight_mask];
+
+    while (NULL != *pp && (*pp)->packet_id != packet_id) {
+        pp = &(*pp)->hnext;
+    }
+    return pp;
+}
+
+/* Unlink the message of 'packet_id' and complete it, 0 if it is not tracked */
+static int iotx_mqtt_mgr_inflight_complete(iotx_mqtt_mgr_session_t *s, uint16_t packet_id, int result)
+{
+    iotx_mqtt_mgr_inflight_t **pp, *m;
+
+    if (0 == s->inflight_num) {
+        return 0;
+    }
+    pp = iotx_mqtt_mgr_inflight_find(s, packet_id);
+    if (NULL == (m = *pp)) {
+        return 0;
+    }
+    *pp = m->hnext;
+    list_del(&m->linked);
+    s->inflight_num--;
+
+    /* unlinked first, the callback may publish the next message */
+    if (NULL != m->complete) {
+        m->complete(m->pcontext, s, packet_id, result);
+    }
+    HAL_Free(m);
+    return 1;
+}
+
+static void iotx_mqtt_mgr_inflight_fail(iotx_mqtt_mgr_session_t *s, int result)
+{
+    while (!list_empty(&s->inflight)) {
+        iotx_mqtt_mgr_inflight_complete(s, list_first_entry(&s->inflight, iotx_mqtt_mgr_inflight_t, linked)->packet_id,
+                                        result);
+    }
+}
+
+/* Send the tracked messages again after CONNACK, in the order published */
+static void iotx_mqtt_mgr_inflight_resend(iotx_mqtt_mgr_session_t *s)
+{
+    hal_iovec_t iov[IOTX_MQTT_MGR_BATCH_MAX];
+    iotx_mqtt_mgr_inflight_t *m;
+    int count = 0, len = 0;
+
+    list_for_each_entry(m, &s->inflight, linked, iotx_mqtt_mgr_inflight_t) {
+        if (m->sent) {
+            *(unsigned char *)(m + 1) |= 0x08;      /* DUP */
+        }
+        m->sent = 1;
+        iov[count].buf = (const char *)(m + 1);
+        iov[count].len = m->len;
+        len += m->len;
+        if (++count == IOTX_MQTT_MGR_BATCH_MAX || m->linked.next == &s->inflight) {
+            if (SUCCESS_RETURN != iotx_mqtt_mgr_sent(s, s->net.writev(&s->net, iov, count, s->mgr->request_timeout_ms),
+                                                     len)) {
+                return;
+            }
+            count = 0;
+            len = 0;
+        }
+    }
+}
+
+static void iotx_mqtt_mgr_schedule(iotx_mqtt_mgr_session_t *s, struct list_head *list)
+{
+    s->timer_ms = HAL_UptimeMs();
+    list_move_tail(&s->timer, list);
+}
+
+static void iotx_mqtt_mgr_event(iotx_mqtt_mgr_session_t *s, iotx_mqtt_event_type_t type, void *msg)
+{
+    iotx_mqtt_event_msg_t event;
+
+    if (NULL == s->handle_event.h_fp) {
+        return;
+    }
+    event.event_type = type;
+    event.msg = msg;
+    s->handle_event.h_fp(s->handle_event.pcontext, s, &event);
+}
+
+static void iotx_mqtt_mgr_disconnect(iotx_mqtt_mgr_session_t *s, const char *reason)
+{
+    iotx_mqtt_mgr_t *mgr = s->mgr;
+    int connected = (IOTX_MQTT_MGR_STATE_CONNECTED == s->state);
+
+    if (IOTX_MQTT_MGR_STATE_DISCONNECTED == s->state) {
+        return;
+    }
+
+    log_info("session '%s' disconnected, %s", s->connect_data.clientID.cstring, reason);
+    HAL_EventLoop_Remove(mgr->loop, s->net.handle);
+    s->net.disconnect(&s->net);
+    s->state = IOTX_MQTT_MGR_STATE_DISCONNECTED;
+    s->ping_sent = 0;
+    s->read_len = 0;
+
+    if (0 != mgr->reconnect_interval_ms && !s->removed) {
+        iotx_mqtt_mgr_schedule(s, &mgr->retry);
+    } else {
+        list_del_init(&s->timer);
+    }
+
+    if (connected && !s->removed) {
+        iotx_mqtt_mgr_event(s, IOTX_MQTT_EVENT_DISCONNECT, (void *)reason);
+    }
+    if (0 == mgr->reconnect_interval_ms && !s->removed) {
+        iotx_mqtt_mgr_inflight_fail(s, MQTT_NETWORK_ERROR);
+    }
+}
+
+static int iotx_mqtt_mgr_sent(iotx_mqtt_mgr_session_t *s, int ret, int len)
+{
+    if (ret != len) {
+        iotx_mqtt_mgr_disconnect(s, "write failed");
+        return MQTT_NETWORK_ERROR;
+    }
+
+    /* any packet counts as keep-alive */
+    if (IOTX_MQTT_MGR_STATE_CONNECTED == s->state && !s->ping_sent) {
+        iotx_mqtt_mgr_schedule(s, &s->mgr->idle);
+    }
+    return SUCCESS_RETURN;
+}
+
+/* send what is serialized in the shared write buffer */
+static int iotx_mqtt_mgr_send(iotx_mqtt_mgr_session_t *s, int len)
+{
+    if (len <= 0) {
+        log_err("serialize packet failed, len = %d", len);
+        return FAIL_RETURN;
+    }
+
+    return iotx_mqtt_mgr_sent(s, s->net.write(&s->net, s->mgr->buf_send, len, s->mgr->request_timeout_ms), len);
+}
+
+static uint16_t iotx_mqtt_mgr_next_packet_id(iotx_mqtt_mgr_session_t *s)
+{
+    return (uint16_t)(IOTX_MQTT_MGR_ADD(&s->packet_seq, 1) % 0xFFFF + 1);
+}
+
+static int iotx_mqtt_mgr_send_subscribe(iotx_mqtt_mgr_session_t *s, iotx_mqtt_mgr_sub_t *sub)
+{
+    int qos = sub->qos;
+    uint16_t id = iotx_mqtt_mgr_next_packet_id(s);
+    MQTTString topic = MQTTString_initializer;
+    int len;
+
+    topic.cstring = sub->topic_filter;
+    len = MQTTSerialize_subscribe((unsigned char *)s->mgr->buf_send, s->mgr->buf_size_send, 0, id, 1, &topic, &qos);
+    if (SUCCESS_RETURN != iotx_mqtt_mgr_send(s, len)) {
+        return MQTT_SUBSCRIBE_PACKET_ERROR;
+    }
+    return id;
+}
+
+typedef struct {
+    iotx_mqtt_event_handle_t           *handles;
+    int                                 num;
+    int                                 size;
+} iotx_mqtt_mgr_match_t;
+
+/* Handlers are copied, so they may unsubscribe while the message is delivered */
+static int iotx_mqtt_mgr_collect(void *value, void *user)
+{
+    iotx_mqtt_mgr_match_t *match = (iotx_mqtt_mgr_match_t *)user;
+
+    if (match->num < match->size) {
+        match->handles[match->num] = ((iotx_mqtt_mgr_sub_t *)value)->handle;
+    }
+    match->num++;
+    return 0;
+}
+
+static void iotx_mqtt_mgr_handle_publish(iotx_mqtt_mgr_session_t *s, unsigned char *buf, int len)
+{
+    int qos = 0;
+    unsigned char dup, retained;
+    unsigned short packet_id;
+    unsigned char *payload;
+    int payload_len;
+    MQTTString topic;
+    iotx_mqtt_topic_info_t topic_msg;
+    iotx_mqtt_event_msg_t msg;
+    iotx_mqtt_event_handle_t handles[IOTX_MQTT_MGR_MATCH_MAX];
+    iotx_mqtt_mgr_match_t match;
+    int i;
+
+    if (1 != MQTTDeserialize_publish(&dup, &qos, &retained, &packet_id, &topic,
+                                     &payload, &payload_len, buf, len)) {
+        log_err("deserialize PUBLISH failed");
+        return;
+    }
+
+    memset(&topic_msg, 0, sizeof(topic_msg));
+    topic_msg.packet_id = packet_id;
+    topic_msg.qos = qos;
+    topic_msg.dup = dup;
+    topic_msg.retain = retained;
+    topic_msg.ptopic = topic.lenstring.data;
+    topic_msg.topic_len = topic.lenstring.len;
+    topic_msg.payload = (const char *)payload;
+    topic_msg.payload_len = payload_len;
+
+    msg.event_type = IOTX_MQTT_EVENT_PUBLISH_RECVEIVED;
+    msg.msg = &topic_msg;
+
+    match.handles = handles;
+    match.num = 0;
+    match.size = IOTX_MQTT_MGR_MATCH_MAX;
+    utils_topic_trie_match(s->subs_trie, topic.lenstring.data, topic.lenstring.len, iotx_mqtt_mgr_collect, &match);
+    if (match.num > match.size) {
+        match.handles = HAL_Malloc(match.num * sizeof(iotx_mqtt_event_handle_t));
+        if (NULL == match.handles) {
+            log_err("not enough memory, deliver to %d of %d handlers", match.size, match.num);
+            match.handles = handles;
+            match.num = match.size;
+        } else {
+            match.size = match.num;
+            match.num = 0;
+            utils_topic_trie_match(s->subs_trie, topic.lenstring.data, topic.lenstring.len,
+                                   iotx_mqtt_mgr_collect, &match);
+        }
+    }
+
+    for (i = 0; i < match.num; i++) {
+        match.handles[i].h_fp(match.handles[i].pcontext, s, &msg);
+        if (s->removed || IOTX_MQTT_MGR_STATE_CONNECTED != s->state) {
+            break;
+        }
+    }
+    if (0 == match.num && NULL != s->handle_event.h_fp) {
+        s->handle_event.h_fp(s->handle_event.pcontext, s, &msg);
+    }
+    if (match.handles != handles) {
+        HAL_Free(match.handles);
+    }
+    if (s->removed || IOTX_MQTT_MGR_STATE_CONNECTED != s->state) {
+        return;
+    }
+
+    if (IOTX_MQTT_QOS1 == qos) {
+        iotx_mqtt_mgr_send(s, MQTTSerialize_ack((unsigned char *)s->mgr->buf_send, s->mgr->buf_size_send,
+                                                PUBACK, 0, packet_id));
+    }
+}
+
+static void iotx_mqtt_mgr_handle_packet(iotx_mqtt_mgr_session_t *s, unsigned char *buf, int len)
+{
+    unsigned char session_present, connack_rc, type, dup;
+    unsigned short packet_id;
+    int count = 0, granted_qos = 0;
+    iotx_mqtt_mgr_sub_t *sub;
+
+    /* any packet answers the keep-alive probe */
+    if (s->ping_sent) {
+        s->ping_sent = 0;
+        iotx_mqtt_mgr_schedule(s, &s->mgr->idle);
+    }
+
+    switch (buf[0] >> 4) {
+        case CONNACK:
+            if (IOTX_MQTT_MGR_STATE_CONNECTING != s->state
+                || 1 != MQTTDeserialize_connack(&session_present, &connack_rc, buf, len)
+                || 0 != connack_rc) {
+                iotx_mqtt_mgr_disconnect(s, "connect refused");
+                return;
+            }
+            s->state = IOTX_MQTT_MGR_STATE_CONNECTED;
+            iotx_mqtt_mgr_schedule(s, &s->mgr->idle);
+            list_for_each_entry(sub, &s->subs, linked, iotx_mqtt_mgr_sub_t) {
+                if (iotx_mqtt_mgr_send_subscribe(s, sub) < 0) {
+                    return;
+                }
+            }
+            iotx_mqtt_mgr_inflight_resend(s);
+            if (IOTX_MQTT_MGR_STATE_CONNECTED != s->state) {
+                return;
+            }
+            if (s->connected_once) {
+                iotx_mqtt_mgr_event(s, IOTX_MQTT_EVENT_RECONNECT, NULL);
+            }
+            s->connected_once = 1;
+            break;
+        case PUBLISH:
+            iotx_mqtt_mgr_handle_publish(s, buf, len);
+            break;
+        case PUBACK:
+            if (1 == MQTTDeserialize_ack(&type, &dup, &packet_id, buf, len)
+                && !iotx_mqtt_mgr_inflight_complete(s, packet_id, SUCCESS_RETURN)) {
+                iotx_mqtt_mgr_event(s, IOTX_MQTT_EVENT_PUBLISH_SUCCESS, (void *)(uintptr_t)packet_id);
+            }
+            break;
+        case SUBACK:
+            if (1 == MQTTDeserialize_suback(&packet_id, 1, &count, &granted_qos, buf, len)) {
+                iotx_mqtt_mgr_event(s, (0x80 == granted_qos) ? IOTX_MQTT_EVENT_SUBCRIBE_NACK
+                                    : IOTX_MQTT_EVENT_SUBCRIBE_SUCCESS, (void *)(uintptr_t)packet_id);
+            }
+            break;
+        case UNSUBACK:
+            if (1 == MQTTDeserialize_unsuback(&packet_id, buf, len)) {
+                iotx_mqtt_mgr_event(s, IOTX_MQTT_EVENT_UNSUBCRIBE_SUCCESS, (void *)(uintptr_t)packet_id);
+            }
+            break;
+        case PINGRESP:
+            break;
+        default:
+            log_err("unexpected packet type %d", buf[0] >> 4);
+            break;
+    }
+}
+
+/* Length of the packet at the start of 'buf', 0 if its header is incomplete */
+static int iotx_mqtt_mgr_packet_len(const unsigned char *buf, uint32_t len)
+{
+    uint32_t i, rem_len = 0, multiplier = 1;
+
+    for (i = 1; i < len && i <= 4; i++) {
+        rem_len += (buf[i] & 0x7F) * multiplier;
+        if (0 == (buf[i] & 0x80)) {
+            return (int)(1 + i + rem_len);
+        }
+        multiplier *= 128;
+    }
+    return (i > 4) ? -1 : 0;
+}
+
+static void iotx_mqtt_mgr_on_event(uintptr_t fd, int events, void *user)
+{
+    iotx_mqtt_mgr_session_t *s = (iotx_mqtt_mgr_session_t *)user;
+    iotx_mqtt_mgr_t *mgr = s->mgr;
+    uint32_t pos, space;
+    int ret, len;
+
+    do {
+        /* a full buffer may leave bytes read ahead by utils_net, which the
+         * event loop does not report again */
+        space = mgr->buf_size_read - s->read_len;
+        len = s->net.read(&s->net, s->buf_read + s->read_len, space, 0);
+        if (len < 0 || (0 == len && (events & HAL_EVENT_ERROR))) {
+            iotx_mqtt_mgr_disconnect(s, "connection closed");
+            break;
+        }
+        events = 0;
+        s->read_len += len;
+
+        for (pos = 0; pos < s->read_len; pos += ret) {
+            ret = iotx_mqtt_mgr_packet_len((unsigned char *)s->buf_read + pos, s->read_len - pos);
+            if (ret < 0 || ret > (int)mgr->buf_size_read) {
+                log_err("packet of session '%s' exceeds the read buffer", s->connect_data.clientID.cstring);
+                iotx_mqtt_mgr_disconnect(s, "read buffer overflow");
+                break;
+            }
+            if (0 == ret || ret > (int)(s->read_len - pos)) {
+                break;
+            }
+            iotx_mqtt_mgr_handle_packet(s, (unsigned char *)s->buf_read + pos, ret);
+            if (s->removed || IOTX_MQTT_MGR_STATE_DISCONNECTED == s->state) {
+                break;
+            }
+        }
+        if (s->removed || IOTX_MQTT_MGR_STATE_DISCONNECTED == s->state) {
+            break;
+        }
+
+        /* keep the incomplete packet for the next read */
+        s->read_len -= pos;
+        if (pos > 0 && s->read_len > 0) {
+            memmove(s->buf_read, s->buf_read + pos, s->read_len);
+        }
+    } while (len == (int)space);
+}
+
+static int iotx_mqtt_mgr_connect(iotx_mqtt_mgr_session_t *s)
+{
+    iotx_mqtt_mgr_t *mgr = s->mgr;
+    int len;
+
+    if (0 != s->net.connect(&s->net)) {
+        log_err("session '%s' connect failed", s->connect_data.clientID.cstring);
+        goto failed;
+    }
+    if (0 != HAL_EventLoop_Add(mgr->loop, s->net.handle, HAL_EVENT_READ, iotx_mqtt_mgr_on_event, s)) {
+        s->net.disconnect(&s->net);
+        goto failed;
+    }
+
+    s->state = IOTX_MQTT_MGR_STATE_CONNECTING;
+    iotx_mqtt_mgr_schedule(s, &mgr->wait);
+    len = MQTTSerialize_connect((unsigned char *)mgr->buf_send, mgr->buf_size_send, &s->connect_data);
+    if (SUCCESS_RETURN != iotx_mqtt_mgr_send(s, len)) {
+        return MQTT_CONNECT_PACKET_ERROR;
+    }
+    return SUCCESS_RETURN;
+
+failed:
+    if (0 != mgr->reconnect_interval_ms) {
+        iotx_mqtt_mgr_schedule(s, &mgr->retry);
+    }
+    return MQTT_NETWORK_CONNECT_ERROR;
+}
+
+/* Time until the head of 'list' is due, 'left' if it is empty */
+static uint32_t iotx_mqtt_mgr_due(struct list_head *list, uint32_t interval, uint64_t now, uint32_t left)
+{
+    iotx_mqtt_mgr_session_t *s;
+
+    if (list_empty(list)) {
+        return left;
+    }
+    s = list_first_entry(list, iotx_mqtt_mgr_session_t, timer);
+    if (s->timer_ms + interval <= now) {
+        return 0;
+    }
+    return (s->timer_ms + interval - now < left) ? (uint32_t)(s->timer_ms + interval - now) : left;
+}
+
+static void iotx_mqtt_mgr_expire(iotx_mqtt_mgr_t *mgr)
+{
+    uint64_t now = HAL_UptimeMs();
+    iotx_mqtt_mgr_session_t *s;
+
+    while (0 == iotx_mqtt_mgr_due(&mgr->wait, mgr->request_timeout_ms, now, 1)) {
+        s = list_first_entry(&mgr->wait, iotx_mqtt_mgr_session_t, timer);
+        iotx_mqtt_mgr_disconnect(s, s->ping_sent ? "keep-alive timeout" : "CONNACK timeout");
+    }
+
+    while (0 == iotx_mqtt_mgr_due(&mgr->idle, mgr->keepalive_interval_ms, now, 1)) {
+        s = list_first_entry(&mgr->idle, iotx_mqtt_mgr_session_t, timer);
+        if (SUCCESS_RETURN == iotx_mqtt_mgr_send(s, MQTTSerialize_pingreq((unsigned char *)mgr->buf_send,
+                                                 mgr->buf_size_send))) {
+            s->ping_sent = 1;
+            iotx_mqtt_mgr_schedule(s, &mgr->wait);
+        }
+    }
+
+    while (0 == iotx_mqtt_mgr_due(&mgr->retry, mgr->reconnect_interval_ms, now, 1)) {
+        s = list_first_entry(&mgr->retry, iotx_mqtt_mgr_session_t, timer);
+        list_del_init(&s->timer);
+        iotx_mqtt_mgr_connect(s);
+    }
+}
+
+/* Called from any thread. A producer claims a position with CAS and then
+ * publishes the slot by its sequence number, so a slow producer only delays
+ * the consumer at its own slot. */
+static int iotx_mqtt_mgr_enqueue(iotx_mqtt_mgr_t *mgr, iotx_mqtt_mgr_msg_t *msg)
+{
+    iotx_mqtt_mgr_slot_t *slot;
+    uint32_t pos, seq, retries = 0;
+
+    pos = __atomic_load_n(&mgr->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = &mgr->queue[pos & mgr->queue_mask];
+        seq = IOTX_MQTT_MGR_LOAD(&slot->seq);
+        if (seq == pos) {
+            if (IOTX_MQTT_MGR_CAS(&mgr->enqueue_pos, &pos, pos + 1)) {
+                break;
+            }
+            retries++;      /* another producer took it, 'pos' is reloaded */
+        } else if ((int32_t)(seq - pos) < 0) {
+            IOTX_MQTT_MGR_ADD(&mgr->stats.rejected, 1);
+            return MQTT_PUBLISH_QUEUE_FULL_ERROR;
+        } else {
+            pos = __atomic_load_n(&mgr->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->msg = msg;
+    IOTX_MQTT_MGR_STORE(&slot->seq, pos + 1);
+    IOTX_MQTT_MGR_ADD(&mgr->stats.queued, 1);
+    iotx_mqtt_mgr_hist_add(mgr->stats.enqueue_retries, retries);
+
+    /* wake the manager thread only if it sleeps, and only once */
+    IOTX_MQTT_MGR_FENCE();
+    if (__atomic_load_n(&mgr->sleeping, __ATOMIC_RELAXED)
+        && __atomic_exchange_n(&mgr->sleeping, 0, __ATOMIC_SEQ_CST)) {
+        HAL_EventLoop_Wakeup(mgr->loop);
+    }
+    return SUCCESS_RETURN;
+}
+
+static iotx_mqtt_mgr_msg_t *iotx_mqtt_mgr_dequeue(iotx_mqtt_mgr_t *mgr)
+{
+    iotx_mqtt_mgr_slot_t *slot = &mgr->queue[mgr->dequeue_pos & mgr->queue_mask];
+    iotx_mqtt_mgr_msg_t *msg;
+
+    if (IOTX_MQTT_MGR_LOAD(&slot->seq) != mgr->dequeue_pos + 1) {
+        return NULL;
+    }
+    msg = slot->msg;
+    IOTX_MQTT_MGR_STORE(&slot->seq, mgr->dequeue_pos + mgr->queue_mask + 1);
+    mgr->dequeue_pos++;
+    return msg;
+}
+
+static void iotx_mqtt_mgr_flush(iotx_mqtt_mgr_session_t *s, iotx_mqtt_mgr_msg_t **batch, int count)
+{
+    iotx_mqtt_mgr_t *mgr = s->mgr;
+    hal_iovec_t iov[IOTX_MQTT_MGR_BATCH_MAX];
+    uint64_t now = HAL_UptimeMs();
+    int i, len = 0;
+
+    if (IOTX_MQTT_MGR_STATE_CONNECTED == s->state) {
+        for (i = 0; i < count; i++) {
+            iov[i].buf = (const char *)(batch[i] + 1);
+            iov[i].len = batch[i]->len;
+            len += batch[i]->len;
+        }
+        IOTX_MQTT_MGR_ADD(&mgr->stats.writes, 1);
+        if (SUCCESS_RETURN != iotx_mqtt_mgr_sent(s, s->net.writev(&s->net, iov, count, mgr->request_timeout_ms), len)) {
+            IOTX_MQTT_MGR_ADD(&mgr->stats.dropped, count);
+        }
+    } else {
+        IOTX_MQTT_MGR_ADD(&mgr->stats.dropped, count);
+    }
+
+    for (i = 0; i < count; i++) {
+        iotx_mqtt_mgr_hist_add(mgr->stats.queue_ms, (uint32_t)(now - batch[i]->enqueue_ms));
+        HAL_Free(batch[i]);
+    }
+}
+
+/* Send the queued messages, consecutive ones of a session with one write.
+ * Return 1 if the queue was found empty. */
+static int iotx_mqtt_mgr_drain(iotx_mqtt_mgr_t *mgr)
+{
+    iotx_mqtt_mgr_msg_t *batch[IOTX_MQTT_MGR_BATCH_MAX];
+    iotx_mqtt_mgr_msg_t *msg;
+    iotx_mqtt_mgr_session_t *s;
+    uint32_t budget = mgr->queue_mask + 1;      /* do not starve the connections */
+    uint64_t start = HAL_UptimeMs();
+    int count;
+
+    msg = iotx_mqtt_mgr_dequeue(mgr);
+    if (NULL == msg) {
+        return 1;
+    }
+
+    while (NULL != msg) {
+        s = msg->session;
+        count = 0;
+        do {
+            batch[count++] = msg;
+            msg = (--budget > 0) ? iotx_mqtt_mgr_dequeue(mgr) : NULL;
+        } while (NULL != msg && msg->session == s && count < IOTX_MQTT_MGR_BATCH_MAX);
+        iotx_mqtt_mgr_flush(s, batch, count);
+    }
+
+    iotx_mqtt_mgr_hist_add(mgr->stats.drain_ms, (uint32_t)(HAL_UptimeMs() - start));
+    return budget > 0;
+}
+
+static void iotx_mqtt_mgr_free_removed(iotx_mqtt_mgr_t *mgr)
+{
+    iotx_mqtt_mgr_session_t *s, *next;
+    iotx_mqtt_mgr_sub_t *sub, *sub_next;
+
+    if (list_empty(&mgr->removed)) {
+        return;
+    }
+    /* A producer which took a slot but has not filled it yet is not seen by
+     * iotx_mqtt_mgr_dequeue(), its message may still refer to the session.
+     * It counts in 'producers' until the slot is filled, and 'enqueue_pos'
+     * moves past the slot before that. */
+    if (NULL != mgr->queue && (0 != __atomic_load_n(&mgr->producers, __ATOMIC_SEQ_CST)
+                               || mgr->dequeue_pos != __atomic_load_n(&mgr->enqueue_pos, __ATOMIC_SEQ_CST))) {
+        return;
+    }
+
+    list_for_each_entry_safe(s, next, &mgr->removed, linked, iotx_mqtt_mgr_session_t) {
+        list_for_each_entry_safe(sub, sub_next, &s->subs, linked, iotx_mqtt_mgr_sub_t) {
+            list_del(&sub->linked);
+            HAL_Free(sub);
+        }
+        utils_topic_trie_free(s->subs_trie);
+        list_del(&s->linked);
+        HAL_Free(s);
+    }
+}
+
+void *IOT_MQTT_Mgr_Construct(iotx_mqtt_mgr_param_t *pInitParams)
+{
+    iotx_mqtt_mgr_t *mgr;
+    uint32_t i;
+
+    POINTER_SANITY_CHECK(pInitParams, NULL);
+
+    mgr = HAL_Malloc(sizeof(iotx_mqtt_mgr_t));
+    if (NULL == mgr) {
+        log_err("not enough memory");
+        return NULL;
+    }
+    memset(mgr, 0, sizeof(iotx_mqtt_mgr_t));
+    INIT_LIST_HEAD(&mgr->sessions);
+    INIT_LIST_HEAD(&mgr->idle);
+    INIT_LIST_HEAD(&mgr->wait);
+    INIT_LIST_HEAD(&mgr->retry);
+    INIT_LIST_HEAD(&mgr->removed);
+
+    mgr->keepalive_interval_ms = pInitParams->keepalive_interval_ms
+                                 ? pInitParams->keepalive_interval_ms : IOTX_MQTT_MGR_KEEPALIVE_DEFAULT_MS;
+    mgr->request_timeout_ms = pInitParams->request_timeout_ms
+                              ? pInitParams->request_timeout_ms : IOTX_MQTT_MGR_TIMEOUT_DEFAULT_MS;
+    mgr->reconnect_interval_ms = pInitParams->reconnect_interval_ms;
+    mgr->buf_size_send = pInitParams->write_buf_size ? pInitParams->write_buf_size : IOTX_MQTT_MGR_BUF_SIZE_DEFAULT;
+    mgr->buf_size_read = pInitParams->read_buf_size ? pInitParams->read_buf_size : IOTX_MQTT_MGR_BUF_SIZE_DEFAULT;
+
+    /* packet ids of 16 bits, one bucket per message on average */
+    mgr->inflight_window = (pInitParams->inflight_window < 0xFFFF) ? pInitParams->inflight_window : 0xFFFF;
+    for (i = 1; i < mgr->inflight_window; i <<= 1) {
+    }
+    mgr->inflight_mask = i - 1;
+
+    if (0 != pInitParams->publish_queue_size) {
+        /* a power of 2, so positions wrap with the 32-bit counters */
+        i = 1;
+        while (i < pInitParams->publish_queue_size && i < 0x80000000) {
+            i <<= 1;
+        }
+        mgr->queue_mask = i - 1;
+        mgr->queue = HAL_Malloc(i * sizeof(iotx_mqtt_mgr_slot_t));
+        for (i = 0; NULL != mgr->queue && i <= mgr->queue_mask; i++) {
+            mgr->queue[i].seq = i;
+        }
+    }
+
+    mgr->buf_send = HAL_Malloc(mgr->buf_size_send);
+    mgr->loop = HAL_EventLoop_Create();
+    if (NULL == mgr->buf_send || NULL == mgr->loop || (0 != pInitParams->publish_queue_size && NULL == mgr->queue)) {
+        log_err("create MQTT manager failed");
+        HAL_Free(mgr->queue);
+        HAL_Free(mgr->buf_send);
+        if (NULL != mgr->loop) {
+            HAL_EventLoop_Destroy(mgr->loop);
+        }
+        HAL_Free(mgr);
+        return NULL;
+    }
+    return mgr;
+}
+
+int IOT_MQTT_Mgr_Destroy(void **phandle)
+{
+    iotx_mqtt_mgr_t *mgr;
+    iotx_mqtt_mgr_session_t *s, *next;
+
+    POINTER_SANITY_CHECK(phandle, FAIL_RETURN);
+    POINTER_SANITY_CHECK(*phandle, FAIL_RETURN);
+    mgr = (iotx_mqtt_mgr_t *)*phandle;
+
+    list_for_each_entry_safe(s, next, &mgr->sessions, linked, iotx_mqtt_mgr_session_t) {
+        IOT_MQTT_Mgr_Remove(mgr, s);
+    }
+    while (NULL != mgr->queue && !iotx_mqtt_mgr_drain(mgr)) {
+    }
+    iotx_mqtt_mgr_free_removed(mgr);
+    HAL_EventLoop_Destroy(mgr->loop);
+    HAL_Free(mgr->queue);
+    HAL_Free(mgr->buf_send);
+    HAL_Free(mgr);
+    *phandle = NULL;
+    return SUCCESS_RETURN;
+}
+
+void *IOT_MQTT_Mgr_Add(void *handle, iotx_mqtt_param_t *pInitParams)
+{
+    iotx_mqtt_mgr_t *mgr = (iotx_mqtt_mgr_t *)handle;
+    iotx_mqtt_mgr_session_t *s;
+    int host_len, id_len, user_len, pass_len;
+    uint32_t index_size;
+    char *str;
+
+    POINTER_SANITY_CHECK(mgr, NULL);
+    POINTER_SANITY_CHECK(pInitParams, NULL);
+    STRING_PTR_SANITY_CHECK(pInitParams->host, NULL);
+    STRING_PTR_SANITY_CHECK(pInitParams->client_id, NULL);
+    if (NULL != pInitParams->pub_key) {
+        log_err("TLS sessions are not supported by the manager");
+        return NULL;
+    }
+
+    host_len = strlen(pInitParams->host) + 1;
+    id_len = strlen(pInitParams->client_id) + 1;
+    user_len = pInitParams->username ? strlen(pInitParams->username) + 1 : 0;
+    pass_len = pInitParams->password ? strlen(pInitParams->password) + 1 : 0;
+
+    index_size = mgr->inflight_window ? (mgr->inflight_mask + 1) * sizeof(iotx_mqtt_mgr_inflight_t *) : 0;
+
+    /* the in-flight index, the read buffer and the strings follow the session in the same block */
+    s = HAL_Malloc(sizeof(iotx_mqtt_mgr_session_t) + index_size + mgr->buf_size_read
+                   + host_len + id_len + user_len + pass_len);
+    if (NULL == s) {
+        log_err("not enough memory");
+        return NULL;
+    }
+    memset(s, 0, sizeof(iotx_mqtt_mgr_session_t));
+    s->subs_trie = utils_topic_trie_new();
+    if (NULL == s->subs_trie) {
+        log_err("not enough memory");
+        HAL_Free(s);
+        return NULL;
+    }
+    s->mgr = mgr;
+    INIT_LIST_HEAD(&s->timer);
+    INIT_LIST_HEAD(&s->subs);
+    INIT_LIST_HEAD(&s->inflight);
+    s->inflight_index = (iotx_mqtt_mgr_inflight_t **)(s + 1);
+    memset(s->inflight_index, 0, index_size);
+    s->buf_read = (char *)(s + 1) + index_size;
+    s->handle_event = pInitParams->handle_event;
+
+    str = s->buf_read + mgr->buf_size_read;
+    memcpy(str, pInitParams->host, host_len);
+    str += host_len;
+    {
+        MQTTPacket_connectData connect_data = MQTTPacket_connectData_initializer;
+        s->connect_data = connect_data;
+    }
+    s->connect_data.MQTTVersion = 4;
+    s->connect_data.keepAliveInterval = (mgr->keepalive_interval_ms + 999) / 1000;
+    s->connect_data.cleansession = pInitParams->clean_session;
+    s->connect_data.clientID.cstring = memcpy(str, pInitParams->client_id, id_len);
+    str += id_len;
+    if (user_len) {
+        s->connect_data.username.cstring = memcpy(str, pInitParams->username, user_len);
+        str += user_len;
+    }
+    if (pass_len) {
+        s->connect_data.password.cstring = memcpy(str, pInitParams->password, pass_len);
+    }
+
+#ifndef IOTX_NET_INIT_WITH_PK_EXT
+    iotx_net_init(&s->net, s->buf_read + mgr->buf_size_read, pInitParams->port, NULL);
+#else
+    iotx_net_init(&s->net, s->buf_read + mgr->buf_size_read, pInitParams->port, NULL, NULL);
+#endif
+
+    if (SUCCESS_RETURN != iotx_mqtt_mgr_connect(s) && IOTX_MQTT_MGR_STATE_DISCONNECTED == s->state
+        && list_empty(&s->timer)) {
+        utils_topic_trie_free(s->subs_trie);
+        HAL_Free(s);
+        return NULL;
+    }
+    list_add_tail(&s->linked, &mgr->sessions);
+    return s;
+}
+
+int IOT_MQTT_Mgr_Remove(void *handle, void *session)
+{
+    iotx_mqtt_mgr_t *mgr = (iotx_mqtt_mgr_t *)handle;
+    iotx_mqtt_mgr_session_t *s = (iotx_mqtt_mgr_session_t *)session;
+
+    POINTER_SANITY_CHECK(mgr, FAIL_RETURN);
+    POINTER_SANITY_CHECK(s, FAIL_RETURN);
+
+    if (s->removed) {
+        return SUCCESS_RETURN;
+    }
+    if (IOTX_MQTT_MGR_STATE_CONNECTED == s->state) {
+        iotx_mqtt_mgr_send(s, MQTTSerialize_disconnect((unsigned char *)mgr->buf_send, mgr->buf_size_send));
+    }
+    s->removed = 1;
+    iotx_mqtt_mgr_disconnect(s, "removed");
+    list_del_init(&s->timer);
+    iotx_mqtt_mgr_inflight_fail(s, MQTT_STATE_ERROR);
+
+    /* Its packets may be being handled or its messages queued, it is freed
+     * by IOT_MQTT_Mgr_Yield() once the queue has been drained. */
+    list_move_tail(&s->linked, &mgr->removed);
+    return SUCCESS_RETURN;
+}
+
+int IOT_MQTT_Mgr_Yield(void *handle, int timeout_ms)
+{
+    iotx_mqtt_mgr_t *mgr = (iotx_mqtt_mgr_t *)handle;
+    iotx_time_t timer;
+    uint64_t now;
+    uint32_t wait;
+    int ret;
+
+    POINTER_SANITY_CHECK(mgr, NULL_VALUE_ERROR);
+    if (timeout_ms < 0) {
+        log_err("Invalid argument, timeout_ms = %d", timeout_ms);
+        return FAIL_RETURN;
+    }
+
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
+
+    do {
+        /* sleep in the event loop until a packet arrives or the next session is due */
+        now = HAL_UptimeMs();
+        wait = iotx_time_left(&timer);
+        wait = iotx_mqtt_mgr_due(&mgr->wait, mgr->request_timeout_ms, now, wait);
+        wait = iotx_mqtt_mgr_due(&mgr->idle, mgr->keepalive_interval_ms, now, wait);
+        wait = iotx_mqtt_mgr_due(&mgr->retry, mgr->reconnect_interval_ms, now, wait);
+
+        /* or until a message is queued, producers wake us after seeing 'sleeping' */
+        if (NULL != mgr->queue && 0 != wait) {
+            __atomic_store_n(&mgr->sleeping, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&mgr->queue[mgr->dequeue_pos & mgr->queue_mask].seq, __ATOMIC_SEQ_CST)
+                == mgr->dequeue_pos + 1) {
+                wait = 0;
+            }
+        }
+        ret = HAL_EventLoop_Run(mgr->loop, wait);
+        if (NULL != mgr->queue) {
+            __atomic_store_n(&mgr->sleeping, 0, __ATOMIC_RELAXED);
+        }
+        if (ret < 0) {
+            return FAIL_RETURN;
+        }
+
+        if (NULL == mgr->queue || iotx_mqtt_mgr_drain(mgr)) {
+            iotx_mqtt_mgr_free_removed(mgr);
+        }
+        iotx_mqtt_mgr_expire(mgr);
+    } while (!utils_time_is_expired(&timer));
+
+    return SUCCESS_RETURN;
+}
+
+int IOT_MQTT_Mgr_CheckStateNormal(void *session)
+{
+    POINTER_SANITY_CHECK(session, 0);
+    return IOTX_MQTT_MGR_STATE_CONNECTED == ((iotx_mqtt_mgr_session_t *)session)->state;
+}
+
+int IOT_MQTT_Mgr_Subscribe(void *session,
+                           const char *topic_filter,
+                           iotx_mqtt_qos_t qos,
+                           iotx_mqtt_event_handle_func_fpt topic_handle_func,
+                           void *pcontext)
+{
+    iotx_mqtt_mgr_session_t *s = (iotx_mqtt_mgr_session_t *)session;
+    iotx_mqtt_mgr_sub_t *sub;
+    int len;
+
+    POINTER_SANITY_CHECK(s, NULL_VALUE_ERROR);
+    POINTER_SANITY_CHECK(topic_handle_func, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_filter, NULL_VALUE_ERROR);
+    if (IOTX_MQTT_QOS1 < qos) {
+        log_err("QoS %d is not supported", qos);
+        return MQTT_SUBSCRIBE_QOS_ERROR;
+    }
+
+    len = strlen(topic_filter) + 1;
+    sub = HAL_Malloc(sizeof(iotx_mqtt_mgr_sub_t) + len);
+    if (NULL == sub) {
+        return MQTT_PUSH_TO_LIST_ERROR;
+    }
+    sub->topic_filter = memcpy(sub + 1, topic_filter, len);
+    sub->qos = qos;
+    sub->handle.h_fp = topic_handle_func;
+    sub->handle.pcontext = pcontext;
+    if (0 != utils_topic_trie_insert(s->subs_trie, sub->topic_filter, sub)) {
+        HAL_Free(sub);
+        return MQTT_TOPIC_FORMAT_ERROR;
+    }
+    list_add_tail(&sub->linked, &s->subs);
+
+    if (IOTX_MQTT_MGR_STATE_CONNECTED != s->state) {
+        return 0;
+    }
+    return iotx_mqtt_mgr_send_subscribe(s, sub);
+}
+
+int IOT_MQTT_Mgr_Unsubscribe(void *session, const char *topic_filter)
+{
+    iotx_mqtt_mgr_session_t *s = (iotx_mqtt_mgr_session_t *)session;
+    iotx_mqtt_mgr_sub_t *sub, *next;
+    MQTTString topic = MQTTString_initializer;
+    uint16_t id;
+    int len;
+
+    POINTER_SANITY_CHECK(s, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_filter, NULL_VALUE_ERROR);
+
+    list_for_each_entry_safe(sub, next, &s->subs, linked, iotx_mqtt_mgr_sub_t) {
+        if (0 == strcmp(sub->topic_filter, topic_filter)) {
+            utils_topic_trie_remove(s->subs_trie, sub->topic_filter, sub);
+            list_del(&sub->linked);
+            HAL_Free(sub);
+        }
+    }
+
+    if (IOTX_MQTT_MGR_STATE_CONNECTED != s->state) {
+        return 0;
+    }
+    id = iotx_mqtt_mgr_next_packet_id(s);
+    topic.cstring = (char *)topic_filter;
+    len = MQTTSerialize_unsubscribe((unsigned char *)s->mgr->buf_send, s->mgr->buf_size_send, 0, id, 1, &topic);
+    if (SUCCESS_RETURN != iotx_mqtt_mgr_send(s, len)) {
+        return MQTT_UNSUBSCRIBE_PACKET_ERROR;
+    }
+    return id;
+}
+
+int IOT_MQTT_Mgr_Publish(void *session, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg)
+{
+    iotx_mqtt_mgr_session_t *s = (iotx_mqtt_mgr_session_t *)session;
+    MQTTString topic = MQTTString_initializer;
+    uint16_t id = 0;
+    int len;
+
+    POINTER_SANITY_CHECK(s, NULL_VALUE_ERROR);
+    POINTER_SANITY_CHECK(topic_msg, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_name, NULL_VALUE_ERROR);
+
+    if (IOTX_MQTT_MGR_STATE_CONNECTED != s->state) {
+        return MQTT_STATE_ERROR;
+    }
+    if (IOTX_MQTT_QOS1 < topic_msg->qos) {
+        return MQTT_PUBLISH_QOS_ERROR;
+    }
+    if (IOTX_MQTT_QOS1 == topic_msg->qos) {
+        id = iotx_mqtt_mgr_next_packet_id(s);
+    }
+
+    topic.cstring = (char *)topic_name;
+    len = MQTTSerialize_publish((unsigned char *)s->mgr->buf_send, s->mgr->buf_size_send, 0, topic_msg->qos,
+                                topic_msg->retain, id, topic, (unsigned char *)topic_msg->payload,
+                                topic_msg->payload_len);
+    if (SUCCESS_RETURN != iotx_mqtt_mgr_send(s, len)) {
+        return MQTT_PUBLISH_PACKET_ERROR;
+    }
+    return id;
+}
+
+int IOT_MQTT_Mgr_PublishTracked(void *session,
+                                const char *topic_name,
+                                iotx_mqtt_topic_info_pt topic_msg,
+                                iotx_mqtt_mgr_complete_func_fpt complete_func,
+                                void *pcontext)
+{
+    iotx_mqtt_mgr_session_t *s = (iotx_mqtt_mgr_session_t *)session;
+    MQTTString topic = MQTTString_initializer;
+    iotx_mqtt_mgr_inflight_t *m, **pp;
+    uint16_t id;
+    int len;
+
+    POINTER_SANITY_CHECK(s, NULL_VALUE_ERROR);
+    POINTER_SANITY_CHECK(topic_msg, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_name, NULL_VALUE_ERROR);
+
+    if (s->removed || (IOTX_MQTT_MGR_STATE_DISCONNECTED == s->state && list_empty(&s->timer))) {
+        return MQTT_STATE_ERROR;
+    }
+    if (s->inflight_num >= s->mgr->inflight_window) {
+        return (0 == s->mgr->inflight_window) ? MQTT_STATE_ERROR : MQTT_PUBLISH_WINDOW_FULL_ERROR;
+    }
+
+    /* the ids wrap, skip one still waiting for its PUBACK */
+    do {
+        id = iotx_mqtt_mgr_next_packet_id(s);
+        pp = iotx_mqtt_mgr_inflight_find(s, id);
+    } while (NULL != *pp);
+
+    len = MQTTPacket_len(2 + strlen(topic_name) + 2 + topic_msg->payload_len);
+    m = HAL_Malloc(sizeof(iotx_mqtt_mgr_inflight_t) + len);
+    if (NULL == m) {
+        return MQTT_PUSH_TO_LIST_ERROR;
+    }
+    topic.cstring = (char *)topic_name;
+    len = MQTTSerialize_publish((unsigned char *)(m + 1), len, 0, IOTX_MQTT_QOS1, topic_msg->retain, id,
+                                topic, (unsigned char *)topic_msg->payload, topic_msg->payload_len);
+    if (len <= 0) {
+        HAL_Free(m);
+        return MQTT_PUBLISH_PACKET_ERROR;
+    }
+    m->packet_id = id;
+    m->sent = 0;
+    m->complete = complete_func;
+    m->pcontext = pcontext;
+    m->len = len;
+    m->hnext = NULL;
+    *pp = m;
+    list_add_tail(&m->linked, &s->inflight);
+    s->inflight_num++;
+
+    /* otherwise it is sent after CONNACK, a failed write is retried the same way */
+    if (IOTX_MQTT_MGR_STATE_CONNECTED == s->state) {
+        m->sent = 1;
+        iotx_mqtt_mgr_sent(s, s->net.write(&s->net, (char *)(m + 1), len, s->mgr->request_timeout_ms), len);
+    }
+    return id;
+}
+
+static int iotx_mqtt_mgr_publish_async(iotx_mqtt_mgr_session_t *s, const char *topic_name,
+                                       iotx_mqtt_topic_info_pt topic_msg)
+{
+    MQTTString topic = MQTTString_initializer;
+    iotx_mqtt_mgr_msg_t *msg;
+    uint16_t id = 0;
+    int len, ret;
+
+    if (IOTX_MQTT_QOS1 < topic_msg->qos) {
+        return MQTT_PUBLISH_QOS_ERROR;
+    }
+    if (IOTX_MQTT_QOS1 == topic_msg->qos) {
+        id = iotx_mqtt_mgr_next_packet_id(s);
+    }
+
+    /* serialized here, so producers share the work instead of the manager thread */
+    len = MQTTPacket_len(2 + strlen(topic_name) + (id ? 2 : 0) + topic_msg->payload_len);
+    msg = HAL_Malloc(sizeof(iotx_mqtt_mgr_msg_t) + len);
+    if (NULL == msg) {
+        return MQTT_PUSH_TO_LIST_ERROR;
+    }
+    topic.cstring = (char *)topic_name;
+    ret = MQTTSerialize_publish((unsigned char *)(msg + 1), len, 0, topic_msg->qos, topic_msg->retain, id,
+                                topic, (unsigned char *)topic_msg->payload, topic_msg->payload_len);
+    if (ret <= 0) {
+        HAL_Free(msg);
+        return MQTT_PUBLISH_PACKET_ERROR;
+    }
+    msg->session = s;
+    msg->len = ret;
+    msg->enqueue_ms = HAL_UptimeMs();
+
+    ret = iotx_mqtt_mgr_enqueue(s->mgr, msg);
+    if (SUCCESS_RETURN != ret) {
+        HAL_Free(msg);
+        return ret;
+    }
+    return id;
+}
+
+int IOT_MQTT_Mgr_PublishAsync(void *session, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg)
+{
+    iotx_mqtt_mgr_session_t *s = (iotx_mqtt_mgr_session_t *)session;
+    iotx_mqtt_mgr_t *mgr;
+    int ret;
+
+    POINTER_SANITY_CHECK(s, NULL_VALUE_ERROR);
+    POINTER_SANITY_CHECK(topic_msg, NULL_VALUE_ERROR);
+    STRING_PTR_SANITY_CHECK(topic_name, NULL_VALUE_ERROR);
+
+    mgr = s->mgr;
+    if (NULL == mgr->queue) {
+        log_err("publish queue is not enabled");
+        return MQTT_STATE_ERROR;
+    }
+
+    /* the session is not freed while a call is in progress, see iotx_mqtt_mgr_free_removed() */
+    __atomic_add_fetch(&mgr->producers, 1, __ATOMIC_SEQ_CST);
+    ret = iotx_mqtt_mgr_publish_async(s, topic_name, topic_msg);
+    __atomic_sub_fetch(&mgr->producers, 1, __ATOMIC_SEQ_CST);
+
+    return ret;
+}
+
+int IOT_MQTT_Mgr_GetStats(void *handle, iotx_mqtt_mgr_stats_t *stats)
+{
+    iotx_mqtt_mgr_t *mgr = (iotx_mqtt_mgr_t *)handle;
+    uint32_t *src, *dst;
+    uint32_t i;
+
+    POINTER_SANITY_CHECK(mgr, NULL_VALUE_ERROR);
+    POINTER_SANITY_CHECK(stats, NULL_VALUE_ERROR);
+
+    /* counters are updated by producers while they are read */
+    src = (uint32_t *)&mgr->stats;
+    dst = (uint32_t *)stats;
+    for (i = 0; i < sizeof(iotx_mqtt_mgr_stats_t) / sizeof(uint32_t); i++) {
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+    return SUCCESS_RETURN;
+}
+
+#endif  /* IOTX_EVENT_LOOP_SUPPORT */
@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdio.h>
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPBlock.h"
+#include "iot_import.h"
+
+/* Give up when no block has been confirmed for this many message cycles,
+ * which is longer than a CON message may stay in the retransmission list */
+#define COAP_BLOCK_STALL_CYCLES    20
+
+/* Give up after this many blocks went unanswered without the window moving */
+#define COAP_BLOCK_MAX_TIMEOUTS    4
+
+static void CoAPBlock_handler(void *user, void *p_message);
+
+int CoAPBlockOption_get(CoAPMessage *message, unsigned short optnum,
+                        unsigned int *num, unsigned char *more, unsigned char *szx)
+{
+    int ret = COAP_SUCCESS;
+    unsigned int value = 0;
+
+    if (NULL == num || NULL == more || NULL == szx) {
+        return COAP_ERROR_NULL;
+    }
+
+    ret = CoAPUintOption_get(message, optnum, &value);
+    if (COAP_SUCCESS != ret) {
+        return ret;
+    }
+    if (COAP_BLOCK_SZX_MAX < (value & 0x07)) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    *num  = value >> 4;
+    *more = (value & 0x08) ? 1 : 0;
+    *szx  = value & 0x07;
+    return COAP_SUCCESS;
+}
+
+static int CoAPBlock_send(CoAPBlockTransfer *transfer, unsigned int num)
+{
+    int            ret    = COAP_SUCCESS;
+    unsigned int   offset = num << (transfer->szx + 4);
+    unsigned int   len    = 0;
+    unsigned char  more   = 0;
+    CoAPMessage    message;
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
+    CoAPMessageCode_set(&message, transfer->code);
+    CoAPMessageId_set(&message, CoAPMessageId_gen(transfer->context));
+    CoAPMessageHandler_set(&message, CoAPBlock_handler);
+    CoAPMessageUserData_set(&message, (void *)transfer);
+    CoAPMessageTimeoutNotify_set(&message, 1);
+
+    ret = transfer->prepare(transfer->user, &message, COAP_BLOCK_PREPARE_HEAD);
+    if (COAP_SUCCESS != ret) {
+        CoAPMessage_destory(&message);
+        return ret;
+    }
+
+    if (COAP_OPTION_BLOCK1 == transfer->blockopt) {
+        len = COAP_BLOCK_SIZE(transfer->szx);
+        if (offset + len >= transfer->total_len) {
+            len = transfer->total_len - offset;
+        } else {
+            more = 1;
+        }
+        if (0 < len && 0 != transfer->read(transfer->user, offset, transfer->buf, len)) {
+            COAP_ERR("Read block %u of the request body failed", num);
+            CoAPMessage_destory(&message);
+            return COAP_ERROR_READ_FAILED;
+        }
+        CoAPUintOption_add(&message, COAP_OPTION_BLOCK1, COAP_BLOCK_VALUE(num, more, transfer->szx));
+        if (0 == num) {
+            CoAPUintOption_add(&message, COAP_OPTION_SIZE1, transfer->total_len);
+        }
+    } else {
+        CoAPUintOption_add(&message, COAP_OPTION_BLOCK2, COAP_BLOCK_VALUE(num, 0, transfer->szx));
+        if (0 == num) {
+            /* ask the server for the body size so the window can be opened */
+            CoAPUintOption_add(&message, COAP_OPTION_SIZE2, 0);
+        }
+    }
+
+    ret = transfer->prepare(transfer->user, &message, COAP_BLOCK_PREPARE_TAIL);
+    if (COAP_SUCCESS == ret) {
+        CoAPMessagePayload_set(&message, transfer->buf, (unsigned short)len);
+        COAP_DEBUG("Send block %u, offset %u, len %u, more %d", num, offset, len, more);
+        ret = CoAPMessage_send(transfer->context, &message);
+    }
+    CoAPMessage_destory(&message);
+
+    return ret;
+}
+
+static void CoAPBlock_pump(CoAPBlockTransfer *transfer)
+{
+    unsigned char limit = transfer->window;
+
+    /* negotiate the block size with a single block before opening the window,
+     * a Block2 download also stays sequential while its size is unknown */
+    if (!transfer->negotiated || COAP_BLOCK_NUM_UNKNOWN == transfer->last) {
+        limit = 1;
+    }
+    if (transfer->next < transfer->base) {
+        transfer->next = transfer->base;
+    }
+
+    while (COAP_BLOCK_STATE_RUNNING == transfer->state
+           && transfer->inflight < limit
+           && transfer->next < transfer->base + transfer->window
+           && (COAP_BLOCK_NUM_UNKNOWN == transfer->last || transfer->next <= transfer->last)) {
+
+        /* the final Block1 goes out once the server holds all of the others */
+        if (COAP_OPTION_BLOCK1 == transfer->blockopt
+            && transfer->next == transfer->last && transfer->base != transfer->last) {
+            break;
+        }
+
+        if (COAP_SUCCESS != CoAPBlock_send(transfer, transfer->next)) {
+            transfer->state = COAP_BLOCK_STATE_FAILED;
+            break;
+        }
+        transfer->next++;
+        transfer->inflight++;
+    }
+}
+
+static void CoAPBlock_finish(CoAPBlockTransfer *transfer, CoAPBlockState state, CoAPMessage *message)
+{
+    transfer->state = state;
+    if (NULL != transfer->handler) {
+        transfer->handler(transfer->user, message);
+    }
+}
+
+static void CoAPBlock_resize(CoAPBlockTransfer *transfer, unsigned char szx)
+{
+    /* the server accepted the first block but prefers smaller ones */
+    COAP_INFO("Block size renegotiated from %u to %u",
+              COAP_BLOCK_SIZE(transfer->szx), COAP_BLOCK_SIZE(szx));
+    transfer->base = transfer->bytes >> (szx + 4);
+    transfer->next = transfer->base;
+    transfer->szx  = szx;
+    if (COAP_OPTION_BLOCK1 == transfer->blockopt) {
+        transfer->last = (0 == transfer->total_len) ? 0 : (transfer->total_len - 1) >> (szx + 4);
+    }
+}
+
+static void CoAPBlock1_handle(CoAPBlockTransfer *transfer, CoAPMessage *message)
+{
+    unsigned int  num  = 0;
+    unsigned char more = 0;
+    unsigned char szx  = 0;
+
+    if (COAP_SUCCESS != CoAPBlockOption_get(message, COAP_OPTION_BLOCK1, &num, &more, &szx)) {
+        if (COAP_MSG_CODE_231_CONTINUE == message->header.code) {
+            COAP_ERR("2.31 Continue without a Block1 option");
+            CoAPBlock_finish(transfer, COAP_BLOCK_STATE_FAILED, message);
+            return;
+        }
+        /* the server answered the whole request at once */
+        num = transfer->last;
+        szx = transfer->szx;
+    }
+
+    if (szx > transfer->szx || num < transfer->base || num >= transfer->base + transfer->window) {
+        COAP_DEBUG("Ignore the acknowledgement of block %u", num);
+        return;
+    }
+
+    if (COAP_MSG_CODE_231_CONTINUE != message->header.code) {
+        transfer->bytes = transfer->total_len;
+        CoAPBlock_finish(transfer, COAP_BLOCK_STATE_DONE, message);
+        return;
+    }
+
+    if (!transfer->negotiated) {
+        transfer->negotiated = 1;
+        transfer->bytes = COAP_BLOCK_SIZE(transfer->szx);
+        if (szx < transfer->szx) {
+            CoAPBlock_resize(transfer, szx);
+            return;
+        }
+    }
+
+    transfer->mask |= 1U << (num - transfer->base);
+    while (transfer->mask & 0x01) {
+        transfer->mask >>= 1;
+        transfer->base++;
+    }
+    transfer->bytes = transfer->base << (transfer->szx + 4);
+}
+
+static void CoAPBlock2_deliver(CoAPBlockTransfer *transfer, unsigned char *data, unsigned short len)
+{
+    unsigned int slot = 0;
+
+    transfer->write(transfer->user, transfer->bytes, data, len);
+    transfer->bytes += len;
+    transfer->base++;
+    transfer->mask >>= 1;
+
+    /* flush the blocks which arrived ahead of this one */
+    while (transfer->mask & 0x01) {
+        slot = transfer->base % transfer->window;
+        transfer->write(transfer->user, transfer->bytes,
+                        transfer->buf + slot * COAP_BLOCK_SIZE(transfer->szx), transfer->lens[slot]);
+        transfer->bytes += transfer->lens[slot];
+        transfer->base++;
+        transfer->mask >>= 1;
+    }
+}
+
+static void CoAPBlock2_handle(CoAPBlockTransfer *transfer, CoAPMessage *message)
+{
+    unsigned int  num   = 0;
+    unsigned int  size  = 0;
+    unsigned int  slot  = 0;
+    unsigned char more  = 0;
+    unsigned char szx   = 0;
+
+    if (COAP_SUCCESS != CoAPBlockOption_get(message, COAP_OPTION_BLOCK2, &num, &more, &szx)) {
+        /* the representation fits in a single response */
+        if (0 == transfer->base) {
+            transfer->write(transfer->user, 0, message->payload, message->payloadlen);
+            transfer->bytes = message->payloadlen;
+        }
+        CoAPBlock_finish(transfer, COAP_BLOCK_STATE_DONE, message);
+        return;
+    }
+
+    if (!transfer->negotiated) {
+        transfer->negotiated = 1;
+        if (szx < transfer->szx) {
+            CoAPBlock_resize(transfer, szx);
+        }
+        if (COAP_SUCCESS == CoAPUintOption_get(message, COAP_OPTION_SIZE2, &size) && 0 < size) {
+            transfer->last = (size - 1) >> (transfer->szx + 4);
+        }
+    }
+
+    if (szx != transfer->szx || num < transfer->base || num >= transfer->base + transfer->window
+        || message->payloadlen > COAP_BLOCK_SIZE(transfer->szx)) {
+        COAP_DEBUG("Ignore the response of block %u", num);
+        return;
+    }
+
+    if (!more) {
+        transfer->last = num;
+    }
+
+    if (num == transfer->base) {
+        CoAPBlock2_deliver(transfer, message->payload, message->payloadlen);
+    } else if (!(transfer->mask & (1U << (num - transfer->base)))) {
+        slot = num % transfer->window;
+        memcpy(transfer->buf + slot * COAP_BLOCK_SIZE(transfer->szx), message->payload, message->payloadlen);
+        transfer->lens[slot] = message->payloadlen;
+        transfer->mask |= 1U << (num - transfer->base);
+    }
+
+    if (COAP_BLOCK_NUM_UNKNOWN != transfer->last && transfer->base > transfer->last) {
+        CoAPBlock_finish(transfer, COAP_BLOCK_STATE_DONE, message);
+    }
+}
+
+static void CoAPBlock_timeout(CoAPBlockTransfer *transfer, CoAPMessage *request)
+{
+    unsigned int  num  = 0;
+    unsigned char more = 0;
+    unsigned char szx  = 0;
+
+    /* a block of the old size is sent again by the renegotiation, one behind the window is done */
+    if (COAP_SUCCESS != CoAPBlockOption_get(request, transfer->blockopt, &num, &more, &szx)
+        || szx != transfer->szx || num < transfer->base) {
+        return;
+    }
+
+    if (COAP_BLOCK_MAX_TIMEOUTS < ++transfer->timeouts) {
+        COAP_ERR("Block %u unanswered, %d blocks lost in a row", num, transfer->timeouts);
+        transfer->state = COAP_BLOCK_STATE_FAILED;
+        return;
+    }
+
+    COAP_INFO("Block %u unanswered, send it again", num);
+    if (COAP_SUCCESS != CoAPBlock_send(transfer, num)) {
+        transfer->state = COAP_BLOCK_STATE_FAILED;
+        return;
+    }
+    transfer->inflight++;
+}
+
+static void CoAPBlock_handler(void *user, void *p_message)
+{
+    CoAPBlockTransfer *transfer = (CoAPBlockTransfer *)user;
+    CoAPMessage       *message  = (CoAPMessage *)p_message;
+    unsigned int       base     = 0;
+
+    if (NULL == transfer || NULL == message || COAP_BLOCK_STATE_RUNNING != transfer->state) {
+        return;
+    }
+    if (0 < transfer->inflight) {
+        transfer->inflight--;
+    }
+
+    /* the retransmissions of a block ran out, the request is handed back */
+    if (COAP_MSG_CODE_DELETE >= message->header.code) {
+        CoAPBlock_timeout(transfer, message);
+        return;
+    }
+
+    if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code) {
+        COAP_ERR("Block-wise transfer failed, response code 0x%x", message->header.code);
+        CoAPBlock_finish(transfer, COAP_BLOCK_STATE_FAILED, message);
+        return;
+    }
+
+    base = transfer->base;
+    if (COAP_OPTION_BLOCK1 == transfer->blockopt) {
+        CoAPBlock1_handle(transfer, message);
+    } else {
+        CoAPBlock2_handle(transfer, message);
+    }
+    if (base != transfer->base) {
+        transfer->timeouts = 0;
+    }
+
+    CoAPBlock_pump(transfer);
+}
+
+int CoAPBlockTransfer_init(CoAPBlockTransfer *transfer, CoAPContext *context,
+                           unsigned short blockopt, unsigned char szx, unsigned char window)
+{
+    unsigned int count = 1;
+
+    if (NULL == transfer || NULL == context) {
+        return COAP_ERROR_NULL;
+    }
+    if ((COAP_OPTION_BLOCK1 != blockopt && COAP_OPTION_BLOCK2 != blockopt)
+        || COAP_BLOCK_SZX_MAX < szx || 0 == window || COAP_BLOCK_MAX_WINDOW < window) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    memset(transfer, 0x00, sizeof(CoAPBlockTransfer));
+    transfer->context  = context;
+    transfer->blockopt = blockopt;
+    transfer->szx      = szx;
+    transfer->window   = window;
+    transfer->last     = COAP_BLOCK_NUM_UNKNOWN;
+    transfer->state    = COAP_BLOCK_STATE_IDLE;
+    transfer->code     = (COAP_OPTION_BLOCK1 == blockopt) ? COAP_MSG_CODE_POST : COAP_MSG_CODE_GET;
+
+    if (COAP_OPTION_BLOCK2 == blockopt) {
+        count = window;
+        transfer->lens = coap_malloc(window * sizeof(unsigned short));
+        if (NULL == transfer->lens) {
+            return COAP_ERROR_INTERNAL;
+        }
+    }
+
+    transfer->buf = coap_malloc(count * COAP_BLOCK_SIZE(szx));
+    if (NULL == transfer->buf) {
+        CoAPBlockTransfer_deinit(transfer);
+        return COAP_ERROR_INTERNAL;
+    }
+
+    return COAP_SUCCESS;
+}
+
+int CoAPBlockTransfer_run(CoAPBlockTransfer *transfer)
+{
+    int          stall    = 0;
+    unsigned int progress = 0;
+
+    if (NULL == transfer || NULL == transfer->buf || NULL == transfer->prepare
+        || (COAP_OPTION_BLOCK1 == transfer->blockopt && NULL == transfer->read)
+        || (COAP_OPTION_BLOCK2 == transfer->blockopt && NULL == transfer->write)) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    if (COAP_OPTION_BLOCK1 == transfer->blockopt) {
+        transfer->last = (0 == transfer->total_len) ? 0 : (transfer->total_len - 1) >> (transfer->szx + 4);
+    }
+    transfer->state = COAP_BLOCK_STATE_RUNNING;
+    CoAPBlock_pump(transfer);
+
+    while (COAP_BLOCK_STATE_RUNNING == transfer->state) {
+        progress = transfer->bytes + transfer->mask + transfer->timeouts;
+        CoAPMessage_cycle(transfer->context);
+
+        /* a block sent again after a timeout starts the wait over */
+        if (progress != transfer->bytes + transfer->mask + transfer->timeouts) {
+            stall = 0;
+        } else if (COAP_BLOCK_STALL_CYCLES <= ++stall) {
+            COAP_ERR("Block-wise transfer stalled at block %u", transfer->base);
+            transfer->state = COAP_BLOCK_STATE_FAILED;
+        }
+    }
+
+    COAP_INFO("Block-wise transfer finished, state %d, %u bytes", transfer->state, transfer->bytes);
+    return (COAP_BLOCK_STATE_DONE == transfer->state) ? COAP_SUCCESS : COAP_ERROR_INTERNAL;
+}
+
+void CoAPBlockTransfer_deinit(CoAPBlockTransfer *transfer)
+{
+    CoAPSendNode *node = NULL, *next = NULL;
+
+    if (NULL == transfer) {
+        return;
+    }
+
+    /* drop the blocks still waiting for a response, they point at this transfer */
+    if (NULL != transfer->context) {
+        list_for_each_entry_safe(node, next, &transfer->context->list.sendlist, sendlist, CoAPSendNode) {
+            if (CoAPBlock_handler == node->handler && (void *)transfer == node->user) {
+                list_del_init(&node->sendlist);
+                transfer->context->list.count--;
+                if (NULL != node->message) {
+                    coap_free(node->message);
+                }
+                coap_free(node);
+            }
+        }
+    }
+
+    if (NULL != transfer->buf) {
+        coap_free(transfer->buf);
+        transfer->buf = NULL;
+    }
+    if (NULL != transfer->lens) {
+        coap_free(transfer->lens);
+        transfer->lens = NULL;
+    }
+    transfer->state = COAP_BLOCK_STATE_IDLE;
+}
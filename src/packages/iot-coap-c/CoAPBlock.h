@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "CoAPExport.h"
+
+#ifndef __COAP_BLOCK_H__
+#define __COAP_BLOCK_H__
+
+/* Block-wise transfers (RFC 7959) */
+
+#define COAP_BLOCK_SZX_MIN         0      /* 16 bytes */
+#define COAP_BLOCK_SZX_MAX         6      /* 1024 bytes */
+#define COAP_BLOCK_MAX_WINDOW      8      /* blocks in flight, must not exceed the send list */
+#define COAP_BLOCK_NUM_UNKNOWN     0xFFFFFFFF
+
+#define COAP_BLOCK_SIZE(szx)               (1U << ((szx) + 4))
+#define COAP_BLOCK_VALUE(num, more, szx)   (((num) << 4) | ((more) ? 0x08 : 0) | ((szx) & 0x07))
+
+typedef enum {
+    COAP_BLOCK_STATE_IDLE = 0,
+    COAP_BLOCK_STATE_RUNNING,
+    COAP_BLOCK_STATE_DONE,
+    COAP_BLOCK_STATE_FAILED,
+} CoAPBlockState;
+
+/* Options are serialized in the order they are added, so the caller fills in
+ * the options numbered below Block2 in the HEAD phase (token, Uri-Path,
+ * Content-Format, Accept) and the ones above Size1 in the TAIL phase. */
+typedef enum {
+    COAP_BLOCK_PREPARE_HEAD = 0,
+    COAP_BLOCK_PREPARE_TAIL,
+} CoAPBlockPhase;
+
+typedef int (*CoAPBlockPrepare)(void *user, CoAPMessage *message, CoAPBlockPhase phase);
+
+/* Provide len bytes of the request body starting at offset, return 0 on success */
+typedef int (*CoAPBlockRead)(void *user, unsigned int offset, unsigned char *buf, unsigned int len);
+
+/* Consume len bytes of the response body at offset, always called in order */
+typedef int (*CoAPBlockWrite)(void *user, unsigned int offset, unsigned char *data, unsigned int len);
+
+typedef struct
+{
+    CoAPContext             *context;
+    unsigned short           blockopt;   /* COAP_OPTION_BLOCK1 to send, COAP_OPTION_BLOCK2 to receive */
+    CoAPMessageCode          code;
+    unsigned char            szx;
+    unsigned char            window;
+    unsigned int             total_len;  /* body length, Block1 only */
+    CoAPBlockPrepare         prepare;
+    CoAPBlockRead            read;
+    CoAPBlockWrite           write;
+    CoAPRespMsgHandler       handler;    /* called with the final response */
+    void                    *user;
+
+    CoAPBlockState           state;
+    char                     negotiated; /* block size confirmed by the first response */
+    unsigned char            inflight;
+    unsigned char            timeouts;   /* blocks sent again since the window last moved */
+    unsigned int             base;       /* lowest block neither confirmed nor delivered */
+    unsigned int             next;       /* next block number to be sent */
+    unsigned int             last;       /* number of the final block */
+    unsigned int             mask;       /* blocks confirmed or buffered, bit 0 is base */
+    unsigned int             bytes;      /* body bytes confirmed or delivered so far */
+    unsigned char           *buf;        /* one block to send, or the Block2 reorder window */
+    unsigned short          *lens;
+} CoAPBlockTransfer;
+
+int CoAPBlockOption_get(CoAPMessage *message, unsigned short optnum,
+                        unsigned int *num, unsigned char *more, unsigned char *szx);
+
+int CoAPBlockTransfer_init(CoAPBlockTransfer *transfer, CoAPContext *context,
+                           unsigned short blockopt, unsigned char szx, unsigned char window);
+
+int CoAPBlockTransfer_run(CoAPBlockTransfer *transfer);
+
+void CoAPBlockTransfer_deinit(CoAPBlockTransfer *transfer);
+
+#endif
@@ -105,7 +105,7 @@ int CoAPDeserialize_Payload(CoAPMessage *msg, unsigned char *buf, int buflen)
 {
     unsigned char *ptr = buf;
 
-    if (0xFF == *ptr) {
+    if (0 < buflen && 0xFF == *ptr) {
         ptr ++;
     } else {
         return 0;
@@ -25,6 +25,8 @@
 
 #include "CoAPNetwork.h"
 #include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPObserve.h"
 
 #define COAP_DEFAULT_PORT           5683 /* CoAP default UDP port */
 #define COAPS_DEFAULT_PORT          5684 /* CoAP default UDP port for secure transmission */
@@ -143,7 +145,7 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
         goto err;
     }
 
-    p_ctx->recvbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN);
+    p_ctx->recvbuf = coap_malloc(COAP_MSG_MAX_PDU_LEN * COAP_MSG_BATCH_NUM);
     if (NULL == p_ctx->recvbuf) {
         COAP_ERR("not enough memory");
         goto err;
@@ -160,6 +162,9 @@ CoAPContext *CoAPContext_create(CoAPInitParam *param)
     p_ctx->list.count = 0;
     p_ctx->list.maxcount = param->maxcount;
 
+    /*CoAP observed resource list*/
+    INIT_LIST_HEAD(&p_ctx->obslist);
+
     /*set the endpoint type by uri schema*/
     if (NULL != param->url) {
         ret = CoAPUri_parse(param->url, &network_param.ep_type, host, &network_param.port);
@@ -217,6 +222,9 @@ void CoAPContext_free(CoAPContext *p_ctx)
 
     CoAPSendNode *cur, *next;
 
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+    CoAPContext_detach(p_ctx);
+#endif
     CoAPNetwork_deinit(&p_ctx->network);
 
     list_for_each_entry_safe(cur, next, &p_ctx->list.sendlist, sendlist, CoAPSendNode) {
@@ -229,6 +237,7 @@ void CoAPContext_free(CoAPContext *p_ctx)
             cur = NULL;
         }
     }
+    CoAPObserve_free(p_ctx);
 
     if (NULL != p_ctx->recvbuf) {
         coap_free(p_ctx->recvbuf);
@@ -246,3 +255,43 @@ void CoAPContext_free(CoAPContext *p_ctx)
         p_ctx    =  NULL;
     }
 }
+
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+static void CoAPContext_event(uintptr_t fd, int events, void *user)
+{
+    CoAPMessage_poll((CoAPContext *)user);
+}
+
+int CoAPContext_attach(CoAPContext *p_ctx, void *loop)
+{
+    if (NULL == p_ctx || NULL == loop) {
+        return COAP_ERROR_NULL;
+    }
+    if (COAP_ENDPOINT_NOSEC != p_ctx->network.ep_type || NULL != p_ctx->loop) {
+        /* the DTLS session hides its socket and may hold decrypted records */
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    if (0 != HAL_EventLoop_Add(loop, (uintptr_t)p_ctx->network.context, HAL_EVENT_READ,
+                               CoAPContext_event, p_ctx)) {
+        COAP_ERR("Add the socket into the event loop failed");
+        return COAP_ERROR_INTERNAL;
+    }
+    p_ctx->loop = loop;
+    return COAP_SUCCESS;
+}
+
+int CoAPContext_detach(CoAPContext *p_ctx)
+{
+    if (NULL == p_ctx) {
+        return COAP_ERROR_NULL;
+    }
+    if (NULL == p_ctx->loop) {
+        return COAP_SUCCESS;
+    }
+
+    HAL_EventLoop_Remove(p_ctx->loop, (uintptr_t)p_ctx->network.context);
+    p_ctx->loop = NULL;
+    return COAP_SUCCESS;
+}
+#endif
@@ -30,6 +30,12 @@
 #define COAP_MSG_MAX_PATH_LEN     32
 #define COAP_MSG_MAX_PDU_LEN      1280
 
+#ifdef COAP_UDP_BATCH_SUPPORT
+#define COAP_MSG_BATCH_NUM        8     /* datagrams read or retransmitted per system call */
+#else
+#define COAP_MSG_BATCH_NUM        1
+#endif
+
 /*CoAP Content Type*/
 #define COAP_CT_TEXT_PLAIN                 0   /* text/plain (UTF-8) */
 #define COAP_CT_APP_LINK_FORMAT           40   /* application/link-format */
@@ -45,6 +51,7 @@
 #define COAP_OPTION_URI_HOST        3   /* C, String,  1-255 B, destination address */
 #define COAP_OPTION_ETAG            4   /* E, opaque,  1-8 B, (none) */
 #define COAP_OPTION_IF_NONE_MATCH   5   /* empty,      0 B, (none) */
+#define COAP_OPTION_OBSERVE         6   /* E, uint,    0-3 B, (none) */
 #define COAP_OPTION_URI_PORT        7   /* C, uint,    0-2 B, destination port */
 #define COAP_OPTION_LOCATION_PATH   8   /* E, String,  0-255 B, - */
 #define COAP_OPTION_URI_PATH       11   /* C, String,  0-255 B, (none) */
@@ -55,6 +62,7 @@
 #define COAP_OPTION_LOCATION_QUERY 20   /* E, String,      0-255 B, (none) */
 #define COAP_OPTION_BLOCK2         23   /* C, uint,    0--3 B, (none) */
 #define COAP_OPTION_BLOCK1         27   /* C, uint,    0--3 B, (none) */
+#define COAP_OPTION_SIZE2          28   /* E, uint,    0-4 B, (none) */
 #define COAP_OPTION_PROXY_URI      35   /* C, String,  1-1024 B, (none) */
 #define COAP_OPTION_PROXY_SCHEME   39   /* C, String,  1-255 B, (none) */
 #define COAP_OPTION_SIZE1          60   /* E, uint,    0-4 B, (none) */
@@ -151,6 +159,9 @@ typedef void (*CoAPRespMsgHandler)(void *data, void *message);
 
 typedef void (*CoAPEventNotifier)(unsigned int event, void *p_message);
 
+/* Adds the options which must be current on every (re-)registration of an observation */
+typedef int (*CoAPObservePrepare)(void *user, void *message);
+
 typedef struct
 {
     void                    *user;
@@ -164,6 +175,7 @@ typedef struct
     unsigned char           *message;
     unsigned int             msglen;
     CoAPRespMsgHandler       handler;
+    char                     timeout_notify;
     struct list_head         sendlist;
 } CoAPSendNode;
 
@@ -175,6 +187,24 @@ typedef struct
 }CoAPSendList;
 
 
+typedef struct
+{
+    unsigned char            tokenlen;
+    unsigned char            token[8];
+    char                     notified;
+    unsigned int             seqnum;
+    unsigned int             max_age;
+    uint64_t                 recv_ms;   /* local time of the latest notification */
+    unsigned char           *message;   /* the registration without the prepared options */
+    unsigned int             msglen;
+    CoAPRespMsgHandler       handler;
+    void                    *user;
+    CoAPObservePrepare       prepare;
+    void                    *prepare_user;
+    struct list_head         obslist;
+} CoAPObserveNode;
+
+
 typedef struct
 {
     CoAPMsgHeader   header;
@@ -186,6 +216,7 @@ typedef struct
     unsigned short  payloadlen;
     CoAPRespMsgHandler handler;
     void           *user;
+    char            timeout_notify;  /* the handler gets the request back when it goes unanswered */
 }CoAPMessage;
 
 typedef struct
@@ -202,9 +233,14 @@ typedef struct
     coap_network_t           network;
     CoAPEventNotifier        notifier;
     unsigned char            *sendbuf;
-    unsigned char            *recvbuf;
+    unsigned char            *recvbuf;  /* COAP_MSG_BATCH_NUM datagrams */
+    unsigned char             recv_depth;
     CoAPSendList             list;
+    struct list_head         obslist;
     unsigned int             waittime;
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+    void                    *loop;      /* NOT NULL, datagrams are received from the event loop */
+#endif
 }CoAPContext;
 
 #define COAP_TRC     log_debug
@@ -216,5 +252,12 @@ typedef struct
 CoAPContext *CoAPContext_create(CoAPInitParam *param);
 void CoAPContext_free(CoAPContext *p_ctx);
 
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+/* Receive from the event loop instead of waiting in CoAPMessage_cycle, which
+ * then only drives retransmissions. Plain UDP endpoints only. */
+int CoAPContext_attach(CoAPContext *p_ctx, void *loop);
+int CoAPContext_detach(CoAPContext *p_ctx);
+#endif
+
 
 #endif
@@ -22,6 +22,7 @@
 #include "CoAPExport.h"
 #include "CoAPSerialize.h"
 #include "CoAPDeserialize.h"
+#include "CoAPObserve.h"
 #include "iot_import.h"
 
 
@@ -86,7 +87,7 @@ int CoAPUintOption_add(CoAPMessage *message, unsigned short  optnum, unsigned in
 
     if (0 == data) {
         message->options[message->optnum].len = 0;
-    } else if (256 >= data) {
+    } else if (255 >= data) {
         message->options[message->optnum].len = 1;
         ptr = (unsigned char *)coap_malloc(1);
         if (NULL != ptr) {
@@ -116,6 +117,31 @@ int CoAPUintOption_add(CoAPMessage *message, unsigned short  optnum, unsigned in
     return COAP_SUCCESS;
 }
 
+int CoAPUintOption_get(CoAPMessage *message, unsigned short optnum, unsigned int *data)
+{
+    int index = 0;
+    int count = 0;
+
+    if (NULL == message || NULL == data) {
+        return COAP_ERROR_NULL;
+    }
+
+    for (index = 0; index < message->optnum; index++) {
+        if (optnum == message->options[index].num) {
+            if (4 < message->options[index].len) {
+                return COAP_ERROR_INVALID_LENGTH;
+            }
+            *data = 0;
+            for (count = 0; count < message->options[index].len; count++) {
+                *data = (*data << 8) | message->options[index].val[count];
+            }
+            return COAP_SUCCESS;
+        }
+    }
+
+    return COAP_ERROR_NOT_FOUND;
+}
+
 unsigned short CoAPMessageId_gen(CoAPContext *context)
 {
     unsigned short msg_id = 0;
@@ -201,6 +227,15 @@ int CoAPMessageHandler_set(CoAPMessage *message, CoAPRespMsgHandler handler)
     return COAP_SUCCESS;
 }
 
+int CoAPMessageTimeoutNotify_set(CoAPMessage *message, char notify)
+{
+    if (NULL == message) {
+        return COAP_ERROR_NULL;
+    }
+    message->timeout_notify = notify;
+    return COAP_SUCCESS;
+}
+
 int CoAPMessage_init(CoAPMessage *message)
 {
     if (NULL == message) {
@@ -248,6 +283,7 @@ static int CoAPMessageList_add(CoAPContext *context, CoAPMessage *message, int l
         node->user         = message->user;
         node->msgid        = message->header.msgid;
         node->handler      = message->handler;
+        node->timeout_notify = message->timeout_notify;
         node->msglen       = len;
         node->timeout_val   = COAP_ACK_TIMEOUT * COAP_ACK_RANDOM_FACTOR;
 
@@ -338,14 +374,43 @@ static int CoAPAckMessage_send(CoAPContext *context, unsigned short msgid)
     return CoAPMessage_send(context, &message);
 }
 
+static int CoAPRstMessage_send(CoAPContext *context, unsigned short msgid)
+{
+    CoAPMessage message;
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_RST);
+    CoAPMessageId_set(&message, msgid);
+    return CoAPMessage_send(context, &message);
+}
+
 static int CoAPRespMessage_handle(CoAPContext *context, CoAPMessage *message)
 {
-    CoAPSendNode *node = NULL;
+    CoAPSendNode    *node     = NULL;
+    CoAPObserveNode *observer = NULL;
+    unsigned int     seqnum   = 0;
+
+    observer = CoAPObserve_find(context, message->token, message->header.tokenlen);
+    if (NULL == observer && COAP_SUCCESS == CoAPUintOption_get(message, COAP_OPTION_OBSERVE, &seqnum)) {
+        list_for_each_entry(node, &context->list.sendlist, sendlist, CoAPSendNode) {
+            if (0 != node->tokenlen && node->tokenlen == message->header.tokenlen
+                && 0 == memcmp(node->token, message->token, message->header.tokenlen)) {
+                break;
+            }
+        }
+        if (&node->sendlist == &context->list.sendlist) {
+            /* Notification of an observation we don't hold, make the server forget it */
+            COAP_DEBUG("Reject the notification with unknown token");
+            return CoAPRstMessage_send(context, message->header.msgid);
+        }
+    }
 
     if (COAP_MESSAGE_TYPE_CON == message->header.type) {
         CoAPAckMessage_send(context, message->header.msgid);
     }
 
+    if (NULL != observer) {
+        CoAPObserve_handle(context, observer, message);
+    }
 
     list_for_each_entry(node, &context->list.sendlist, sendlist, CoAPSendNode) {
         if (0 != node->tokenlen && node->tokenlen == message->header.tokenlen
@@ -353,15 +418,17 @@ static int CoAPRespMessage_handle(CoAPContext *context, CoAPMessage *message)
 
             COAP_DEBUG("Find the node by token");
             message->user  = node->user;
-            if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code) {
-                /* TODO:i */
-                if (NULL != context->notifier) {
-                    context->notifier(message->header.code, message);
+            if (NULL == observer) {
+                if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code) {
+                    /* TODO:i */
+                    if (NULL != context->notifier) {
+                        context->notifier(message->header.code, message);
+                    }
                 }
-            }
 
-            if (NULL != node->handler) {
-                node->handler(node->user, message);
+                if (NULL != node->handler) {
+                    node->handler(node->user, message);
+                }
             }
             COAP_DEBUG("Remove the message id %d from list", node->msgid);
             list_del_init(&node->sendlist);
@@ -374,7 +441,7 @@ static int CoAPRespMessage_handle(CoAPContext *context, CoAPMessage *message)
             return COAP_SUCCESS;
         }
     }
-    return COAP_ERROR_NOT_FOUND;
+    return (NULL != observer) ? COAP_SUCCESS : COAP_ERROR_NOT_FOUND;
 }
 
 static void CoAPMessage_handle(CoAPContext *context,
@@ -414,32 +481,119 @@ static void CoAPMessage_handle(CoAPContext *context,
 int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount)
 {
     int len = 0;
+    int num = 0;
+    int index = 0;
     int count = readcount;
+    unsigned int batch = COAP_MSG_BATCH_NUM;
+    hal_udp_msg_t msgs[COAP_MSG_BATCH_NUM];
+
+    /* A handler may receive again (e.g. re-authentication), it only gets the
+     * first slot so the datagrams of this batch which are not handled yet survive */
+    if (0 != context->recv_depth) {
+        batch = 1;
+    }
+    context->recv_depth++;
 
     while (1) {
-        len = CoAPNetwork_read(&context->network, context->recvbuf,
-                               COAP_MSG_MAX_PDU_LEN, timeout);
-        if (len > 0) {
-            if(0 == readcount){
-                CoAPMessage_handle(context, context->recvbuf, len);
+        if (0 != readcount && batch > (unsigned int)count) {
+            batch = count;
+        }
+        for (index = 0; index < batch; index++) {
+            msgs[index].p_data  = context->recvbuf + index * COAP_MSG_MAX_PDU_LEN;
+            msgs[index].datalen = COAP_MSG_MAX_PDU_LEN;
+        }
+
+        num = CoAPNetwork_readBatch(&context->network, msgs, batch, timeout);
+        if (0 >= num) {
+            len = 0;
+            break;
+        }
+
+        for (index = 0; index < num; index++) {
+            len = msgs[index].datalen;
+            CoAPMessage_handle(context, msgs[index].p_data, len);
+            if (0 != readcount && 0 == --count) {
+                break;
             }
-            else{
-                count--;
-                CoAPMessage_handle(context, context->recvbuf, len);
-                if(0 == count){
-                    return len;
-                }
+        }
+        if (0 != readcount && 0 == count) {
+            break;
+        }
+    }
+
+    context->recv_depth--;
+    return len;
+}
+
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+int CoAPMessage_poll(CoAPContext *context)
+{
+    int num = 0;
+    int index = 0;
+    unsigned int batch = COAP_MSG_BATCH_NUM;
+    hal_udp_msg_t msgs[COAP_MSG_BATCH_NUM];
+
+    if (0 != context->recv_depth) {
+        batch = 1;
+    }
+    context->recv_depth++;
+
+    for (index = 0; index < batch; index++) {
+        msgs[index].p_data  = context->recvbuf + index * COAP_MSG_MAX_PDU_LEN;
+        msgs[index].datalen = COAP_MSG_MAX_PDU_LEN;
+    }
+
+    /* The socket is readable so this does not wait, a timeout of 0 would
+     * block forever. The loop reports again what is left in the queue */
+    num = CoAPNetwork_readBatch(&context->network, msgs, batch, 1);
+    for (index = 0; index < num; index++) {
+        CoAPMessage_handle(context, msgs[index].p_data, msgs[index].datalen);
+    }
+
+    context->recv_depth--;
+    return (num > 0) ? num : 0;
+}
+#endif
+
+static unsigned int CoAPMessage_flush(CoAPContext *context, hal_udp_msg_t *msgs, unsigned int num)
+{
+    unsigned int ret = COAP_SUCCESS;
+
+    if (0 < num) {
+        ret = CoAPNetwork_writeBatch(&context->network, msgs, num);
+        if (ret != COAP_SUCCESS) {
+            if (NULL != context->notifier) {
+                /* TODO: */
+                /* context->notifier(context, event); */
             }
-        } else {
-            return 0;
         }
     }
+    return 0;
+}
+
+static void CoAPMessage_timeout(CoAPSendNode *node)
+{
+    CoAPMessage request;
+
+    /* the request points into the node, which is only freed after the handler returns */
+    memset(&request, 0x00, sizeof(CoAPMessage));
+    if (NULL != node->message && COAP_SUCCESS == CoAPDeserialize_Message(&request, node->message, node->msglen)) {
+        request.user = node->user;
+        node->handler(node->user, &request);
+    }
 }
 
 int CoAPMessage_cycle(CoAPContext *context)
 {
-    unsigned int ret = 0;
-    CoAPMessage_recv(context, context->waittime, 0);
+    unsigned int num = 0;
+    hal_udp_msg_t msgs[COAP_MSG_BATCH_NUM];
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+    if (NULL == context->loop)
+#endif
+    {
+        CoAPMessage_recv(context, context->waittime, 0);
+    }
+    CoAPObserve_cycle(context);
 
     CoAPSendNode *node = NULL, *next = NULL;
     list_for_each_entry_safe(node, next, &context->list.sendlist, sendlist, CoAPSendNode) {
@@ -450,13 +604,9 @@ int CoAPMessage_cycle(CoAPContext *context)
                     node->timeout_val = node->timeout;
                     node->retrans_count++;
                     COAP_DEBUG("Retansmit the message id %d len %d", node->msgid, node->msglen);
-                    ret = CoAPNetwork_write(&context->network, node->message, node->msglen);
-                    if (ret != COAP_SUCCESS) {
-                        if (NULL != context->notifier) {
-                            /* TODO: */
-                            /* context->notifier(context, event); */
-                        }
-                    }
+                    msgs[num].p_data  = node->message;
+                    msgs[num].datalen = node->msglen;
+                    num++;
                 }
 
                 if ((node->timeout > COAP_MAX_TRANSMISSION_SPAN) ||
@@ -465,14 +615,21 @@ int CoAPMessage_cycle(CoAPContext *context)
                         /* TODO: */
                         /* context->notifier(context, event); */
                     }
+                    /* The last retransmission may still be queued */
+                    num = CoAPMessage_flush(context, msgs, num);
 
                     /*Remove the node from the list*/
                     list_del_init(&node->sendlist);
                     context->list.count--;
                     COAP_INFO("Retransmit timeout,remove the message id %d count %d",
                               node->msgid, context->list.count);
+                    if (node->timeout_notify && NULL != node->handler) {
+                        CoAPMessage_timeout(node);
+                    }
                     coap_free(node->message);
                     coap_free(node);
+                } else if (COAP_MSG_BATCH_NUM == num) {
+                    num = CoAPMessage_flush(context, msgs, num);
                 }
             }
              else {
@@ -480,6 +637,6 @@ int CoAPMessage_cycle(CoAPContext *context)
             }
         }
     }
+    CoAPMessage_flush(context, msgs, num);
     return COAP_SUCCESS;
 }
-
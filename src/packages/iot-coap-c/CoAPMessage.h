@@ -29,6 +29,9 @@ int CoAPStrOption_add(CoAPMessage *message, unsigned short optnum,
 int CoAPUintOption_add(CoAPMessage *message, unsigned short  optnum,
             unsigned int data);
 
+int CoAPUintOption_get(CoAPMessage *message, unsigned short  optnum,
+            unsigned int *data);
+
 unsigned short CoAPMessageId_gen(CoAPContext *context);
 
 int CoAPMessageId_set(CoAPMessage *message, unsigned short msgid);
@@ -47,6 +50,10 @@ int CoAPMessagePayload_set(CoAPMessage *message, unsigned char *payload,
 
 int CoAPMessageHandler_set(CoAPMessage *message, CoAPRespMsgHandler handler);
 
+/* Also call the handler when the retransmissions of the request run out, with
+ * the request itself, whose code tells it from a response */
+int CoAPMessageTimeoutNotify_set(CoAPMessage *message, char notify);
+
 int CoAPMessage_init(CoAPMessage *message);
 
 int CoAPMessage_destory(CoAPMessage *message);
@@ -57,6 +64,11 @@ int CoAPMessage_recv(CoAPContext *context, unsigned int timeout, int readcount);
 
 int CoAPMessage_cycle(CoAPContext *context);
 
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+/* Handle the datagrams already received, called when the socket is readable */
+int CoAPMessage_poll(CoAPContext *context);
+#endif
+
 
 
 #endif
@@ -147,6 +147,58 @@ int CoAPNetwork_read(coap_network_t *network, unsigned char  *data,
     return len;
 }
 
+int CoAPNetwork_readBatch(coap_network_t *network, hal_udp_msg_t *p_msgs,
+                          unsigned int count, unsigned int timeout)
+{
+    int len = 0;
+
+#ifdef COAP_UDP_BATCH_SUPPORT
+    if (COAP_ENDPOINT_NOSEC == network->ep_type && 1 < count) {
+        int          index = 0;
+        unsigned int size  = p_msgs[0].datalen;
+
+        len = HAL_UDP_readBatch((void *)network->context, p_msgs, count, timeout);
+        for (index = 0; index < len; index++) {
+            /* payloads are handled as strings further up */
+            if (p_msgs[index].datalen < size) {
+                p_msgs[index].p_data[p_msgs[index].datalen] = 0x00;
+            }
+        }
+        COAP_TRC("<< CoAP recv %d datagrams", len);
+        return len;
+    }
+#endif
+
+    len = CoAPNetwork_read(network, p_msgs[0].p_data, p_msgs[0].datalen, timeout);
+    if (0 >= len) {
+        return len;
+    }
+    p_msgs[0].datalen = len;
+    return 1;
+}
+
+unsigned int CoAPNetwork_writeBatch(coap_network_t *p_network,
+                                    const hal_udp_msg_t *p_msgs, unsigned int count)
+{
+    unsigned int rc    = COAP_SUCCESS;
+    unsigned int index = 0;
+
+#ifdef COAP_UDP_BATCH_SUPPORT
+    if (COAP_ENDPOINT_NOSEC == p_network->ep_type && 1 < count) {
+        int sent = HAL_UDP_writeBatch((void *)p_network->context, p_msgs, count);
+        COAP_DEBUG("[CoAP-NWK]: Network batch write %d of %d", sent, count);
+        return (count == (unsigned int)sent) ? COAP_SUCCESS : COAP_ERROR_WRITE_FAILED;
+    }
+#endif
+
+    for (index = 0; index < count; index++) {
+        if (COAP_SUCCESS != CoAPNetwork_write(p_network, p_msgs[index].p_data, p_msgs[index].datalen)) {
+            rc = COAP_ERROR_WRITE_FAILED;
+        }
+    }
+    return rc;
+}
+
 unsigned int CoAPNetwork_init(const coap_network_init_t *p_param, coap_network_t *p_network)
 {
     unsigned int    err_code = COAP_SUCCESS;
@@ -63,6 +63,13 @@ unsigned int CoAPNetwork_write(coap_network_t *p_network,
 int CoAPNetwork_read(coap_network_t *network, unsigned char  *data,
                       unsigned int datalen, unsigned int timeout);
 
+/* Read up to count datagrams, returns the number read or <= 0 on timeout/error */
+int CoAPNetwork_readBatch(coap_network_t *network, hal_udp_msg_t *p_msgs,
+                          unsigned int count, unsigned int timeout);
+
+unsigned int CoAPNetwork_writeBatch(coap_network_t *p_network,
+                                    const hal_udp_msg_t *p_msgs, unsigned int count);
+
 unsigned int CoAPNetwork_deinit(coap_network_t *p_network);
 
 
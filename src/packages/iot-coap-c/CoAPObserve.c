@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdio.h>
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPSerialize.h"
+#include "CoAPDeserialize.h"
+#include "CoAPObserve.h"
+#include "iot_import.h"
+
+#define COAP_OBSERVE_SEQ_HALF          (1 << 23)
+#define COAP_OBSERVE_FRESH_MS          (128 * 1000)
+#define COAP_OBSERVE_DEFAULT_MAXAGE    60   /* seconds, the Max-Age option default */
+#define COAP_OBSERVE_REREGISTER_MARGIN 5    /* seconds past Max-Age before re-registering */
+
+CoAPObserveNode *CoAPObserve_find(CoAPContext *context, unsigned char *token, unsigned char tokenlen)
+{
+    CoAPObserveNode *node = NULL;
+
+    if (NULL == context || NULL == token || 0 == tokenlen) {
+        return NULL;
+    }
+
+    list_for_each_entry(node, &context->obslist, obslist, CoAPObserveNode) {
+        if (node->tokenlen == tokenlen && 0 == memcmp(node->token, token, tokenlen)) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+static void CoAPObserve_remove(CoAPContext *context, CoAPObserveNode *node)
+{
+    list_del_init(&node->obslist);
+    if (NULL != node->message) {
+        coap_free(node->message);
+    }
+    coap_free(node);
+}
+
+/* Build the registration kept in the node with a new message id and the prepared options, and send it */
+static int CoAPObserve_send(CoAPContext *context, CoAPObserveNode *node, unsigned short msgid)
+{
+    int          ret   = COAP_SUCCESS;
+    int          index = 0;
+    CoAPMessage  stored;
+    CoAPMessage  message;
+
+    memset(&stored, 0x00, sizeof(CoAPMessage));
+    ret = CoAPDeserialize_Message(&stored, node->message, node->msglen);
+    if (COAP_SUCCESS != ret) {
+        return ret;
+    }
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, stored.header.type);
+    CoAPMessageCode_set(&message, stored.header.code);
+    CoAPMessageId_set(&message, msgid);
+    CoAPMessageToken_set(&message, node->token, node->tokenlen);
+    CoAPMessageHandler_set(&message, node->handler);
+    CoAPMessageUserData_set(&message, node->user);
+    /* the stored options point into node->message, copy them so that the message owns its options */
+    for (index = 0; index < stored.optnum && COAP_SUCCESS == ret; index++) {
+        ret = CoAPStrOption_add(&message, stored.options[index].num,
+                                stored.options[index].val, stored.options[index].len);
+    }
+    if (COAP_SUCCESS == ret && NULL != node->prepare) {
+        ret = node->prepare(node->prepare_user, &message);
+    }
+    if (COAP_SUCCESS == ret) {
+        ret = CoAPMessage_send(context, &message);
+    }
+    CoAPMessage_destory(&message);
+
+    return ret;
+}
+
+int CoAPObserve_register(CoAPContext *context, CoAPMessage *message,
+                         CoAPObservePrepare prepare, void *prepare_user)
+{
+    int              ret    = COAP_SUCCESS;
+    unsigned short   msglen = 0;
+    CoAPObserveNode *node   = NULL;
+
+    if (NULL == context || NULL == message) {
+        return COAP_ERROR_NULL;
+    }
+    if (0 == message->header.tokenlen || sizeof(node->token) < message->header.tokenlen) {
+        return COAP_ERROR_INVALID_LENGTH;
+    }
+    if (NULL != CoAPObserve_find(context, message->token, message->header.tokenlen)) {
+        return COAP_ERROR_INVALID_PARAM;
+    }
+
+    msglen = CoAPSerialize_MessageLength(message);
+    node = coap_malloc(sizeof(CoAPObserveNode));
+    if (NULL == node) {
+        return COAP_ERROR_INTERNAL;
+    }
+    memset(node, 0x00, sizeof(CoAPObserveNode));
+    node->message = coap_malloc(msglen);
+    if (NULL == node->message) {
+        coap_free(node);
+        return COAP_ERROR_INTERNAL;
+    }
+
+    node->msglen       = CoAPSerialize_Message(message, node->message, msglen);
+    node->tokenlen     = message->header.tokenlen;
+    memcpy(node->token, message->token, message->header.tokenlen);
+    node->handler      = message->handler;
+    node->user         = message->user;
+    node->prepare      = prepare;
+    node->prepare_user = prepare_user;
+    node->max_age      = COAP_OBSERVE_DEFAULT_MAXAGE;
+    node->recv_ms      = HAL_UptimeMs();
+
+    ret = CoAPObserve_send(context, node, message->header.msgid);
+    if (COAP_SUCCESS != ret) {
+        coap_free(node->message);
+        coap_free(node);
+        return ret;
+    }
+    list_add_tail(&node->obslist, &context->obslist);
+
+    COAP_DEBUG("Observe registered, message id %d", message->header.msgid);
+    return COAP_SUCCESS;
+}
+
+int CoAPObserve_deregister(CoAPContext *context, unsigned char *token, unsigned char tokenlen)
+{
+    CoAPObserveNode *node = CoAPObserve_find(context, token, tokenlen);
+
+    if (NULL == node) {
+        return COAP_ERROR_NOT_FOUND;
+    }
+    CoAPObserve_remove(context, node);
+    return COAP_SUCCESS;
+}
+
+static int CoAPObserve_fresh(CoAPObserveNode *node, unsigned int seqnum, uint64_t now)
+{
+    /* RFC 7641 section 3.4, sequence numbers are 24 bits and wrap around */
+    if (!node->notified) {
+        return 1;
+    }
+    if ((node->seqnum < seqnum && seqnum - node->seqnum < COAP_OBSERVE_SEQ_HALF)
+        || (node->seqnum > seqnum && node->seqnum - seqnum > COAP_OBSERVE_SEQ_HALF)) {
+        return 1;
+    }
+    return now > node->recv_ms + COAP_OBSERVE_FRESH_MS;
+}
+
+int CoAPObserve_handle(CoAPContext *context, CoAPObserveNode *node, CoAPMessage *message)
+{
+    unsigned int       seqnum  = 0;
+    unsigned int       max_age = COAP_OBSERVE_DEFAULT_MAXAGE;
+    uint64_t           now     = HAL_UptimeMs();
+    CoAPRespMsgHandler handler = NULL;
+    void              *user    = NULL;
+
+    if (NULL == context || NULL == node || NULL == message) {
+        return COAP_ERROR_NULL;
+    }
+
+    message->user = node->user;
+
+    /* a response without Observe or an error ends the observation */
+    if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code
+        || COAP_SUCCESS != CoAPUintOption_get(message, COAP_OPTION_OBSERVE, &seqnum)) {
+        COAP_INFO("Observation ended by server, code 0x%x", message->header.code);
+        handler = node->handler;
+        user    = node->user;
+        CoAPObserve_remove(context, node);
+        if (COAP_MSG_CODE_400_BAD_REQUEST <= message->header.code && NULL != context->notifier) {
+            context->notifier(message->header.code, message);
+        }
+        if (NULL != handler) {
+            handler(user, message);
+        }
+        return COAP_SUCCESS;
+    }
+
+    if (!CoAPObserve_fresh(node, seqnum, now)) {
+        COAP_DEBUG("Drop the stale notification %u, latest %u", seqnum, node->seqnum);
+        return COAP_SUCCESS;
+    }
+
+    CoAPUintOption_get(message, COAP_OPTION_MAXAGE, &max_age);
+    node->notified = 1;
+    node->seqnum   = seqnum;
+    node->recv_ms  = now;
+    node->max_age  = max_age;
+
+    if (NULL != node->handler) {
+        node->handler(node->user, message);
+    }
+    return COAP_SUCCESS;
+}
+
+int CoAPObserve_cycle(CoAPContext *context)
+{
+    unsigned short   msgid = 0;
+    uint64_t         now   = HAL_UptimeMs();
+    CoAPObserveNode *node  = NULL;
+
+    list_for_each_entry(node, &context->obslist, obslist, CoAPObserveNode) {
+        if (now < node->recv_ms + (uint64_t)(node->max_age + COAP_OBSERVE_REREGISTER_MARGIN) * 1000) {
+            continue;
+        }
+
+        /* the representation may be outdated, register again with the same token */
+        msgid = CoAPMessageId_gen(context);
+        node->recv_ms = now;
+        COAP_INFO("Re-register the observation, message id %d", msgid);
+        if (COAP_SUCCESS != CoAPObserve_send(context, node, msgid)) {
+            COAP_ERR("Re-register the observation failed");
+        }
+    }
+    return COAP_SUCCESS;
+}
+
+void CoAPObserve_free(CoAPContext *context)
+{
+    CoAPObserveNode *node = NULL, *next = NULL;
+
+    list_for_each_entry_safe(node, next, &context->obslist, obslist, CoAPObserveNode) {
+        CoAPObserve_remove(context, node);
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include "CoAPExport.h"
+
+#ifndef __COAP_OBSERVE_H__
+#define __COAP_OBSERVE_H__
+
+/* Observing resources (RFC 7641) */
+
+#define COAP_OBSERVE_REGISTER      0
+#define COAP_OBSERVE_DEREGISTER    1
+
+CoAPObserveNode *CoAPObserve_find(CoAPContext *context, unsigned char *token, unsigned char tokenlen);
+
+/* Send a GET which carries Observe 0 and a token, notifications matching the
+ * token are passed to the message handler until the observation ends. The
+ * message is kept to register again, 'prepare' (may be NULL) adds the options
+ * which have to be current, such as credentials, to every registration sent. */
+int CoAPObserve_register(CoAPContext *context, CoAPMessage *message,
+                         CoAPObservePrepare prepare, void *prepare_user);
+
+int CoAPObserve_deregister(CoAPContext *context, unsigned char *token, unsigned char tokenlen);
+
+int CoAPObserve_handle(CoAPContext *context, CoAPObserveNode *node, CoAPMessage *message);
+
+int CoAPObserve_cycle(CoAPContext *context);
+
+void CoAPObserve_free(CoAPContext *context);
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "iot_import.h"
+
+#define HAL_EVENT_MAX_NUM       (64)    /* events fetched per epoll_wait */
+
+typedef struct {
+    hal_event_cb_t  cb;
+    void           *user;
+} hal_event_node_t;
+
+typedef struct {
+    int                 epfd;
+    int                 wakefd;     /* eventfd written by HAL_EventLoop_Wakeup() */
+    int                 node_num;   /* size of 'nodes', indexed by fd */
+    hal_event_node_t   *nodes;
+    struct epoll_event  events[HAL_EVENT_MAX_NUM];
+} hal_event_loop_t;
+
+static uint32_t _linux_epoll_events(int events)
+{
+    uint32_t ev = 0;
+
+    if (events & HAL_EVENT_READ) {
+        ev |= EPOLLIN;
+    }
+    if (events & HAL_EVENT_WRITE) {
+        ev |= EPOLLOUT;
+    }
+    return ev;
+}
+
+void *HAL_EventLoop_Create(void)
+{
+    hal_event_loop_t *loop = NULL;
+    struct epoll_event ev;
+
+    loop = malloc(sizeof(hal_event_loop_t));
+    if (NULL == loop) {
+        return NULL;
+    }
+    memset(loop, 0, sizeof(hal_event_loop_t));
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        perror("epoll_create1 fail");
+        free(loop);
+        return NULL;
+    }
+
+    loop->wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = loop->wakefd;
+    if (loop->wakefd < 0 || 0 != epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev)) {
+        perror("eventfd fail");
+        if (loop->wakefd >= 0) {
+            close(loop->wakefd);
+        }
+        close(loop->epfd);
+        free(loop);
+        return NULL;
+    }
+    return loop;
+}
+
+void HAL_EventLoop_Destroy(void *loop)
+{
+    hal_event_loop_t *p_loop = (hal_event_loop_t *)loop;
+
+    if (NULL == p_loop) {
+        return;
+    }
+    close(p_loop->wakefd);
+    close(p_loop->epfd);
+    free(p_loop->nodes);
+    free(p_loop);
+}
+
+int HAL_EventLoop_Add(void *loop, uintptr_t fd, int events, hal_event_cb_t cb, void *user)
+{
+    int num;
+    hal_event_node_t *nodes;
+    struct epoll_event ev;
+    hal_event_loop_t *p_loop = (hal_event_loop_t *)loop;
+
+    if (NULL == p_loop || NULL == cb || (int)fd < 0) {
+        return -1;
+    }
+
+    if ((int)fd >= p_loop->node_num) {
+        num = (0 == p_loop->node_num) ? 64 : p_loop->node_num;
+        while (num <= (int)fd) {
+            num *= 2;
+        }
+        nodes = realloc(p_loop->nodes, num * sizeof(hal_event_node_t));
+        if (NULL == nodes) {
+            return -1;
+        }
+        memset(nodes + p_loop->node_num, 0, (num - p_loop->node_num) * sizeof(hal_event_node_t));
+        p_loop->nodes = nodes;
+        p_loop->node_num = num;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = _linux_epoll_events(events);
+    ev.data.fd = (int)fd;
+    if (0 != epoll_ctl(p_loop->epfd, EPOLL_CTL_ADD, (int)fd, &ev)) {
+        perror("epoll_ctl add fail");
+        return -1;
+    }
+
+    p_loop->nodes[fd].cb = cb;
+    p_loop->nodes[fd].user = user;
+    return 0;
+}
+
+int HAL_EventLoop_Modify(void *loop, uintptr_t fd, int events)
+{
+    struct epoll_event ev;
+    hal_event_loop_t *p_loop = (hal_event_loop_t *)loop;
+
+    if (NULL == p_loop || (int)fd < 0 || (int)fd >= p_loop->node_num || NULL == p_loop->nodes[fd].cb) {
+        return -1;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = _linux_epoll_events(events);
+    ev.data.fd = (int)fd;
+    if (0 != epoll_ctl(p_loop->epfd, EPOLL_CTL_MOD, (int)fd, &ev)) {
+        perror("epoll_ctl mod fail");
+        return -1;
+    }
+    return 0;
+}
+
+int HAL_EventLoop_Remove(void *loop, uintptr_t fd)
+{
+    hal_event_loop_t *p_loop = (hal_event_loop_t *)loop;
+
+    if (NULL == p_loop || (int)fd < 0 || (int)fd >= p_loop->node_num || NULL == p_loop->nodes[fd].cb) {
+        return -1;
+    }
+
+    /* a pending event of this round finds the slot empty and is dropped */
+    p_loop->nodes[fd].cb = NULL;
+    p_loop->nodes[fd].user = NULL;
+    if (0 != epoll_ctl(p_loop->epfd, EPOLL_CTL_DEL, (int)fd, NULL)) {
+        perror("epoll_ctl del fail");
+        return -1;
+    }
+    return 0;
+}
+
+int HAL_EventLoop_Run(void *loop, uint32_t timeout_ms)
+{
+    int i, fd, num, events, called = 0;
+    uint64_t count;
+    hal_event_node_t *node;
+    hal_event_loop_t *p_loop = (hal_event_loop_t *)loop;
+
+    if (NULL == p_loop) {
+        return -1;
+    }
+
+    num = epoll_wait(p_loop->epfd, p_loop->events, HAL_EVENT_MAX_NUM, (int)timeout_ms);
+    if (num < 0) {
+        if (EINTR == errno) {
+            return 0;
+        }
+        perror("epoll_wait fail");
+        return -1;
+    }
+
+    for (i = 0; i < num; i++) {
+        fd = p_loop->events[i].data.fd;
+        if (fd == p_loop->wakefd) {
+            if (read(fd, &count, sizeof(count)) < 0 && EAGAIN != errno) {
+                perror("eventfd read fail");
+            }
+            continue;
+        }
+        if (fd >= p_loop->node_num || NULL == p_loop->nodes[fd].cb) {
+            continue;
+        }
+        node = &p_loop->nodes[fd];
+
+        events = 0;
+        if (p_loop->events[i].events & EPOLLIN) {
+            events |= HAL_EVENT_READ;
+        }
+        if (p_loop->events[i].events & EPOLLOUT) {
+            events |= HAL_EVENT_WRITE;
+        }
+        if (p_loop->events[i].events & (EPOLLERR | EPOLLHUP)) {
+            /* let the reader see the error or EOF too */
+            events |= HAL_EVENT_ERROR | HAL_EVENT_READ;
+        }
+
+        node->cb((uintptr_t)fd, events, node->user);
+        called++;
+    }
+    return called;
+}
+
+int HAL_EventLoop_Wakeup(void *loop)
+{
+    uint64_t one = 1;
+    hal_event_loop_t *p_loop = (hal_event_loop_t *)loop;
+
+    if (NULL == p_loop) {
+        return -1;
+    }
+
+    /* the counter would need 2^64 - 1 pending wakeups to block the write */
+    if (write(p_loop->wakefd, &one, sizeof(one)) != sizeof(one)) {
+        perror("eventfd write fail");
+        return -1;
+    }
+    return 0;
+}
+
+#endif  /* IOTX_EVENT_LOOP_SUPPORT */
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifdef IOTX_SPOOL_SUPPORT
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "iot_import.h"
+
+#define HAL_FILE_IOV_MAX        (16)    /* buffers passed to one writev */
+
+/* the handle is the descriptor plus 1, so descriptor 0 is not NULL */
+#define HAL_FILE_FD(fp)         ((int)(intptr_t)(fp) - 1)
+
+void *HAL_File_Open(const char *path, int truncate)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+
+    if (fd < 0) {
+        perror("open fail");
+        return NULL;
+    }
+    return (void *)(intptr_t)(fd + 1);
+}
+
+void HAL_File_Close(void *fp)
+{
+    close(HAL_FILE_FD(fp));
+}
+
+int32_t HAL_File_Read(void *fp, uint32_t offset, char *buf, uint32_t len)
+{
+    uint32_t done = 0;
+    ssize_t ret;
+
+    while (done < len) {
+        ret = pread(HAL_FILE_FD(fp), buf + done, len - done, (off_t)offset + done);
+        if (ret < 0 && EINTR == errno) {
+            continue;
+        }
+        if (ret < 0) {
+            perror("pread fail");
+            return -1;
+        }
+        if (0 == ret) {
+            break;
+        }
+        done += ret;
+    }
+    return done;
+}
+
+int32_t HAL_File_Append(void *fp, const hal_iovec_t *iov, uint32_t iovcnt)
+{
+    struct iovec vec[HAL_FILE_IOV_MAX];
+    uint32_t i, cnt, skip = 0, total = 0;
+    ssize_t ret;
+
+    while (iovcnt > 0) {
+        cnt = (iovcnt < HAL_FILE_IOV_MAX) ? iovcnt : HAL_FILE_IOV_MAX;
+        for (i = 0; i < cnt; i++) {
+            vec[i].iov_base = (void *)iov[i].buf;
+            vec[i].iov_len = iov[i].len;
+        }
+        vec[0].iov_base = (char *)vec[0].iov_base + skip;
+        vec[0].iov_len -= skip;
+
+        ret = writev(HAL_FILE_FD(fp), vec, cnt);
+        if (ret < 0 && EINTR == errno) {
+            continue;
+        }
+        if (ret < 0) {
+            perror("writev fail");
+            return -1;
+        }
+        total += ret;
+
+        /* a short write continues from where it stopped */
+        ret += skip;
+        skip = 0;
+        while (iovcnt > 0 && (size_t)ret >= iov[0].len) {
+            ret -= iov[0].len;
+            iov++;
+            iovcnt--;
+        }
+        skip = ret;
+    }
+    return total;
+}
+
+int32_t HAL_File_Size(void *fp)
+{
+    struct stat st;
+
+    if (0 != fstat(HAL_FILE_FD(fp), &st)) {
+        perror("fstat fail");
+        return -1;
+    }
+    return (int32_t)st.st_size;
+}
+
+int HAL_File_Truncate(void *fp, uint32_t size)
+{
+    if (0 != ftruncate(HAL_FILE_FD(fp), size)) {
+        perror("ftruncate fail");
+        return -1;
+    }
+    return 0;
+}
+
+int HAL_File_Sync(void *fp)
+{
+    if (0 != fdatasync(HAL_FILE_FD(fp))) {
+        perror("fdatasync fail");
+        return -1;
+    }
+    return 0;
+}
+
+int HAL_File_Remove(const char *path)
+{
+    if (0 != unlink(path) && ENOENT != errno) {
+        perror("unlink fail");
+        return -1;
+    }
+    return 0;
+}
+
+void *HAL_File_Map(void *fp, uint32_t size)
+{
+    void *addr;
+
+    if (HAL_File_Size(fp) < (int32_t)size && 0 != HAL_File_Truncate(fp, size)) {
+        return NULL;
+    }
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, HAL_FILE_FD(fp), 0);
+    if (MAP_FAILED == addr) {
+        perror("mmap fail");
+        return NULL;
+    }
+    return addr;
+}
+
+int HAL_File_SyncMap(void *addr, uint32_t size)
+{
+    if (0 != msync(addr, size, MS_SYNC)) {
+        perror("msync fail");
+        return -1;
+    }
+    return 0;
+}
+
+void HAL_File_Unmap(void *addr, uint32_t size)
+{
+    munmap(addr, size);
+}
+
+#endif  /* IOTX_SPOOL_SUPPORT */
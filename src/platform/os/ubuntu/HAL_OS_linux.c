@@ -389,14 +389,17 @@ int HAL_GetFirmwareVesion(_OU_ char* version)
 }
 
 static FILE *fp;
+static FILE *fp_running;
 
 #define otafilename "/tmp/alinkota.bin"
+#define runningfilename "/proc/self/exe"
 
 void HAL_Firmware_Persistence_Start(void)
 {
 #ifdef __DEMO__
     fp = fopen(otafilename, "w");
 //    assert(fp);
+    fp_running = fopen(runningfilename, "rb");
 #endif
     return;
 }
@@ -414,15 +417,115 @@ int HAL_Firmware_Persistence_Write(_IN_ char *buffer, _IN_ uint32_t length)
     return 0;
 }
 
+/* the firmware writer thread, it writes one buffer at a time */
+static pthread_t fw_thread;
+static pthread_mutex_t fw_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fw_cond = PTHREAD_COND_INITIALIZER;
+static int fw_running;
+static int fw_busy;
+static int fw_result;
+static char *fw_buffer;
+static uint32_t fw_length;
+
+static void *_firmware_writer(void *arg)
+{
+    int result;
+
+    pthread_mutex_lock(&fw_lock);
+    while (fw_running) {
+        if (!fw_busy) {
+            pthread_cond_wait(&fw_cond, &fw_lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&fw_lock);
+        result = HAL_Firmware_Persistence_Write(fw_buffer, fw_length);
+        pthread_mutex_lock(&fw_lock);
+
+        fw_result = result;
+        fw_busy = 0;
+        pthread_cond_broadcast(&fw_cond);
+    }
+    pthread_mutex_unlock(&fw_lock);
+
+    return NULL;
+}
+
+int HAL_Firmware_Persistence_WriteAsync(_IN_ char *buffer, _IN_ uint32_t length)
+{
+    pthread_mutex_lock(&fw_lock);
+    if (!fw_running) {
+        if (0 != pthread_create(&fw_thread, NULL, _firmware_writer, NULL)) {
+            pthread_mutex_unlock(&fw_lock);
+            perror("pthread_create fail");
+            return -1;
+        }
+        fw_running = 1;
+    }
+
+    while (fw_busy) {
+        pthread_cond_wait(&fw_cond, &fw_lock);
+    }
+    fw_buffer = buffer;
+    fw_length = length;
+    fw_busy = 1;
+    pthread_cond_broadcast(&fw_cond);
+    pthread_mutex_unlock(&fw_lock);
+
+    return 0;
+}
+
+int HAL_Firmware_Persistence_Wait(void)
+{
+    int result;
+
+    pthread_mutex_lock(&fw_lock);
+    while (fw_busy) {
+        pthread_cond_wait(&fw_cond, &fw_lock);
+    }
+    result = fw_result;
+    pthread_mutex_unlock(&fw_lock);
+
+    return result;
+}
+
+int HAL_Firmware_Persistence_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+#ifdef __DEMO__
+    if (fp_running == NULL || fseek(fp_running, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    return fread(buffer, 1, length, fp_running);
+#else
+    return -1;
+#endif
+}
+
 int HAL_Firmware_Persistence_Stop(void)
 {
+    /* the last write is over, as the caller waited for it */
+    pthread_mutex_lock(&fw_lock);
+    if (fw_running) {
+        fw_running = 0;
+        pthread_cond_broadcast(&fw_cond);
+        pthread_mutex_unlock(&fw_lock);
+        pthread_join(fw_thread, NULL);
+    } else {
+        pthread_mutex_unlock(&fw_lock);
+    }
+
 #ifdef __DEMO__
     if (fp != NULL) {
         fclose(fp);
     }
+    if (fp_running != NULL) {
+        fclose(fp_running);
+        fp_running = NULL;
+    }
 #endif
 
-    /* check file md5, and burning it to flash ... finally reboot system */
+    /* the image was hashed while written and is checked by the caller, no need to read it back.
+     * burning it to flash ... finally reboot system */
 
     return 0;
 }
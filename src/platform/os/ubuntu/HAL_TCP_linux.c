@@ -31,6 +31,8 @@
 
 #include "iot_import.h"
 
+#define HAL_TCP_IOV_MAX     (16)    /* buffers passed to one sendmsg */
+
 #define PLATFORM_LINUXSOCK_LOG(format, ...) \
     do { \
         HAL_Printf("LINUXSOCK %u %s() | "format"\n", __LINE__, __FUNCTION__, ##__VA_ARGS__);\
@@ -70,6 +72,7 @@ uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
     struct addrinfo *cur = NULL;
     int fd = 0;
     int rc = 0;
+    int one = 1;
     char service[6];
 
     memset(&hints, 0, sizeof(hints));
@@ -101,6 +104,8 @@ uintptr_t HAL_TCP_Establish(const char *host, uint16_t port)
         }
 
         if (connect(fd, cur->ai_addr, cur->ai_addrlen) == 0) {
+            /* small packets go out at once, pipelined ones would wait for the ACK of the previous */
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
             rc = fd;
             break;
         }
@@ -188,12 +193,16 @@ int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t time
         }
 
         if (ret > 0) {
-            ret = send(fd, buf + len_sent, len - len_sent, 0);
+            /* never block when called from an event loop, a reset peer fails the write instead of raising SIGPIPE */
+            ret = send(fd, buf + len_sent, len - len_sent, MSG_NOSIGNAL | ((0 == timeout_ms) ? MSG_DONTWAIT : 0));
             if (ret > 0) {
                 len_sent += ret;
             } else if (0 == ret) {
                 PLATFORM_LINUXSOCK_LOG("No data be sent");
             } else {
+                if (0 == timeout_ms && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                    break;
+                }
                 if (EINTR == errno) {
                     PLATFORM_LINUXSOCK_LOG("EINTR be caught");
                     continue;
@@ -209,6 +218,84 @@ int32_t HAL_TCP_Write(uintptr_t fd, const char *buf, uint32_t len, uint32_t time
 }
 
 
+#ifdef IOTX_WRITEV_SUPPORT
+int32_t HAL_TCP_Writev(uintptr_t fd, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    int ret;
+    uint32_t i, cnt, idx, off, len, len_sent;
+    uint64_t t_end, t_left;
+    fd_set sets;
+    struct iovec vec[HAL_TCP_IOV_MAX];
+    struct msghdr msg;
+
+    t_end = _linux_get_time_ms() + timeout_ms;
+    len = 0;
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+    len_sent = 0;
+    idx = 0;    /* first buffer not sent completely */
+    off = 0;    /* bytes of iov[idx] already sent */
+    ret = 1;    /* send one time if timeout_ms is value 0 */
+
+    do {
+        t_left = _linux_time_left(t_end, _linux_get_time_ms());
+
+        if (0 != t_left) {
+            struct timeval timeout;
+
+            FD_ZERO(&sets);
+            FD_SET(fd, &sets);
+
+            timeout.tv_sec = t_left / 1000;
+            timeout.tv_usec = (t_left % 1000) * 1000;
+
+            ret = select(fd + 1, NULL, &sets, NULL, &timeout);
+            if (0 == ret) {
+                PLATFORM_LINUXSOCK_LOG("select-write timeout %d", (int)fd);
+                break;
+            } else if (ret < 0) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                perror("select-write fail");
+                break;
+            }
+        }
+
+        for (cnt = 0; cnt < HAL_TCP_IOV_MAX && idx + cnt < iovcnt; cnt++) {
+            vec[cnt].iov_base = (char *)iov[idx + cnt].buf + (0 == cnt ? off : 0);
+            vec[cnt].iov_len = iov[idx + cnt].len - (0 == cnt ? off : 0);
+        }
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = cnt;
+
+        ret = sendmsg(fd, &msg, MSG_NOSIGNAL | ((0 == timeout_ms) ? MSG_DONTWAIT : 0));
+        if (ret > 0) {
+            len_sent += ret;
+            /* skip what went out, possibly stopping inside a buffer */
+            off += ret;
+            while (idx < iovcnt && off >= iov[idx].len) {
+                off -= iov[idx].len;
+                idx++;
+            }
+        } else if (ret < 0) {
+            if (0 == timeout_ms && (EAGAIN == errno || EWOULDBLOCK == errno)) {
+                break;
+            }
+            if (EINTR == errno) {
+                continue;
+            }
+            perror("sendmsg fail");
+            break;
+        }
+    } while ((len_sent < len) && (_linux_time_left(t_end, _linux_get_time_ms()) > 0));
+
+    return len_sent;
+}
+#endif  /* IOTX_WRITEV_SUPPORT */
+
 int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
 {
     int ret, err_code;
@@ -217,6 +304,24 @@ int32_t HAL_TCP_Read(uintptr_t fd, char *buf, uint32_t len, uint32_t timeout_ms)
     fd_set sets;
     struct timeval timeout;
 
+    if (0 == timeout_ms) {
+        /* poll once, the caller was told the connection is readable */
+        do {
+            ret = recv(fd, buf, len, MSG_DONTWAIT);
+        } while (ret < 0 && EINTR == errno);
+
+        if (ret > 0) {
+            return ret;
+        } else if (0 == ret) {
+            perror("connection is closed");
+            return -1;
+        } else if (EAGAIN == errno || EWOULDBLOCK == errno) {
+            return 0;
+        }
+        perror("recv fail");
+        return -2;
+    }
+
     t_end = _linux_get_time_ms() + timeout_ms;
     len_recv = 0;
     err_code = 0;
@@ -17,6 +17,9 @@
  */
 
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* recvmmsg() and sendmmsg() */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -169,3 +172,120 @@ int HAL_UDP_readTimeout(void *p_socket,
     return HAL_UDP_read(p_socket, p_data, datalen);
 }
 
+#define HAL_UDP_BATCH_MAX   (16)
+
+int HAL_UDP_readBatch(void *p_socket,
+                      hal_udp_msg_t *p_msgs,
+                      unsigned int count,
+                      unsigned int timeout)
+{
+    int                 ret;
+    unsigned int        i;
+    struct timeval      tv;
+    fd_set              read_fds;
+    long                socket_id = -1;
+    struct mmsghdr      msgs[HAL_UDP_BATCH_MAX];
+    struct iovec        iovs[HAL_UDP_BATCH_MAX];
+
+    if (NULL == p_socket || NULL == p_msgs || 0 == count) {
+        return -1;
+    }
+    socket_id = (long)p_socket;
+
+    if (socket_id < 0) {
+        return -1;
+    }
+    if (count > HAL_UDP_BATCH_MAX) {
+        count = HAL_UDP_BATCH_MAX;
+    }
+
+    memset(msgs, 0x00, sizeof(msgs));
+    for (i = 0; i < count; i++) {
+        iovs[i].iov_base = p_msgs[i].p_data;
+        iovs[i].iov_len  = p_msgs[i].datalen;
+        msgs[i].msg_hdr.msg_iov    = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    /* Under load datagrams are already queued, take them without waiting first */
+    ret = recvmmsg(socket_id, msgs, count, MSG_DONTWAIT, NULL);
+    if (ret < 0 && EAGAIN != errno && EWOULDBLOCK != errno) {
+        return (errno == EINTR) ? -3 : -4;
+    }
+
+    if (ret < 0) {
+        FD_ZERO(&read_fds);
+        FD_SET(socket_id, &read_fds);
+
+        tv.tv_sec  = timeout / 1000;
+        tv.tv_usec = (timeout % 1000) * 1000;
+
+        ret = select(socket_id + 1, &read_fds, NULL, NULL, timeout == 0 ? NULL : &tv);
+
+        /* Zero fds ready means we timed out */
+        if (ret == 0) {
+            return -2;    /* receive timeout */
+        }
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                return -3;    /* want read */
+            }
+
+            return -4; /* receive failed */
+        }
+
+        /* This call will not block, it takes what is queued up to 'count' */
+        ret = recvmmsg(socket_id, msgs, count, MSG_DONTWAIT, NULL);
+        if (ret < 0) {
+            return (errno == EINTR) ? -3 : -4;
+        }
+    }
+
+    for (i = 0; i < (unsigned int)ret; i++) {
+        p_msgs[i].datalen = msgs[i].msg_len;
+    }
+
+    return ret;
+}
+
+int HAL_UDP_writeBatch(void *p_socket,
+                       const hal_udp_msg_t *p_msgs,
+                       unsigned int count)
+{
+    int                 rc = -1;
+    unsigned int        i;
+    unsigned int        sent = 0;
+    long                socket_id = -1;
+    struct mmsghdr      msgs[HAL_UDP_BATCH_MAX];
+    struct iovec        iovs[HAL_UDP_BATCH_MAX];
+
+    if (NULL == p_socket || NULL == p_msgs) {
+        return -1;
+    }
+    socket_id = (long)p_socket;
+
+    while (sent < count) {
+        unsigned int num = count - sent;
+
+        if (num > HAL_UDP_BATCH_MAX) {
+            num = HAL_UDP_BATCH_MAX;
+        }
+
+        memset(msgs, 0x00, sizeof(msgs));
+        for (i = 0; i < num; i++) {
+            iovs[i].iov_base = (void *)p_msgs[sent + i].p_data;
+            iovs[i].iov_len  = p_msgs[sent + i].datalen;
+            msgs[i].msg_hdr.msg_iov    = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        rc = sendmmsg(socket_id, msgs, num, 0);
+        if (rc <= 0) {
+            return (0 == sent) ? -1 : (int)sent;
+        }
+        sent += rc;
+    }
+
+    return (int)sent;
+}
@@ -363,6 +363,26 @@ int HAL_Firmware_Persistence_Write(_IN_ char *buffer, _IN_ uint32_t length)
     return 0;
 }
 
+static int fw_result;
+
+int HAL_Firmware_Persistence_WriteAsync(_IN_ char *buffer, _IN_ uint32_t length)
+{
+    /* written at once, the result is kept for HAL_Firmware_Persistence_Wait() */
+    fw_result = HAL_Firmware_Persistence_Write(buffer, length);
+    return 0;
+}
+
+int HAL_Firmware_Persistence_Wait(void)
+{
+    return fw_result;
+}
+
+int HAL_Firmware_Persistence_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length)
+{
+    /* the running image is not read, so only whole images can be applied */
+    return -1;
+}
+
 int HAL_Firmware_Persistence_Stop(void)
 {
 #ifdef __DEMO__
@@ -371,7 +391,8 @@ int HAL_Firmware_Persistence_Stop(void)
     }
 #endif
 
-    /* check file md5, and burning it to flash ... finally reboot system */
+    /* the image was hashed while written and is checked by the caller, no need to read it back.
+     * burning it to flash ... finally reboot system */
     return 0;
 }
 
@@ -33,6 +33,16 @@
 #include "mbedtls/ssl_cookie.h"
 #include "mbedtls/net_sockets.h"
 
+#define DTLS_SESSION_HOST_LEN        (64)
+
+#ifndef DTLS_SESSION_CACHE_NUM
+#define DTLS_SESSION_CACHE_NUM       (2)
+#endif
+
+#if defined(MBEDTLS_SSL_CLI_C) && (DTLS_SESSION_CACHE_NUM > 0)
+#define DTLS_SESSION_CACHE_SUPPORT
+#endif
+
 typedef struct {
     mbedtls_ssl_context          context;
     mbedtls_ssl_config           conf;
@@ -44,8 +54,29 @@ typedef struct {
     mbedtls_net_context          fd;
     mbedtls_timing_delay_context timer;
     mbedtls_ssl_cookie_ctx       cookie_ctx;
+    char                         host[DTLS_SESSION_HOST_LEN];
+    unsigned short               port;
+    unsigned char                ca_digest[32];  /* SHA-256 of the CA PEM string, zeros without one */
+    int                          authmode;
 } dtls_session_t;
 
+#ifdef DTLS_SESSION_CACHE_SUPPORT
+/* Sessions of the last handshakes, an abbreviated handshake (session ID or
+ * session ticket) is tried first when connecting to the same server again with
+ * the same CA and verify mode, a session verified less strictly is never reused */
+typedef struct {
+    char                         host[DTLS_SESSION_HOST_LEN];
+    unsigned short               port;
+    unsigned char                ca_digest[32];
+    int                          authmode;
+    int                          valid;
+    mbedtls_ssl_session          session;
+} dtls_session_cache_t;
+
+static dtls_session_cache_t g_dtls_session_cache[DTLS_SESSION_CACHE_NUM];
+static void *g_dtls_session_cache_mutex = NULL;
+#endif
+
 
 static  void *_DTLSCalloc_wrapper(size_t n, size_t s)
 {
@@ -75,10 +106,12 @@ static unsigned int _DTLSVerifyOptions_set(dtls_session_t *p_dtls_session,
 #ifdef MBEDTLS_X509_CRT_PARSE_C
     if (p_ca_cert_pem != NULL) {
 #ifndef TEST_COAP_DAILY
-        mbedtls_ssl_conf_authmode(&p_dtls_session->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        p_dtls_session->authmode = MBEDTLS_SSL_VERIFY_REQUIRED;
 #else
-        mbedtls_ssl_conf_authmode(&p_dtls_session->conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+        p_dtls_session->authmode = MBEDTLS_SSL_VERIFY_OPTIONAL;
 #endif
+        mbedtls_ssl_conf_authmode(&p_dtls_session->conf, p_dtls_session->authmode);
+        mbedtls_sha256(p_ca_cert_pem, strlen((const char *)p_ca_cert_pem), p_dtls_session->ca_digest, 0);
         DTLS_TRC("Call mbedtls_ssl_conf_authmode\r\n");
 
         DTLS_TRC("x509 ca cert pem len %d\r\n%s\r\n", (int)strlen((char *)p_ca_cert_pem) + 1, p_ca_cert_pem);
@@ -95,12 +128,137 @@ static unsigned int _DTLSVerifyOptions_set(dtls_session_t *p_dtls_session,
     } else
 #endif
     {
+        p_dtls_session->authmode = MBEDTLS_SSL_VERIFY_NONE;
         mbedtls_ssl_conf_authmode(&p_dtls_session->conf, MBEDTLS_SSL_VERIFY_NONE);
     }
 
     return err_code;
 }
 
+#ifdef DTLS_SESSION_CACHE_SUPPORT
+/* Sessions connect on several threads, the cache is shared under a mutex created as on the TLS side:
+ * the first connection publishes it, the ones losing the race destroy their own */
+static void _DTLSSessionCache_lock(void)
+{
+    void *mutex = __atomic_load_n(&g_dtls_session_cache_mutex, __ATOMIC_ACQUIRE);
+    void *expected = NULL;
+
+    if (NULL == mutex) {
+        mutex = HAL_MutexCreate();
+        if (NULL != mutex && !__atomic_compare_exchange_n(&g_dtls_session_cache_mutex, &expected, mutex, 0,
+                                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            HAL_MutexDestroy(mutex);
+            mutex = expected;
+        }
+    }
+    if (NULL != mutex) {
+        HAL_MutexLock(mutex);
+    }
+}
+
+static void _DTLSSessionCache_unlock(void)
+{
+    void *mutex = __atomic_load_n(&g_dtls_session_cache_mutex, __ATOMIC_ACQUIRE);
+
+    if (NULL != mutex) {
+        HAL_MutexUnlock(mutex);
+    }
+}
+
+/* called with the cache locked */
+static dtls_session_cache_t *_DTLSSessionCache_find(const dtls_session_t *p_dtls_session)
+{
+    int i;
+
+    for (i = 0; i < DTLS_SESSION_CACHE_NUM; i++) {
+        if (g_dtls_session_cache[i].valid && p_dtls_session->port == g_dtls_session_cache[i].port
+            && 0 == strncmp(g_dtls_session_cache[i].host, p_dtls_session->host, DTLS_SESSION_HOST_LEN)
+            && p_dtls_session->authmode == g_dtls_session_cache[i].authmode
+            && 0 == memcmp(g_dtls_session_cache[i].ca_digest, p_dtls_session->ca_digest, 32)) {
+            return &g_dtls_session_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Offer the cached session of the server to the handshake, returns 1 if there was one */
+static int _DTLSSessionCache_load(dtls_session_t *p_dtls_session)
+{
+    int result = 0;
+    dtls_session_cache_t *p_cache = NULL;
+
+    _DTLSSessionCache_lock();
+    p_cache = _DTLSSessionCache_find(p_dtls_session);
+    if (NULL != p_cache) {
+        /* copied into the context, the cache entry may go once unlocked */
+        result = mbedtls_ssl_set_session(&p_dtls_session->context, &p_cache->session);
+        DTLS_TRC("mbedtls_ssl_set_session result 0x%04x\r\n", result);
+    }
+    _DTLSSessionCache_unlock();
+
+    return (NULL != p_cache);
+}
+
+static void _DTLSSessionCache_remove(dtls_session_t *p_dtls_session)
+{
+    dtls_session_cache_t *p_cache = NULL;
+
+    _DTLSSessionCache_lock();
+    p_cache = _DTLSSessionCache_find(p_dtls_session);
+    if (NULL != p_cache) {
+        mbedtls_ssl_session_free(&p_cache->session);
+        p_cache->valid = 0;
+    }
+    _DTLSSessionCache_unlock();
+}
+
+static void _DTLSSessionCache_save(dtls_session_t *p_dtls_session)
+{
+    int i;
+    dtls_session_cache_t *p_cache = NULL;
+
+    /* a session whose certificate was not verified is not worth resuming */
+    if (MBEDTLS_SSL_VERIFY_NONE != p_dtls_session->authmode
+        && 0 != mbedtls_ssl_get_verify_result(&p_dtls_session->context)) {
+        _DTLSSessionCache_remove(p_dtls_session);
+        DTLS_TRC("certificate not verified, session not cached\r\n");
+        return;
+    }
+
+    _DTLSSessionCache_lock();
+    p_cache = _DTLSSessionCache_find(p_dtls_session);
+    if (NULL == p_cache) {
+        /* take a free slot, or evict the first one */
+        p_cache = &g_dtls_session_cache[0];
+        for (i = 0; i < DTLS_SESSION_CACHE_NUM; i++) {
+            if (!g_dtls_session_cache[i].valid) {
+                p_cache = &g_dtls_session_cache[i];
+                break;
+            }
+        }
+    }
+    if (p_cache->valid) {
+        mbedtls_ssl_session_free(&p_cache->session);
+        p_cache->valid = 0;
+    }
+
+    mbedtls_ssl_session_init(&p_cache->session);
+    if (0 != mbedtls_ssl_get_session(&p_dtls_session->context, &p_cache->session)) {
+        mbedtls_ssl_session_free(&p_cache->session);
+        _DTLSSessionCache_unlock();
+        DTLS_TRC("mbedtls_ssl_get_session failed, session not cached\r\n");
+        return;
+    }
+    strncpy(p_cache->host, p_dtls_session->host, DTLS_SESSION_HOST_LEN - 1);
+    p_cache->host[DTLS_SESSION_HOST_LEN - 1] = '\0';
+    p_cache->port  = p_dtls_session->port;
+    memcpy(p_cache->ca_digest, p_dtls_session->ca_digest, sizeof(p_cache->ca_digest));
+    p_cache->authmode = p_dtls_session->authmode;
+    p_cache->valid = 1;
+    _DTLSSessionCache_unlock();
+}
+#endif
+
 static void _DTLSLog_wrapper(void        *p_ctx, int level,
                              const char *p_file, int line,   const char *p_str)
 {
@@ -110,6 +268,9 @@ static void _DTLSLog_wrapper(void        *p_ctx, int level,
 static unsigned int _DTLSContext_setup(dtls_session_t *p_dtls_session, coap_dtls_options_t  *p_options)
 {
     int   result = 0;
+#ifdef DTLS_SESSION_CACHE_SUPPORT
+    int   resumed = 0;
+#endif
 
     mbedtls_ssl_init(&p_dtls_session->context);
 
@@ -135,11 +296,24 @@ static unsigned int _DTLSContext_setup(dtls_session_t *p_dtls_session, coap_dtls
                             mbedtls_net_recv_timeout);
         DTLS_TRC("mbedtls_ssl_set_bio result 0x%04x\r\n", result);
 
+#ifdef DTLS_SESSION_CACHE_SUPPORT
+        /* the server falls back to a full handshake if it no longer knows the session */
+        resumed = _DTLSSessionCache_load(p_dtls_session);
+#endif
+
         do {
             result = mbedtls_ssl_handshake(&p_dtls_session->context);
         } while (result == MBEDTLS_ERR_SSL_WANT_READ ||
                  result == MBEDTLS_ERR_SSL_WANT_WRITE);
         DTLS_TRC("mbedtls_ssl_handshake result 0x%04x\r\n", result);
+
+#ifdef DTLS_SESSION_CACHE_SUPPORT
+        if (0 == result) {
+            _DTLSSessionCache_save(p_dtls_session);
+        } else if (resumed) {
+            _DTLSSessionCache_remove(p_dtls_session);
+        }
+#endif
     }
 
     return (result ? DTLS_HANDSHAKE_FAILED : DTLS_SUCCESS);
@@ -153,6 +327,7 @@ dtls_session_t *_DTLSSession_init()
     mbedtls_debug_set_threshold(0);
     mbedtls_platform_set_calloc_free(_DTLSCalloc_wrapper, _DTLSFree_wrapper);
     if (NULL != p_dtls_session) {
+        memset(p_dtls_session, 0x00, sizeof(dtls_session_t));
         mbedtls_net_init(&p_dtls_session->fd);
         mbedtls_ssl_init(&p_dtls_session->context);
         mbedtls_ssl_config_init(&p_dtls_session->conf);
@@ -223,6 +398,9 @@ DTLSContext *HAL_DTLSSession_create(coap_dtls_options_t            *p_options)
         }
         mbedtls_ssl_conf_rng(&p_dtls_session->conf, mbedtls_ctr_drbg_random, &p_dtls_session->ctr_drbg);
         mbedtls_ssl_conf_dbg(&p_dtls_session->conf, _DTLSLog_wrapper, NULL);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS) && defined(DTLS_SESSION_CACHE_SUPPORT)
+        mbedtls_ssl_conf_session_tickets(&p_dtls_session->conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
 
         result = mbedtls_ssl_cookie_setup(&p_dtls_session->cookie_ctx,
                                           mbedtls_ctr_drbg_random, &p_dtls_session->ctr_drbg);
@@ -241,6 +419,8 @@ DTLSContext *HAL_DTLSSession_create(coap_dtls_options_t            *p_options)
             DTLS_ERR("DTLSVerifyOptions_set result 0x%04x\r\n", result);
             goto error;
         }
+        strncpy(p_dtls_session->host, p_options->p_host, DTLS_SESSION_HOST_LEN - 1);
+        p_dtls_session->port = p_options->port;
         sprintf(port, "%u", p_options->port);
         result = mbedtls_net_connect(&p_dtls_session->fd, p_options->p_host,
                                      port, MBEDTLS_NET_PROTO_UDP);
@@ -328,6 +508,10 @@ unsigned int HAL_DTLSSession_read(DTLSContext *context,
             *p_datalen = 0;
             if (MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE == len) {
                 err_code = DTLS_FATAL_ALERT_MESSAGE;
+#ifdef DTLS_SESSION_CACHE_SUPPORT
+                /* the session must not be resumed after a fatal alert */
+                _DTLSSessionCache_remove(p_dtls_session);
+#endif
                 DTLS_INFO("Recv peer fatal alert message\r\n");
             } else if (MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY == len) {
                 err_code = DTLS_PEER_CLOSE_NOTIFY;
@@ -29,6 +29,8 @@
     #include <netdb.h>
     #include <signal.h>
     #include <unistd.h>
+    #include <errno.h>
+    #include <poll.h>
 #endif
 #include "mbedtls/error.h"
 #include "mbedtls/ssl.h"
@@ -37,11 +39,93 @@
 #include "mbedtls/pk.h"
 #include "mbedtls/debug.h"
 #include "mbedtls/platform.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
 
 #include "iot_import.h"
 
 #define SEND_TIMEOUT_SECONDS (10)
 
+#define TLS_SESSION_HOST_LEN        (64)
+
+#ifndef TLS_SESSION_CACHE_NUM
+#define TLS_SESSION_CACHE_NUM       (4)     /* MQTT, HTTP and OTA servers */
+#endif
+
+#ifndef TLS_CONF_CACHE_NUM
+#define TLS_CONF_CACHE_NUM          (2)     /* distinct CAs in use at the same time */
+#endif
+
+#if defined(MBEDTLS_SSL_CLI_C) && defined(MBEDTLS_SHA256_C) && (TLS_SESSION_CACHE_NUM > 0)
+#define TLS_SESSION_CACHE_SUPPORT
+#endif
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C) && defined(MBEDTLS_SHA256_C) && (TLS_CONF_CACHE_NUM > 0)
+#define TLS_CONF_CACHE_SUPPORT
+#endif
+
+#if defined(MBEDTLS_CTR_DRBG_C) && defined(MBEDTLS_ENTROPY_C)
+#define TLS_DRBG_SUPPORT
+#endif
+
+/* Record buffers built smaller than the 16KB TLS allows (-DMBEDTLS_SSL_MAX_CONTENT_LEN)
+ * only work if the server is asked to send records no larger than them */
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH) && (MBEDTLS_SSL_MAX_CONTENT_LEN < 16384)
+#if MBEDTLS_SSL_MAX_CONTENT_LEN >= 4096
+#define TLS_MAX_FRAG_LEN            MBEDTLS_SSL_MAX_FRAG_LEN_4096
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 2048
+#define TLS_MAX_FRAG_LEN            MBEDTLS_SSL_MAX_FRAG_LEN_2048
+#elif MBEDTLS_SSL_MAX_CONTENT_LEN >= 1024
+#define TLS_MAX_FRAG_LEN            MBEDTLS_SSL_MAX_FRAG_LEN_1024
+#else
+#define TLS_MAX_FRAG_LEN            MBEDTLS_SSL_MAX_FRAG_LEN_512
+#endif
+#endif
+
+#ifdef TLS_CONF_CACHE_SUPPORT
+/* The configuration (parsed CA chain, verify mode, RNG) of the connections
+ * trusting one CA, built once and borrowed by each of them. It stays after
+ * the last one is gone so that reconnecting does not build it again */
+typedef struct {
+    unsigned char       digest[32];   /**< SHA-256 of the CA PEM string */
+    int                 has_ca;
+    int                 valid;
+    int                 refs;         /**< connections using 'conf' */
+    mbedtls_x509_crt    ca;
+    mbedtls_ssl_config  conf;
+} tls_conf_cache_t;
+
+static tls_conf_cache_t g_tls_conf_cache[TLS_CONF_CACHE_NUM];
+#endif
+
+#ifdef TLS_DRBG_SUPPORT
+/* seeded by the first connection, then shared under 'g_tls_mutex' */
+static mbedtls_entropy_context  g_tls_entropy;
+static mbedtls_ctr_drbg_context g_tls_ctr_drbg;
+static int                      g_tls_drbg_seeded = 0;
+#endif
+
+#ifdef TLS_SESSION_CACHE_SUPPORT
+/* Sessions of the last handshakes, an abbreviated handshake (session ID or
+ * session ticket) is tried first when connecting to the same server again.
+ * It skips the certificate exchange, so a session is only offered to a
+ * connection trusting the same CA with the same verify mode as the one
+ * which verified it */
+typedef struct {
+    char                host[TLS_SESSION_HOST_LEN];
+    char                port[6];
+    unsigned char       ca_digest[32];  /**< SHA-256 of the CA PEM string, zeros without one */
+    int                 authmode;
+    int                 valid;
+    mbedtls_ssl_session session;
+} tls_session_cache_t;
+
+static tls_session_cache_t g_tls_session_cache[TLS_SESSION_CACHE_NUM];
+#endif
+
+static void *g_tls_mutex = NULL;
+
 typedef struct _TLSDataParams {
     mbedtls_ssl_context ssl;          /**< mbed TLS control context. */
     mbedtls_net_context fd;           /**< mbed TLS network context. */
@@ -49,6 +133,11 @@ typedef struct _TLSDataParams {
     mbedtls_x509_crt cacertl;         /**< mbed TLS CA certification. */
     mbedtls_x509_crt clicert;         /**< mbed TLS Client certification. */
     mbedtls_pk_context pkey;          /**< mbed TLS Client key. */
+    uint32_t read_timeout;            /**< timeout of the current read, the shared 'conf' has none */
+    uint32_t write_timeout;           /**< time left for the current write */
+#ifdef TLS_CONF_CACHE_SUPPORT
+    tls_conf_cache_t *conf_cache;     /**< shared configuration used instead of 'conf' */
+#endif
 } TLSDataParams_t, *TLSDataParams_pt;
 
 #define SSL_LOG(format, ...) \
@@ -61,6 +150,63 @@ typedef struct _TLSDataParams {
 #define DEBUG_LEVEL 10
 
 
+/* Created by the first connection and kept for the life of the process, as is the state it guards.
+ * Connections may start on several threads at once, the ones losing the race to publish their
+ * mutex destroy it. */
+static void _tls_lock(void)
+{
+    void *mutex = __atomic_load_n(&g_tls_mutex, __ATOMIC_ACQUIRE);
+    void *expected = NULL;
+
+    if (NULL == mutex) {
+        mutex = HAL_MutexCreate();
+        if (NULL != mutex && !__atomic_compare_exchange_n(&g_tls_mutex, &expected, mutex, 0,
+                                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            HAL_MutexDestroy(mutex);
+            mutex = expected;
+        }
+    }
+    if (NULL != mutex) {
+        HAL_MutexLock(mutex);
+    }
+}
+
+static void _tls_unlock(void)
+{
+    void *mutex = __atomic_load_n(&g_tls_mutex, __ATOMIC_ACQUIRE);
+
+    if (NULL != mutex) {
+        HAL_MutexUnlock(mutex);
+    }
+}
+
+#ifdef TLS_DRBG_SUPPORT
+static int _ssl_random(void *p_rng, unsigned char *output, size_t output_len)
+{
+    int ret = 0;
+
+    _tls_lock();
+    if (!g_tls_drbg_seeded) {
+        mbedtls_entropy_init(&g_tls_entropy);
+        mbedtls_ctr_drbg_init(&g_tls_ctr_drbg);
+        ret = mbedtls_ctr_drbg_seed(&g_tls_ctr_drbg, mbedtls_entropy_func, &g_tls_entropy,
+                                    (const unsigned char *)"iotx_tls", 8);
+        if (0 != ret) {
+            SSL_LOG("mbedtls_ctr_drbg_seed returned -0x%04x", -ret);
+            mbedtls_ctr_drbg_free(&g_tls_ctr_drbg);
+            mbedtls_entropy_free(&g_tls_entropy);
+        } else {
+            g_tls_drbg_seeded = 1;
+        }
+    }
+    if (g_tls_drbg_seeded) {
+        ret = mbedtls_ctr_drbg_random(&g_tls_ctr_drbg, output, output_len);
+    }
+    _tls_unlock();
+
+    return ret;
+}
+#else
 static unsigned int _avRandom()
 {
     return (((unsigned int)rand() << 16) + rand());
@@ -78,6 +224,7 @@ static int _ssl_random(void *p_rng, unsigned char *output, size_t output_len)
     }
     return 0;
 }
+#endif
 
 static void _ssl_debug(void *ctx, int level, const char *file, int line, const char *str)
 {
@@ -117,6 +264,19 @@ static int _real_confirm(int verify_result)
     return 0;
 }
 
+static int _ssl_authmode(int has_ca)
+{
+    /* OPTIONAL is not optimal for security, but makes interop easier in this simplified example */
+    if (has_ca) {
+#if defined(FORCE_SSL_VERIFY)
+        return MBEDTLS_SSL_VERIFY_REQUIRED;
+#else
+        return MBEDTLS_SSL_VERIFY_OPTIONAL;
+#endif
+    }
+    return MBEDTLS_SSL_VERIFY_NONE;
+}
+
 static int _ssl_parse_crt(mbedtls_x509_crt *crt)
 {
     char buf[1024];
@@ -148,6 +308,98 @@ static int _ssl_parse_crt(mbedtls_x509_crt *crt)
     return i;
 }
 
+#ifdef TLS_SESSION_CACHE_SUPPORT
+static tls_session_cache_t *_tls_session_cache_find(const char *host, const char *port,
+                                                    const unsigned char *ca_digest, int authmode)
+{
+    int i;
+
+    for (i = 0; i < TLS_SESSION_CACHE_NUM; i++) {
+        if (g_tls_session_cache[i].valid && 0 == strcmp(g_tls_session_cache[i].port, port)
+            && 0 == strncmp(g_tls_session_cache[i].host, host, TLS_SESSION_HOST_LEN)
+            && authmode == g_tls_session_cache[i].authmode
+            && 0 == memcmp(g_tls_session_cache[i].ca_digest, ca_digest, 32)) {
+            return &g_tls_session_cache[i];
+        }
+    }
+    return NULL;
+}
+
+/* Offer the cached session, the server falls back to a full handshake if it
+ * no longer knows it */
+static void _tls_session_cache_load(mbedtls_ssl_context *ssl, const char *host, const char *port,
+                                    const unsigned char *ca_digest, int authmode)
+{
+    tls_session_cache_t *p_cache;
+
+    _tls_lock();
+    p_cache = _tls_session_cache_find(host, port, ca_digest, authmode);
+    if (NULL != p_cache && 0 == mbedtls_ssl_set_session(ssl, &p_cache->session)) {
+        SSL_LOG("Resuming the session of the last connection");
+    }
+    _tls_unlock();
+}
+
+static void _tls_session_cache_remove(const char *host, const char *port,
+                                      const unsigned char *ca_digest, int authmode)
+{
+    tls_session_cache_t *p_cache;
+
+    _tls_lock();
+    p_cache = _tls_session_cache_find(host, port, ca_digest, authmode);
+    if (NULL != p_cache) {
+        mbedtls_ssl_session_free(&p_cache->session);
+        p_cache->valid = 0;
+    }
+    _tls_unlock();
+}
+
+static void _tls_session_cache_save(mbedtls_ssl_context *ssl, const char *host, const char *port,
+                                    const unsigned char *ca_digest, int authmode)
+{
+    int i;
+    tls_session_cache_t *p_cache;
+
+    /* a session whose certificate was not verified is not worth resuming */
+    if (MBEDTLS_SSL_VERIFY_NONE != authmode && 0 != mbedtls_ssl_get_verify_result(ssl)) {
+        _tls_session_cache_remove(host, port, ca_digest, authmode);
+        return;
+    }
+
+    _tls_lock();
+    p_cache = _tls_session_cache_find(host, port, ca_digest, authmode);
+    if (NULL == p_cache) {
+        /* take a free slot, or evict the first one */
+        p_cache = &g_tls_session_cache[0];
+        for (i = 0; i < TLS_SESSION_CACHE_NUM; i++) {
+            if (!g_tls_session_cache[i].valid) {
+                p_cache = &g_tls_session_cache[i];
+                break;
+            }
+        }
+    }
+    if (p_cache->valid) {
+        mbedtls_ssl_session_free(&p_cache->session);
+        p_cache->valid = 0;
+    }
+
+    mbedtls_ssl_session_init(&p_cache->session);
+    if (0 != mbedtls_ssl_get_session(ssl, &p_cache->session)) {
+        mbedtls_ssl_session_free(&p_cache->session);
+        SSL_LOG("mbedtls_ssl_get_session failed, session not cached");
+    } else {
+        strncpy(p_cache->host, host, TLS_SESSION_HOST_LEN - 1);
+        p_cache->host[TLS_SESSION_HOST_LEN - 1] = '\0';
+        strncpy(p_cache->port, port, sizeof(p_cache->port) - 1);
+        p_cache->port[sizeof(p_cache->port) - 1] = '\0';
+        memcpy(p_cache->ca_digest, ca_digest, sizeof(p_cache->ca_digest));
+        p_cache->authmode = authmode;
+        p_cache->valid = 1;
+    }
+    _tls_unlock();
+}
+#endif
+
 static int _ssl_client_init(mbedtls_ssl_context *ssl,
                             mbedtls_net_context *tcp_fd,
                             mbedtls_ssl_config *conf,
@@ -173,15 +425,15 @@ static int _ssl_client_init(mbedtls_ssl_context *ssl,
      * 0. Initialize certificates
      */
 
-    SSL_LOG("Loading the CA root certificate ...");
     if (NULL != ca_crt) {
+        SSL_LOG("Loading the CA root certificate ...");
         if (0 != (ret = mbedtls_x509_crt_parse(crt509_ca, (const unsigned char *)ca_crt, ca_len))) {
             SSL_LOG(" failed ! x509parse_crt returned -0x%04x", -ret);
             return ret;
         }
+        _ssl_parse_crt(crt509_ca);
+        SSL_LOG(" ok (%d skipped)", ret);
     }
-    _ssl_parse_crt(crt509_ca);
-    SSL_LOG(" ok (%d skipped)", ret);
 
 
     /* Setup Client Cert/Key */
@@ -225,6 +477,119 @@ static int _ssl_client_init(mbedtls_ssl_context *ssl,
     return 0;
 }
 
+static int _ssl_conf_setup(mbedtls_ssl_config *conf, mbedtls_x509_crt *ca_chain, int has_ca,
+                           mbedtls_x509_crt *cli_crt, mbedtls_pk_context *cli_key)
+{
+    int ret = -1;
+
+    SSL_LOG("  . Setting up the SSL/TLS structure...");
+    if ((ret = mbedtls_ssl_config_defaults(conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
+        SSL_LOG(" failed! mbedtls_ssl_config_defaults returned %d", ret);
+        return ret;
+    }
+
+    mbedtls_ssl_conf_max_version(conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+    mbedtls_ssl_conf_min_version(conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+
+    SSL_LOG(" ok");
+
+    mbedtls_ssl_conf_authmode(conf, _ssl_authmode(has_ca));
+
+#if defined(MBEDTLS_X509_CRT_PARSE_C)
+    mbedtls_ssl_conf_ca_chain(conf, ca_chain, NULL);
+
+    if (NULL != cli_crt && (ret = mbedtls_ssl_conf_own_cert(conf, cli_crt, cli_key)) != 0) {
+        SSL_LOG(" failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n", ret);
+        return ret;
+    }
+#endif
+#ifdef TLS_MAX_FRAG_LEN
+    if ((ret = mbedtls_ssl_conf_max_frag_len(conf, TLS_MAX_FRAG_LEN)) != 0) {
+        SSL_LOG(" failed! mbedtls_ssl_conf_max_frag_len returned %d", ret);
+        return ret;
+    }
+#endif
+    mbedtls_ssl_conf_rng(conf, _ssl_random, NULL);
+    mbedtls_ssl_conf_dbg(conf, _ssl_debug, NULL);
+    /* mbedtls_ssl_conf_dbg( conf, _ssl_debug, stdout ); */
+
+    return 0;
+}
+
+#ifdef TLS_CONF_CACHE_SUPPORT
+/* Take a reference to the configuration trusting 'ca_crt', NULL if it can
+ * not be cached and the connection has to build its own */
+static tls_conf_cache_t *_tls_conf_cache_get(const char *ca_crt, size_t ca_len,
+                                             const unsigned char digest[32])
+{
+    int i, ret;
+    int has_ca = (NULL != ca_crt);
+    tls_conf_cache_t *p_cache = NULL;
+
+    _tls_lock();
+    for (i = 0; i < TLS_CONF_CACHE_NUM; i++) {
+        if (g_tls_conf_cache[i].valid && has_ca == g_tls_conf_cache[i].has_ca
+            && 0 == memcmp(g_tls_conf_cache[i].digest, digest, sizeof(g_tls_conf_cache[i].digest))) {
+            g_tls_conf_cache[i].refs++;
+            _tls_unlock();
+            return &g_tls_conf_cache[i];
+        }
+    }
+
+    /* take a free slot, or replace a configuration no connection uses any more */
+    for (i = 0; i < TLS_CONF_CACHE_NUM && NULL == p_cache; i++) {
+        if (!g_tls_conf_cache[i].valid) {
+            p_cache = &g_tls_conf_cache[i];
+        }
+    }
+    for (i = 0; i < TLS_CONF_CACHE_NUM && NULL == p_cache; i++) {
+        if (0 == g_tls_conf_cache[i].refs) {
+            p_cache = &g_tls_conf_cache[i];
+            mbedtls_ssl_config_free(&p_cache->conf);
+            mbedtls_x509_crt_free(&p_cache->ca);
+            p_cache->valid = 0;
+        }
+    }
+
+    if (NULL != p_cache) {
+        mbedtls_x509_crt_init(&p_cache->ca);
+        mbedtls_ssl_config_init(&p_cache->conf);
+        ret = 0;
+        if (has_ca) {
+            SSL_LOG("Loading the CA root certificate ...");
+            if (0 == (ret = mbedtls_x509_crt_parse(&p_cache->ca, (const unsigned char *)ca_crt, ca_len))) {
+                _ssl_parse_crt(&p_cache->ca);
+            }
+        }
+        if (0 == ret) {
+            ret = _ssl_conf_setup(&p_cache->conf, &p_cache->ca, has_ca, NULL, NULL);
+        }
+        if (0 != ret) {
+            /* left to the connection, which reports the error */
+            mbedtls_ssl_config_free(&p_cache->conf);
+            mbedtls_x509_crt_free(&p_cache->ca);
+            p_cache = NULL;
+        } else {
+            memcpy(p_cache->digest, digest, sizeof(p_cache->digest));
+            p_cache->has_ca = has_ca;
+            p_cache->refs   = 1;
+            p_cache->valid  = 1;
+        }
+    }
+    _tls_unlock();
+
+    return p_cache;
+}
+
+static void _tls_conf_cache_put(tls_conf_cache_t *p_cache)
+{
+    _tls_lock();
+    p_cache->refs--;
+    _tls_unlock();
+}
+#endif
+
 #if defined(_PLATFORM_IS_LINUX_)
 static int net_prepare(void)
 {
@@ -306,6 +671,46 @@ static int mbedtls_net_connect_timeout(mbedtls_net_context *ctx, const char *hos
 #endif
 
 
+#if defined(_PLATFORM_IS_LINUX_)
+/* Send what the socket takes within the write timeout. A blocking send() would
+ * wait for the whole buffer, up to the SO_SNDTIMEO of the socket. */
+static int _ssl_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    int ret;
+    TLSDataParams_t *pTlsData = (TLSDataParams_t *)ctx;
+    struct pollfd pfd = { pTlsData->fd.fd, POLLOUT, 0 };
+
+    ret = poll(&pfd, 1, (int)pTlsData->write_timeout);
+    if (0 == ret) {
+        return MBEDTLS_ERR_SSL_TIMEOUT;
+    } else if (ret < 0) {
+        return (EINTR == errno) ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+
+    ret = send(pTlsData->fd.fd, buf, len, MSG_DONTWAIT);
+    if (ret < 0) {
+        if (EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno) {
+            return MBEDTLS_ERR_SSL_WANT_WRITE;
+        }
+        return (EPIPE == errno || ECONNRESET == errno) ? MBEDTLS_ERR_NET_CONN_RESET : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return ret;
+}
+#else
+static int _ssl_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    return mbedtls_net_send(&((TLSDataParams_t *)ctx)->fd, buf, len);
+}
+#endif
+
+/* the configuration may be shared, so the read timeout is kept per connection */
+static int _ssl_recv_timeout(void *ctx, unsigned char *buf, size_t len, uint32_t timeout)
+{
+    TLSDataParams_t *pTlsData = (TLSDataParams_t *)ctx;
+
+    return mbedtls_net_recv_timeout(&(pTlsData->fd), buf, len, pTlsData->read_timeout);
+}
+
 /**
  * @brief This function connects to the specific SSL server with TLS, and returns a value that indicates whether the connection is create successfully or not. Call #NewNetwork() to initialize network structure before calling this function.
  * @param[in] n is the the network structure pointer.
@@ -329,11 +734,32 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
                               const char *client_pwd, size_t client_pwd_len)
 {
     int ret = -1;
+    const char *ca_pem = ca_crt;
+    mbedtls_ssl_config *conf = &(pTlsData->conf);
+#if defined(MBEDTLS_SHA256_C)
+    unsigned char ca_digest[32] = {0};
+
+    if (NULL != ca_crt) {
+        mbedtls_sha256((const unsigned char *)ca_crt, ca_crt_len, ca_digest, 0);
+    }
+#endif
+
+#ifdef TLS_CONF_CACHE_SUPPORT
+    /* a client certificate belongs to this connection only */
+    if (NULL == client_crt) {
+        pTlsData->conf_cache = _tls_conf_cache_get(ca_crt, ca_crt_len, ca_digest);
+    }
+    if (NULL != pTlsData->conf_cache) {
+        conf = &(pTlsData->conf_cache->conf);
+        ca_pem = NULL;
+    }
+#endif
+
     /*
      * 0. Init
      */
     if (0 != (ret = _ssl_client_init(&(pTlsData->ssl), &(pTlsData->fd), &(pTlsData->conf),
-                                     &(pTlsData->cacertl), ca_crt, ca_crt_len,
+                                     &(pTlsData->cacertl), ca_pem, ca_crt_len,
                                      &(pTlsData->clicert), client_crt, client_crt_len,
                                      &(pTlsData->pkey), client_key, client_key_len, client_pwd, client_pwd_len))) {
         SSL_LOG(" failed ! ssl_client_init returned -0x%04x", -ret);
@@ -361,47 +787,22 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
     /*
      * 2. Setup stuff
      */
-    SSL_LOG("  . Setting up the SSL/TLS structure...");
-    if ((ret = mbedtls_ssl_config_defaults(&(pTlsData->conf), MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
-                                           MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
-        SSL_LOG(" failed! mbedtls_ssl_config_defaults returned %d", ret);
-        return ret;
-    }
-
-    mbedtls_ssl_conf_max_version(&pTlsData->conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
-    mbedtls_ssl_conf_min_version(&pTlsData->conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
-
-    SSL_LOG(" ok");
-
-    /* OPTIONAL is not optimal for security, but makes interop easier in this simplified example */
-    if (ca_crt != NULL) {
-#if defined(FORCE_SSL_VERIFY)
-        mbedtls_ssl_conf_authmode(&(pTlsData->conf), MBEDTLS_SSL_VERIFY_REQUIRED);
-#else
-        mbedtls_ssl_conf_authmode(&(pTlsData->conf), MBEDTLS_SSL_VERIFY_OPTIONAL);
-#endif
-    } else {
-        mbedtls_ssl_conf_authmode(&(pTlsData->conf), MBEDTLS_SSL_VERIFY_NONE);
-    }
-
-#if defined(MBEDTLS_X509_CRT_PARSE_C)
-    mbedtls_ssl_conf_ca_chain(&(pTlsData->conf), &(pTlsData->cacertl), NULL);
-
-    if ((ret = mbedtls_ssl_conf_own_cert(&(pTlsData->conf), &(pTlsData->clicert), &(pTlsData->pkey))) != 0) {
-        SSL_LOG(" failed\n  ! mbedtls_ssl_conf_own_cert returned %d\n", ret);
+    if (conf == &(pTlsData->conf)
+        && 0 != (ret = _ssl_conf_setup(conf, &(pTlsData->cacertl), NULL != ca_crt,
+                                       &(pTlsData->clicert), &(pTlsData->pkey)))) {
         return ret;
     }
-#endif
-    mbedtls_ssl_conf_rng(&(pTlsData->conf), _ssl_random, NULL);
-    mbedtls_ssl_conf_dbg(&(pTlsData->conf), _ssl_debug, NULL);
-    /* mbedtls_ssl_conf_dbg( &(pTlsData->conf), _ssl_debug, stdout ); */
 
-    if ((ret = mbedtls_ssl_setup(&(pTlsData->ssl), &(pTlsData->conf))) != 0) {
+    if ((ret = mbedtls_ssl_setup(&(pTlsData->ssl), conf)) != 0) {
         SSL_LOG("failed! mbedtls_ssl_setup returned %d", ret);
         return ret;
     }
     mbedtls_ssl_set_hostname(&(pTlsData->ssl), addr);
-    mbedtls_ssl_set_bio(&(pTlsData->ssl), &(pTlsData->fd), mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout);
+    pTlsData->write_timeout = SEND_TIMEOUT_SECONDS * 1000;
+    mbedtls_ssl_set_bio(&(pTlsData->ssl), pTlsData, _ssl_send, NULL, _ssl_recv_timeout);
+#ifdef TLS_SESSION_CACHE_SUPPORT
+    _tls_session_cache_load(&(pTlsData->ssl), addr, port, ca_digest, _ssl_authmode(NULL != ca_crt));
+#endif
 
     /*
       * 4. Handshake
@@ -411,6 +812,9 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
     while ((ret = mbedtls_ssl_handshake(&(pTlsData->ssl))) != 0) {
         if ((ret != MBEDTLS_ERR_SSL_WANT_READ) && (ret != MBEDTLS_ERR_SSL_WANT_WRITE)) {
             SSL_LOG("failed  ! mbedtls_ssl_handshake returned -0x%04x", -ret);
+#ifdef TLS_SESSION_CACHE_SUPPORT
+            _tls_session_cache_remove(addr, port, ca_digest, _ssl_authmode(NULL != ca_crt));
+#endif
             return ret;
         }
     }
@@ -423,6 +827,9 @@ static int _TLSConnectNetwork(TLSDataParams_t *pTlsData, const char *addr, const
         SSL_LOG(" failed  ! verify result not confirmed.");
         return ret;
     }
+#ifdef TLS_SESSION_CACHE_SUPPORT
+    _tls_session_cache_save(&(pTlsData->ssl), addr, port, ca_digest, _ssl_authmode(NULL != ca_crt));
+#endif
     /* n->my_socket = (int)((n->tlsdataparams.fd).fd); */
     /* WRITE_IOT_DEBUG_LOG("my_socket=%d", n->my_socket); */
 
@@ -437,7 +844,7 @@ static int _network_ssl_read(TLSDataParams_t *pTlsData, char *buffer, int len, i
     int             ret = -1;
     char            err_str[33];
 
-    mbedtls_ssl_conf_read_timeout(&(pTlsData->conf), timeout_ms);
+    pTlsData->read_timeout = timeout_ms;
     while (readLen < len) {
         ret = mbedtls_ssl_read(&(pTlsData->ssl), (unsigned char *)(buffer + readLen), (len - readLen));
         if (ret > 0) {
@@ -472,16 +879,29 @@ static int _network_ssl_read(TLSDataParams_t *pTlsData, char *buffer, int len, i
     return (readLen > 0) ? readLen : net_status;
 }
 
+/* A record which times out partly sent is finished by the next write, which
+ * has to go on with the data not counted as written, as mbedtls requires */
 static int _network_ssl_write(TLSDataParams_t *pTlsData, const char *buffer, int len, int timeout_ms)
 {
     uint32_t writtenLen = 0;
     int ret = -1;
+    uint64_t now = HAL_UptimeMs();
+    uint64_t deadline = now + (timeout_ms > 0 ? timeout_ms : 0);
 
     while (writtenLen < len) {
-        ret = mbedtls_ssl_write(&(pTlsData->ssl), (unsigned char *)(buffer + writtenLen), (len - writtenLen));
+        pTlsData->write_timeout = (deadline > now) ? (uint32_t)(deadline - now) : 0;
+        /* this mbedtls copies into the record buffer without bounding the length */
+        ret = mbedtls_ssl_write(&(pTlsData->ssl), (unsigned char *)(buffer + writtenLen),
+                                (len - writtenLen > MBEDTLS_SSL_MAX_CONTENT_LEN) ? MBEDTLS_SSL_MAX_CONTENT_LEN : (len - writtenLen));
+        now = HAL_UptimeMs();
         if (ret > 0) {
             writtenLen += ret;
             continue;
+        } else if (MBEDTLS_ERR_SSL_WANT_WRITE == ret && now < deadline) {
+            continue;
+        } else if (MBEDTLS_ERR_SSL_WANT_WRITE == ret || MBEDTLS_ERR_SSL_TIMEOUT == ret) {
+            SSL_LOG("ssl write timeout");
+            return writtenLen;
         } else if (ret == 0) {
             SSL_LOG("ssl write timeout");
             return 0;
@@ -512,6 +932,12 @@ static void _network_ssl_disconnect(TLSDataParams_t *pTlsData)
 #endif
     mbedtls_ssl_free(&(pTlsData->ssl));
     mbedtls_ssl_config_free(&(pTlsData->conf));
+#ifdef TLS_CONF_CACHE_SUPPORT
+    if (NULL != pTlsData->conf_cache) {
+        _tls_conf_cache_put(pTlsData->conf_cache);
+        pTlsData->conf_cache = NULL;
+    }
+#endif
     SSL_LOG("ssl_disconnect");
 }
 
@@ -525,6 +951,50 @@ int HAL_SSL_Write(uintptr_t handle, const char *buf, int len, int timeout_ms)
     return _network_ssl_write((TLSDataParams_t *)handle, buf, len, timeout_ms);
 }
 
+#ifdef IOTX_WRITEV_SUPPORT
+int HAL_SSL_Writev(uintptr_t handle, const hal_iovec_t *iov, uint32_t iovcnt, int timeout_ms)
+{
+    int ret;
+    uint32_t i, len = 0, written = 0;
+    size_t max_len = MBEDTLS_SSL_MAX_CONTENT_LEN;
+    char *gather = NULL;
+
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    max_len = mbedtls_ssl_get_max_frag_len(&((TLSDataParams_t *)handle)->ssl);
+#endif
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+
+    /* mbedtls_ssl_write() takes one buffer, gather a message which fits in one
+     * record so it does not go out as one record per buffer */
+    if (iovcnt > 1 && len <= max_len) {
+        gather = HAL_Malloc(len);
+    }
+    if (NULL != gather) {
+        for (i = 0; i < iovcnt; i++) {
+            memcpy(gather + written, iov[i].buf, iov[i].len);
+            written += iov[i].len;
+        }
+        ret = _network_ssl_write((TLSDataParams_t *)handle, gather, len, timeout_ms);
+        HAL_Free(gather);
+        return ret;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        ret = _network_ssl_write((TLSDataParams_t *)handle, iov[i].buf, iov[i].len, timeout_ms);
+        if (ret <= 0) {
+            return (written > 0) ? written : ret;
+        }
+        written += ret;
+        if (ret < iov[i].len) {
+            break;
+        }
+    }
+    return written;
+}
+#endif  /* IOTX_WRITEV_SUPPORT */
+
 int32_t HAL_SSL_Destroy(uintptr_t handle)
 {
     if ((uintptr_t)NULL == handle) {
@@ -1,4 +1,3 @@
-
 #include "iot_import.h"
 
 #include "openssl/crypto.h"
@@ -6,19 +5,82 @@
 #include "openssl/pem.h"
 #include "openssl/ssl.h"
 #include "openssl/err.h"
+#include "openssl/sha.h"
+
+#ifndef SSL_CTX_CACHE_NUM
+#define SSL_CTX_CACHE_NUM       (2)     /* distinct CAs in use at the same time */
+#endif
+
+#define SSL_SESSION_HOST_LEN    (64)
+
+#ifndef SSL_SESSION_CACHE_NUM
+#define SSL_SESSION_CACHE_NUM   (4)     /* MQTT, HTTP and OTA servers */
+#endif
+
+/* The context of the connections trusting one CA, its store holds the CA.
+ * Each SSL holds a reference to its SSL_CTX, so a context replaced here is
+ * freed only after the last connection made from it */
+typedef struct {
+    unsigned char digest[SHA256_DIGEST_LENGTH];   /* SHA-256 of the CA PEM string */
+    SSL_CTX      *ctx;
+} ssl_ctx_cache_t;
+
+static ssl_ctx_cache_t ssl_ctx_cache[SSL_CTX_CACHE_NUM];
+static int ssl_ctx_cache_next = 0;
+static int ssl_lib_inited = 0;
+
+/* Sessions of the last handshakes, resumed when connecting to the same server
+ * again through a context trusting the same CA */
+typedef struct {
+    char          host[SSL_SESSION_HOST_LEN];
+    uint16_t      port;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SSL_SESSION  *session;
+} ssl_session_cache_t;
+
+static ssl_session_cache_t ssl_session_cache[SSL_SESSION_CACHE_NUM];
 
-static SSL_CTX *ssl_ctx = NULL;
-static X509_STORE *ca_store = NULL;
-static X509 *ca = NULL;
+/* guards both caches */
+static void *ssl_mutex = NULL;
 
 
+#if defined(_MSC_VER)
 #pragma comment(lib,"libeay32.lib")
 #pragma comment(lib,"ssleay32.lib")
+#endif
 
 
 #define PLATFORM_WINSOCK_LOG    printf
 #define PLATFORM_WINSOCK_PERROR printf
 
+/* Created once, a thread losing the race to publish its mutex destroys it */
+static void ssl_lock(void)
+{
+    void *mutex = __atomic_load_n(&ssl_mutex, __ATOMIC_ACQUIRE);
+    void *expected = NULL;
+
+    if (NULL == mutex) {
+        mutex = HAL_MutexCreate();
+        if (NULL != mutex && !__atomic_compare_exchange_n(&ssl_mutex, &expected, mutex, 0,
+                                                          __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            HAL_MutexDestroy(mutex);
+            mutex = expected;
+        }
+    }
+    if (NULL != mutex) {
+        HAL_MutexLock(mutex);
+    }
+}
+
+static void ssl_unlock(void)
+{
+    void *mutex = __atomic_load_n(&ssl_mutex, __ATOMIC_ACQUIRE);
+
+    if (NULL != mutex) {
+        HAL_MutexUnlock(mutex);
+    }
+}
+
 static X509 *ssl_load_cert(const char *cert_str)
 {
     X509 *cert = NULL;
@@ -42,29 +104,39 @@ static X509 *ssl_load_cert(const char *cert_str)
 }
 
 
-static int ssl_ca_store_init(const char *my_ca)
+static X509_STORE *ssl_ca_store_new(const char *my_ca)
 {
     int ret;
-    if (!ca_store) {
-        if (!my_ca) {
-            printf("no global ca string provided \n");
-            return -1;
-        }
-        ca_store = X509_STORE_new();
-        ca = ssl_load_cert(my_ca);
-        ret = X509_STORE_add_cert(ca_store, ca);
-        if (ret != 1) {
-            printf("failed to X509_STORE_add_cert ret = %d \n", ret);
-            return -1;
-        }
+    X509 *ca;
+    X509_STORE *store;
+
+    ca = ssl_load_cert(my_ca);
+    if (!ca) {
+        printf("failed to load the ca \n");
+        return NULL;
     }
 
-    return 0;
+    store = X509_STORE_new();
+    if (!store) {
+        X509_free(ca);
+        return NULL;
+    }
+
+    /* the store takes its own reference */
+    ret = X509_STORE_add_cert(store, ca);
+    X509_free(ca);
+    if (ret != 1) {
+        printf("failed to X509_STORE_add_cert ret = %d \n", ret);
+        X509_STORE_free(store);
+        return NULL;
+    }
+
+    return store;
 }
 
 
 
-static int ssl_verify_ca(X509 *target_cert)
+static int ssl_verify_ca(X509_STORE *ca_store, X509 *target_cert)
 {
     STACK_OF(X509) *ca_stack = NULL;
     X509_STORE_CTX *store_ctx = NULL;
@@ -81,8 +153,8 @@ static int ssl_verify_ca(X509 *target_cert)
     ret = X509_verify_cert(store_ctx);
     if (ret != 1) {
         printf("X509_verify_cert fail, ret = %d, error id = %d, %s\n",
-               ret, store_ctx->error,
-               X509_verify_cert_error_string(store_ctx->error));
+               ret, X509_STORE_CTX_get_error(store_ctx),
+               X509_verify_cert_error_string(X509_STORE_CTX_get_error(store_ctx)));
         goto end;
     }
 end:
@@ -95,51 +167,151 @@ end:
 }
 
 
-static int ssl_init(const char *my_ca)
+/* Find or build the context trusting 'my_ca', called with the lock held */
+static SSL_CTX *ssl_ctx_get(const char *my_ca, const unsigned char *digest)
 {
-    if (ssl_ca_store_init(my_ca) != 0) {
-        return -1;
+    int i;
+    SSL_CTX *ctx;
+    X509_STORE *store;
+    ssl_ctx_cache_t *cache;
+
+    for (i = 0; i < SSL_CTX_CACHE_NUM; i++) {
+        if (NULL != ssl_ctx_cache[i].ctx
+            && 0 == memcmp(ssl_ctx_cache[i].digest, digest, SHA256_DIGEST_LENGTH)) {
+            return ssl_ctx_cache[i].ctx;
+        }
     }
 
-    if (!ssl_ctx) {
-        SSL_METHOD *meth;
-
+    if (!ssl_lib_inited) {
         SSLeay_add_ssl_algorithms();
+        SSL_load_error_strings();
+        ssl_lib_inited = 1;
+    }
 
-        meth = TLSv1_client_method();
+    store = ssl_ca_store_new(my_ca);
+    if (!store) {
+        return NULL;
+    }
 
-        SSL_load_error_strings();
-        ssl_ctx = SSL_CTX_new(meth);
-        if (!ssl_ctx) {
-            printf("fail to initialize ssl context \n");
-            return -1;
+    ctx = SSL_CTX_new(TLSv1_client_method());
+    if (!ctx) {
+        printf("fail to initialize ssl context \n");
+        X509_STORE_free(store);
+        return NULL;
+    }
+    SSL_CTX_set_cert_store(ctx, store);
+
+    /* replace the oldest context, its connections keep it alive */
+    cache = &ssl_ctx_cache[ssl_ctx_cache_next];
+    ssl_ctx_cache_next = (ssl_ctx_cache_next + 1) % SSL_CTX_CACHE_NUM;
+    if (NULL != cache->ctx) {
+        SSL_CTX_free(cache->ctx);
+    }
+    memcpy(cache->digest, digest, SHA256_DIGEST_LENGTH);
+    cache->ctx = ctx;
+
+    return ctx;
+}
+
+
+static ssl_session_cache_t *ssl_session_cache_find(const char *host, uint16_t port,
+                                                   const unsigned char *digest)
+{
+    int i;
+
+    for (i = 0; i < SSL_SESSION_CACHE_NUM; i++) {
+        if (NULL != ssl_session_cache[i].session && port == ssl_session_cache[i].port
+            && 0 == strncmp(ssl_session_cache[i].host, host, SSL_SESSION_HOST_LEN)
+            && 0 == memcmp(ssl_session_cache[i].digest, digest, SHA256_DIGEST_LENGTH)) {
+            return &ssl_session_cache[i];
         }
-    } else {
-        printf("ssl context already initialized \n");
     }
+    return NULL;
+}
 
-    return 0;
+static void ssl_session_cache_remove(const char *host, uint16_t port, const unsigned char *digest)
+{
+    ssl_session_cache_t *cache;
+
+    ssl_lock();
+    cache = ssl_session_cache_find(host, port, digest);
+    if (NULL != cache) {
+        SSL_SESSION_free(cache->session);
+        cache->session = NULL;
+    }
+    ssl_unlock();
+}
+
+static void ssl_session_cache_save(SSL *ssl, const char *host, uint16_t port, const unsigned char *digest)
+{
+    int i;
+    ssl_session_cache_t *cache;
+
+    ssl_lock();
+    cache = ssl_session_cache_find(host, port, digest);
+    if (NULL == cache) {
+        /* take a free slot, or evict the first one */
+        cache = &ssl_session_cache[0];
+        for (i = 0; i < SSL_SESSION_CACHE_NUM; i++) {
+            if (NULL == ssl_session_cache[i].session) {
+                cache = &ssl_session_cache[i];
+                break;
+            }
+        }
+    }
+    if (NULL != cache->session) {
+        SSL_SESSION_free(cache->session);
+    }
+
+    cache->session = SSL_get1_session(ssl);
+    strncpy(cache->host, host, SSL_SESSION_HOST_LEN - 1);
+    cache->host[SSL_SESSION_HOST_LEN - 1] = '\0';
+    cache->port = port;
+    memcpy(cache->digest, digest, SHA256_DIGEST_LENGTH);
+    ssl_unlock();
 }
 
 
-static int ssl_establish(int sock, SSL **ppssl)
+static int ssl_establish(int sock, const char *host, uint16_t port, const char *my_ca, SSL **ppssl)
 {
+    ssl_session_cache_t *cache;
     int err;
-    SSL *ssl_temp;
-    X509 *server_cert;
+    SSL *ssl_temp = NULL;
+    SSL_CTX *ctx;
+    X509 *server_cert = NULL;
+    unsigned char digest[SHA256_DIGEST_LENGTH];
 
-    if (!ssl_ctx) {
-        printf("no ssl context to create ssl connection \n");
+    if (!my_ca) {
+        printf("no global ca string provided \n");
         return -1;
     }
+    SHA256((const unsigned char *)my_ca, strlen(my_ca), digest);
+
+    /* the SSL takes a reference to the context before it can be replaced */
+    ssl_lock();
+    ctx = ssl_ctx_get(my_ca, digest);
+    if (ctx) {
+        ssl_temp = SSL_new(ctx);
+    }
+    /* the server runs a full handshake if it no longer knows the session */
+    cache = ssl_session_cache_find(host, port, digest);
+    if (NULL != ssl_temp && NULL != cache) {
+        SSL_set_session(ssl_temp, cache->session);
+    }
+    ssl_unlock();
 
-    ssl_temp = SSL_new(ssl_ctx);
+    if (!ssl_temp) {
+        printf("no ssl context to create ssl connection \n");
+        goto err;
+    }
 
     SSL_set_fd(ssl_temp, sock);
+
     err = SSL_connect(ssl_temp);
 
     if (err == -1) {
         printf("failed create ssl connection \n");
+        ssl_session_cache_remove(host, port, digest);
         goto err;
     }
 
@@ -150,7 +322,7 @@ static int ssl_establish(int sock, SSL **ppssl)
         goto err;
     }
 
-    /* if (ssl_verify_ca(server_cert) != 0) */
+    /* if (ssl_verify_ca(SSL_CTX_get_cert_store(ctx), server_cert) != 0) */
     /* { */
     /*     goto err; */
     /* } */
@@ -159,6 +331,12 @@ static int ssl_establish(int sock, SSL **ppssl)
 
     printf("success to verify cert \n");
 
+    if (SSL_session_reused(ssl_temp)) {
+        printf("ssl session resumed \n");
+    } else {
+        ssl_session_cache_save(ssl_temp, host, port, digest);
+    }
+
     *ppssl = (void *)ssl_temp;
 
     return 0;
@@ -178,16 +356,14 @@ err:
 
 
 void *platform_ssl_connect(void *tcp_fd,
+                           const char *host,
+                           uint16_t port,
                            const char *server_cert,
                            int server_cert_len)
 {
     SSL *pssl;
 
-    if (0 != ssl_init(server_cert)) {
-        return NULL;
-    }
-
-    if (0 != ssl_establish((int)tcp_fd, &pssl)) {
+    if (0 != ssl_establish((int)(intptr_t)tcp_fd, host, port, server_cert, &pssl)) {
         return NULL;
     }
 
@@ -201,23 +377,9 @@ int platform_ssl_close(void *ssl)
     /* SOCKET sock = (SOCKET)SSL_get_fd( ssl ); */
 
     SSL_set_shutdown((SSL *)ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    /* drops the reference to its context, freed here if it was replaced */
     SSL_free((SSL *)ssl);
 
-    if (ssl_ctx) {
-        SSL_CTX_free(ssl_ctx);
-        ssl_ctx = NULL;
-    }
-
-    if (ca) {
-        X509_free(ca);
-        ca = NULL;
-    }
-
-    if (ca_store) {
-        X509_STORE_free(ca_store);
-        ca_store = NULL;
-    }
-
     /* ssl_destroy_net( sock ); */
 
     return 0;
@@ -247,7 +409,7 @@ int platform_ssl_recv(void *ssl, char *buf, uint32_t len, int timeout_ms)
     struct timeval timeout;
     int fd = SSL_get_fd(ssl);
 
-    t_end = GetTickCount() + timeout_ms;
+    t_end = HAL_UptimeMs() + timeout_ms;
     len_recv = 0;
     err_code = 0;
 
@@ -255,7 +417,7 @@ int platform_ssl_recv(void *ssl, char *buf, uint32_t len, int timeout_ms)
         len_recv = SSL_read(ssl, buf, len);
     } else {
         do {
-            t_left = time_left(t_end, GetTickCount());
+            t_left = time_left(t_end, HAL_UptimeMs());
 
             FD_ZERO(&sets);
             FD_SET(fd, &sets);
@@ -287,7 +449,7 @@ int platform_ssl_recv(void *ssl, char *buf, uint32_t len, int timeout_ms)
                 err_code = -2;
                 break;
             }
-        } while ((len_recv < len) && (time_left(t_end, GetTickCount()) > 0));
+        } while ((len_recv < len) && (time_left(t_end, HAL_UptimeMs()) > 0));
     }
     /* priority to return data bytes if any data be received from TCP connection. */
     /* It will get error code on next calling */
@@ -308,6 +470,9 @@ int platform_ssl_send(void *ssl, const char *buf, uint32_t len)
 struct ssl_info_st {
     long tcp;
     long ssl;
+#ifdef IOTX_READ_VIEW_SUPPORT
+    char *view;     /* data lent by HAL_SSL_ReadView() */
+#endif
 };
 
 uintptr_t HAL_SSL_Establish(const char *host,
@@ -329,8 +494,11 @@ uintptr_t HAL_SSL_Establish(const char *host,
         return (uintptr_t)NULL;
     }
     handle->tcp = tmp;
+#ifdef IOTX_READ_VIEW_SUPPORT
+    handle->view = NULL;
+#endif
 
-    tmp = (long)platform_ssl_connect((void *)tmp, ca_crt, ca_crt_len);
+    tmp = (long)platform_ssl_connect((void *)tmp, host, port, ca_crt, ca_crt_len);
     if (0 == tmp) {
         HAL_TCP_Destroy(handle->tcp);
         free(handle);
@@ -356,6 +524,9 @@ int32_t HAL_SSL_Destroy(uintptr_t handle)
         HAL_TCP_Destroy(h->tcp);
     }
 
+#ifdef IOTX_READ_VIEW_SUPPORT
+    free(h->view);
+#endif
     free((void *)handle);
     return 0;
 }
@@ -371,3 +542,81 @@ int HAL_SSL_Write(uintptr_t handle, const char *buf, int len, int timeout_ms)
     timeout_ms = timeout_ms;
     return platform_ssl_send((void *)(((struct ssl_info_st *)handle)->ssl), buf, len);
 }
+
+#ifdef IOTX_WRITEV_SUPPORT
+#define SSL_WRITEV_GATHER_SIZE  (16384)     /* the largest TLS record */
+
+int HAL_SSL_Writev(uintptr_t handle, const hal_iovec_t *iov, uint32_t iovcnt, int timeout_ms)
+{
+    int ret;
+    uint32_t i, len = 0, written = 0;
+    char *gather = NULL;
+
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+
+    /* SSL_write() takes one buffer, gather a message which fits in one record
+     * so it does not go out as one record per buffer */
+    if (iovcnt > 1 && len <= SSL_WRITEV_GATHER_SIZE) {
+        gather = malloc(len);
+    }
+    if (NULL != gather) {
+        for (i = 0; i < iovcnt; i++) {
+            memcpy(gather + written, iov[i].buf, iov[i].len);
+            written += iov[i].len;
+        }
+        ret = HAL_SSL_Write(handle, gather, len, timeout_ms);
+        free(gather);
+        return ret;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        ret = HAL_SSL_Write(handle, iov[i].buf, iov[i].len, timeout_ms);
+        if (ret <= 0) {
+            return (written > 0) ? written : ret;
+        }
+        written += ret;
+    }
+    return written;
+}
+#endif  /* IOTX_WRITEV_SUPPORT */
+
+#ifdef IOTX_READ_VIEW_SUPPORT
+#define SSL_READ_VIEW_SIZE      (16384)     /* the largest TLS record */
+
+/* OpenSSL does not lend out its record buffer, so the data is copied once
+ * into one of the handle. Only what the current record holds is taken. */
+int HAL_SSL_ReadView(uintptr_t handle, const char **data, int len, int timeout_ms)
+{
+    int ret, pending;
+    struct ssl_info_st *h = (struct ssl_info_st *)handle;
+
+    if (NULL == h->view) {
+        h->view = malloc(SSL_READ_VIEW_SIZE);
+        if (NULL == h->view) {
+            printf("no enough memory\n");
+            return -2;
+        }
+    }
+    if (len > SSL_READ_VIEW_SIZE) {
+        len = SSL_READ_VIEW_SIZE;
+    }
+
+    /* the first byte decrypts a record, the rest of it is pending then */
+    ret = platform_ssl_recv((void *)h->ssl, h->view, 1, timeout_ms);
+    if (ret <= 0) {
+        return ret;
+    }
+    pending = SSL_pending((SSL *)h->ssl);
+    if (pending > len - 1) {
+        pending = len - 1;
+    }
+    if (pending > 0 && (pending = SSL_read((SSL *)h->ssl, h->view + 1, pending)) > 0) {
+        ret += pending;
+    }
+
+    *data = h->view;
+    return ret;
+}
+#endif  /* IOTX_READ_VIEW_SUPPORT */
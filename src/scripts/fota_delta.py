@@ -0,0 +1,144 @@
+#! /usr/bin/env python
+#
+# Make a delta firmware applied by the FOTA service, see src/utils/misc/utils_delta.h
+#
+#   fota_delta.py diff  <old image> <new image> <delta>
+#   fota_delta.py apply <old image> <delta> <new image>
+#
+# Upload the delta in place of the new image. Its MD5 is checked as fetched,
+# the digest of the new image as applied, with linkkit_fota_set_digest(). A
+# delta is refused without that digest, and by a device not running the old
+# image, whose SHA-256 is in the header.
+
+import hashlib
+import struct
+import sys
+
+MAGIC = b'IOTXDLT1'
+OP_COPY = 0
+OP_ADD = 1
+
+BLOCK = 32      # the shortest copy found, a few bytes are not worth one
+STRIDE = 4      # old image offsets indexed, so a copy is found if BLOCK + STRIDE - 1 bytes match
+
+
+def varint(value):
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7f) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value) << 1) - 1
+
+
+def match_len(a, ai, b, bi):
+    n, step = 0, 4096
+    limit = min(len(a) - ai, len(b) - bi)
+    while n < limit:
+        m = min(step, limit - n)
+        if a[ai + n:ai + n + m] == b[bi + n:bi + n + m]:
+            n += m
+        elif m == 1:
+            break
+        else:
+            step = max(1, m // 2)
+    return n
+
+
+def diff(old, new):
+    index = {}
+    for i in range(len(old) - BLOCK, -1, -STRIDE):
+        index[old[i:i + BLOCK]] = i
+
+    out = [MAGIC, struct.pack('<II', len(new), len(old)), hashlib.sha256(old).digest()]
+    old_pos = 0     # where the last copy ended
+    added = 0       # start of the bytes not copied yet
+    i = 0
+
+    while i + BLOCK <= len(new):
+        block = new[i:i + BLOCK]
+        # after changed bytes of the same length, the old image goes on where it was
+        pos = old_pos + (i - added)
+        if old[pos:pos + BLOCK] != block:
+            pos = index.get(block)
+            if pos is None:
+                i += 1
+                continue
+
+        while i > added and pos > 0 and new[i - 1] == old[pos - 1]:
+            i -= 1
+            pos -= 1
+        length = match_len(new, i, old, pos)
+
+        if i > added:
+            out += [varint((i - added) << 1 | OP_ADD), new[added:i]]
+        out += [varint(length << 1 | OP_COPY), varint(zigzag(pos - old_pos))]
+        old_pos = pos + length
+        i += length
+        added = i
+
+    if len(new) > added:
+        out += [varint((len(new) - added) << 1 | OP_ADD), new[added:]]
+    return b''.join(out)
+
+
+def apply(old, delta):
+    if delta[:len(MAGIC)] != MAGIC:
+        return delta
+    new_size, old_size = struct.unpack('<II', delta[len(MAGIC):len(MAGIC) + 8])
+    if old_size != len(old):
+        raise ValueError('delta made against a %d bytes image' % old_size)
+    p = len(MAGIC) + 8
+    if delta[p:p + 32] != hashlib.sha256(old).digest():
+        raise ValueError('delta made against another image')
+
+    def read_varint(p):
+        value, shift = 0, 0
+        while True:
+            value |= (delta[p] & 0x7f) << shift
+            shift += 7
+            p += 1
+            if not delta[p - 1] & 0x80:
+                return value, p
+
+    new = bytearray()
+    old_pos, p = 0, len(MAGIC) + 8 + 32
+    while len(new) < new_size:
+        op, p = read_varint(p)
+        length = op >> 1
+        if op & 1 == OP_ADD:
+            new += delta[p:p + length]
+            p += length
+        else:
+            move, p = read_varint(p)
+            old_pos += (move >> 1) ^ -(move & 1)
+            new += old[old_pos:old_pos + length]
+            old_pos += length
+    return bytes(new)
+
+
+def main(argv):
+    if len(argv) != 5 or argv[1] not in ('diff', 'apply'):
+        sys.stderr.write('usage: %s diff <old> <new> <delta> | apply <old> <delta> <new>\n' % argv[0])
+        return 1
+
+    with open(argv[2], 'rb') as f:
+        old = f.read()
+    with open(argv[3], 'rb') as f:
+        data = f.read()
+
+    out = diff(old, data) if argv[1] == 'diff' else apply(old, data)
+    with open(argv[4], 'wb') as f:
+        f.write(out)
+
+    if argv[1] == 'diff':
+        print('%d bytes image, %d bytes delta (%.1f%%)' % (len(data), len(out), 100.0 * len(out) / max(1, len(data))))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -104,6 +104,36 @@ typedef struct {
 } iotx_message_t;
 
 
+/* Block size of a block-wise transfer, the value is the CoAP SZX */
+typedef enum {
+    IOTX_COAP_BLOCK_SIZE_16   = 0,
+    IOTX_COAP_BLOCK_SIZE_32   = 1,
+    IOTX_COAP_BLOCK_SIZE_64   = 2,
+    IOTX_COAP_BLOCK_SIZE_128  = 3,
+    IOTX_COAP_BLOCK_SIZE_256  = 4,
+    IOTX_COAP_BLOCK_SIZE_512  = 5,
+    IOTX_COAP_BLOCK_SIZE_1024 = 6,
+} iotx_coap_block_size_t;
+
+/* Callback function to provide len bytes of the body to upload, starting at offset. Return 0 on success. */
+typedef int (*iotx_block_read_t)(void *p_arg, unsigned int offset, unsigned char *p_buf, unsigned int len);
+
+/* Callback function to consume len bytes of the downloaded body at offset, called in order. */
+typedef int (*iotx_block_write_t)(void *p_arg, unsigned int offset, unsigned char *p_data, unsigned int len);
+
+/* IoTx block-wise message definition */
+typedef struct {
+    unsigned int             total_len;      /* Length of the body to upload, unused by download */
+    iotx_coap_block_size_t   block_size;
+    unsigned char            window;         /* Blocks in flight, 1 ~ 8 */
+    iotx_content_type_t      content_type;
+    void                    *user_data;
+    iotx_block_read_t        read_callback;  /* Upload: provides the body block by block */
+    iotx_block_write_t       write_callback; /* Download: consumes the body block by block */
+    iotx_response_callback_t resp_callback;  /* Called with the final response, can be NULL */
+} iotx_block_message_t;
+
+
 /*iotx coap context definition*/
 typedef void iotx_coap_context_t;
 
@@ -167,6 +197,33 @@ int  IOT_CoAP_DeviceNameAuth(iotx_coap_context_t *p_context);
 int  IOT_CoAP_Yield(iotx_coap_context_t *p_context);
 
 
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+/**
+ * @brief   Let an event loop created by HAL_EventLoop_Create() receive for the CoAP client,
+ *          so one thread can drive many clients. IOT_CoAP_Yield() then returns without
+ *          waiting and only needs to be called about every wait_time_ms for retransmissions.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client, "coap://" only.
+ * @param [in] loop : The event loop.
+ *
+ * @return status.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_Attach(iotx_coap_context_t *p_context, void *loop);
+
+
+/**
+ * @brief   Remove the CoAP client from its event loop, IOT_CoAP_Deinit() does it too.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ *
+ * @return status.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_Detach(iotx_coap_context_t *p_context);
+#endif
+
+
 /**
  * @brief   Send a message with specific path to server.
  *        Client must authentication with server before send message.
@@ -182,6 +239,75 @@ int  IOT_CoAP_Yield(iotx_coap_context_t *p_context);
  */
 int  IOT_CoAP_SendMessage(iotx_coap_context_t *p_context,   char *p_path, iotx_message_t *p_message);
 
+/**
+ * @brief   Upload a large body to server with block-wise transfer (RFC 7959, Block1).
+ *        The body is pulled from read_callback one block at a time and up to
+ *        window blocks are in flight, so it is never buffered as a whole.
+ *        This function returns when the server has answered the final block.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] p_path: Specify the path name.
+ * @param [in] p_message: Block-wise message to be sent.
+ *
+ * @retval IOTX_SUCCESS             : The whole body is accepted by the server.
+ * @retval IOTX_ERR_NOT_AUTHED      : The client hasn't authenticated with server
+ * @retval IOTX_ERR_SEND_MSG_FAILED : The transfer is rejected or timeout.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_SendMessageBlockwise(iotx_coap_context_t *p_context, char *p_path, iotx_block_message_t *p_message);
+
+/**
+ * @brief   Download a large resource from server with block-wise transfer (RFC 7959, Block2).
+ *        The body is handed to write_callback in order as it arrives, blocks
+ *        received ahead of time are kept in a window sized reorder buffer.
+ *        This function returns when the last block is delivered.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] p_path: Specify the path name.
+ * @param [in] p_message: Block-wise message to receive into.
+ *
+ * @retval IOTX_SUCCESS             : The whole body is received.
+ * @retval IOTX_ERR_NOT_AUTHED      : The client hasn't authenticated with server
+ * @retval IOTX_ERR_RECV_MSG_TIMEOUT: The transfer is rejected or timeout.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_GetMessageBlockwise(iotx_coap_context_t *p_context, char *p_path, iotx_block_message_t *p_message);
+
+/**
+ * @brief   Observe a resource on server (RFC 7641) instead of polling it.
+ *        The callback is called with the first response and then with every
+ *        fresh notification, out of order notifications are dropped.
+ *        The observation is re-registered when no notification arrives within
+ *        the Max-Age of the latest one, and ends when the server answers
+ *        without the Observe option or with an error code.
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] p_path: Specify the path name of the resource.
+ * @param [in] callback: Handle the notifications of this resource.
+ * @param [in] user_data: Passed to the callback as p_arg.
+ * @param [out] p_observe_id: Identify the observation, used to cancel it.
+ *
+ * @retval IOTX_SUCCESS             : Send the registration success.
+ * @retval IOTX_ERR_NOT_AUTHED      : The client hasn't authenticated with server
+ * @retval IOTX_ERR_SEND_MSG_FAILED : Send the registration failed.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_Observe(iotx_coap_context_t *p_context, char *p_path, iotx_response_callback_t callback,
+                      void *user_data, unsigned int *p_observe_id);
+
+/**
+ * @brief   Cancel an observation registered by IOT_CoAP_Observe().
+ *
+ * @param [in] p_context : Pointer of contex, specify the CoAP client.
+ * @param [in] p_path: Specify the path name of the resource.
+ * @param [in] observe_id: Returned by IOT_CoAP_Observe().
+ *
+ * @retval IOTX_SUCCESS             : Cancel the observation success.
+ * @retval IOTX_ERR_INVALID_PARAM   : The observation is not found.
+ * @see iotx_ret_code_t.
+ */
+int  IOT_CoAP_CancelObserve(iotx_coap_context_t *p_context, char *p_path, unsigned int observe_id);
+
 /**
 * @brief Retrieves the length and payload pointer of specified message.
 *
@@ -37,6 +37,10 @@ typedef void (*handle_service_cota_callback_fp_t)(service_cota_callback_type_t c
 																							  const char* sign,
 																							  const char* signmethod,
 																							  const char* cota_url);
+/* a key of the new config added or changed, value is NULL if the key is removed.
+ * key is NULL if the config is not a JSON object or too large to be compared, then it is applied whole. */
+typedef void (*handle_service_cota_change_fp_t)(const char* key, int key_len, const char* value, int value_len);
+
 void* config_ota_lite_calloc(size_t nmemb, size_t size);
 void* config_ota_lite_malloc(size_t size);
 void config_ota_lite_free_func(void* ptr);
@@ -51,6 +55,7 @@ typedef struct {
     int   (*end)(void* _self);
     int   (*perform_ota_service)(void* _self, void* _data_buf, int _data_buf_length);
     void  (*install_callback_function)(void* _self, handle_service_cota_callback_fp_t linkkit_callback_fp);
+    void  (*install_change_callback)(void* _self, handle_service_cota_change_fp_t change_callback_fp);
 } cota_t;
 
 typedef struct {
@@ -69,8 +74,15 @@ typedef struct {
     char*       _rsp_signMethod;
     char*       _rsp_url;
     char*       _rsp_getType;
+    char*       _rsp_configscope;   /* the config fetched is cached as of it, NULL for the product. */
     int         _ota_inited;
     int         _destructing;
+    void*       _change_callback_fp;
+    void*       _cache;             /* the config applied last of each scope, by its digest. */
+    void*       _digest;            /* of the config fetched so far. */
+    int         _digest_type;       /* -1 if the sign method is not known. */
+    char*       _content;           /* the config fetched, kept to find the keys changed. */
+    uint32_t    _content_len;
 } config_ota_t;
 
 extern const void* get_config_ota_class();
@@ -34,6 +34,8 @@ typedef enum IOT_RETURN_CODES {
     ERROR_NET_CONN = -301,
     ERROR_NET_UNKNOWN_HOST = -300,
 
+    MQTT_PUBLISH_WINDOW_FULL_ERROR = -45,
+    MQTT_PUBLISH_QUEUE_FULL_ERROR = -44,
     MQTT_SUB_INFO_NOT_FOUND_ERROR = -43,
     MQTT_PUSH_TO_LIST_ERROR = -42,
     MQTT_TOPIC_FORMAT_ERROR = -41,
@@ -26,6 +26,7 @@ typedef struct {
     int   (*end)(void* _self);
     int   (*perform_ota_service)(void* _self, void* _data_buf, int _data_buf_length);
     void  (*install_callback_function)(void* _self, handle_service_fota_callback_fp_t linkkit_callback_fp);
+    int   (*set_digest)(void* _self, const char* sign_method, const char* digest);  /* "Md5" or "Sha256", checked as written, required for a delta. */
 } fota_t;
 
 void* service_ota_lite_malloc(size_t size);
@@ -54,6 +55,11 @@ typedef struct {
     char*       _current_verison;
     int         _ota_inited;
     int         _destructing;
+    void*       _digest;            /* of the image written so far. */
+    int         _digest_type;
+    char*       _digest_expected;
+    void*       _delta;             /* applies a delta firmware, or passes a whole one through. */
+    void*       _writer;            /* writes a block while the next one is fetched. */
 } service_ota_t;
 
 extern const void* get_service_ota_class();
@@ -39,8 +39,15 @@ typedef struct {
     void               *httpc;
     int                 keep_alive;
     int                 timeout_ms;
+    char               *p_upstream_header;  /* rendered once per auth token */
+    void               *p_hmac;             /* key schedule of the device secret, made once at init */
 } iotx_http_t, *iotx_http_pt;
 
+/* Max requests in flight on the connection in IOT_HTTP_SendMessages */
+#ifndef IOTX_HTTP_PIPELINE_DEPTH
+#define IOTX_HTTP_PIPELINE_DEPTH    (4)
+#endif
+
 /* IoTx http message definition
  * request_payload and response_payload need to be allocate in order to save memory.
  * topic_path specify the topic url you want to publish message.
@@ -122,6 +129,22 @@ int     IOT_HTTP_DeviceNameAuth(void *handle);
  */
 int     IOT_HTTP_SendMessage(void *handle, iotx_http_message_param_t *msg_param);
 
+/**
+ * @brief   Send several messages to server over one keep-alive connection.
+ *        Up to IOTX_HTTP_PIPELINE_DEPTH requests are written before their responses are read
+ *        (HTTP/1.1 pipelining), the responses are matched to the messages in order.
+ *        Client must authentication with server before send message.
+ *
+ * @param [in] handle: Pointer of contex, specify the HTTP client.
+ * @param [in] msg_params: Array of messages, each one configured as for IOT_HTTP_SendMessage.
+ * @param [in] count: Number of messages in msg_params.
+ *
+ * @retval >=0 : Number of leading messages acknowledged by server, the rest need to be sent again.
+ * @retval  -1 : Invalid parameter or device not authed.
+ * @see IOT_HTTP_SendMessage.
+ */
+int     IOT_HTTP_SendMessages(void *handle, iotx_http_message_param_t *msg_params, int count);
+
 /**
  * @brief   close tcp connection from client to server.
  *
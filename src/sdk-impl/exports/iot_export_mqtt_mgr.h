@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#ifndef _IOT_EXPORT_MQTT_MGR_H_
+#define _IOT_EXPORT_MQTT_MGR_H_
+
+/*
+ * The MQTT client manager runs many MQTT sessions on one event loop created by
+ * HAL_EventLoop_Create(). Sessions share the keep-alive and timeout scheduling
+ * and the write buffer, and are added or removed while the manager runs.
+ *
+ * A manager and its sessions are driven by the one thread which calls
+ * IOT_MQTT_Mgr_Yield(), all the other calls are made from that thread or from
+ * the event handlers, except IOT_MQTT_Mgr_PublishAsync() and
+ * IOT_MQTT_Mgr_GetStats(). Run one manager per thread to use several threads.
+ */
+
+#define IOTX_MQTT_MGR_HIST_NUM      (16)
+
+/* The statistics of the publish queue. A histogram counts value 0 in
+ * bucket 0, values in [2^(i-1), 2^i) in bucket i, and the rest in the last one. */
+typedef struct {
+    uint32_t                    queued;                   /* Messages queued by IOT_MQTT_Mgr_PublishAsync() */
+    uint32_t                    rejected;                 /* Messages refused as the queue was full */
+    uint32_t                    dropped;                  /* Messages discarded as the session was not connected */
+    uint32_t                    writes;                   /* Writes the queued messages were sent with */
+    uint32_t                    enqueue_retries[IOTX_MQTT_MGR_HIST_NUM];  /* Enqueues by retries lost to other producers */
+    uint32_t                    queue_ms[IOTX_MQTT_MGR_HIST_NUM];         /* Messages by milliseconds from queued to sent */
+    uint32_t                    drain_ms[IOTX_MQTT_MGR_HIST_NUM];         /* Passes over the queue by milliseconds taken */
+} iotx_mqtt_mgr_stats_t, *iotx_mqtt_mgr_stats_pt;
+
+/* Called when a message of IOT_MQTT_Mgr_PublishTracked() completes, 'result' is
+ * SUCCESS_RETURN once its PUBACK is received, negative if it is given up. */
+typedef void (*iotx_mqtt_mgr_complete_func_fpt)(void *pcontext, void *session, int packet_id, int result);
+
+/* The structure of MQTT client manager initial parameter */
+typedef struct {
+    uint32_t                    keepalive_interval_ms;    /* Specify MQTT keep-alive interval of every session */
+    uint32_t                    request_timeout_ms;       /* Specify timeout of CONNACK, PINGRESP and writes */
+    uint32_t                    reconnect_interval_ms;    /* Specify delay before reconnecting, 0 never reconnects */
+    uint32_t                    write_buf_size;           /* Specify size of the write-buffer shared by all sessions */
+    uint32_t                    read_buf_size;            /* Specify size of the read-buffer of each session */
+    uint32_t                    publish_queue_size;       /* Specify messages of the publish queue, 0 disables it */
+    uint32_t                    inflight_window;          /* Specify unacknowledged QoS1 messages tracked per session */
+} iotx_mqtt_mgr_param_t, *iotx_mqtt_mgr_param_pt;
+
+/** @defgroup group_api api
+ *  @{
+ */
+
+/** @defgroup group_api_mqtt_mgr mqtt_mgr
+ *  @{
+ */
+
+/**
+ * @brief Construct the MQTT client manager and its event loop.
+ *
+ * @param [in] pInitParams: specify the manager parameter.
+ *
+ * @retval     NULL : Construct failed.
+ * @retval NOT_NULL : The handle of the manager.
+ * @see None.
+ */
+void *IOT_MQTT_Mgr_Construct(iotx_mqtt_mgr_param_t *pInitParams);
+
+
+/**
+ * @brief Disconnect and remove all the sessions, then deconstruct the manager.
+ *
+ * @param [in] phandle: pointer of handle, specify the manager.
+ *
+ * @retval  0 : Deconstruct success.
+ * @retval -1 : Deconstruct failed.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_Destroy(void **phandle);
+
+
+/**
+ * @brief Add a session, connect it over TCP and send CONNECT.
+ *        CONNACK is handled by IOT_MQTT_Mgr_Yield(), check IOT_MQTT_Mgr_CheckStateNormal().
+ *        'pub_key' must be NULL, the keep-alive, timeout and buffer settings come from the manager.
+ *
+ * @param [in] handle: specify the manager.
+ * @param [in] pInitParams: specify the MQTT session parameter, the strings are copied.
+ *
+ * @retval     NULL : Add failed.
+ * @retval NOT_NULL : The handle of the session.
+ * @see None.
+ */
+void *IOT_MQTT_Mgr_Add(void *handle, iotx_mqtt_param_t *pInitParams);
+
+
+/**
+ * @brief Disconnect the session and remove it from the manager, the handle must not be used afterwards.
+ *
+ * @param [in] handle: specify the manager.
+ * @param [in] session: specify the session.
+ *
+ * @retval  0 : Success.
+ * @retval -1 : Failed.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_Remove(void *handle, void *session);
+
+
+/**
+ * @brief Handle the received packets, keep-alive, timeouts and reconnects of all the sessions.
+ *
+ * @param [in] handle: specify the manager.
+ * @param [in] timeout_ms: return after this time, 0 handles what is due without waiting.
+ *
+ * @return status.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_Yield(void *handle, int timeout_ms);
+
+
+/**
+ * @brief check whether the session is connected.
+ *
+ * @param [in] session: specify the session.
+ *
+ * @retval  1 : The session is connected.
+ * @retval  0 : The session is not connected.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_CheckStateNormal(void *session);
+
+
+/**
+ * @brief Subscribe a topic filter on the session. It is kept by the session and
+ *        sent again after reconnecting, or sent after CONNACK if not connected yet.
+ *
+ * @param [in] session: specify the session.
+ * @param [in] topic_filter: specify the topic filter, wildcards are allowed.
+ * @param [in] qos: specify the MQTT Requested QoS, QoS0 or QoS1.
+ * @param [in] topic_handle_func: specify the topic handle callback-function.
+ * @param [in] pcontext: specify context. When call 'topic_handle_func', it will be passed back.
+ *
+ * @retval  > 0 : The packet id of the subscribe message.
+ * @retval    0 : Subscribe is deferred until the session is connected.
+ * @retval  < 0 : Subscribe failed.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_Subscribe(void *session,
+                           const char *topic_filter,
+                           iotx_mqtt_qos_t qos,
+                           iotx_mqtt_event_handle_func_fpt topic_handle_func,
+                           void *pcontext);
+
+
+/**
+ * @brief Unsubscribe a topic filter on the session.
+ *
+ * @param [in] session: specify the session.
+ * @param [in] topic_filter: specify the topic filter.
+ *
+ * @retval  >= 0 : The packet id of the unsubscribe message, 0 if not connected.
+ * @retval   < 0 : Unsubscribe failed.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_Unsubscribe(void *session, const char *topic_filter);
+
+
+/**
+ * @brief Publish message to specific topic on the session.
+ *
+ * @param [in] session: specify the session.
+ * @param [in] topic_name: specify the topic name.
+ * @param [in] topic_msg: specify the topic message, QoS0 or QoS1.
+ *
+ * @retval  > 0 : The packet id of the QoS1 message.
+ * @retval    0 : The QoS0 message is sent.
+ * @retval  < 0 : Publish failed.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_Publish(void *session, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg);
+
+
+/**
+ * @brief Publish a QoS1 message whose PUBACK is tracked in the in-flight window of the session.
+ *        Up to 'inflight_window' messages are sent without waiting for their PUBACK. A message
+ *        not acknowledged is kept, and sent again with DUP set after reconnecting, in the order
+ *        published. A message published while the session reconnects is sent after CONNACK.
+ *        'complete_func' is called once for each message, on PUBACK, or with a negative result
+ *        when the session is removed or disconnected without reconnecting.
+ *
+ * @param [in] session: specify the session.
+ * @param [in] topic_name: specify the topic name.
+ * @param [in] topic_msg: specify the topic message, its QoS is ignored, it is copied.
+ * @param [in] complete_func: specify the completion callback-function, or NULL.
+ * @param [in] pcontext: specify context. When call 'complete_func', it will be passed back.
+ *
+ * @retval  > 0 : The packet id of the message.
+ * @retval  MQTT_PUBLISH_WINDOW_FULL_ERROR : The window is full, try again after a message completes.
+ * @retval  < 0 : Publish failed.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_PublishTracked(void *session,
+                                const char *topic_name,
+                                iotx_mqtt_topic_info_pt topic_msg,
+                                iotx_mqtt_mgr_complete_func_fpt complete_func,
+                                void *pcontext);
+
+
+/**
+ * @brief Queue a message to be published on the session by the thread of IOT_MQTT_Mgr_Yield().
+ *        It may be called from any thread until IOT_MQTT_Mgr_Remove() is called on the session,
+ *        the session is freed only after the calls in progress by then have returned.
+ *        Consecutive messages of a session are sent with one write. A message is
+ *        discarded and counted in 'dropped' if the session is not connected when it is sent.
+ *
+ * @param [in] session: specify the session.
+ * @param [in] topic_name: specify the topic name.
+ * @param [in] topic_msg: specify the topic message, QoS0 or QoS1, it is copied.
+ *
+ * @retval  > 0 : The packet id of the QoS1 message.
+ * @retval    0 : The QoS0 message is queued.
+ * @retval  MQTT_PUBLISH_QUEUE_FULL_ERROR : The queue is full, try again after it drains.
+ * @retval  < 0 : Publish failed.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_PublishAsync(void *session, const char *topic_name, iotx_mqtt_topic_info_pt topic_msg);
+
+
+/**
+ * @brief Get the statistics of the publish queue, it may be called from any thread.
+ *
+ * @param [in] handle: specify the manager.
+ * @param [out] stats: the counters and histograms since the manager is constructed.
+ *
+ * @return status.
+ * @see None.
+ */
+int IOT_MQTT_Mgr_GetStats(void *handle, iotx_mqtt_mgr_stats_t *stats);
+
+/** @} */ /* end of api_mqtt_mgr */
+
+/** @} */ /* end of api */
+
+#endif /* _IOT_EXPORT_MQTT_MGR_H_ */
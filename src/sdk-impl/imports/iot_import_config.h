@@ -17,4 +17,32 @@
     #define CONFIG_COAP_AUTH_TIMEOUT    (10 * 1000)
 #endif
 
+/* the directory of the offline message spool, NULL to lose messages sent while offline */
+#ifndef CONFIG_DM_SPOOL_DIR
+    #define CONFIG_DM_SPOOL_DIR         NULL
+#endif
+
+#ifndef CONFIG_DM_SPOOL_SIZE
+    #define CONFIG_DM_SPOOL_SIZE        (1024 * 1024)
+#endif
+
+#ifndef CONFIG_DM_SPOOL_SEGMENT
+    #define CONFIG_DM_SPOOL_SEGMENT     (64 * 1024)
+#endif
+
+/* bytes of the running image read at a time to apply a delta firmware */
+#ifndef CONFIG_FOTA_DELTA_BUFFER_SIZE
+    #define CONFIG_FOTA_DELTA_BUFFER_SIZE   (1024)
+#endif
+
+/* bytes of firmware handed to HAL_Firmware_Persistence_WriteAsync() at a time, best the flash erase size */
+#ifndef CONFIG_FOTA_WRITE_BLOCK_SIZE
+    #define CONFIG_FOTA_WRITE_BLOCK_SIZE    (4096)
+#endif
+
+/* bytes of a config kept to find the keys changed by the next one, a larger one is applied whole */
+#ifndef CONFIG_COTA_CACHE_MAX_SIZE
+    #define CONFIG_COTA_CACHE_MAX_SIZE      (16 * 1024)
+#endif
+
 #endif  /* __IOT_IMPORT_CONFIG_H__ */
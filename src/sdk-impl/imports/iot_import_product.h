@@ -154,6 +154,37 @@ void HAL_Firmware_Persistence_Start(void);
 int HAL_Firmware_Persistence_Write(_IN_ char *buffer, _IN_ uint32_t length);
 
 
+/**
+ * @brief   开始写入固件, 不等写完即返回, 由HAL_Firmware_Persistence_Wait()等待写完.
+ *          写完前buffer不可改动, 同一时间只有一次写入. 不能异步写入的平台可直接调用HAL_Firmware_Persistence_Write()
+ *
+ * @param   buffer : 写入内容
+ * @param   length : 写入内容长度
+ * @return  成功开始写入返回0, 否则返回-1
+ */
+int HAL_Firmware_Persistence_WriteAsync(_IN_ char *buffer, _IN_ uint32_t length);
+
+
+/**
+ * @brief   等待HAL_Firmware_Persistence_WriteAsync()开始的写入完成
+ *
+ * @param   NULL
+ * @return  写入结果, 同HAL_Firmware_Persistence_Write()
+ */
+int HAL_Firmware_Persistence_Wait(void);
+
+
+/**
+ * @brief   读取当前运行的固件, 差分升级时新固件由它和差分包合成
+ *
+ * @param   offset : 在当前固件中的偏移
+ * @param   buffer : 读出内容
+ * @param   length : 读出内容长度
+ * @return  实际读出长度, 不支持差分升级时返回-1
+ */
+int HAL_Firmware_Persistence_Read(_IN_ uint32_t offset, _OU_ char *buffer, _IN_ uint32_t length);
+
+
 /**
  * @brief   结束固件写入
  *
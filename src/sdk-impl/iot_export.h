@@ -201,6 +201,9 @@ void    IOT_SetupDomain(int domain_type);
 
 #include "exports/iot_export_errno.h"
 #include "exports/iot_export_mqtt.h"
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+#include "exports/iot_export_mqtt_mgr.h"
+#endif /* IOTX_EVENT_LOOP_SUPPORT */
 #include "exports/iot_export_shadow.h"
 #include "exports/iot_export_coap.h"
 #include "exports/iot_export_ota.h"
@@ -261,6 +261,7 @@ int32_t HAL_TCP_Destroy(_IN_ uintptr_t fd);
  * @param [in] buf @n A pointer to a buffer containing the data to be transmitted.
  * @param [in] len @n The length, in bytes, of the data pointed to by the 'buf' parameter.
  * @param [in] timeout_ms @n Specify the timeout value in millisecond. In other words, the API block 'timeout_ms' millisecond maximumly.
+ *                          0 sends once without blocking, as needed by an event loop callback.
  *
  * @retval      < 0 : TCP connection error occur..
  * @retval        0 : No any data be write into the TCP connection in 'timeout_ms' timeout period.
@@ -279,6 +280,7 @@ int32_t HAL_TCP_Write(_IN_ uintptr_t fd, _IN_ const char *buf, _IN_ uint32_t len
  * @param [out] buf @n A pointer to a buffer to receive incoming data.
  * @param [out] len @n The length, in bytes, of the data pointed to by the 'buf' parameter.
  * @param [in] timeout_ms @n Specify the timeout value in millisecond. In other words, the API block 'timeout_ms' millisecond maximumly.
+ *                          0 returns the bytes already received without blocking, as needed by an event loop callback.
  *
  * @retval       -2 : TCP connection error occur.
  * @retval       -1 : TCP connection be closed by remote server.
@@ -289,6 +291,29 @@ int32_t HAL_TCP_Write(_IN_ uintptr_t fd, _IN_ const char *buf, _IN_ uint32_t len
  */
 int32_t HAL_TCP_Read(_IN_ uintptr_t fd, _OU_ char *buf, _OU_ uint32_t len, _IN_ uint32_t timeout_ms);
 
+/* One buffer of a gathered write */
+typedef struct {
+    const char      *buf;
+    uint32_t         len;
+} hal_iovec_t;
+
+/**
+ * @brief Write several buffers into the specific TCP connection as if they were one,
+ *        e.g. a protocol header and its payload, without copying them together.
+ *        Optional, only used when IOTX_WRITEV_SUPPORT is defined.
+ *
+ * @param [in] fd @n A descriptor identifying a connection.
+ * @param [in] iov @n The buffers to be transmitted in order.
+ * @param [in] iovcnt @n The number of entries in 'iov'.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond, as HAL_TCP_Write().
+ *
+ * @retval      < 0 : TCP connection error occur..
+ * @retval        0 : No any data be write into the TCP connection in 'timeout_ms' timeout period.
+ * @retval      > 0 : The total number of bytes be written in 'timeout_ms' timeout period.
+ * @see None.
+ */
+int32_t HAL_TCP_Writev(_IN_ uintptr_t fd, _IN_ const hal_iovec_t *iov, _IN_ uint32_t iovcnt, _IN_ uint32_t timeout_ms);
+
 /**
  * @brief Establish a SSL connection.
  *
@@ -353,6 +378,43 @@ int32_t HAL_SSL_Write(_IN_ uintptr_t handle, _IN_ const char *buf, _IN_ int len,
  */
 int32_t HAL_SSL_Read(_IN_ uintptr_t handle, _OU_ char *buf, _OU_ int len, _IN_ int timeout_ms);
 
+/**
+ * @brief Write several buffers into the specific SSL connection as if they were one.
+ *        They should go out in a single record when they fit in one.
+ *        Optional, only used when IOTX_WRITEV_SUPPORT is defined.
+ *
+ * @param [in] handle @n A descriptor identifying a connection.
+ * @param [in] iov @n The buffers to be transmitted in order.
+ * @param [in] iovcnt @n The number of entries in 'iov'.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond, as HAL_SSL_Write().
+ * @retval      < 0 : SSL connection error occur..
+ * @retval        0 : No any data be write into the SSL connection in 'timeout_ms' timeout period.
+ * @retval      > 0 : The total number of bytes be written in 'timeout_ms' timeout period.
+ * @see None.
+ */
+int32_t HAL_SSL_Writev(_IN_ uintptr_t handle, _IN_ const hal_iovec_t *iov, _IN_ uint32_t iovcnt, _IN_ int timeout_ms);
+
+/**
+ * @brief Read data of the specific SSL connection into a buffer owned by the connection and point '*data' at it,
+ *        the caller passes no buffer of its own. Whether a copy is saved depends on the TLS library: one that
+ *        cannot lend its record buffer still copies the decrypted data once into the connection's buffer.
+ *        Wait like HAL_SSL_Read() until some data is there, then return at most 'len' bytes of it,
+ *        fewer when the current record holds less. The data counts as read and '*data' stays valid
+ *        until the next read or destroy on 'handle'.
+ *        Optional, only used when IOTX_READ_VIEW_SUPPORT is defined. The mbedtls HAL does not implement it.
+ *
+ * @param [in] handle @n A descriptor identifying a connection.
+ * @param [out] data @n Points to the data on success.
+ * @param [in] len @n The maximum length of data to be lent.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond.
+ * @retval       -2 : SSL connection error occur.
+ * @retval       -1 : SSL connection be closed by remote server.
+ * @retval        0 : No any data be received in 'timeout_ms' timeout period.
+ * @retval (0, len] : The length of data pointed to by '*data'.
+ * @see None.
+ */
+int32_t HAL_SSL_ReadView(_IN_ uintptr_t handle, _OU_ const char **data, _IN_ int len, _IN_ int timeout_ms);
+
 /**
  * @brief Establish a UDP connection.
  *
@@ -431,7 +493,236 @@ int HAL_UDP_readTimeout(
             _OU_ unsigned int datalen,
             _IN_ unsigned int timeout_ms);
 
+/* One datagram of a batched UDP read or write */
+typedef struct {
+    unsigned char   *p_data;
+    unsigned int     datalen;   /* read: buffer size on input, bytes received on output */
+} hal_udp_msg_t;
+
+/**
+ * @brief Read several datagrams from the specific UDP connection in one call.
+ *        Waits at most 'timeout_ms' for the first datagram, then returns the ones already queued.
+ *        Optional, only used when COAP_UDP_BATCH_SUPPORT is defined.
+ *
+ * @param [in] p_socket @n A descriptor identifying a UDP connection.
+ * @param [in,out] p_msgs @n Array of receive buffers, 'datalen' is set to the received length.
+ * @param [in] count @n The number of entries in 'p_msgs'.
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond.
+ *
+ * @retval          -4 : UDP connect error occur.
+ * @retval          -3 : The  call  was interrupted by a signal before any data was read.
+ * @retval          -2 : No any data be received in 'timeout_ms' timeout period.
+ * @retval          -1 : Invalid parameter.
+ * @retval  (0, count] : The number of datagrams read.
+ * @see None.
+ */
+int HAL_UDP_readBatch(
+            _IN_ void *p_socket,
+            _OU_ hal_udp_msg_t *p_msgs,
+            _IN_ unsigned int count,
+            _IN_ unsigned int timeout_ms);
+
+/**
+ * @brief Write several datagrams into the specific UDP connection in one call.
+ *        Optional, only used when COAP_UDP_BATCH_SUPPORT is defined.
+ *
+ * @param [in] p_socket @n A descriptor identifying a connection.
+ * @param [in] p_msgs @n Array of datagrams to be transmitted.
+ * @param [in] count @n The number of entries in 'p_msgs'.
+ *
+ * @retval        < 0 : UDP connection error occur.
+ * @retval [0, count] : The number of datagrams sent.
+ * @see None.
+ */
+int HAL_UDP_writeBatch(
+            _IN_ void *p_socket,
+            _IN_ const hal_udp_msg_t *p_msgs,
+            _IN_ unsigned int count);
+
 /** @} */ /* end of platform_network */
+
+/** @defgroup group_platform_event event loop
+ *  Optional readiness notification, only used when IOTX_EVENT_LOOP_SUPPORT is defined.
+ *  One thread can then drive many connections instead of one blocking Yield loop each.
+ *  @{
+ */
+
+#define HAL_EVENT_READ      (0x01)
+#define HAL_EVENT_WRITE     (0x02)
+#define HAL_EVENT_ERROR     (0x04)
+
+/**
+ * @brief Readiness callback, called from HAL_EventLoop_Run().
+ *
+ * @param [in] fd @n The descriptor registered by HAL_EventLoop_Add().
+ * @param [in] events @n HAL_EVENT_READ, HAL_EVENT_WRITE and HAL_EVENT_ERROR ored together.
+ * @param [in] user @n The user data given to HAL_EventLoop_Add().
+ */
+typedef void (*hal_event_cb_t)(uintptr_t fd, int events, void *user);
+
+/**
+ * @brief Create an event loop.
+ *
+ * @return NULL, fail; NOT NULL, handle of the event loop.
+ */
+void *HAL_EventLoop_Create(void);
+
+/**
+ * @brief Destroy an event loop. The registered descriptors are not closed.
+ *
+ * @param [in] loop @n The handle returned by HAL_EventLoop_Create().
+ */
+void HAL_EventLoop_Destroy(_IN_ void *loop);
+
+/**
+ * @brief Watch a descriptor returned by HAL_TCP_Establish() or HAL_UDP_create().
+ *        Notification is level triggered, the callback is called again while the condition holds.
+ *
+ * @param [in] loop @n The handle returned by HAL_EventLoop_Create().
+ * @param [in] fd @n The descriptor to watch, at most once per loop.
+ * @param [in] events @n HAL_EVENT_READ and/or HAL_EVENT_WRITE, errors are always reported.
+ * @param [in] cb @n Called with the ready events.
+ * @param [in] user @n Passed to 'cb'.
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_EventLoop_Add(_IN_ void *loop, _IN_ uintptr_t fd, _IN_ int events, _IN_ hal_event_cb_t cb, _IN_ void *user);
+
+/**
+ * @brief Change the events watched for a registered descriptor.
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_EventLoop_Modify(_IN_ void *loop, _IN_ uintptr_t fd, _IN_ int events);
+
+/**
+ * @brief Stop watching a descriptor, it may be called from a callback.
+ *        It must be called before the descriptor is closed.
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_EventLoop_Remove(_IN_ void *loop, _IN_ uintptr_t fd);
+
+/**
+ * @brief Wait at most 'timeout_ms' for ready descriptors and call their callbacks.
+ *
+ * @param [in] loop @n The handle returned by HAL_EventLoop_Create().
+ * @param [in] timeout_ms @n Specify the timeout value in millisecond.
+ *
+ * @retval  < 0 : Fail.
+ * @retval >= 0 : The number of callbacks called.
+ */
+int HAL_EventLoop_Run(_IN_ void *loop, _IN_ uint32_t timeout_ms);
+
+/**
+ * @brief Make HAL_EventLoop_Run() return early, or the next call if none is waiting.
+ *        Unlike the other event loop functions, it may be called from any thread.
+ *
+ * @param [in] loop @n The handle returned by HAL_EventLoop_Create().
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_EventLoop_Wakeup(_IN_ void *loop);
+
+/** @} */ /* end of group_platform_event */
+
+/** @defgroup group_platform_file file
+ *  Optional file access, only used when IOTX_SPOOL_SUPPORT is defined.
+ *  @{
+ */
+
+/**
+ * @brief Open a file for reading and appending, it is created if it does not exist.
+ *
+ * @param [in] path @n The name of the file.
+ * @param [in] truncate @n Non-zero to empty the file.
+ *
+ * @return NULL, fail; NOT NULL, handle of the file.
+ */
+void *HAL_File_Open(_IN_ const char *path, _IN_ int truncate);
+
+/**
+ * @brief Close a file, a mapping of it stays valid until HAL_File_Unmap().
+ *
+ * @param [in] fp @n The handle returned by HAL_File_Open().
+ */
+void HAL_File_Close(_IN_ void *fp);
+
+/**
+ * @brief Read at 'offset' of the file.
+ *
+ * @retval  < 0 : Fail.
+ * @retval >= 0 : The number of bytes read, less than 'len' at the end of the file.
+ */
+int32_t HAL_File_Read(_IN_ void *fp, _IN_ uint32_t offset, _OU_ char *buf, _IN_ uint32_t len);
+
+/**
+ * @brief Write the buffers in order at the end of the file.
+ *
+ * @retval  < 0 : Fail, part of the data may have been written.
+ * @retval >= 0 : The number of bytes written, all of them.
+ */
+int32_t HAL_File_Append(_IN_ void *fp, _IN_ const hal_iovec_t *iov, _IN_ uint32_t iovcnt);
+
+/**
+ * @brief Get the size of the file.
+ *
+ * @retval  < 0 : Fail.
+ * @retval >= 0 : The size in bytes.
+ */
+int32_t HAL_File_Size(_IN_ void *fp);
+
+/**
+ * @brief Cut the file to 'size' bytes.
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_File_Truncate(_IN_ void *fp, _IN_ uint32_t size);
+
+/**
+ * @brief Write what was appended to the file to the storage.
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_File_Sync(_IN_ void *fp);
+
+/**
+ * @brief Remove a file by name.
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_File_Remove(_IN_ const char *path);
+
+/**
+ * @brief Map the first 'size' bytes of the file to memory, shared with the file.
+ *        The file is extended with zeros if it is shorter. Stores to the mapping
+ *        reach the file even if the process crashes, HAL_File_SyncMap() makes them durable.
+ *
+ * @return NULL, fail; NOT NULL, the address of the mapping.
+ */
+void *HAL_File_Map(_IN_ void *fp, _IN_ uint32_t size);
+
+/**
+ * @brief Write the stores to a mapping of HAL_File_Map() to the storage.
+ *
+ * @retval  < 0 : Fail.
+ * @retval    0 : Success.
+ */
+int HAL_File_SyncMap(_IN_ void *addr, _IN_ uint32_t size);
+
+/**
+ * @brief Remove a mapping of HAL_File_Map().
+ */
+void HAL_File_Unmap(_IN_ void *addr, _IN_ uint32_t size);
+
+/** @} */ /* end of group_platform_file */
 /** @} */ /* end of platform */
 
 #endif  /* SIM7000C_DAM */
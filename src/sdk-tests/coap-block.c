@@ -0,0 +1,295 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+
+#ifdef COAP_COMM_ENABLED
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPSerialize.h"
+#include "CoAPDeserialize.h"
+#include "CoAPBlock.h"
+
+#define BLOCK_BODY_LEN      (1000)
+#define BLOCK_SZX           (2)         /* 64 bytes, 16 blocks */
+#define BLOCK_NUM_MAX       (32)
+
+/* A block-wise server on the loopback that loses and reorders responses as told */
+typedef struct {
+    int             fd;
+    unsigned short  port;
+    volatile int    stop;
+    pthread_t       thread;
+    unsigned char   body[BLOCK_BODY_LEN];
+    int             lose;               /* every transmission of this block is lost ... */
+    int             lose_count;         /* ... the first this many times */
+    int             hold;               /* the response to this block is sent after the next one */
+    int             received[BLOCK_NUM_MAX];
+} _block_server_t;
+
+typedef struct {
+    unsigned char   body[BLOCK_BODY_LEN];
+    unsigned int    len;
+    int             writes;
+    int             in_order;
+    int             code;
+    unsigned char   token;
+} _block_client_t;
+
+static _block_server_t _server;
+
+static int _block_respond(CoAPMessage *request, unsigned char *out)
+{
+    unsigned int  num   = 0;
+    unsigned int  size  = 0;
+    int           len   = 0;
+    unsigned char more  = 0;
+    unsigned char szx   = 0;
+    unsigned int  block = 0;
+    CoAPMessage   response;
+
+    CoAPMessage_init(&response);
+    CoAPMessageType_set(&response, COAP_MESSAGE_TYPE_ACK);
+    CoAPMessageId_set(&response, request->header.msgid);
+    CoAPMessageToken_set(&response, request->token, request->header.tokenlen);
+
+    if (COAP_MSG_CODE_GET == request->header.code) {
+        CoAPBlockOption_get(request, COAP_OPTION_BLOCK2, &num, &more, &szx);
+        block = COAP_BLOCK_SIZE(szx);
+        more = (num * block + block < BLOCK_BODY_LEN) ? 1 : 0;
+        CoAPMessageCode_set(&response, COAP_MSG_CODE_205_CONTENT);
+        CoAPUintOption_add(&response, COAP_OPTION_BLOCK2, COAP_BLOCK_VALUE(num, more, szx));
+        if (COAP_SUCCESS == CoAPUintOption_get(request, COAP_OPTION_SIZE2, &size)) {
+            CoAPUintOption_add(&response, COAP_OPTION_SIZE2, BLOCK_BODY_LEN);
+        }
+        CoAPMessagePayload_set(&response, _server.body + num * block, more ? block : BLOCK_BODY_LEN - num * block);
+    } else {
+        CoAPBlockOption_get(request, COAP_OPTION_BLOCK1, &num, &more, &szx);
+        memcpy(_server.body + num * COAP_BLOCK_SIZE(szx), request->payload, request->payloadlen);
+        CoAPMessageCode_set(&response, more ? COAP_MSG_CODE_231_CONTINUE : COAP_MSG_CODE_204_CHANGED);
+        CoAPUintOption_add(&response, COAP_OPTION_BLOCK1, COAP_BLOCK_VALUE(num, more, szx));
+    }
+
+    if (num < BLOCK_NUM_MAX) {
+        _server.received[num]++;
+    }
+    if ((int)num != _server.lose || _server.received[num] > _server.lose_count) {
+        len = CoAPSerialize_Message(&response, out, COAP_MSG_MAX_PDU_LEN);
+    }
+    CoAPMessage_destory(&response);
+    return len;
+}
+
+static void *_block_server_run(void *arg)
+{
+    int                 len, out_len, held_len = 0;
+    unsigned int        num = 0;
+    unsigned char       more = 0, szx = 0;
+    unsigned char       in[COAP_MSG_MAX_PDU_LEN];
+    unsigned char       out[COAP_MSG_MAX_PDU_LEN], held[COAP_MSG_MAX_PDU_LEN];
+    struct sockaddr_in  peer;
+    socklen_t           peer_len;
+    CoAPMessage         request;
+
+    while (!_server.stop) {
+        peer_len = sizeof(peer);
+        len = recvfrom(_server.fd, in, sizeof(in), 0, (struct sockaddr *)&peer, &peer_len);
+        if (len <= 0) {
+            continue;
+        }
+
+        memset(&request, 0, sizeof(CoAPMessage));
+        if (COAP_SUCCESS != CoAPDeserialize_Message(&request, in, len)
+            || COAP_MSG_CODE_EMPTY_MESSAGE == request.header.code) {
+            continue;
+        }
+        out_len = _block_respond(&request, out);
+        if (0 == out_len) {
+            continue;
+        }
+
+        CoAPBlockOption_get(&request, (COAP_MSG_CODE_GET == request.header.code)
+                            ? COAP_OPTION_BLOCK2 : COAP_OPTION_BLOCK1, &num, &more, &szx);
+        if ((int)num == _server.hold && 0 == held_len) {
+            memcpy(held, out, out_len);
+            held_len = out_len;
+            _server.hold = -1;
+            continue;
+        }
+        sendto(_server.fd, out, out_len, 0, (struct sockaddr *)&peer, peer_len);
+        if (0 < held_len) {
+            sendto(_server.fd, held, held_len, 0, (struct sockaddr *)&peer, peer_len);
+            held_len = 0;
+        }
+    }
+    return NULL;
+}
+
+static int _block_server_start(int lose, int lose_count, int hold)
+{
+    int                 i;
+    struct sockaddr_in  addr;
+    socklen_t           addr_len = sizeof(addr);
+    struct timeval      tv = { 0, 20 * 1000 };
+
+    memset(&_server, 0, sizeof(_block_server_t));
+    for (i = 0; i < BLOCK_BODY_LEN; i++) {
+        _server.body[i] = (unsigned char)(i * 7 + i / 256);
+    }
+    _server.lose = lose;
+    _server.lose_count = lose_count;
+    _server.hold = hold;
+
+    _server.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (_server.fd < 0 || 0 != bind(_server.fd, (struct sockaddr *)&addr, sizeof(addr))
+        || 0 != getsockname(_server.fd, (struct sockaddr *)&addr, &addr_len)) {
+        return -1;
+    }
+    setsockopt(_server.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    _server.port = ntohs(addr.sin_port);
+
+    return pthread_create(&_server.thread, NULL, _block_server_run, NULL);
+}
+
+static void _block_server_stop(void)
+{
+    _server.stop = 1;
+    pthread_join(_server.thread, NULL);
+    close(_server.fd);
+}
+
+static int _block_prepare(void *user, CoAPMessage *message, CoAPBlockPhase phase)
+{
+    _block_client_t *client = (_block_client_t *)user;
+    unsigned char    token[2] = { 0x5a, 0 };
+
+    if (COAP_BLOCK_PREPARE_HEAD == phase) {
+        token[1] = ++client->token;
+        CoAPMessageToken_set(message, token, sizeof(token));
+        CoAPStrOption_add(message, COAP_OPTION_URI_PATH, (unsigned char *)"block", strlen("block"));
+    }
+    return COAP_SUCCESS;
+}
+
+static int _block_read(void *user, unsigned int offset, unsigned char *buf, unsigned int len)
+{
+    _block_client_t *client = (_block_client_t *)user;
+
+    memcpy(buf, client->body + offset, len);
+    return 0;
+}
+
+static int _block_write(void *user, unsigned int offset, unsigned char *data, unsigned int len)
+{
+    _block_client_t *client = (_block_client_t *)user;
+
+    if (offset != client->len || offset + len > BLOCK_BODY_LEN) {
+        client->in_order = 0;
+        return -1;
+    }
+    memcpy(client->body + offset, data, len);
+    client->len += len;
+    client->writes++;
+    return 0;
+}
+
+static void _block_done(void *user, void *p_message)
+{
+    _block_client_t *client = (_block_client_t *)user;
+
+    client->code = ((CoAPMessage *)p_message)->header.code;
+}
+
+/* lose every transmission of block 'lose' the first 'lose_count' times, answer block 'hold' late */
+static int _block_transfer(unsigned short blockopt, int lose, int lose_count, int hold, _block_client_t *client)
+{
+    int                 i, ret;
+    char                url[32];
+    CoAPInitParam       param;
+    CoAPContext        *context = NULL;
+    CoAPBlockTransfer   transfer;
+
+    if (0 != _block_server_start(lose, lose_count, hold)) {
+        return -1;
+    }
+
+    memset(client, 0, sizeof(_block_client_t));
+    client->in_order = 1;
+    if (COAP_OPTION_BLOCK1 == blockopt) {
+        for (i = 0; i < BLOCK_BODY_LEN; i++) {
+            client->body[i] = (unsigned char)(i * 13);
+        }
+    }
+
+    HAL_Snprintf(url, sizeof(url), "coap://127.0.0.1:%d", _server.port);
+    memset(&param, 0, sizeof(CoAPInitParam));
+    param.url = url;
+    param.maxcount = 16;
+    param.waittime = 10;
+    context = CoAPContext_create(&param);
+    if (NULL == context) {
+        _block_server_stop();
+        return -1;
+    }
+
+    CoAPBlockTransfer_init(&transfer, context, blockopt, BLOCK_SZX, 4);
+    transfer.total_len = BLOCK_BODY_LEN;
+    transfer.prepare = _block_prepare;
+    transfer.read = _block_read;
+    transfer.write = _block_write;
+    transfer.handler = _block_done;
+    transfer.user = client;
+
+    ret = CoAPBlockTransfer_run(&transfer);
+    CoAPBlockTransfer_deinit(&transfer);
+    CoAPContext_free(context);
+    _block_server_stop();
+
+    return ret;
+}
+
+/* a block whose retransmissions all go unanswered is sent again, and the window moves on */
+CASE(COAP_BLOCK, download_lost_block) {
+    _block_client_t client;
+
+    ASSERT_EQ(_block_transfer(COAP_OPTION_BLOCK2, 5, 4, 2, &client), COAP_SUCCESS);
+    ASSERT_EQ(client.code, COAP_MSG_CODE_205_CONTENT);
+    ASSERT_EQ(client.in_order, 1);
+    ASSERT_EQ(client.len, BLOCK_BODY_LEN);
+    ASSERT_EQ(memcmp(client.body, _server.body, BLOCK_BODY_LEN), 0);
+    ASSERT_EQ(_server.received[5], 5);
+}
+
+CASE(COAP_BLOCK, upload_lost_block) {
+    _block_client_t client;
+
+    ASSERT_EQ(_block_transfer(COAP_OPTION_BLOCK1, 3, 4, 6, &client), COAP_SUCCESS);
+    ASSERT_EQ(client.code, COAP_MSG_CODE_204_CHANGED);
+    ASSERT_EQ(memcmp(client.body, _server.body, BLOCK_BODY_LEN), 0);
+    ASSERT_EQ(_server.received[3], 5);
+}
+
+/* a block lost for good fails the transfer instead of leaving it waiting */
+CASE(COAP_BLOCK, download_block_gone) {
+    _block_client_t client;
+
+    ASSERT_NE(_block_transfer(COAP_OPTION_BLOCK2, 7, 1000, -1, &client), COAP_SUCCESS);
+    ASSERT_EQ(client.len, 7 * COAP_BLOCK_SIZE(BLOCK_SZX));
+}
+
+SUITE(COAP_BLOCK) = {
+    ADD_CASE(COAP_BLOCK, download_lost_block),
+    ADD_CASE(COAP_BLOCK, upload_lost_block),
+    ADD_CASE(COAP_BLOCK, download_block_gone),
+    ADD_CASE_NULL
+};
+
+#endif  /* #ifdef COAP_COMM_ENABLED */
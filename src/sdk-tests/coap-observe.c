@@ -0,0 +1,201 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+
+#ifdef COAP_COMM_ENABLED
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "CoAPExport.h"
+#include "CoAPMessage.h"
+#include "CoAPSerialize.h"
+#include "CoAPDeserialize.h"
+#include "CoAPObserve.h"
+
+#define OBSERVE_REG_MAX     (8)
+#define OBSERVE_AUTH_LEN    (16)
+
+/* An observable resource on the loopback, every registration is answered with Max-Age 0 */
+typedef struct {
+    int             fd;
+    unsigned short  port;
+    volatile int    stop;
+    pthread_t       thread;
+    int             lose;                   /* the first transmission of this registration is lost */
+    volatile int    count;
+    unsigned short  msgid[OBSERVE_REG_MAX];
+    unsigned char   token[OBSERVE_REG_MAX];
+    char            auth[OBSERVE_REG_MAX][OBSERVE_AUTH_LEN];
+    int             answered;
+} _observe_server_t;
+
+typedef struct {
+    char            auth[OBSERVE_AUTH_LEN];
+    volatile int    notified;
+} _observe_client_t;
+
+static _observe_server_t _obs_server;
+
+static void *_observe_server_run(void *arg)
+{
+    int                 i, len;
+    unsigned char       in[COAP_MSG_MAX_PDU_LEN];
+    unsigned char       out[COAP_MSG_MAX_PDU_LEN];
+    struct sockaddr_in  peer;
+    socklen_t           peer_len;
+    CoAPMessage         request;
+    CoAPMessage         response;
+
+    while (!_obs_server.stop) {
+        peer_len = sizeof(peer);
+        len = recvfrom(_obs_server.fd, in, sizeof(in), 0, (struct sockaddr *)&peer, &peer_len);
+        if (len <= 0) {
+            continue;
+        }
+
+        memset(&request, 0, sizeof(CoAPMessage));
+        if (COAP_SUCCESS != CoAPDeserialize_Message(&request, in, len)
+            || COAP_MSG_CODE_GET != request.header.code || OBSERVE_REG_MAX <= _obs_server.count) {
+            continue;
+        }
+        i = _obs_server.count;
+        _obs_server.msgid[i] = request.header.msgid;
+        _obs_server.token[i] = request.token[request.header.tokenlen - 1];
+        for (len = 0; len < request.optnum; len++) {
+            if (COAP_OPTION_AUTH_TOKEN == request.options[len].num && OBSERVE_AUTH_LEN > request.options[len].len) {
+                memcpy(_obs_server.auth[i], request.options[len].val, request.options[len].len);
+            }
+        }
+        _obs_server.count++;
+        if (i == _obs_server.lose) {
+            continue;
+        }
+
+        CoAPMessage_init(&response);
+        CoAPMessageType_set(&response, COAP_MESSAGE_TYPE_ACK);
+        CoAPMessageCode_set(&response, COAP_MSG_CODE_205_CONTENT);
+        CoAPMessageId_set(&response, request.header.msgid);
+        CoAPMessageToken_set(&response, request.token, request.header.tokenlen);
+        CoAPUintOption_add(&response, COAP_OPTION_OBSERVE, ++_obs_server.answered);
+        CoAPUintOption_add(&response, COAP_OPTION_MAXAGE, 0);
+        CoAPMessagePayload_set(&response, (unsigned char *)"on", 2);
+        len = CoAPSerialize_Message(&response, out, sizeof(out));
+        CoAPMessage_destory(&response);
+        sendto(_obs_server.fd, out, len, 0, (struct sockaddr *)&peer, peer_len);
+    }
+    return NULL;
+}
+
+static int _observe_server_start(int lose)
+{
+    struct sockaddr_in  addr;
+    socklen_t           addr_len = sizeof(addr);
+    struct timeval      tv = { 0, 20 * 1000 };
+
+    memset(&_obs_server, 0, sizeof(_observe_server_t));
+    _obs_server.lose = lose;
+
+    _obs_server.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (_obs_server.fd < 0 || 0 != bind(_obs_server.fd, (struct sockaddr *)&addr, sizeof(addr))
+        || 0 != getsockname(_obs_server.fd, (struct sockaddr *)&addr, &addr_len)) {
+        return -1;
+    }
+    setsockopt(_obs_server.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    _obs_server.port = ntohs(addr.sin_port);
+
+    return pthread_create(&_obs_server.thread, NULL, _observe_server_run, NULL);
+}
+
+static void _observe_server_stop(void)
+{
+    _obs_server.stop = 1;
+    pthread_join(_obs_server.thread, NULL);
+    close(_obs_server.fd);
+}
+
+static int _observe_prepare(void *user, void *message)
+{
+    _observe_client_t *client = (_observe_client_t *)user;
+
+    return CoAPStrOption_add((CoAPMessage *)message, COAP_OPTION_AUTH_TOKEN,
+                             (unsigned char *)client->auth, strlen(client->auth));
+}
+
+static void _observe_notified(void *user, void *p_message)
+{
+    _observe_client_t *client = (_observe_client_t *)user;
+
+    client->notified++;
+}
+
+static void _observe_wait(CoAPContext *context, _observe_client_t *client, int notified, int seconds)
+{
+    uint64_t deadline = HAL_UptimeMs() + seconds * 1000;
+
+    while (client->notified < notified && HAL_UptimeMs() < deadline) {
+        CoAPMessage_cycle(context);
+    }
+}
+
+/* a re-registration is sent reliably, carrying the auth token current at the time */
+CASE(COAP_OBSERVE, reregister_current_auth) {
+    char                url[32];
+    unsigned char       token[4] = { 0x0b, 0x5e, 0x00, 0x01 };
+    CoAPInitParam       param;
+    CoAPContext        *context = NULL;
+    CoAPMessage         message;
+    _observe_client_t   client;
+
+    ASSERT_EQ(_observe_server_start(1), 0);
+
+    HAL_Snprintf(url, sizeof(url), "coap://127.0.0.1:%d", _obs_server.port);
+    memset(&param, 0, sizeof(CoAPInitParam));
+    param.url = url;
+    param.maxcount = 16;
+    param.waittime = 10;
+    context = CoAPContext_create(&param);
+    ASSERT_NE(context, NULL);
+
+    memset(&client, 0, sizeof(_observe_client_t));
+    strcpy(client.auth, "first");
+
+    CoAPMessage_init(&message);
+    CoAPMessageType_set(&message, COAP_MESSAGE_TYPE_CON);
+    CoAPMessageCode_set(&message, COAP_MSG_CODE_GET);
+    CoAPMessageId_set(&message, CoAPMessageId_gen(context));
+    CoAPMessageToken_set(&message, token, sizeof(token));
+    CoAPMessageHandler_set(&message, _observe_notified);
+    CoAPMessageUserData_set(&message, &client);
+    CoAPUintOption_add(&message, COAP_OPTION_OBSERVE, COAP_OBSERVE_REGISTER);
+    CoAPStrOption_add(&message, COAP_OPTION_URI_PATH, (unsigned char *)"obs", strlen("obs"));
+    ASSERT_EQ(CoAPObserve_register(context, &message, _observe_prepare, &client), COAP_SUCCESS);
+    CoAPMessage_destory(&message);
+
+    _observe_wait(context, &client, 1, 2);
+    strcpy(client.auth, "second");
+    _observe_wait(context, &client, 2, 10);
+
+    CoAPContext_free(context);
+    _observe_server_stop();
+
+    ASSERT_EQ(client.notified, 2);
+    ASSERT_EQ(_obs_server.count, 3);
+    ASSERT_STR_EQ(_obs_server.auth[0], "first");
+    ASSERT_STR_EQ(_obs_server.auth[1], "second");
+    ASSERT_NE(_obs_server.msgid[1], _obs_server.msgid[0]);
+    ASSERT_EQ(_obs_server.msgid[2], _obs_server.msgid[1]);
+    ASSERT_EQ(_obs_server.token[2], token[3]);
+}
+
+SUITE(COAP_OBSERVE) = {
+    ADD_CASE(COAP_OBSERVE, reregister_current_auth),
+    ADD_CASE_NULL
+};
+
+#endif  /* #ifdef COAP_COMM_ENABLED */
@@ -11,5 +11,9 @@ ifneq (,$(filter -DMQTT_ID2_AUTH,$(CFLAGS)))
 LDFLAGS     += -ltfs
 endif
 
+ifneq (,$(filter -DSERVICE_OTA_ENABLED,$(CFLAGS)))
+LDFLAGS     += -liot_fota
+endif
+
 LDFLAGS     += -Bstatic -liot_tls
 LDFLAGS     += -liot_sdk
\ No newline at end of file
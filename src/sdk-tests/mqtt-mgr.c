@@ -0,0 +1,520 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "iot_export.h"
+
+#define MGR_BROKER_BUF_LEN  (4096)
+#define MGR_PUB_MAX         (16)
+#define MGR_TOPIC           "/mgr/a"
+
+/* An MQTT broker on the loopback for one client at a time, every SUBSCRIBE
+ * is answered with SUBACK and a QoS1 message on MGR_TOPIC. It holds PUBACKs
+ * and cuts the first connection off as told. */
+typedef struct {
+    int                 fd;
+    int                 conn;               /* the connected client, -1 if none */
+    unsigned short      port;
+    volatile int        stop;
+    volatile int        drop;               /* close the connection as a broken network would */
+    pthread_t           thread;
+    volatile int        connects;
+    volatile int        subscribes;
+    volatile int        pubacks;            /* PUBACKs of the messages sent to the client */
+    int                 hold;               /* PUBACKs are held until 'release' */
+    volatile int        release;
+    int                 cut;                /* the first connection is closed unacknowledged after this many PUBLISHes */
+    volatile int        publishes;
+    unsigned short      pub_ids[MGR_PUB_MAX];
+    unsigned char       pub_dups[MGR_PUB_MAX];
+    unsigned char       pub_conns[MGR_PUB_MAX];
+    int                 held_num;
+    unsigned short      held[MGR_PUB_MAX];
+    int                 len;
+    unsigned char       buf[MGR_BROKER_BUF_LEN];
+} _mgr_broker_t;
+
+typedef struct {
+    int                 delivered[2];       /* messages by the handler of MGR_TOPIC and of "/mgr/+" */
+    int                 disconnects;
+    int                 reconnects;
+    int                 completed;
+    int                 complete_ids[MGR_PUB_MAX];
+    int                 complete_results[MGR_PUB_MAX];
+} _mgr_client_t;
+
+static _mgr_broker_t _broker;
+static _mgr_client_t _mclient;
+
+static void _mgr_broker_send(const unsigned char *packet, int len)
+{
+    send(_broker.conn, packet, len, MSG_NOSIGNAL);
+}
+
+static void _mgr_broker_puback(unsigned short id)
+{
+    unsigned char out[4] = { 0x40, 2, 0, 0 };
+
+    out[2] = id >> 8;
+    out[3] = id & 0xFF;
+    _mgr_broker_send(out, 4);
+}
+
+static void _mgr_broker_publish(unsigned char *p, int hl)
+{
+    int             i = _broker.publishes;
+    int             topic_len = (p[hl] << 8) | p[hl + 1];
+    unsigned short  id = (p[hl + 2 + topic_len] << 8) | p[hl + 3 + topic_len];
+
+    if (MGR_PUB_MAX <= i) {
+        return;
+    }
+    _broker.pub_ids[i] = id;
+    _broker.pub_dups[i] = (p[0] >> 3) & 1;
+    _broker.pub_conns[i] = _broker.connects;
+    _broker.publishes++;
+
+    if (1 == _broker.connects && 0 < _broker.cut) {
+        if (0 == --_broker.cut) {
+            close(_broker.conn);
+            _broker.conn = -1;
+        }
+    } else if (_broker.hold) {
+        _broker.held[_broker.held_num++] = id;
+    } else {
+        _mgr_broker_puback(id);
+    }
+}
+
+static void _mgr_broker_handle(unsigned char *p, int hl, int rem)
+{
+    unsigned char   out[64];
+    int             len;
+
+    switch (p[0] >> 4) {
+        case 1:     /* CONNECT */
+            _broker.connects++;
+            out[0] = 0x20;
+            out[1] = 2;
+            out[2] = 0;
+            out[3] = 0;
+            _mgr_broker_send(out, 4);
+            break;
+        case 8:     /* SUBSCRIBE */
+            _broker.subscribes++;
+            out[0] = 0x90;
+            out[1] = 3;
+            out[2] = p[hl];
+            out[3] = p[hl + 1];
+            out[4] = p[hl + rem - 1];
+            _mgr_broker_send(out, 5);
+
+            len = strlen(MGR_TOPIC);
+            out[0] = 0x32;
+            out[1] = 2 + len + 2 + 2;
+            out[2] = 0;
+            out[3] = len;
+            memcpy(out + 4, MGR_TOPIC, len);
+            out[4 + len] = 0;
+            out[5 + len] = _broker.subscribes;
+            memcpy(out + 6 + len, "on", 2);
+            _mgr_broker_send(out, 8 + len);
+            break;
+        case 3:     /* PUBLISH, QoS1 only */
+            _mgr_broker_publish(p, hl);
+            break;
+        case 4:     /* PUBACK */
+            _broker.pubacks++;
+            break;
+        case 12:    /* PINGREQ */
+            out[0] = 0xD0;
+            out[1] = 0;
+            _mgr_broker_send(out, 2);
+            break;
+        case 14:    /* DISCONNECT */
+            close(_broker.conn);
+            _broker.conn = -1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void *_mgr_broker_run(void *arg)
+{
+    int                 i, ret, pos, hl, rem, mul;
+    struct timeval      tv = { 0, 20 * 1000 };
+
+    while (!_broker.stop) {
+        if (_broker.conn < 0) {
+            _broker.conn = accept(_broker.fd, NULL, NULL);
+            if (0 <= _broker.conn) {
+                setsockopt(_broker.conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+                _broker.len = 0;
+            }
+            continue;
+        }
+        if (_broker.drop) {
+            _broker.drop = 0;
+            close(_broker.conn);
+            _broker.conn = -1;
+            continue;
+        }
+        if (_broker.release) {
+            for (i = 0; i < _broker.held_num; i++) {
+                _mgr_broker_puback(_broker.held[i]);
+            }
+            _broker.held_num = 0;
+            _broker.hold = 0;
+            _broker.release = 0;
+        }
+
+        ret = recv(_broker.conn, _broker.buf + _broker.len, sizeof(_broker.buf) - _broker.len, 0);
+        if (0 == ret) {
+            close(_broker.conn);
+            _broker.conn = -1;
+            continue;
+        } else if (ret < 0) {
+            continue;
+        }
+        _broker.len += ret;
+
+        for (pos = 0; 0 <= _broker.conn; pos += hl + rem) {
+            for (i = 1, rem = 0, mul = 1; i < 5 && pos + i < _broker.len; i++, mul *= 128) {
+                rem += (_broker.buf[pos + i] & 0x7F) * mul;
+                if (0 == (_broker.buf[pos + i] & 0x80)) {
+                    break;
+                }
+            }
+            hl = i + 1;
+            if (pos + i >= _broker.len || _broker.len - pos < hl + rem) {
+                break;
+            }
+            _mgr_broker_handle(_broker.buf + pos, hl, rem);
+        }
+        if (0 <= _broker.conn) {
+            _broker.len -= pos;
+            memmove(_broker.buf, _broker.buf + pos, _broker.len);
+        }
+    }
+    if (0 <= _broker.conn) {
+        close(_broker.conn);
+    }
+    return NULL;
+}
+
+static int _mgr_broker_start(int hold, int cut)
+{
+    struct sockaddr_in  addr;
+    socklen_t           addr_len = sizeof(addr);
+    struct timeval      tv = { 0, 20 * 1000 };
+
+    memset(&_broker, 0, sizeof(_mgr_broker_t));
+    _broker.conn = -1;
+    _broker.hold = hold;
+    _broker.cut = cut;
+
+    _broker.fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (_broker.fd < 0 || 0 != bind(_broker.fd, (struct sockaddr *)&addr, sizeof(addr))
+        || 0 != listen(_broker.fd, 4) || 0 != getsockname(_broker.fd, (struct sockaddr *)&addr, &addr_len)) {
+        return -1;
+    }
+    setsockopt(_broker.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    _broker.port = ntohs(addr.sin_port);
+
+    return pthread_create(&_broker.thread, NULL, _mgr_broker_run, NULL);
+}
+
+static void _mgr_broker_stop(void)
+{
+    _broker.stop = 1;
+    pthread_join(_broker.thread, NULL);
+    close(_broker.fd);
+}
+
+static void _mgr_event(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    _mgr_client_t *client = (_mgr_client_t *)pcontext;
+
+    if (IOTX_MQTT_EVENT_DISCONNECT == msg->event_type) {
+        client->disconnects++;
+    } else if (IOTX_MQTT_EVENT_RECONNECT == msg->event_type) {
+        client->reconnects++;
+    }
+}
+
+static void _mgr_delivered(void *pcontext, void *pclient, iotx_mqtt_event_msg_pt msg)
+{
+    iotx_mqtt_topic_info_pt topic_msg = (iotx_mqtt_topic_info_pt)msg->msg;
+
+    if (IOTX_MQTT_EVENT_PUBLISH_RECVEIVED == msg->event_type && 2 == topic_msg->payload_len
+        && 0 == memcmp(topic_msg->payload, "on", 2)) {
+        (*(int *)pcontext)++;
+    }
+}
+
+static void _mgr_complete(void *pcontext, void *session, int packet_id, int result)
+{
+    _mgr_client_t *client = (_mgr_client_t *)pcontext;
+
+    if (client->completed < MGR_PUB_MAX) {
+        client->complete_ids[client->completed] = packet_id;
+        client->complete_results[client->completed] = result;
+    }
+    client->completed++;
+}
+
+static int _mgr_publish(void *session, int i)
+{
+    char                    payload[8];
+    iotx_mqtt_topic_info_t  topic_msg;
+
+    memset(&topic_msg, 0, sizeof(iotx_mqtt_topic_info_t));
+    topic_msg.payload_len = HAL_Snprintf(payload, sizeof(payload), "%d", i);
+    topic_msg.payload = payload;
+    return IOT_MQTT_Mgr_PublishTracked(session, "/mgr/up", &topic_msg, _mgr_complete, &_mclient);
+}
+
+static void *_mgr_construct(uint32_t inflight_window, uint32_t reconnect_interval_ms)
+{
+    iotx_mqtt_mgr_param_t param;
+
+    memset(&param, 0, sizeof(iotx_mqtt_mgr_param_t));
+    param.request_timeout_ms = 2000;
+    param.reconnect_interval_ms = reconnect_interval_ms;
+    param.inflight_window = inflight_window;
+    return IOT_MQTT_Mgr_Construct(&param);
+}
+
+static void *_mgr_add(void *mgr)
+{
+    iotx_mqtt_param_t param;
+
+    memset(&_mclient, 0, sizeof(_mgr_client_t));
+    memset(&param, 0, sizeof(iotx_mqtt_param_t));
+    param.host = "127.0.0.1";
+    param.port = _broker.port;
+    param.client_id = "mgr-test";
+    param.clean_session = 1;
+    param.handle_event.h_fp = _mgr_event;
+    param.handle_event.pcontext = &_mclient;
+    return IOT_MQTT_Mgr_Add(mgr, &param);
+}
+
+/* yield until '*value' reaches 'expected', or for 'ms' */
+static int _mgr_wait(void *mgr, volatile int *value, int expected, int ms)
+{
+    uint64_t deadline = HAL_UptimeMs() + ms;
+
+    while (*value < expected && HAL_UptimeMs() < deadline) {
+        IOT_MQTT_Mgr_Yield(mgr, 10);
+    }
+    return *value;
+}
+
+static int _mgr_wait_connected(void *mgr, void *session, int ms)
+{
+    uint64_t deadline = HAL_UptimeMs() + ms;
+
+    while (!IOT_MQTT_Mgr_CheckStateNormal(session) && HAL_UptimeMs() < deadline) {
+        IOT_MQTT_Mgr_Yield(mgr, 10);
+    }
+    return IOT_MQTT_Mgr_CheckStateNormal(session);
+}
+
+/* subscriptions made before CONNACK are sent after it, and again after reconnecting */
+CASE(MQTT_MGR, subscribe_reconnect) {
+    void   *mgr, *session;
+    int     pubacks[2], subscribes;
+
+    ASSERT_EQ(_mgr_broker_start(0, 0), 0);
+    mgr = _mgr_construct(0, 50);
+    ASSERT_NE(mgr, NULL);
+    session = _mgr_add(mgr);
+    ASSERT_NE(session, NULL);
+
+    ASSERT_EQ(IOT_MQTT_Mgr_Subscribe(session, MGR_TOPIC, IOTX_MQTT_QOS1, _mgr_delivered, &_mclient.delivered[0]), 0);
+    ASSERT_EQ(IOT_MQTT_Mgr_Subscribe(session, "/mgr/+", IOTX_MQTT_QOS1, _mgr_delivered, &_mclient.delivered[1]), 0);
+    pubacks[0] = _mgr_wait(mgr, &_broker.pubacks, 2, 2000);
+
+    _broker.drop = 1;
+    pubacks[1] = _mgr_wait(mgr, &_broker.pubacks, 4, 2000);
+    subscribes = _broker.subscribes;
+
+    IOT_MQTT_Mgr_Remove(mgr, session);
+    IOT_MQTT_Mgr_Destroy(&mgr);
+    _mgr_broker_stop();
+
+    ASSERT_EQ(pubacks[0], 2);
+    ASSERT_EQ(pubacks[1], 4);
+    ASSERT_EQ(subscribes, 4);
+    ASSERT_EQ(_broker.connects, 2);
+    ASSERT_EQ(_mclient.delivered[0], 4);
+    ASSERT_EQ(_mclient.delivered[1], 4);
+    ASSERT_EQ(_mclient.disconnects, 1);
+    ASSERT_EQ(_mclient.reconnects, 1);
+}
+
+/* no more than the window is unacknowledged, each PUBACK completes its message */
+CASE(MQTT_MGR, inflight_window) {
+    void   *mgr, *session;
+    int     i, connected, ids[5], full, held, completed[2];
+
+    ASSERT_EQ(_mgr_broker_start(1, 0), 0);
+    mgr = _mgr_construct(4, 50);
+    ASSERT_NE(mgr, NULL);
+    session = _mgr_add(mgr);
+    ASSERT_NE(session, NULL);
+    connected = _mgr_wait_connected(mgr, session, 2000);
+
+    for (i = 0; i < 4; i++) {
+        ids[i] = _mgr_publish(session, i);
+    }
+    full = _mgr_publish(session, 4);
+    _mgr_wait(mgr, &_broker.publishes, 4, 2000);
+    IOT_MQTT_Mgr_Yield(mgr, 100);
+    held = _broker.held_num;
+    completed[0] = _mclient.completed;
+
+    _broker.release = 1;
+    _mgr_wait(mgr, &_mclient.completed, 4, 2000);
+    ids[4] = _mgr_publish(session, 4);
+    completed[1] = _mgr_wait(mgr, &_mclient.completed, 5, 2000);
+
+    IOT_MQTT_Mgr_Remove(mgr, session);
+    IOT_MQTT_Mgr_Destroy(&mgr);
+    _mgr_broker_stop();
+
+    ASSERT_EQ(connected, 1);
+    ASSERT_EQ(full, MQTT_PUBLISH_WINDOW_FULL_ERROR);
+    ASSERT_EQ(held, 4);
+    ASSERT_EQ(completed[0], 0);
+    ASSERT_EQ(completed[1], 5);
+    ASSERT_EQ(_broker.publishes, 5);
+    for (i = 0; i < 5; i++) {
+        ASSERT_NE(ids[i], 0);
+        ASSERT_EQ(_broker.pub_ids[i], ids[i]);
+        ASSERT_EQ(_broker.pub_dups[i], 0);
+        ASSERT_EQ(_mclient.complete_ids[i], ids[i]);
+        ASSERT_EQ(_mclient.complete_results[i], SUCCESS_RETURN);
+    }
+}
+
+/* the unacknowledged messages are sent again after reconnecting, in order and with DUP,
+ * followed by the one published while reconnecting */
+CASE(MQTT_MGR, resend_after_reconnect) {
+    void   *mgr, *session;
+    int     i, connected, ids[6], first;
+
+    ASSERT_EQ(_mgr_broker_start(0, 3), 0);
+    mgr = _mgr_construct(8, 200);
+    ASSERT_NE(mgr, NULL);
+    session = _mgr_add(mgr);
+    ASSERT_NE(session, NULL);
+    connected = _mgr_wait_connected(mgr, session, 2000);
+
+    for (i = 0; i < 5; i++) {
+        ids[i] = _mgr_publish(session, i);
+    }
+    _mgr_wait(mgr, &_mclient.disconnects, 1, 2000);
+    first = _broker.publishes;
+    ids[5] = _mgr_publish(session, 5);
+    _mgr_wait(mgr, &_mclient.completed, 6, 2000);
+
+    IOT_MQTT_Mgr_Remove(mgr, session);
+    IOT_MQTT_Mgr_Destroy(&mgr);
+    _mgr_broker_stop();
+
+    ASSERT_EQ(connected, 1);
+    ASSERT_EQ(_mclient.disconnects, 1);
+    ASSERT_EQ(_mclient.reconnects, 1);
+    ASSERT_EQ(first, 3);
+    ASSERT_EQ(_broker.publishes, first + 6);
+    ASSERT_EQ(_mclient.completed, 6);
+    for (i = 0; i < 6; i++) {
+        ASSERT_EQ(_broker.pub_conns[first + i], 2);
+        ASSERT_EQ(_broker.pub_ids[first + i], ids[i]);
+        ASSERT_EQ(_broker.pub_dups[first + i], (i < 5) ? 1 : 0);
+        ASSERT_EQ(_mclient.complete_ids[i], ids[i]);
+        ASSERT_EQ(_mclient.complete_results[i], SUCCESS_RETURN);
+    }
+}
+
+/* messages never acknowledged complete with an error, once, when there is no reconnect */
+CASE(MQTT_MGR, complete_unacked) {
+    void   *mgr, *session;
+    int     i, connected, gone;
+
+    ASSERT_EQ(_mgr_broker_start(1, 0), 0);
+    mgr = _mgr_construct(4, 0);
+    ASSERT_NE(mgr, NULL);
+    session = _mgr_add(mgr);
+    ASSERT_NE(session, NULL);
+    connected = _mgr_wait_connected(mgr, session, 2000);
+
+    _mgr_publish(session, 0);
+    _mgr_publish(session, 1);
+    _mgr_wait(mgr, &_broker.publishes, 2, 2000);
+    _broker.drop = 1;
+    _mgr_wait(mgr, &_mclient.completed, 2, 2000);
+    gone = _mgr_publish(session, 2);
+
+    IOT_MQTT_Mgr_Remove(mgr, session);
+    IOT_MQTT_Mgr_Destroy(&mgr);
+    _mgr_broker_stop();
+
+    ASSERT_EQ(connected, 1);
+    ASSERT_EQ(gone, MQTT_STATE_ERROR);
+    ASSERT_EQ(_mclient.completed, 2);
+    for (i = 0; i < 2; i++) {
+        ASSERT_EQ(_mclient.complete_ids[i], _broker.pub_ids[i]);
+        ASSERT_EQ(_mclient.complete_results[i], MQTT_NETWORK_ERROR);
+    }
+}
+
+/* removing the session completes what is still waiting for PUBACK */
+CASE(MQTT_MGR, complete_on_remove) {
+    void   *mgr, *session;
+    int     connected, completed;
+
+    ASSERT_EQ(_mgr_broker_start(1, 0), 0);
+    mgr = _mgr_construct(4, 50);
+    ASSERT_NE(mgr, NULL);
+    session = _mgr_add(mgr);
+    ASSERT_NE(session, NULL);
+    connected = _mgr_wait_connected(mgr, session, 2000);
+
+    _mgr_publish(session, 0);
+    _mgr_publish(session, 1);
+    _mgr_wait(mgr, &_broker.publishes, 2, 2000);
+    IOT_MQTT_Mgr_Remove(mgr, session);
+    completed = _mclient.completed;
+    IOT_MQTT_Mgr_Destroy(&mgr);
+    _mgr_broker_stop();
+
+    ASSERT_EQ(connected, 1);
+    ASSERT_EQ(completed, 2);
+    ASSERT_EQ(_mclient.complete_results[0], MQTT_STATE_ERROR);
+    ASSERT_EQ(_mclient.complete_results[1], MQTT_STATE_ERROR);
+}
+
+SUITE(MQTT_MGR) = {
+    ADD_CASE(MQTT_MGR, subscribe_reconnect),
+    ADD_CASE(MQTT_MGR, inflight_window),
+    ADD_CASE(MQTT_MGR, resend_after_reconnect),
+    ADD_CASE(MQTT_MGR, complete_unacked),
+    ADD_CASE(MQTT_MGR, complete_on_remove),
+    ADD_CASE_NULL
+};
+
+#endif  /* #ifdef IOTX_EVENT_LOOP_SUPPORT */
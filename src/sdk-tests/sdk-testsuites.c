@@ -25,9 +25,49 @@ static void _setup_hal_suite(void)
     ADD_SUITE(HAL_OS);
 }
 
+static void _setup_utils_suite(void)
+{
+    ADD_SUITE(UTILS_HTTPC);
+    ADD_SUITE(UTILS_DELTA);
+    ADD_SUITE(UTILS_BWRITER);
+    ADD_SUITE(UTILS_JSONDIFF);
+    ADD_SUITE(UTILS_DIGEST);
+    ADD_SUITE(UTILS_TOPIC_TRIE);
+    ADD_SUITE(UTILS_NET);
+#ifdef IOTX_SPOOL_SUPPORT
+    ADD_SUITE(UTILS_SPOOL);
+#endif
+}
+
+static void _setup_coap_suite(void)
+{
+#ifdef COAP_COMM_ENABLED
+    ADD_SUITE(COAP_BLOCK);
+    ADD_SUITE(COAP_OBSERVE);
+#endif
+}
+
+static void _setup_mqtt_suite(void)
+{
+#ifdef IOTX_EVENT_LOOP_SUPPORT
+    ADD_SUITE(MQTT_MGR);
+#endif
+}
+
+static void _setup_service_suite(void)
+{
+#ifdef SERVICE_OTA_ENABLED
+    ADD_SUITE(SERVICE_OTA);
+#endif
+}
+
 int main(int argc, char *argv[])
 {
     _setup_hal_suite();
+    _setup_utils_suite();
+    _setup_coap_suite();
+    _setup_mqtt_suite();
+    _setup_service_suite();
     cut_main(argc, argv);
 
     return 0;
@@ -0,0 +1,119 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+
+#ifdef SERVICE_OTA_ENABLED
+
+#include "iot_export_fota.h"
+#include "utils_delta.h"
+#include "utils_bwriter.h"
+
+#define OTA_BUF_LEN     (256)
+
+/* the buffer pieces of the firmware are fetched into, as by perform_ota_service() */
+static char _ota_buf[OTA_BUF_LEN];
+
+static service_ota_t *_ota_create(void)
+{
+    const fota_t *cls = SERVICE_FOTA_CLASS;
+    service_ota_t *self;
+
+    /* not constructed, that would connect to the cloud */
+    self = service_ota_lite_calloc(1, cls->size);
+    if (NULL != self) {
+        self->_ = cls;
+        self->_data_buf = _ota_buf;
+        self->_data_buf_length = sizeof(_ota_buf);
+        cls->start(self);
+    }
+    return self;
+}
+
+static void _ota_destroy(service_ota_t *self)
+{
+    const fota_t *cls = SERVICE_FOTA_CLASS;
+
+    /* as perform_ota_service() does after a failed end */
+    if (self->_writer) {
+        utils_bwriter_abort(self->_writer);
+    }
+    cls->dtor(self);
+    service_ota_lite_free(self);
+}
+
+static int _ota_write(service_ota_t *self, const char *data, int len)
+{
+    const fota_t *cls = SERVICE_FOTA_CLASS;
+
+    memcpy(_ota_buf, data, len);
+    return cls->write(self, _ota_buf, len);
+}
+
+/* a delta of added bytes only, it does not read the running image */
+static int _ota_delta(char *p, const char *image, uint32_t len)
+{
+    memset(p, 0, UTILS_DELTA_HEADER_LEN);
+    memcpy(p, UTILS_DELTA_MAGIC, UTILS_DELTA_MAGIC_LEN);
+    p[UTILS_DELTA_MAGIC_LEN] = (char)len;
+    p[UTILS_DELTA_HEADER_LEN] = (char)(len << 1 | UTILS_DELTA_OP_ADD);
+    memcpy(p + UTILS_DELTA_HEADER_LEN + 1, image, len);
+    return UTILS_DELTA_HEADER_LEN + 1 + len;
+}
+
+/* the image a delta builds is not taken unless its digest can be checked */
+CASE(SERVICE_OTA, delta_without_digest) {
+    const fota_t *cls = SERVICE_FOTA_CLASS;
+    service_ota_t *self;
+    char delta[OTA_BUF_LEN];
+    int len, ret[2];
+
+    self = _ota_create();
+    ASSERT_NE(self, NULL);
+
+    len = _ota_delta(delta, "new image", 9);
+    ret[0] = _ota_write(self, delta, len);
+    ret[1] = cls->end(self);
+    _ota_destroy(self);
+
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(ret[1], -1);
+}
+
+static int _ota_submit(void *user, char *buf, uint32_t len)
+{
+    return 0;
+}
+
+static int _ota_wait_fail(void *user)
+{
+    return -1;
+}
+
+/* the last block failing to be written fails the end, the image is not taken */
+CASE(SERVICE_OTA, flush_error) {
+    const fota_t *cls = SERVICE_FOTA_CLASS;
+    service_ota_t *self;
+    int ret[2];
+
+    self = _ota_create();
+    ASSERT_NE(self, NULL);
+    ASSERT_NE(self->_writer, NULL);
+    /* blocks go to a storage failing them instead of the firmware HAL */
+    utils_bwriter_init(self->_writer, (char *)self->_writer + sizeof(utils_bwriter_t), CONFIG_FOTA_WRITE_BLOCK_SIZE,
+                       _ota_submit, _ota_wait_fail, NULL);
+
+    /* a whole image shorter than a block, only written by the flush */
+    ret[0] = _ota_write(self, "a whole image", 13);
+    ret[1] = cls->end(self);
+    _ota_destroy(self);
+
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(ret[1], -1);
+}
+
+SUITE(SERVICE_OTA) = {
+    ADD_CASE(SERVICE_OTA, delta_without_digest),
+    ADD_CASE(SERVICE_OTA, flush_error),
+    ADD_CASE_NULL
+};
+
+#endif  /* #ifdef SERVICE_OTA_ENABLED */
@@ -0,0 +1,177 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+#include "utils_bwriter.h"
+
+#define BWRITER_BLOCK       (16)
+#define BWRITER_OUT_MAX     (256)
+#define BWRITER_EVENT_MAX   (32)
+
+/* storage written asynchronously: a block submitted is only read when waited for,
+ * so a block refilled before its write is over shows up in 'out' */
+typedef struct {
+    char        out[BWRITER_OUT_MAX];
+    uint32_t    out_len;
+    char       *pending;
+    uint32_t    pending_len;
+    char        events[BWRITER_EVENT_MAX];  /* 'S'ubmit or 'W'ait, in order */
+    int         event_num;
+    uint32_t    lens[BWRITER_EVENT_MAX];    /* of the blocks submitted */
+    int         submit_num;
+    int         fail_submit;                /* fail the submit or the wait of this block, 1 for the first */
+    int         fail_wait;
+} _bwriter_storage_t;
+
+static _bwriter_storage_t _storage;
+static char _bwriter_buf[2 * BWRITER_BLOCK];
+
+static int _bwriter_submit(void *user, char *buf, uint32_t len)
+{
+    _bwriter_storage_t *s = (_bwriter_storage_t *)user;
+
+    s->events[s->event_num++] = 'S';
+    s->lens[s->submit_num++] = len;
+    if (s->submit_num == s->fail_submit) {
+        return -1;
+    }
+    s->pending = buf;
+    s->pending_len = len;
+    return 0;
+}
+
+static int _bwriter_wait(void *user)
+{
+    _bwriter_storage_t *s = (_bwriter_storage_t *)user;
+
+    s->events[s->event_num++] = 'W';
+    if (s->submit_num == s->fail_wait) {
+        return -1;
+    }
+    memcpy(s->out + s->out_len, s->pending, s->pending_len);
+    s->out_len += s->pending_len;
+    return 0;
+}
+
+static void _bwriter_init(utils_bwriter_t *writer)
+{
+    memset(&_storage, 0, sizeof(_storage));
+    memset(_bwriter_buf, 0, sizeof(_bwriter_buf));
+    utils_bwriter_init(writer, _bwriter_buf, BWRITER_BLOCK, _bwriter_submit, _bwriter_wait, &_storage);
+}
+
+static void _bwriter_pattern(char *data, int len, int from)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        data[i] = (char)(from + i);
+    }
+}
+
+/* a flush writes what is there of a block, and nothing if there is nothing */
+CASE(UTILS_BWRITER, partial_flush) {
+    utils_bwriter_t writer;
+    char data[8], expected[8];
+    int ret[4];
+
+    _bwriter_init(&writer);
+    ret[0] = utils_bwriter_flush(&writer);
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(_storage.event_num, 0);
+
+    _bwriter_pattern(data, 5, 0);
+    ret[0] = utils_bwriter_write(&writer, data, 5);
+    ret[1] = utils_bwriter_flush(&writer);
+    /* the stream goes on after a flush */
+    _bwriter_pattern(data, 3, 5);
+    ret[2] = utils_bwriter_write(&writer, data, 3);
+    ret[3] = utils_bwriter_flush(&writer);
+
+    _bwriter_pattern(expected, 8, 0);
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(ret[1], 0);
+    ASSERT_EQ(ret[2], 0);
+    ASSERT_EQ(ret[3], 0);
+    ASSERT_EQ(_storage.submit_num, 2);
+    ASSERT_EQ(_storage.lens[0], 5);
+    ASSERT_EQ(_storage.lens[1], 3);
+    ASSERT_NSTR_EQ(_storage.events, "SWSW", 4);
+    ASSERT_EQ(_storage.out_len, 8);
+    ASSERT_EQ(memcmp(_storage.out, expected, 8), 0);
+}
+
+/* a write across blocks fills one while the other is written, and waits before refilling it */
+CASE(UTILS_BWRITER, span_blocks) {
+    utils_bwriter_t writer;
+    char data[40];
+    int ret[3];
+
+    _bwriter_init(&writer);
+    _bwriter_pattern(data, sizeof(data), 0);
+    ret[0] = utils_bwriter_write(&writer, data, 10);
+    ret[1] = utils_bwriter_write(&writer, data + 10, 30);
+    ret[2] = utils_bwriter_flush(&writer);
+
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(ret[1], 0);
+    ASSERT_EQ(ret[2], 0);
+    ASSERT_EQ(_storage.submit_num, 3);
+    ASSERT_EQ(_storage.lens[0], BWRITER_BLOCK);
+    ASSERT_EQ(_storage.lens[1], BWRITER_BLOCK);
+    ASSERT_EQ(_storage.lens[2], 40 - 2 * BWRITER_BLOCK);
+    /* the first block is still being written while the second is filled */
+    ASSERT_NSTR_EQ(_storage.events, "SWSWSW", 6);
+    ASSERT_EQ(_storage.event_num, 6);
+    ASSERT_EQ(_storage.out_len, 40);
+    ASSERT_EQ(memcmp(_storage.out, data, 40), 0);
+}
+
+/* a block failing to be written fails the write or the flush after it */
+CASE(UTILS_BWRITER, errors) {
+    utils_bwriter_t writer;
+    char data[40];
+    int ret[4];
+
+    _bwriter_pattern(data, sizeof(data), 0);
+
+    /* the first block fails, the write filling the second one sees it */
+    _bwriter_init(&writer);
+    _storage.fail_wait = 1;
+    ret[0] = utils_bwriter_write(&writer, data, BWRITER_BLOCK);
+    ret[1] = utils_bwriter_write(&writer, data, BWRITER_BLOCK);
+    utils_bwriter_abort(&writer);
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(ret[1], -1);
+
+    /* the last, short block fails */
+    _bwriter_init(&writer);
+    _storage.fail_wait = 2;
+    ret[0] = utils_bwriter_write(&writer, data, BWRITER_BLOCK + 4);
+    ret[1] = utils_bwriter_flush(&writer);
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(ret[1], -1);
+    ASSERT_EQ(_storage.lens[1], 4);
+
+    /* a block not even started */
+    _bwriter_init(&writer);
+    _storage.fail_submit = 1;
+    ret[0] = utils_bwriter_write(&writer, data, 4);
+    ret[1] = utils_bwriter_flush(&writer);
+    /* nothing is left pending, a new stream starts clean */
+    utils_bwriter_abort(&writer);
+    _storage.fail_submit = 0;
+    ret[2] = utils_bwriter_write(&writer, data + 4, 4);
+    ret[3] = utils_bwriter_flush(&writer);
+    ASSERT_EQ(ret[0], 0);
+    ASSERT_EQ(ret[1], -1);
+    ASSERT_EQ(ret[2], 0);
+    ASSERT_EQ(ret[3], 0);
+    ASSERT_EQ(_storage.out_len, 4);
+    ASSERT_EQ(memcmp(_storage.out, data + 4, 4), 0);
+}
+
+SUITE(UTILS_BWRITER) = {
+    ADD_CASE(UTILS_BWRITER, partial_flush),
+    ADD_CASE(UTILS_BWRITER, span_blocks),
+    ADD_CASE(UTILS_BWRITER, errors),
+    ADD_CASE_NULL
+};
@@ -0,0 +1,199 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+#include "utils_delta.h"
+#include "utils_sha256.h"
+
+#define OLD_SIZE    (4096)
+#define NEW_MAX     (8192)
+
+typedef struct {
+    char        old[OLD_SIZE];
+    char        out[NEW_MAX];
+    uint32_t    out_len;
+} delta_test_t;
+
+static delta_test_t t;
+
+static int _read_old(void *user, uint32_t offset, char *buf, uint32_t len)
+{
+    if (offset + len > OLD_SIZE) {
+        return -1;
+    }
+    memcpy(buf, t.old + offset, len);
+    return len;
+}
+
+static int _write_new(void *user, const char *buf, uint32_t len)
+{
+    if (t.out_len + len > NEW_MAX) {
+        return -1;
+    }
+    memcpy(t.out + t.out_len, buf, len);
+    t.out_len += len;
+    return 0;
+}
+
+static int _varint(char *p, uint32_t value)
+{
+    int n = 0;
+
+    while (value >= 0x80) {
+        p[n++] = (char)((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (char)value;
+    return n;
+}
+
+static int _header(char *p, uint32_t new_size)
+{
+    memcpy(p, UTILS_DELTA_MAGIC, UTILS_DELTA_MAGIC_LEN);
+    p += UTILS_DELTA_MAGIC_LEN;
+    p[0] = (char)new_size;
+    p[1] = (char)(new_size >> 8);
+    p[2] = (char)(new_size >> 16);
+    p[3] = (char)(new_size >> 24);
+    p[4] = (char)OLD_SIZE;
+    p[5] = (char)(OLD_SIZE >> 8);
+    p[6] = 0;
+    p[7] = 0;
+    utils_sha256((const unsigned char *)t.old, OLD_SIZE, (unsigned char *)p + 8);
+    return UTILS_DELTA_HEADER_LEN;
+}
+
+/* feed data in pieces of random length, as the network would */
+static int _apply_split(const char *data, int len, int max_piece)
+{
+    utils_delta_t delta;
+    char buf[64];
+    int fed = 0, n;
+
+    t.out_len = 0;
+    utils_delta_init(&delta, buf, sizeof(buf), _read_old, _write_new, NULL);
+    while (fed < len) {
+        n = 1 + rand() % max_piece;
+        n = (n > len - fed) ? len - fed : n;
+        if (0 != utils_delta_feed(&delta, data + fed, n)) {
+            return -1;
+        }
+        fed += n;
+    }
+    return utils_delta_finish(&delta);
+}
+
+CASE(UTILS_DELTA, apply) {
+    char delta[256], expected[NEW_MAX];
+    int i, len, size = 0;
+
+    srand(3);
+    for (i = 0; i < OLD_SIZE; i++) {
+        t.old[i] = (char)rand();
+    }
+
+    /* add 5 bytes, copy 1000 bytes at 100, 200 bytes at 50, add 3 bytes */
+    memcpy(expected, "hello", 5);
+    memcpy(expected + 5, t.old + 100, 1000);
+    memcpy(expected + 1005, t.old + 50, 200);
+    memcpy(expected + 1205, "end", 3);
+    size = 1208;
+
+    len = _header(delta, size);
+    len += _varint(delta + len, 5 << 1 | UTILS_DELTA_OP_ADD);
+    memcpy(delta + len, "hello", 5);
+    len += 5;
+    len += _varint(delta + len, 1000 << 1 | UTILS_DELTA_OP_COPY);
+    len += _varint(delta + len, 100 << 1);
+    len += _varint(delta + len, 200 << 1 | UTILS_DELTA_OP_COPY);
+    len += _varint(delta + len, ((1100 - 50) << 1) - 1);
+    len += _varint(delta + len, 3 << 1 | UTILS_DELTA_OP_ADD);
+    memcpy(delta + len, "end", 3);
+    len += 3;
+
+    for (i = 0; i < 1000; i++) {
+        ASSERT_EQ(_apply_split(delta, len, 1 + i % 32), 0);
+        ASSERT_EQ(t.out_len, size);
+        ASSERT_EQ(memcmp(t.out, expected, size), 0);
+    }
+
+    /* anything past the new image is refused */
+    delta[len] = 0;
+    ASSERT_EQ(_apply_split(delta, len + 1, len + 1), -1);
+    /* and so is stopping short of it */
+    ASSERT_EQ(_apply_split(delta, len - 1, len), -1);
+}
+
+CASE(UTILS_DELTA, whole_image) {
+    const char *image = "IOTX not a delta, written as it is";
+    int len = strlen(image);
+
+    ASSERT_EQ(_apply_split(image, len, 4), 0);
+    ASSERT_EQ(t.out_len, len);
+    ASSERT_NSTR_EQ(t.out, image, len);
+
+    ASSERT_EQ(_apply_split("IOTX", 4, 4), 0);
+    ASSERT_EQ(t.out_len, 4);
+}
+
+CASE(UTILS_DELTA, invalid) {
+    char delta[64];
+    int len;
+
+    /* copy past the end of the old image */
+    len = _header(delta, 100);
+    len += _varint(delta + len, 100 << 1 | UTILS_DELTA_OP_COPY);
+    len += _varint(delta + len, (OLD_SIZE - 50) << 1);
+    ASSERT_EQ(_apply_split(delta, len, len), -1);
+
+    /* copy before the start of the old image */
+    len = _header(delta, 100);
+    len += _varint(delta + len, 100 << 1 | UTILS_DELTA_OP_COPY);
+    len += _varint(delta + len, 1);
+    ASSERT_EQ(_apply_split(delta, len, len), -1);
+
+    /* more bytes than the new image has */
+    len = _header(delta, 100);
+    len += _varint(delta + len, 101 << 1 | UTILS_DELTA_OP_ADD);
+    ASSERT_EQ(_apply_split(delta, len, len), -1);
+
+    /* a varint longer than 32 bits */
+    len = _header(delta, 100);
+    memcpy(delta + len, "\xff\xff\xff\xff\x7f", 5);
+    len += 5;
+    ASSERT_EQ(_apply_split(delta, len, len), -1);
+
+    /* a header cut short */
+    ASSERT_EQ(_apply_split(UTILS_DELTA_MAGIC "\x01", UTILS_DELTA_MAGIC_LEN + 1, 4), -1);
+}
+
+/* a delta made against another image stops at its first copy */
+CASE(UTILS_DELTA, other_image) {
+    char delta[64];
+    int len, ret[2];
+    uint32_t out_len;
+
+    len = _header(delta, 105);
+    len += _varint(delta + len, 5 << 1 | UTILS_DELTA_OP_ADD);
+    memcpy(delta + len, "hello", 5);
+    len += 5;
+    len += _varint(delta + len, 100 << 1 | UTILS_DELTA_OP_COPY);
+    len += _varint(delta + len, 0);
+
+    t.old[OLD_SIZE - 1] ^= 1;
+    ret[0] = _apply_split(delta, len, len);
+    out_len = t.out_len;
+    t.old[OLD_SIZE - 1] ^= 1;
+    ret[1] = _apply_split(delta, len, len);
+
+    ASSERT_EQ(ret[0], -1);
+    ASSERT_EQ(out_len, 5);
+    ASSERT_EQ(ret[1], 0);
+    ASSERT_EQ(t.out_len, 105);
+}
+
+SUITE(UTILS_DELTA) = {
+    ADD_CASE(UTILS_DELTA, apply),
+    ADD_CASE(UTILS_DELTA, whole_image),
+    ADD_CASE(UTILS_DELTA, invalid),
+    ADD_CASE(UTILS_DELTA, other_image),
+    ADD_CASE_NULL
+};
@@ -0,0 +1,172 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+#include "utils_md5.h"
+#include "utils_sha1.h"
+#include "utils_sha256.h"
+#include "utils_hmac.h"
+#include "utils_digest_accel.h"
+
+#define DIGEST_DATA_LEN     (4200)
+#define DIGEST_BATCH_NUM    (20)
+
+static unsigned char digest_data[DIGEST_DATA_LEN];
+
+static void _digest_data_init(void)
+{
+    int i;
+
+    srand(7);
+    for (i = 0; i < DIGEST_DATA_LEN; i++) {
+        digest_data[i] = (unsigned char)rand();
+    }
+}
+
+/* hash digest_data[0, len) in pieces of random length */
+static void _sha1_split(size_t len, unsigned char out[20])
+{
+    iot_sha1_context ctx;
+    size_t fed = 0, n;
+
+    utils_sha1_init(&ctx);
+    utils_sha1_starts(&ctx);
+    while (fed < len) {
+        n = 1 + rand() % 150;
+        n = (n > len - fed) ? len - fed : n;
+        utils_sha1_update(&ctx, digest_data + fed, n);
+        fed += n;
+    }
+    utils_sha1_finish(&ctx, out);
+}
+
+static void _sha256_split(size_t len, unsigned char out[32])
+{
+    iot_sha256_context ctx;
+    size_t fed = 0, n;
+
+    utils_sha256_init(&ctx);
+    utils_sha256_starts(&ctx);
+    while (fed < len) {
+        n = 1 + rand() % 150;
+        n = (n > len - fed) ? len - fed : n;
+        utils_sha256_update(&ctx, digest_data + fed, n);
+        fed += n;
+    }
+    utils_sha256_finish(&ctx, out);
+}
+
+CASE(UTILS_DIGEST, vectors) {
+    unsigned char out[32];
+    int accel = utils_digest_accel_get();
+
+    utils_sha1((const unsigned char *)"abc", 3, out);
+    ASSERT_EQ(memcmp(out, "\xa9\x99\x3e\x36\x47\x06\x81\x6a\xba\x3e\x25\x71\x78\x50\xc2\x6c\x9c\xd0\xd8\x9d", 20), 0);
+    utils_sha256((const unsigned char *)"abc", 3, out);
+    ASSERT_EQ(memcmp(out, "\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23"
+                     "\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad", 32), 0);
+
+    utils_digest_accel_set(0);
+    ASSERT_EQ(utils_digest_accel_get(), 0);
+    ASSERT_EQ(utils_digest_accel_set(~0), accel);
+}
+
+/* the SHA instructions give what plain C gives, at every length and split */
+CASE(UTILS_DIGEST, accel) {
+    unsigned char c[32], hw[32];
+    size_t len;
+
+    _digest_data_init();
+    for (len = 0; len < DIGEST_DATA_LEN; len += (len < 300) ? 1 : 97) {
+        utils_digest_accel_set(0);
+        utils_sha1(digest_data, len, c);
+        utils_digest_accel_set(~0);
+        _sha1_split(len, hw);
+        ASSERT_EQ(memcmp(c, hw, 20), 0);
+
+        utils_digest_accel_set(0);
+        utils_sha256(digest_data, len, c);
+        utils_digest_accel_set(~0);
+        _sha256_split(len, hw);
+        ASSERT_EQ(memcmp(c, hw, 32), 0);
+    }
+}
+
+/* a batch of messages of mixed lengths, so lanes finish and refill at different times */
+CASE(UTILS_DIGEST, batch) {
+    const unsigned char *input[DIGEST_BATCH_NUM];
+    size_t ilen[DIGEST_BATCH_NUM];
+    unsigned char out[DIGEST_BATCH_NUM][32], c[32];
+    unsigned char *output[DIGEST_BATCH_NUM];
+    int i, num, round;
+
+    _digest_data_init();
+    for (round = 0; round < 100; round++) {
+        /* SHA-256 takes the SHA instructions over AVX2 where there are both, mask them off half the time */
+        utils_digest_accel_set((round & 1) ? UTILS_DIGEST_ACCEL_AVX2 : ~0);
+
+        num = 1 + round / 2 % DIGEST_BATCH_NUM;
+        for (i = 0; i < num; i++) {
+            ilen[i] = (round < 20) ? (size_t)(round / 2 * 7 + i) : (size_t)(rand() % 600);
+            input[i] = digest_data + rand() % (DIGEST_DATA_LEN - 600);
+            output[i] = out[i];
+        }
+
+        utils_md5_batch(input, ilen, output, num);
+        for (i = 0; i < num; i++) {
+            utils_md5(input[i], ilen[i], c);
+            ASSERT_EQ(memcmp(c, out[i], 16), 0);
+        }
+
+        utils_sha1_batch(input, ilen, output, num);
+        for (i = 0; i < num; i++) {
+            utils_sha1(input[i], ilen[i], c);
+            ASSERT_EQ(memcmp(c, out[i], 20), 0);
+        }
+
+        utils_sha256_batch(input, ilen, output, num);
+        for (i = 0; i < num; i++) {
+            utils_sha256(input[i], ilen[i], c);
+            ASSERT_EQ(memcmp(c, out[i], 32), 0);
+        }
+    }
+    utils_digest_accel_set(~0);
+}
+
+CASE(UTILS_DIGEST, hmac) {
+    const char *msg = "what do ya want for nothing?";
+    char digest[41];
+    utils_hmac_t hmac;
+    int i;
+
+    /* RFC 2202 test case 2, signing more than once with the same key schedule */
+    memset(digest, 0, sizeof(digest));
+    ASSERT_EQ(utils_hmac_init(&hmac, UTILS_HMAC_MD5, "Jefe", 4), 0);
+    for (i = 0; i < 3; i++) {
+        utils_hmac_sign(&hmac, msg, strlen(msg), digest);
+        ASSERT_STR_EQ(digest, "750c783e6ab0b503eaa86e310a5db738");
+    }
+    utils_hmac_free(&hmac);
+
+    ASSERT_EQ(utils_hmac_init(&hmac, UTILS_HMAC_SHA1, "Jefe", 4), 0);
+    for (i = 0; i < 3; i++) {
+        utils_hmac_sign(&hmac, msg, strlen(msg), digest);
+        ASSERT_STR_EQ(digest, "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79");
+    }
+    utils_hmac_free(&hmac);
+
+    memset(digest, 0, sizeof(digest));
+    utils_hmac_md5(msg, strlen(msg), digest, "Jefe", 4);
+    ASSERT_STR_EQ(digest, "750c783e6ab0b503eaa86e310a5db738");
+    utils_hmac_sha1(msg, strlen(msg), digest, "Jefe", 4);
+    ASSERT_STR_EQ(digest, "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79");
+
+    /* keys longer than the block are refused */
+    ASSERT_EQ(utils_hmac_init(&hmac, UTILS_HMAC_SHA1, (const char *)digest_data, 65), -1);
+}
+
+SUITE(UTILS_DIGEST) = {
+    ADD_CASE(UTILS_DIGEST, vectors),
+    ADD_CASE(UTILS_DIGEST, accel),
+    ADD_CASE(UTILS_DIGEST, batch),
+    ADD_CASE(UTILS_DIGEST, hmac),
+    ADD_CASE_NULL
+};
@@ -0,0 +1,266 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+#include "utils_httpc.h"
+
+#define RESPONSE_OK \
+    "HTTP/1.1 200 OK\r\n" \
+    "Server: test\r\n" \
+    "content-length:  42 \r\n" \
+    "Connection: close\r\n" \
+    "X-Empty:\r\n" \
+    "\r\n" \
+    "body"
+
+#define RESPONSE_CHUNKED \
+    "HTTP/1.0 206\r\n" \
+    "Content-Length: 10\r\n" \
+    "Transfer-Encoding: gzip, Chunked\r\n" \
+    "\r\n"
+
+static const char *bad_responses[] = {
+    "HTTP/2.0 200 OK\r\n\r\n",
+    "HTTP/1.1 20 OK\r\n\r\n",
+    "HTTP/1.1 200 OK\n\r\n",
+    "HTTP/1.1 200 OK\r\nBad Name: x\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 1x\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 1\r\nContent-Length: 1\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 99999999999\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 1 2\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nX: a\nb\r\n\r\n",
+    NULL
+};
+
+/* feed buf to the parser in pieces of random length, as the network would */
+static int _parse_split(httpclient_parser_t *parser, const char *buf, int len)
+{
+    int ret = 0;
+    int fed = 0;
+
+    httpclient_parser_init(parser);
+    while (fed < len) {
+        fed += 1 + rand() % 7;
+        fed = fed > len ? len : fed;
+        ret = httpclient_parser_execute(parser, buf, fed);
+        if (0 != ret) {
+            break;
+        }
+    }
+    return ret;
+}
+
+CASE(UTILS_HTTPC, parser_fields) {
+    httpclient_parser_t parser;
+    const char *value = NULL;
+    int len;
+
+    httpclient_parser_init(&parser);
+    len = httpclient_parser_execute(&parser, RESPONSE_OK, strlen(RESPONSE_OK));
+    ASSERT_EQ(len, strlen(RESPONSE_OK) - 4);
+    ASSERT_EQ(parser.status_code, 200);
+    ASSERT_EQ(parser.content_length, 42);
+    ASSERT_EQ(parser.conn_close, 1);
+    ASSERT_EQ(parser.is_chunked, 0);
+    ASSERT_EQ(parser.header_num, 4);
+
+    ASSERT_EQ(httpclient_parser_find(&parser, RESPONSE_OK, "SERVER", &value), 4);
+    ASSERT_NSTR_EQ(value, "test", 4);
+    ASSERT_EQ(httpclient_parser_find(&parser, RESPONSE_OK, "Content-Length", &value), 2);
+    ASSERT_NSTR_EQ(value, "42", 2);
+    ASSERT_EQ(httpclient_parser_find(&parser, RESPONSE_OK, "x-empty", &value), 0);
+    ASSERT_EQ(httpclient_parser_find(&parser, RESPONSE_OK, "Date", &value), -1);
+
+    httpclient_parser_init(&parser);
+    len = httpclient_parser_execute(&parser, RESPONSE_CHUNKED, strlen(RESPONSE_CHUNKED));
+    ASSERT_EQ(len, strlen(RESPONSE_CHUNKED));
+    ASSERT_EQ(parser.status_code, 206);
+    ASSERT_EQ(parser.is_chunked, 1);
+}
+
+CASE(UTILS_HTTPC, parser_invalid) {
+    int i;
+    httpclient_parser_t parser;
+
+    for (i = 0; NULL != bad_responses[i]; i++) {
+        httpclient_parser_init(&parser);
+        ASSERT_LT(httpclient_parser_execute(&parser, bad_responses[i], strlen(bad_responses[i])), 0);
+    }
+}
+
+CASE(UTILS_HTTPC, parser_split) {
+    int i, len;
+    httpclient_parser_t whole, split;
+
+    srand(1);
+    len = strlen(RESPONSE_OK);
+    httpclient_parser_init(&whole);
+    ASSERT_GT(httpclient_parser_execute(&whole, RESPONSE_OK, len), 0);
+
+    for (i = 0; i < 1000; i++) {
+        ASSERT_EQ(_parse_split(&split, RESPONSE_OK, len), whole.offset);
+        ASSERT_EQ(memcmp(&whole, &split, sizeof(httpclient_parser_t)), 0);
+    }
+}
+
+/* random mutations must give the same result whether fed at once or in pieces */
+CASE(UTILS_HTTPC, parser_fuzz) {
+    int i, j, len, ret;
+    char buf[sizeof(RESPONSE_OK)];
+    const char alphabet[] = "\r\n :\t0a-H";
+    httpclient_parser_t whole, split;
+
+    srand(2);
+    for (i = 0; i < 20000; i++) {
+        len = strlen(RESPONSE_OK);
+        memcpy(buf, RESPONSE_OK, len);
+        for (j = rand() % 4; j >= 0; j--) {
+            buf[rand() % len] = (rand() & 1) ? alphabet[rand() % (sizeof(alphabet) - 1)] : (char)rand();
+        }
+        len = 1 + rand() % len;
+
+        httpclient_parser_init(&whole);
+        ret = httpclient_parser_execute(&whole, buf, len);
+        ASSERT_IN(-1, ret, len);
+        ASSERT_EQ(_parse_split(&split, buf, len), ret);
+        if (ret > 0) {
+            ASSERT_EQ(memcmp(&whole, &split, sizeof(httpclient_parser_t)), 0);
+        }
+    }
+}
+
+/* a response served by the network in pieces of at most 'piece' bytes, then nothing but timeouts */
+typedef struct {
+    const char *data;
+    int         len;
+    int         piece;
+    char        body[64];
+    int         body_len;
+    int         body_calls;
+    int         abort;
+} _stream_t;
+
+static _stream_t _stream;
+
+static int _stream_read(utils_network_pt net, char *buf, uint32_t len, uint32_t timeout_ms)
+{
+    int n = 1 + rand() % _stream.piece;
+
+    n = n > (int)len ? (int)len : n;
+    n = n > _stream.len ? _stream.len : n;
+    memcpy(buf, _stream.data, n);
+    _stream.data += n;
+    _stream.len -= n;
+    return n;
+}
+
+static int _stream_body(void *user, const char *data, int len)
+{
+    _stream_t *stream = (_stream_t *)user;
+
+    stream->body_calls++;
+    if (stream->abort) {
+        return -1;
+    }
+    if (stream->body_len + len > (int)sizeof(stream->body)) {
+        return -1;
+    }
+    memcpy(stream->body + stream->body_len, data, len);
+    stream->body_len += len;
+    return 0;
+}
+
+static int _stream_response(const char *response, int piece, int abort, httpclient_data_t *client_data)
+{
+    int ret;
+    httpclient_t client;
+
+    memset(&client, 0, sizeof(httpclient_t));
+    client.net.handle = 1;
+    client.net.read = _stream_read;
+
+    memset(&_stream, 0, sizeof(_stream_t));
+    _stream.data = response;
+    _stream.len = strlen(response);
+    _stream.piece = piece;
+    _stream.abort = abort;
+
+    memset(client_data, 0, sizeof(httpclient_data_t));
+    client_data->body_cb = _stream_body;
+    client_data->body_user = &_stream;
+
+    ret = httpclient_recv_response(&client, 100, client_data);
+    if (NULL != client.carry_buf) {
+        HAL_Free(client.carry_buf);
+    }
+    return ret;
+}
+
+/* no body must not wait for one */
+CASE(UTILS_HTTPC, stream_empty) {
+    int i;
+    httpclient_data_t client_data;
+    const char *responses[] = {
+        "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n",
+        "HTTP/1.1 204 No Content\r\n\r\n",
+        "HTTP/1.1 304 Not Modified\r\nETag: \"1\"\r\n\r\n",
+    };
+
+    for (i = 0; i < (int)(sizeof(responses) / sizeof(responses[0])); i++) {
+        ASSERT_EQ(_stream_response(responses[i], 64, 0, &client_data), 0);
+        ASSERT_EQ(client_data.is_more, 0);
+        ASSERT_EQ(client_data.response_content_len, 0);
+        ASSERT_EQ(_stream.body_calls, 0);
+    }
+}
+
+/* chunk-size lines, extensions, CRLFs and the trailer split anywhere across reads */
+CASE(UTILS_HTTPC, stream_chunked_split) {
+    int i;
+    httpclient_data_t client_data;
+    const char *response =
+        "HTTP/1.1 200 OK\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "\r\n"
+        "4\r\nWiki\r\n"
+        "5;name=value\r\npedia\r\n"
+        "E\r\n in\r\n\r\nchunks.\r\n"
+        "0\r\n"
+        "X-Trailer: 1\r\n"
+        "\r\n";
+
+    srand(3);
+    for (i = 0; i < 200; i++) {
+        ASSERT_EQ(_stream_response(response, 1 + i % 4, 0, &client_data), 0);
+        ASSERT_EQ(client_data.is_more, 0);
+        ASSERT_EQ(client_data.response_content_len, 23);
+        ASSERT_EQ(client_data.response_received_len, 23);
+        ASSERT_EQ(_stream.body_len, 23);
+        ASSERT_NSTR_EQ(_stream.body, "Wikipedia in\r\n\r\nchunks.", 23);
+        ASSERT_EQ(_stream.len, 0);
+    }
+}
+
+/* a receiver refusing the body ends the response */
+CASE(UTILS_HTTPC, stream_abort) {
+    httpclient_data_t client_data;
+    const char *response =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: 10\r\n"
+        "\r\n"
+        "0123456789";
+
+    srand(4);
+    ASSERT_EQ(_stream_response(response, 4, 1, &client_data), ERROR_HTTP);
+    ASSERT_EQ(_stream.body_calls, 1);
+    ASSERT_EQ(client_data.is_more, 1);
+}
+
+SUITE(UTILS_HTTPC) = {
+    ADD_CASE(UTILS_HTTPC, parser_fields),
+    ADD_CASE(UTILS_HTTPC, parser_invalid),
+    ADD_CASE(UTILS_HTTPC, parser_split),
+    ADD_CASE(UTILS_HTTPC, parser_fuzz),
+    ADD_CASE(UTILS_HTTPC, stream_empty),
+    ADD_CASE(UTILS_HTTPC, stream_chunked_split),
+    ADD_CASE(UTILS_HTTPC, stream_abort),
+    ADD_CASE_NULL
+};
@@ -0,0 +1,56 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+#include "utils_jsondiff.h"
+
+static char diff_keys[256];
+static int diff_removed;
+
+static void _diff_cb(void *user, const char *key, int key_len, const char *value, int value_len)
+{
+    strncat(diff_keys, key, key_len);
+    strcat(diff_keys, ",");
+    if (NULL == value) {
+        diff_removed++;
+    }
+}
+
+static int _diff(const char *old_json, const char *new_json)
+{
+    diff_keys[0] = '\0';
+    diff_removed = 0;
+    return utils_json_diff(old_json, old_json ? strlen(old_json) : 0, new_json, strlen(new_json), _diff_cb, NULL);
+}
+
+CASE(UTILS_JSONDIFF, changed) {
+    ASSERT_EQ(_diff("{\"a\":1,\"b\":\"x\",\"c\":{\"d\":2}}", "{\"c\":{\"d\":2},\"b\":\"y\",\"a\":1}"), 1);
+    ASSERT_STR_EQ(diff_keys, "b,");
+
+    /* same text, other type */
+    ASSERT_EQ(_diff("{\"a\":\"1\"}", "{\"a\":1}"), 1);
+    ASSERT_STR_EQ(diff_keys, "a,");
+
+    ASSERT_EQ(_diff("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}"), 0);
+}
+
+CASE(UTILS_JSONDIFF, added_removed) {
+    ASSERT_EQ(_diff("{\"a\":1,\"b\":2}", "{\"b\":2,\"c\":3}"), 2);
+    ASSERT_STR_EQ(diff_keys, "c,a,");
+    ASSERT_EQ(diff_removed, 1);
+
+    ASSERT_EQ(_diff(NULL, "{\"a\":1,\"b\":2}"), 2);
+    ASSERT_EQ(diff_removed, 0);
+
+    ASSERT_EQ(_diff("not json", "{\"a\":1}"), 1);
+}
+
+CASE(UTILS_JSONDIFF, not_object) {
+    ASSERT_EQ(_diff("{\"a\":1}", "a=1"), -1);
+    ASSERT_EQ(_diff("{\"a\":1}", "[1,2]"), -1);
+}
+
+SUITE(UTILS_JSONDIFF) = {
+    ADD_CASE(UTILS_JSONDIFF, changed),
+    ADD_CASE(UTILS_JSONDIFF, added_removed),
+    ADD_CASE(UTILS_JSONDIFF, not_object),
+    ADD_CASE_NULL
+};
@@ -0,0 +1,247 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "utils_net.h"
+
+#define NET_TIMEOUT_MS      (1000)
+#define NET_CHUNK_MAX       (4)
+#define NET_PACKET_MAX      (512)
+
+/* A peer on the loopback sending MQTT packets, in pieces and late as told */
+typedef struct {
+    const unsigned char *data;
+    int                 len;
+    int                 delay_ms;           /* before sending it */
+} _net_chunk_t;
+
+typedef struct {
+    int                 fd;
+    int                 conn;
+    unsigned short      port;
+    pthread_t           thread;
+    _net_chunk_t        chunks[NET_CHUNK_MAX];
+    int                 chunk_num;
+} _net_peer_t;
+
+static _net_peer_t _peer;
+static utils_network_t _net;
+
+static void *_net_peer_run(void *arg)
+{
+    int i;
+
+    for (i = 0; i < _peer.chunk_num; i++) {
+        usleep(_peer.chunks[i].delay_ms * 1000);
+        send(_peer.conn, _peer.chunks[i].data, _peer.chunks[i].len, MSG_NOSIGNAL);
+    }
+    return NULL;
+}
+
+/* the client connected through utils_net, the peer accepted */
+static int _net_peer_start(void)
+{
+    struct sockaddr_in  addr;
+    socklen_t           addr_len = sizeof(addr);
+
+    memset(&_peer, 0, sizeof(_net_peer_t));
+    _peer.conn = -1;
+    _peer.fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (_peer.fd < 0 || 0 != bind(_peer.fd, (struct sockaddr *)&addr, sizeof(addr))
+        || 0 != listen(_peer.fd, 1) || 0 != getsockname(_peer.fd, (struct sockaddr *)&addr, &addr_len)) {
+        return -1;
+    }
+    _peer.port = ntohs(addr.sin_port);
+
+    iotx_net_init(&_net, "127.0.0.1", _peer.port, NULL, NULL);
+    if (0 != _net.connect(&_net)) {
+        return -1;
+    }
+    _peer.conn = accept(_peer.fd, NULL, NULL);
+    return (_peer.conn < 0) ? -1 : 0;
+}
+
+static void _net_peer_stop(void)
+{
+    _net.disconnect(&_net);
+    if (0 <= _peer.conn) {
+        close(_peer.conn);
+    }
+    close(_peer.fd);
+}
+
+static void _net_peer_send(const unsigned char *data, int len)
+{
+    send(_peer.conn, data, len, MSG_NOSIGNAL);
+    /* it is in the client's socket before the client reads on */
+    usleep(20 * 1000);
+}
+
+/* send the chunks from a thread while the client reads */
+static int _net_peer_send_later(const _net_chunk_t *chunks, int num)
+{
+    memcpy(_peer.chunks, chunks, num * sizeof(_net_chunk_t));
+    _peer.chunk_num = num;
+    return pthread_create(&_peer.thread, NULL, _net_peer_run, NULL);
+}
+
+/* read a packet as the MQTT client does: the fixed header, the remaining length
+ * a byte at a time, then the rest. The packet length or what the read returned. */
+static int _net_read_packet(unsigned char *packet)
+{
+    int ret, len = 1, rem = 0, mul = 1;
+
+    ret = _net.read(&_net, (char *)packet, 1, NET_TIMEOUT_MS);
+    if (1 != ret) {
+        return ret;
+    }
+    do {
+        ret = _net.read(&_net, (char *)packet + len, 1, NET_TIMEOUT_MS);
+        if (1 != ret) {
+            return ret;
+        }
+        rem += (packet[len] & 0x7F) * mul;
+        mul *= 128;
+    } while (packet[len++] & 0x80);
+
+    if (len + rem > NET_PACKET_MAX) {
+        return -1;
+    }
+    if (rem > 0) {
+        ret = _net.read(&_net, (char *)packet + len, rem, NET_TIMEOUT_MS);
+        if (rem != ret) {
+            return ret;
+        }
+    }
+    return len + rem;
+}
+
+/* a PUBLISH of QoS0 on "/net" with 'payload_len' bytes of 'fill' */
+static int _net_publish(unsigned char *p, int payload_len, unsigned char fill)
+{
+    int rem = 2 + 4 + payload_len, len = 0;
+
+    p[len++] = 0x30;
+    do {
+        p[len] = rem & 0x7F;
+        rem >>= 7;
+        p[len++] |= (rem > 0) ? 0x80 : 0;
+    } while (rem > 0);
+    p[len++] = 0;
+    p[len++] = 4;
+    memcpy(p + len, "/net", 4);
+    len += 4;
+    memset(p + len, fill, payload_len);
+    return len + payload_len;
+}
+
+/* packets coming in one segment are all taken by one receive, and served from it
+ * before the socket is read again */
+CASE(UTILS_NET, packets_in_one_recv) {
+    static unsigned char sent[2 * NET_PACKET_MAX], next[NET_PACKET_MAX], packet[NET_PACKET_MAX];
+    int len[3], ret[4];
+    uint16_t buffered[3];
+
+    len[0] = _net_publish(sent, 10, 'a');
+    len[1] = _net_publish(sent + len[0], 100, 'b');
+    len[2] = _net_publish(next, 20, 'c');
+
+    ASSERT_EQ(_net_peer_start(), 0);
+    _net_peer_send(sent, len[0] + len[1]);
+
+    ret[0] = _net_read_packet(packet);
+    ret[3] = memcmp(packet, sent, len[0]);
+    buffered[0] = _net.rbuf_len;
+
+    /* the next packet is waiting in the socket while the second is still buffered */
+    _net_peer_send(next, len[2]);
+    ret[1] = _net_read_packet(packet);
+    ret[3] |= memcmp(packet, sent + len[0], len[1]);
+    buffered[1] = _net.rbuf_len;
+
+    ret[2] = _net_read_packet(packet);
+    ret[3] |= memcmp(packet, next, len[2]);
+    buffered[2] = _net.rbuf_len;
+    _net_peer_stop();
+
+    ASSERT_EQ(ret[0], len[0]);
+    ASSERT_EQ(buffered[0], len[1]);
+    ASSERT_EQ(ret[1], len[1]);
+    ASSERT_EQ(buffered[1], 0);
+    ASSERT_EQ(ret[2], len[2]);
+    ASSERT_EQ(buffered[2], 0);
+    ASSERT_EQ(ret[3], 0);
+}
+
+/* a packet arriving in pieces is waited for, whether cut in its body or in its
+ * remaining length */
+CASE(UTILS_NET, packet_split) {
+    static unsigned char sent[2 * NET_PACKET_MAX], packet[NET_PACKET_MAX];
+    _net_chunk_t chunks[3];
+    int len[2], ret[3];
+
+    len[0] = _net_publish(sent, 40, 'a');
+    len[1] = _net_publish(sent + len[0], 200, 'b');
+
+    ASSERT_EQ(_net_peer_start(), 0);
+    /* the first packet cut after a byte of its body, the second after the first byte of
+     * its remaining length, which takes two */
+    chunks[0].data = sent;
+    chunks[0].len = 3;
+    chunks[0].delay_ms = 0;
+    chunks[1].data = sent + 3;
+    chunks[1].len = len[0] - 3 + 2;
+    chunks[1].delay_ms = 50;
+    chunks[2].data = sent + len[0] + 2;
+    chunks[2].len = len[1] - 2;
+    chunks[2].delay_ms = 50;
+    ASSERT_EQ(_net_peer_send_later(chunks, 3), 0);
+
+    ret[0] = _net_read_packet(packet);
+    ret[2] = memcmp(packet, sent, len[0]);
+    ret[1] = _net_read_packet(packet);
+    ret[2] |= memcmp(packet, sent + len[0], len[1]);
+    pthread_join(_peer.thread, NULL);
+    _net_peer_stop();
+
+    ASSERT_EQ(ret[0], len[0]);
+    ASSERT_EQ(ret[1], len[1]);
+    ASSERT_EQ(ret[2], 0);
+}
+
+/* what was read ahead is served even once the peer has closed, then the close is seen */
+CASE(UTILS_NET, close_after_data) {
+    static unsigned char sent[2 * NET_PACKET_MAX], packet[NET_PACKET_MAX];
+    int len[2], ret[3];
+
+    len[0] = _net_publish(sent, 10, 'a');
+    len[1] = _net_publish(sent + len[0], 10, 'b');
+
+    ASSERT_EQ(_net_peer_start(), 0);
+    _net_peer_send(sent, len[0] + len[1]);
+    close(_peer.conn);
+    _peer.conn = -1;
+
+    ret[0] = _net_read_packet(packet);
+    ret[1] = _net_read_packet(packet);
+    ret[2] = _net_read_packet(packet);
+    _net_peer_stop();
+
+    ASSERT_EQ(ret[0], len[0]);
+    ASSERT_EQ(ret[1], len[1]);
+    ASSERT_EQ(ret[2] <= 0, 1);
+}
+
+SUITE(UTILS_NET) = {
+    ADD_CASE(UTILS_NET, packets_in_one_recv),
+    ADD_CASE(UTILS_NET, packet_split),
+    ADD_CASE(UTILS_NET, close_after_data),
+    ADD_CASE_NULL
+};
@@ -0,0 +1,309 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+
+#ifdef IOTX_SPOOL_SUPPORT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "utils_spool.h"
+
+#define SPOOL_REC_LEN       (4)                                 /* "%04d" */
+#define SPOOL_SEG_RECORDS   (10)
+#define SPOOL_SEGMENT_SIZE  (SPOOL_SEG_RECORDS * (8 + SPOOL_REC_LEN))
+#define SPOOL_REPLAY_MAX    (64)
+
+typedef struct {
+    int         values[SPOOL_REPLAY_MAX];
+    int         num;
+    uint32_t    consume;                    /* consume at most this many of a batch, 0 for all */
+} _spool_replayed_t;
+
+static char _spool_dir[32];
+static char _spool_file[64];
+static _spool_replayed_t _replayed;
+
+static int _spool_collect(const hal_iovec_t *records, uint32_t count, void *user)
+{
+    _spool_replayed_t *r = (_spool_replayed_t *)user;
+    char value[SPOOL_REC_LEN + 1];
+    uint32_t i;
+
+    if (0 != r->consume && r->consume < count) {
+        count = r->consume;
+    }
+    for (i = 0; i < count && r->num < SPOOL_REPLAY_MAX; i++) {
+        memset(value, 0, sizeof(value));
+        memcpy(value, records[i].buf, (records[i].len < SPOOL_REC_LEN) ? records[i].len : SPOOL_REC_LEN);
+        r->values[r->num++] = atoi(value);
+    }
+    return count;
+}
+
+static utils_spool_t *_spool_open(uint32_t segments, utils_spool_policy_t policy)
+{
+    utils_spool_param_t param;
+
+    memset(&param, 0, sizeof(utils_spool_param_t));
+    param.dir = _spool_dir;
+    param.max_size = segments * SPOOL_SEGMENT_SIZE;
+    param.segment_size = SPOOL_SEGMENT_SIZE;
+    param.policy = policy;
+    return utils_spool_open(&param);
+}
+
+/* append the records 'from' to 'to' - 1, the number appended */
+static int _spool_append(utils_spool_t *spool, int from, int to)
+{
+    char        value[SPOOL_REC_LEN + 1];
+    hal_iovec_t iov;
+    int         i;
+
+    for (i = from; i < to; i++) {
+        HAL_Snprintf(value, sizeof(value), "%04d", i);
+        iov.buf = value;
+        iov.len = SPOOL_REC_LEN;
+        if (0 != utils_spool_append(spool, &iov, 1)) {
+            break;
+        }
+    }
+    return i - from;
+}
+
+static int _spool_replay(utils_spool_t *spool, uint32_t consume)
+{
+    memset(&_replayed, 0, sizeof(_replayed));
+    _replayed.consume = consume;
+    return utils_spool_replay(spool, _spool_collect, &_replayed);
+}
+
+/* 1 if the replayed values are 'from' to 'from' + 'num' - 1 */
+static int _spool_replayed_in_order(int from, int num)
+{
+    int i;
+
+    if (_replayed.num != num) {
+        return 0;
+    }
+    for (i = 0; i < num; i++) {
+        if (_replayed.values[i] != from + i) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static const char *_spool_segment(uint32_t seg)
+{
+    HAL_Snprintf(_spool_file, sizeof(_spool_file), "%s/spool.%u", _spool_dir, (unsigned int)seg);
+    return _spool_file;
+}
+
+static int _spool_setup(void)
+{
+    strcpy(_spool_dir, "/tmp/cut-spool-XXXXXX");
+    return (NULL == mkdtemp(_spool_dir)) ? -1 : 0;
+}
+
+static void _spool_cleanup(void)
+{
+    DIR            *dir = opendir(_spool_dir);
+    struct dirent  *entry;
+
+    while (NULL != dir && NULL != (entry = readdir(dir))) {
+        if ('.' != entry->d_name[0]) {
+            HAL_Snprintf(_spool_file, sizeof(_spool_file), "%s/%s", _spool_dir, entry->d_name);
+            unlink(_spool_file);
+        }
+    }
+    if (NULL != dir) {
+        closedir(dir);
+    }
+    rmdir(_spool_dir);
+}
+
+/* records come back in the order appended, across segments, partial replays and reopening */
+CASE(UTILS_SPOOL, replay_order) {
+    utils_spool_t  *spool;
+    int             appended, consumed[3], in_order[3];
+    uint32_t        count;
+
+    ASSERT_EQ(_spool_setup(), 0);
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    appended = _spool_append(spool, 0, 35);
+
+    consumed[0] = _spool_replay(spool, 3);
+    in_order[0] = _spool_replayed_in_order(0, 3);
+    utils_spool_close(spool);
+
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    count = utils_spool_count(spool);
+    consumed[1] = _spool_replay(spool, 0);
+    in_order[1] = _spool_replayed_in_order(3, 32);
+
+    /* an emptied spool takes records again */
+    _spool_append(spool, 35, 40);
+    consumed[2] = _spool_replay(spool, 0);
+    in_order[2] = _spool_replayed_in_order(35, 5);
+    utils_spool_close(spool);
+    _spool_cleanup();
+
+    ASSERT_EQ(appended, 35);
+    ASSERT_EQ(consumed[0], 3);
+    ASSERT_EQ(in_order[0], 1);
+    ASSERT_EQ(count, 32);
+    ASSERT_EQ(consumed[1], 32);
+    ASSERT_EQ(in_order[1], 1);
+    ASSERT_EQ(consumed[2], 5);
+    ASSERT_EQ(in_order[2], 1);
+}
+
+/* a record torn off the tail by a crash is cut when the spool is opened again */
+CASE(UTILS_SPOOL, torn_tail) {
+    utils_spool_t  *spool;
+    void           *fp;
+    FILE           *file;
+    int             truncated, count[2], in_order[2];
+
+    ASSERT_EQ(_spool_setup(), 0);
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    _spool_append(spool, 0, 15);
+    utils_spool_close(spool);
+
+    /* the second segment holds records 10 to 14, lose half of the last one */
+    fp = HAL_File_Open(_spool_segment(1), 0);
+    ASSERT_NE(fp, NULL);
+    truncated = HAL_File_Truncate(fp, HAL_File_Size(fp) - SPOOL_REC_LEN / 2);
+    HAL_File_Close(fp);
+
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    count[0] = utils_spool_count(spool);
+    _spool_append(spool, 14, 16);
+    count[1] = utils_spool_count(spool);
+    _spool_replay(spool, 0);
+    in_order[0] = _spool_replayed_in_order(0, 16);
+    utils_spool_close(spool);
+    _spool_cleanup();
+
+    ASSERT_EQ(truncated, 0);
+    ASSERT_EQ(count[0], 14);
+    ASSERT_EQ(count[1], 16);
+    ASSERT_EQ(in_order[0], 1);
+
+    /* a last record of the full length whose CRC does not match is cut the same way */
+    ASSERT_EQ(_spool_setup(), 0);
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    _spool_append(spool, 0, 5);
+    utils_spool_close(spool);
+
+    file = fopen(_spool_segment(0), "r+b");
+    ASSERT_NE(file, NULL);
+    fseek(file, -1, SEEK_END);
+    fputc('x', file);
+    fclose(file);
+
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    count[0] = utils_spool_count(spool);
+    _spool_replay(spool, 0);
+    in_order[1] = _spool_replayed_in_order(0, 4);
+    utils_spool_close(spool);
+    _spool_cleanup();
+
+    ASSERT_EQ(count[0], 4);
+    ASSERT_EQ(in_order[1], 1);
+}
+
+/* a corrupted record in an older segment drops the rest of that segment only */
+CASE(UTILS_SPOOL, corrupted_segment) {
+    utils_spool_t  *spool;
+    FILE           *fp;
+    uint32_t        dropped;
+    int             i, consumed;
+
+    ASSERT_EQ(_spool_setup(), 0);
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    _spool_append(spool, 0, 25);
+    utils_spool_close(spool);
+
+    /* a payload byte of record 4 */
+    fp = fopen(_spool_segment(0), "r+b");
+    ASSERT_NE(fp, NULL);
+    fseek(fp, 4 * (8 + SPOOL_REC_LEN) + 8, SEEK_SET);
+    fputc('x', fp);
+    fclose(fp);
+
+    spool = _spool_open(8, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    consumed = _spool_replay(spool, 0);
+    dropped = utils_spool_dropped(spool);
+    utils_spool_close(spool);
+    _spool_cleanup();
+
+    ASSERT_EQ(consumed, 4 + 15);
+    ASSERT_EQ(dropped, 6);
+    ASSERT_EQ(_replayed.num, 19);
+    for (i = 0; i < 4; i++) {
+        ASSERT_EQ(_replayed.values[i], i);
+    }
+    for (i = 4; i < 19; i++) {
+        ASSERT_EQ(_replayed.values[i], i + 6);
+    }
+}
+
+/* a full spool drops its oldest segment, or refuses the record by the policy */
+CASE(UTILS_SPOOL, full) {
+    utils_spool_t  *spool;
+    int             appended[2], in_order[2];
+    uint32_t        count[2], dropped[2];
+
+    ASSERT_EQ(_spool_setup(), 0);
+    spool = _spool_open(3, UTILS_SPOOL_DROP_OLDEST);
+    ASSERT_NE(spool, NULL);
+    appended[0] = _spool_append(spool, 0, 45);
+    count[0] = utils_spool_count(spool);
+    dropped[0] = utils_spool_dropped(spool);
+    _spool_replay(spool, 0);
+    in_order[0] = _spool_replayed_in_order(20, 25);
+    utils_spool_close(spool);
+    _spool_cleanup();
+
+    ASSERT_EQ(appended[0], 45);
+    ASSERT_EQ(count[0], 25);
+    ASSERT_EQ(dropped[0], 20);
+    ASSERT_EQ(in_order[0], 1);
+
+    ASSERT_EQ(_spool_setup(), 0);
+    spool = _spool_open(3, UTILS_SPOOL_DROP_NEWEST);
+    ASSERT_NE(spool, NULL);
+    appended[1] = _spool_append(spool, 0, 45);
+    _spool_append(spool, 45, 50);
+    count[1] = utils_spool_count(spool);
+    dropped[1] = utils_spool_dropped(spool);
+    _spool_replay(spool, 0);
+    in_order[1] = _spool_replayed_in_order(0, 30);
+    utils_spool_close(spool);
+    _spool_cleanup();
+
+    ASSERT_EQ(appended[1], 30);
+    ASSERT_EQ(count[1], 30);
+    ASSERT_EQ(dropped[1], 2);
+    ASSERT_EQ(in_order[1], 1);
+}
+
+SUITE(UTILS_SPOOL) = {
+    ADD_CASE(UTILS_SPOOL, replay_order),
+    ADD_CASE(UTILS_SPOOL, torn_tail),
+    ADD_CASE(UTILS_SPOOL, corrupted_segment),
+    ADD_CASE(UTILS_SPOOL, full),
+    ADD_CASE_NULL
+};
+
+#endif  /* #ifdef IOTX_SPOOL_SUPPORT */
@@ -0,0 +1,184 @@
+#include "sdk-testsuites_internal.h"
+#include "cut.h"
+#include "utils_topic_trie.h"
+
+#define TRIE_MATCH_MAX      (16)
+
+typedef struct {
+    intptr_t    values[TRIE_MATCH_MAX];
+    int         num;
+    int         stop_at;        /* stop the match after this many, 0 for all */
+} _trie_matches_t;
+
+static int _trie_collect(void *value, void *user)
+{
+    _trie_matches_t *m = (_trie_matches_t *)user;
+
+    if (m->num < TRIE_MATCH_MAX) {
+        m->values[m->num] = (intptr_t)value;
+    }
+    m->num++;
+    return (0 != m->stop_at && m->num >= m->stop_at);
+}
+
+/* the values matching 'topic' as a bit set, -1 if one was reported twice */
+static int _trie_match(utils_topic_trie_t *trie, const char *topic)
+{
+    _trie_matches_t m;
+    int i, set = 0;
+
+    memset(&m, 0, sizeof(m));
+    if (utils_topic_trie_match(trie, topic, strlen(topic), _trie_collect, &m) != m.num) {
+        return -1;
+    }
+    for (i = 0; i < m.num; i++) {
+        if (set & (1 << m.values[i])) {
+            return -1;
+        }
+        set |= 1 << m.values[i];
+    }
+    return set;
+}
+
+static utils_topic_trie_t *_trie_build(const char **filters)
+{
+    utils_topic_trie_t *trie = utils_topic_trie_new();
+    intptr_t i;
+
+    for (i = 0; NULL != trie && NULL != filters[i]; i++) {
+        if (0 != utils_topic_trie_insert(trie, filters[i], (void *)i)) {
+            utils_topic_trie_free(trie);
+            return NULL;
+        }
+    }
+    return trie;
+}
+
+CASE(UTILS_TOPIC_TRIE, plus) {
+    const char *filters[] = { "a/+/c", "+/b/+", "a/+", "+", NULL };
+    utils_topic_trie_t *trie = _trie_build(filters);
+
+    ASSERT_NE(trie, NULL);
+    ASSERT_EQ(_trie_match(trie, "a/b/c"), (1 << 0) | (1 << 1));
+    ASSERT_EQ(_trie_match(trie, "a/x/c"), 1 << 0);
+    ASSERT_EQ(_trie_match(trie, "a/b"), 1 << 2);
+    ASSERT_EQ(_trie_match(trie, "a"), 1 << 3);
+    /* '+' takes exactly one level, which may be empty */
+    ASSERT_EQ(_trie_match(trie, "a/b/c/d"), 0);
+    ASSERT_EQ(_trie_match(trie, "a//c"), 1 << 0);
+    ASSERT_EQ(_trie_match(trie, "a/"), 1 << 2);
+    ASSERT_EQ(_trie_match(trie, "/b/"), 1 << 1);
+    utils_topic_trie_free(trie);
+}
+
+CASE(UTILS_TOPIC_TRIE, hash) {
+    const char *filters[] = { "a/#", "a/b/#", "#", "+/#", NULL };
+    utils_topic_trie_t *trie = _trie_build(filters);
+
+    ASSERT_NE(trie, NULL);
+    /* '#' matches the parent level too */
+    ASSERT_EQ(_trie_match(trie, "a"), (1 << 0) | (1 << 2) | (1 << 3));
+    ASSERT_EQ(_trie_match(trie, "a/b"), (1 << 0) | (1 << 1) | (1 << 2) | (1 << 3));
+    ASSERT_EQ(_trie_match(trie, "a/b/c/d/e"), (1 << 0) | (1 << 1) | (1 << 2) | (1 << 3));
+    ASSERT_EQ(_trie_match(trie, "x/b"), (1 << 2) | (1 << 3));
+    utils_topic_trie_free(trie);
+}
+
+/* several filters and values for one topic are all reported, each once */
+CASE(UTILS_TOPIC_TRIE, overlap) {
+    const char *filters[] = { "/sys/pk/dn/rrpc/request/+", "/sys/pk/dn/rrpc/#", "/sys/pk/dn/rrpc/request/1",
+                              "/sys/+/+/rrpc/request/+", NULL };
+    utils_topic_trie_t *trie = _trie_build(filters);
+    _trie_matches_t m;
+
+    ASSERT_NE(trie, NULL);
+    ASSERT_EQ(_trie_match(trie, "/sys/pk/dn/rrpc/request/1"), 0xf);
+    ASSERT_EQ(_trie_match(trie, "/sys/pk/dn/rrpc/request/2"), (1 << 0) | (1 << 1) | (1 << 3));
+    ASSERT_EQ(_trie_match(trie, "/sys/pk/dn/rrpc/response/1"), 1 << 1);
+    ASSERT_EQ(_trie_match(trie, "/sys/pk2/dn/rrpc/request/1"), 1 << 3);
+
+    /* a filter holds its values in the order they were added */
+    ASSERT_EQ(utils_topic_trie_insert(trie, "/sys/pk/dn/rrpc/request/1", (void *)4), 0);
+    ASSERT_EQ(utils_topic_trie_insert(trie, "/sys/pk/dn/rrpc/request/1", (void *)5), 0);
+    ASSERT_EQ(_trie_match(trie, "/sys/pk/dn/rrpc/request/1"), 0x3f);
+    memset(&m, 0, sizeof(m));
+    utils_topic_trie_match(trie, "/sys/pk2/dn/rrpc/request/1", strlen("/sys/pk2/dn/rrpc/request/1"), _trie_collect, &m);
+    ASSERT_EQ(m.num, 1);
+
+    /* the callback stops the match */
+    memset(&m, 0, sizeof(m));
+    m.stop_at = 2;
+    ASSERT_EQ(utils_topic_trie_match(trie, "/sys/pk/dn/rrpc/request/1", strlen("/sys/pk/dn/rrpc/request/1"),
+                                     _trie_collect, &m), 2);
+    utils_topic_trie_free(trie);
+}
+
+CASE(UTILS_TOPIC_TRIE, remove) {
+    const char *filters[] = { "a/b/c", "a/+/c", "a/#", "a/b/c", NULL };
+    utils_topic_trie_t *trie = _trie_build(filters);
+
+    ASSERT_NE(trie, NULL);
+    ASSERT_EQ(_trie_match(trie, "a/b/c"), 0xf);
+
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/b/c", (void *)0), 0);
+    ASSERT_EQ(_trie_match(trie, "a/b/c"), (1 << 1) | (1 << 2) | (1 << 3));
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/b/c", (void *)0), -1);
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/b/c", (void *)3), 0);
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/+/c", (void *)1), 0);
+    ASSERT_EQ(_trie_match(trie, "a/b/c"), 1 << 2);
+    ASSERT_EQ(_trie_match(trie, "a/x/c"), 1 << 2);
+
+    /* a value is removed from its own filter only */
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/+", (void *)2), -1);
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/b/c/d", (void *)2), -1);
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/#", (void *)2), 0);
+    ASSERT_EQ(_trie_match(trie, "a/b/c"), 0);
+    ASSERT_EQ(_trie_match(trie, "a"), 0);
+
+    /* the pruned levels come back */
+    ASSERT_EQ(utils_topic_trie_insert(trie, "a/+/c", (void *)1), 0);
+    ASSERT_EQ(_trie_match(trie, "a/b/c"), 1 << 1);
+    utils_topic_trie_free(trie);
+}
+
+/* filters starting with a wildcard do not match topics starting with '$' */
+CASE(UTILS_TOPIC_TRIE, dollar) {
+    const char *filters[] = { "#", "+/monitor/#", "$SYS/#", "$SYS/+/clients", "+", NULL };
+    utils_topic_trie_t *trie = _trie_build(filters);
+
+    ASSERT_NE(trie, NULL);
+    ASSERT_EQ(_trie_match(trie, "$SYS/monitor/clients"), (1 << 2) | (1 << 3));
+    ASSERT_EQ(_trie_match(trie, "$SYS"), 1 << 2);
+    ASSERT_EQ(_trie_match(trie, "SYS/monitor/clients"), (1 << 0) | (1 << 1));
+    /* '$' is an ordinary character past the first level */
+    ASSERT_EQ(_trie_match(trie, "a/monitor/$x"), (1 << 0) | (1 << 1));
+    utils_topic_trie_free(trie);
+}
+
+CASE(UTILS_TOPIC_TRIE, invalid) {
+    const char *invalid[] = { "a/#/b", "a/b#", "#a", "a+/b", "a/+b", "++", "##", NULL };
+    utils_topic_trie_t *trie = utils_topic_trie_new();
+    int i;
+
+    ASSERT_NE(trie, NULL);
+    ASSERT_EQ(utils_topic_trie_insert(trie, "a/b", (void *)0), 0);
+    for (i = 0; NULL != invalid[i]; i++) {
+        ASSERT_EQ(utils_topic_trie_insert(trie, invalid[i], (void *)1), -1);
+    }
+    /* nothing of a rejected filter stays behind */
+    ASSERT_EQ(_trie_match(trie, "a/b"), 1 << 0);
+    ASSERT_EQ(_trie_match(trie, "a/x/b"), 0);
+    ASSERT_EQ(utils_topic_trie_remove(trie, "a/b", (void *)0), 0);
+    ASSERT_EQ(_trie_match(trie, "a/b"), 0);
+    utils_topic_trie_free(trie);
+}
+
+SUITE(UTILS_TOPIC_TRIE) = {
+    ADD_CASE(UTILS_TOPIC_TRIE, plus),
+    ADD_CASE(UTILS_TOPIC_TRIE, hash),
+    ADD_CASE(UTILS_TOPIC_TRIE, overlap),
+    ADD_CASE(UTILS_TOPIC_TRIE, remove),
+    ADD_CASE(UTILS_TOPIC_TRIE, dollar),
+    ADD_CASE(UTILS_TOPIC_TRIE, invalid),
+    ADD_CASE_NULL
+};
@@ -3,6 +3,7 @@
 #include "utils_list.h"
 #include "lite-utils.h"
 #include "lite-system.h"
+#include "utils_hmac.h"
 #include "iotx_subdev_common.h"
 
 iotx_gateway_t g_gateway_subdevice = {0};
@@ -740,8 +741,10 @@ void* IOT_Gateway_Construct(iotx_gateway_param_pt gateway_param)
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
     g_gateway_subdevice_t->gateway_data.lock_sync = HAL_MutexCreate();
     g_gateway_subdevice_t->gateway_data.lock_sync_enter = HAL_MutexCreate();
+    g_gateway_subdevice_t->gateway_data.lock_hmac = HAL_MutexCreate();
     if (NULL == g_gateway_subdevice_t->gateway_data.lock_sync || 
-        NULL == g_gateway_subdevice_t->gateway_data.lock_sync_enter)
+        NULL == g_gateway_subdevice_t->gateway_data.lock_sync_enter ||
+        NULL == g_gateway_subdevice_t->gateway_data.lock_hmac)
     {
         log_err("create mutex error");
         return NULL;
@@ -856,7 +859,8 @@ int IOT_Subdevice_Register(void* handle,
 
         /* sign */  
         MALLOC_MEMORY_WITH_FREE_AND_RESULT(sign, 41, timestamp, FAIL_RETURN);    
-        if (FAIL_RETURN == (rc = iotx_gateway_calc_sign(product_key,
+        if (FAIL_RETURN == (rc = iotx_gateway_calc_sign(gateway,
+                                product_key,
                                 device_name,
                                 device_secret,
                                 sign, 
@@ -1535,8 +1539,12 @@ int IOT_Gateway_Destroy(void** handle)
     HAL_MutexDestroy(gateway->gateway_data.lock_login_enter);
     HAL_MutexDestroy(gateway->gateway_data.lock_sync);
     HAL_MutexDestroy(gateway->gateway_data.lock_sync_enter);
+    HAL_MutexDestroy(gateway->gateway_data.lock_hmac);
 #endif
 
+    /* the cached key schedules are as good as the secrets */
+    iotx_gateway_hmac_clear(gateway);
+
     /* actually *handle is g_gateway_subdevice_t */
     g_gateway_subdevice_t->is_construct = 0;
     *handle = NULL;
@@ -257,7 +257,72 @@ static void iotx_gateway_splice_device_cloud_id(char* device_cloud_id,
 }
 
 
-int iotx_gateway_calc_sign(const char* product_key, 
+void iotx_gateway_hmac_clear(iotx_gateway_pt gateway)
+{
+    int i;
+
+    for (i = 0; i < IOTX_GATEWAY_HMAC_CACHE_NUM; i++) {
+        if ('\0' != gateway->hmac_cache[i].device_secret[0]) {
+            utils_hmac_free(&gateway->hmac_cache[i].hmac);
+            memset(gateway->hmac_cache[i].device_secret, 0, DEVICE_SECRET_LEN);
+        }
+    }
+    gateway->hmac_cache_next = 0;
+}
+
+/* Sign with the key schedule of device_secret, made over the oldest one cached if it is not there */
+static int iotx_gateway_hmac_sign(iotx_gateway_pt gateway,
+        const char* device_secret,
+        utils_hmac_type_t type,
+        const char* msg,
+        char* signature)
+{
+    iotx_gateway_hmac_t* entry = NULL;
+    int secret_len = strlen(device_secret);
+    int i, rc = SUCCESS_RETURN;
+
+    if (secret_len >= DEVICE_SECRET_LEN) {
+        log_err("device secret too long");
+        return FAIL_RETURN;
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexLock(gateway->gateway_data.lock_hmac);
+#endif
+
+    for (i = 0; i < IOTX_GATEWAY_HMAC_CACHE_NUM; i++) {
+        if (type == gateway->hmac_cache[i].hmac.type &&
+            0 == strcmp(device_secret, gateway->hmac_cache[i].device_secret)) {
+            entry = &gateway->hmac_cache[i];
+            break;
+        }
+    }
+
+    if (NULL == entry) {
+        entry = &gateway->hmac_cache[gateway->hmac_cache_next];
+        gateway->hmac_cache_next = (gateway->hmac_cache_next + 1) % IOTX_GATEWAY_HMAC_CACHE_NUM;
+
+        memset(entry->device_secret, 0, DEVICE_SECRET_LEN);
+        if (0 == utils_hmac_init(&entry->hmac, type, device_secret, secret_len)) {
+            memcpy(entry->device_secret, device_secret, secret_len);
+        } else {
+            rc = FAIL_RETURN;
+        }
+    }
+
+    if (SUCCESS_RETURN == rc) {
+        utils_hmac_sign(&entry->hmac, msg, strlen(msg), signature);
+    }
+
+#ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
+    HAL_MutexUnlock(gateway->gateway_data.lock_hmac);
+#endif
+
+    return rc;
+}
+
+int iotx_gateway_calc_sign(iotx_gateway_pt gateway,
+        const char* product_key, 
         const char* device_name,
         const char* device_secret,
         char* hmac_sigbuf,
@@ -269,6 +334,7 @@ int iotx_gateway_calc_sign(const char* product_key,
     char signature[64];                    
     char hmac_source[256];
     
+    PARAMETER_NULL_CHECK_WITH_RESULT(gateway, FAIL_RETURN);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(product_key, FAIL_RETURN);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_name, FAIL_RETURN);
     PARAMETER_STRING_NULL_CHECK_WITH_RESULT(device_secret, FAIL_RETURN);
@@ -287,15 +353,15 @@ int iotx_gateway_calc_sign(const char* product_key,
                       timestamp_str);
 
     if (sign_method == IOTX_SUBDEV_SIGN_METHOD_TYPE_SHA) {
-        utils_hmac_sha1(hmac_source, strlen(hmac_source),
-                    signature,
-                    device_secret,
-                    strlen(device_secret));
+        if (FAIL_RETURN == iotx_gateway_hmac_sign(gateway, device_secret, UTILS_HMAC_SHA1,
+                    hmac_source, signature)) {
+            return FAIL_RETURN;
+        }
     } else if (sign_method == IOTX_SUBDEV_SIGN_METHOD_TYPE_MD5) {
-        utils_hmac_md5(hmac_source, strlen(hmac_source),
-                   signature,
-                   device_secret,
-                   strlen(device_secret));
+        if (FAIL_RETURN == iotx_gateway_hmac_sign(gateway, device_secret, UTILS_HMAC_MD5,
+                    hmac_source, signature)) {
+            return FAIL_RETURN;
+        }
     }
 
     memcpy(hmac_sigbuf, signature, hmac_buflen);
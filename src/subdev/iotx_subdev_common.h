@@ -79,10 +79,23 @@ typedef struct iotx_gateway_data_st {
 #ifdef IOT_GATEWAY_SUPPORT_MULTI_THREAD
     void*                               lock_sync; 
     void*                               lock_sync_enter;  
+    void*                               lock_hmac;
 #endif
 } iotx_gateway_data_t, *iotx_gateway_data_pt;
 
 
+/* Sub-device secrets whose HMAC key schedule the gateway keeps */
+#ifndef IOTX_GATEWAY_HMAC_CACHE_NUM
+#define IOTX_GATEWAY_HMAC_CACHE_NUM     (8)
+#endif
+
+/* The key schedule of a sub-device secret signed before, so signing for it again only hashes the message */
+typedef struct iotx_gateway_hmac_st {
+    char                                device_secret[DEVICE_SECRET_LEN];   /* empty if the slot is free */
+    utils_hmac_t                        hmac;
+} iotx_gateway_hmac_t;
+
+
 /* The structure of gateway context */
 typedef struct iotx_gateway_st {
     void                               *mqtt;      
@@ -93,6 +106,8 @@ typedef struct iotx_gateway_st {
     void*                               event_pcontext;
     iotx_subdev_event_handle_func_fpt   event_handler;
     int                                 is_construct;
+    iotx_gateway_hmac_t                 hmac_cache[IOTX_GATEWAY_HMAC_CACHE_NUM];
+    int                                 hmac_cache_next;    /* slot made over next, the oldest */
 } iotx_gateway_t, *iotx_gateway_pt;
 
 extern iotx_gateway_pt g_gateway_subdevice_t;
@@ -281,7 +296,11 @@ char *iotx_gateway_splice_logout_packet(const char *product_key,
         uint32_t* msg_id);
         
 
-int iotx_gateway_calc_sign(const char* prodect_key, 
+/* Wipe the key schedules cached by iotx_gateway_calc_sign() */
+void iotx_gateway_hmac_clear(iotx_gateway_pt gateway);
+
+int iotx_gateway_calc_sign(iotx_gateway_pt gateway,
+        const char* prodect_key, 
         const char* device_name,
         const char* device_secret,
         char* hmac_sigbuf,
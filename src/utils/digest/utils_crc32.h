@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _IOTX_COMMON_CRC32_H_
+#define _IOTX_COMMON_CRC32_H_
+
+#include "iot_import.h"
+
+/* CRC-32 of IEEE 802.3, as zlib's crc32(): start with 0, pass the result to continue */
+uint32_t utils_crc32(uint32_t crc, const void *data, uint32_t len);
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <string.h>
+#include <ctype.h>
+
+#include "utils_digest.h"
+
+static int _digest_strcasecmp(const char *a, const char *b)
+{
+    while ('\0' != *a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return tolower((unsigned char)*a) - tolower((unsigned char)*b);
+}
+
+int utils_digest_type(const char *sign_method)
+{
+    if (NULL == sign_method) {
+        return -1;
+    }
+    if (0 == _digest_strcasecmp(sign_method, "Md5")) {
+        return UTILS_DIGEST_MD5;
+    }
+    if (0 == _digest_strcasecmp(sign_method, "Sha256")) {
+        return UTILS_DIGEST_SHA256;
+    }
+    return -1;
+}
+
+void utils_digest_starts(utils_digest_t *digest, utils_digest_type_t type)
+{
+    digest->type = type;
+    if (UTILS_DIGEST_SHA256 == type) {
+        utils_sha256_init(&digest->ctx.sha256);
+        utils_sha256_starts(&digest->ctx.sha256);
+    } else {
+        utils_md5_init(&digest->ctx.md5);
+        utils_md5_starts(&digest->ctx.md5);
+    }
+}
+
+void utils_digest_update(utils_digest_t *digest, const void *data, uint32_t len)
+{
+    if (UTILS_DIGEST_SHA256 == digest->type) {
+        utils_sha256_update(&digest->ctx.sha256, data, len);
+    } else {
+        utils_md5_update(&digest->ctx.md5, data, len);
+    }
+}
+
+int utils_digest_finish_hex(utils_digest_t *digest, char *hex)
+{
+    unsigned char out[SHA256_DIGEST_LENGTH];
+    int i, len;
+
+    if (UTILS_DIGEST_SHA256 == digest->type) {
+        utils_sha256_finish(&digest->ctx.sha256, out);
+        len = SHA256_DIGEST_LENGTH;
+    } else {
+        utils_md5_finish(&digest->ctx.md5, out);
+        len = 16;
+    }
+
+    for (i = 0; i < len; i++) {
+        hex[i * 2] = "0123456789abcdef"[out[i] >> 4];
+        hex[i * 2 + 1] = "0123456789abcdef"[out[i] & 0x0F];
+    }
+    hex[len * 2] = '\0';
+    return len * 2;
+}
+
+int utils_digest_verify(utils_digest_t *digest, const char *expected, char *hex)
+{
+    char buf[UTILS_DIGEST_HEX_MAXLEN];
+
+    if (NULL == hex) {
+        hex = buf;
+    }
+    utils_digest_finish_hex(digest, hex);
+    return (NULL == expected || 0 != _digest_strcasecmp(hex, expected)) ? -1 : 0;
+}
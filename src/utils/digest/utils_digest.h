@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#ifndef _IOTX_COMMON_DIGEST_H_
+#define _IOTX_COMMON_DIGEST_H_
+
+#include "iot_import.h"
+#include "utils_md5.h"
+#include "utils_sha256.h"
+
+#define UTILS_DIGEST_HEX_MAXLEN     (SHA256_DIGEST_LENGTH * 2 + 1)
+
+typedef enum {
+    UTILS_DIGEST_MD5 = 0,
+    UTILS_DIGEST_SHA256,
+} utils_digest_type_t;
+
+/* MD5 or SHA-256 fed piece by piece, so data is hashed as it passes by */
+typedef struct {
+    utils_digest_type_t type;
+    union {
+        iot_md5_context     md5;
+        iot_sha256_context  sha256;
+    } ctx;
+} utils_digest_t;
+
+/* The type of a sign method such as "Md5" or "Sha256", -1 if unknown */
+int utils_digest_type(const char *sign_method);
+
+void utils_digest_starts(utils_digest_t *digest, utils_digest_type_t type);
+
+void utils_digest_update(utils_digest_t *digest, const void *data, uint32_t len);
+
+/* Write the digest as lowercase hex to 'hex' of UTILS_DIGEST_HEX_MAXLEN bytes, return its length */
+int utils_digest_finish_hex(utils_digest_t *digest, char *hex);
+
+/* Finish and compare to 'expected' hex of either case, 0 if they match. The
+ * digest is also written to 'hex' as by utils_digest_finish_hex() unless NULL. */
+int utils_digest_verify(utils_digest_t *digest, const char *expected, char *hex);
+
+#endif
@@ -0,0 +1,659 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <string.h>
+#include "iot_import.h"
+#include "utils_md5.h"
+#include "utils_sha1.h"
+#include "utils_sha256.h"
+#include "utils_digest_accel.h"
+
+/*
+ * The SHA and AVX2 code is built with per-function target attributes, so the
+ * rest of the SDK needs no special compiler flags and runs on any CPU. Which
+ * code runs is decided from the CPU when first hashing.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DIGEST_ACCEL_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/* A batch this small is hashed one message at a time, 8 lanes would mostly idle */
+#define DIGEST_MB_MIN       (3)
+
+static int g_digest_accel = -1;
+
+#if defined(DIGEST_ACCEL_X86)
+static const uint32_t digest_k256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+#endif
+
+#if defined(DIGEST_ACCEL_X86)
+
+static int _digest_accel_detect(void)
+{
+    unsigned int eax, ebx, ecx, edx, xcr0 = 0;
+    int ssse3_sse41, avx, features = 0;
+
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return 0;
+    }
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    ssse3_sse41 = (ecx & (1 << 9)) && (ecx & (1 << 19));
+    avx = (ecx & (1 << 28)) != 0;
+    if (ecx & (1 << 27)) {
+        /* OSXSAVE: ask the OS whether it saves the YMM registers */
+        __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+    }
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if ((ebx & (1 << 29)) && ssse3_sse41) {
+        features |= UTILS_DIGEST_ACCEL_SHA;
+    }
+    if ((ebx & (1 << 5)) && avx && (xcr0 & 6) == 6) {
+        features |= UTILS_DIGEST_ACCEL_AVX2;
+    }
+
+    return features;
+}
+
+#define SHA_NI_TARGET   __attribute__((target("sha,sse4.1")))
+#define AVX2_TARGET     __attribute__((target("avx2")))
+
+/* 4 rounds of function f, the message words 'm' go in with E */
+#define SHA1_NI_4(m, f)                                                             \
+    e = _mm_sha1nexte_epu32(prev, m);                                               \
+    prev = abcd;                                                                    \
+    abcd = _mm_sha1rnds4_epu32(abcd, e, f)
+
+/* Next 4 message words into m0 from the last 16, m0 the oldest, then 4 rounds */
+#define SHA1_NI_ROUNDS(m0, m1, m2, m3, f)                                           \
+    m0 = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(m0, m1), m2), m3);     \
+    SHA1_NI_4(m0, f)
+
+SHA_NI_TARGET
+static void _sha1_blocks_hw(uint32_t state[5], const unsigned char *data, size_t blocks)
+{
+    const __m128i swap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcd_save, e, e_save, prev, m0, m1, m2, m3;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1b);
+    e = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    while (blocks--) {
+        abcd_save = abcd;
+        e_save = e;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data)), swap);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), swap);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), swap);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), swap);
+
+        e = _mm_add_epi32(e, m0);
+        prev = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e, 0);
+        SHA1_NI_4(m1, 0);
+        SHA1_NI_4(m2, 0);
+        SHA1_NI_4(m3, 0);
+        SHA1_NI_ROUNDS(m0, m1, m2, m3, 0);
+        SHA1_NI_ROUNDS(m1, m2, m3, m0, 1);
+        SHA1_NI_ROUNDS(m2, m3, m0, m1, 1);
+        SHA1_NI_ROUNDS(m3, m0, m1, m2, 1);
+        SHA1_NI_ROUNDS(m0, m1, m2, m3, 1);
+        SHA1_NI_ROUNDS(m1, m2, m3, m0, 1);
+        SHA1_NI_ROUNDS(m2, m3, m0, m1, 2);
+        SHA1_NI_ROUNDS(m3, m0, m1, m2, 2);
+        SHA1_NI_ROUNDS(m0, m1, m2, m3, 2);
+        SHA1_NI_ROUNDS(m1, m2, m3, m0, 2);
+        SHA1_NI_ROUNDS(m2, m3, m0, m1, 2);
+        SHA1_NI_ROUNDS(m3, m0, m1, m2, 3);
+        SHA1_NI_ROUNDS(m0, m1, m2, m3, 3);
+        SHA1_NI_ROUNDS(m1, m2, m3, m0, 3);
+        SHA1_NI_ROUNDS(m2, m3, m0, m1, 3);
+        SHA1_NI_ROUNDS(m3, m0, m1, m2, 3);
+
+        e = _mm_sha1nexte_epu32(prev, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+        data += 64;
+    }
+
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = (uint32_t)_mm_extract_epi32(e, 3);
+}
+
+/* 4 rounds with the message words 'm' and constants from K[k] */
+#define SHA256_NI_4(m, k)                                                           \
+    msg = _mm_add_epi32(m, _mm_loadu_si128((const __m128i *)&digest_k256[k]));      \
+    s1 = _mm_sha256rnds2_epu32(s1, s0, msg);                                        \
+    s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(msg, 0x0e))
+
+#define SHA256_NI_ROUNDS(m0, m1, m2, m3, k)                                         \
+    m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1),           \
+                                            _mm_alignr_epi8(m3, m2, 4)), m3);       \
+    SHA256_NI_4(m0, k)
+
+SHA_NI_TARGET
+static void _sha256_blocks_hw(uint32_t state[8], const unsigned char *data, size_t blocks)
+{
+    const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i s0, s1, s0_save, s1_save, msg, tmp, m0, m1, m2, m3;
+
+    /* the instructions keep the state as ABEF and CDGH */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+    s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+    s0 = _mm_alignr_epi8(tmp, s1, 8);
+    s1 = _mm_blend_epi16(s1, tmp, 0xf0);
+
+    while (blocks--) {
+        s0_save = s0;
+        s1_save = s1;
+
+        m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data)), swap);
+        m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16)), swap);
+        m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 32)), swap);
+        m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 48)), swap);
+
+        SHA256_NI_4(m0, 0);
+        SHA256_NI_4(m1, 4);
+        SHA256_NI_4(m2, 8);
+        SHA256_NI_4(m3, 12);
+        SHA256_NI_ROUNDS(m0, m1, m2, m3, 16);
+        SHA256_NI_ROUNDS(m1, m2, m3, m0, 20);
+        SHA256_NI_ROUNDS(m2, m3, m0, m1, 24);
+        SHA256_NI_ROUNDS(m3, m0, m1, m2, 28);
+        SHA256_NI_ROUNDS(m0, m1, m2, m3, 32);
+        SHA256_NI_ROUNDS(m1, m2, m3, m0, 36);
+        SHA256_NI_ROUNDS(m2, m3, m0, m1, 40);
+        SHA256_NI_ROUNDS(m3, m0, m1, m2, 44);
+        SHA256_NI_ROUNDS(m0, m1, m2, m3, 48);
+        SHA256_NI_ROUNDS(m1, m2, m3, m0, 52);
+        SHA256_NI_ROUNDS(m2, m3, m0, m1, 56);
+        SHA256_NI_ROUNDS(m3, m0, m1, m2, 60);
+
+        s0 = _mm_add_epi32(s0, s0_save);
+        s1 = _mm_add_epi32(s1, s1_save);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(s0, 0x1b);
+    s1 = _mm_shuffle_epi32(s1, 0xb1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, s1, 0xf0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(s1, tmp, 8));
+}
+
+/*
+ * Multi-buffer: 8 messages in the 8 lanes of the AVX2 registers. state[i]
+ * holds word i of each lane's state, w[i] word i of each lane's block. The
+ * kernels clear the upper halves of the registers on the way out, or SSE
+ * code run after them, such as SHA-NI, would stall on every instruction.
+ */
+#define MB_LOAD(p)          _mm256_loadu_si256((const __m256i *)(p))
+#define MB_STORE(p, x)      _mm256_storeu_si256((__m256i *)(p), x)
+#define MB_ADD(x, y)        _mm256_add_epi32(x, y)
+#define MB_XOR(x, y)        _mm256_xor_si256(x, y)
+#define MB_ROTL(x, n)       _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+#define MB_ROTR(x, n)       MB_ROTL(x, 32 - (n))
+#define MB_CONST(t)         _mm256_set1_epi32((int)(t))
+#define MB_BSWAP(x)         _mm256_shuffle_epi8(x, _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, \
+                                                                   12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3))
+
+#define MD5_MB_P(a, b, c, d, k, s, t)                                               \
+    a = MB_ADD(MB_ROTL(MB_ADD(MB_ADD(a, F(b, c, d)), MB_ADD(X[k], MB_CONST(t))), s), b)
+
+AVX2_TARGET
+static void _md5_mb(uint32_t state[8][8], uint32_t w[16][8])
+{
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i X[16], A, B, C, D;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        X[i] = MB_LOAD(w[i]);
+    }
+    A = MB_LOAD(state[0]);
+    B = MB_LOAD(state[1]);
+    C = MB_LOAD(state[2]);
+    D = MB_LOAD(state[3]);
+
+#define F(x, y, z) MB_XOR(z, _mm256_and_si256(x, MB_XOR(y, z)))
+
+    MD5_MB_P(A, B, C, D,  0,  7, 0xD76AA478);
+    MD5_MB_P(D, A, B, C,  1, 12, 0xE8C7B756);
+    MD5_MB_P(C, D, A, B,  2, 17, 0x242070DB);
+    MD5_MB_P(B, C, D, A,  3, 22, 0xC1BDCEEE);
+    MD5_MB_P(A, B, C, D,  4,  7, 0xF57C0FAF);
+    MD5_MB_P(D, A, B, C,  5, 12, 0x4787C62A);
+    MD5_MB_P(C, D, A, B,  6, 17, 0xA8304613);
+    MD5_MB_P(B, C, D, A,  7, 22, 0xFD469501);
+    MD5_MB_P(A, B, C, D,  8,  7, 0x698098D8);
+    MD5_MB_P(D, A, B, C,  9, 12, 0x8B44F7AF);
+    MD5_MB_P(C, D, A, B, 10, 17, 0xFFFF5BB1);
+    MD5_MB_P(B, C, D, A, 11, 22, 0x895CD7BE);
+    MD5_MB_P(A, B, C, D, 12,  7, 0x6B901122);
+    MD5_MB_P(D, A, B, C, 13, 12, 0xFD987193);
+    MD5_MB_P(C, D, A, B, 14, 17, 0xA679438E);
+    MD5_MB_P(B, C, D, A, 15, 22, 0x49B40821);
+
+#undef F
+
+#define F(x, y, z) MB_XOR(y, _mm256_and_si256(z, MB_XOR(x, y)))
+
+    MD5_MB_P(A, B, C, D,  1,  5, 0xF61E2562);
+    MD5_MB_P(D, A, B, C,  6,  9, 0xC040B340);
+    MD5_MB_P(C, D, A, B, 11, 14, 0x265E5A51);
+    MD5_MB_P(B, C, D, A,  0, 20, 0xE9B6C7AA);
+    MD5_MB_P(A, B, C, D,  5,  5, 0xD62F105D);
+    MD5_MB_P(D, A, B, C, 10,  9, 0x02441453);
+    MD5_MB_P(C, D, A, B, 15, 14, 0xD8A1E681);
+    MD5_MB_P(B, C, D, A,  4, 20, 0xE7D3FBC8);
+    MD5_MB_P(A, B, C, D,  9,  5, 0x21E1CDE6);
+    MD5_MB_P(D, A, B, C, 14,  9, 0xC33707D6);
+    MD5_MB_P(C, D, A, B,  3, 14, 0xF4D50D87);
+    MD5_MB_P(B, C, D, A,  8, 20, 0x455A14ED);
+    MD5_MB_P(A, B, C, D, 13,  5, 0xA9E3E905);
+    MD5_MB_P(D, A, B, C,  2,  9, 0xFCEFA3F8);
+    MD5_MB_P(C, D, A, B,  7, 14, 0x676F02D9);
+    MD5_MB_P(B, C, D, A, 12, 20, 0x8D2A4C8A);
+
+#undef F
+
+#define F(x, y, z) MB_XOR(MB_XOR(x, y), z)
+
+    MD5_MB_P(A, B, C, D,  5,  4, 0xFFFA3942);
+    MD5_MB_P(D, A, B, C,  8, 11, 0x8771F681);
+    MD5_MB_P(C, D, A, B, 11, 16, 0x6D9D6122);
+    MD5_MB_P(B, C, D, A, 14, 23, 0xFDE5380C);
+    MD5_MB_P(A, B, C, D,  1,  4, 0xA4BEEA44);
+    MD5_MB_P(D, A, B, C,  4, 11, 0x4BDECFA9);
+    MD5_MB_P(C, D, A, B,  7, 16, 0xF6BB4B60);
+    MD5_MB_P(B, C, D, A, 10, 23, 0xBEBFBC70);
+    MD5_MB_P(A, B, C, D, 13,  4, 0x289B7EC6);
+    MD5_MB_P(D, A, B, C,  0, 11, 0xEAA127FA);
+    MD5_MB_P(C, D, A, B,  3, 16, 0xD4EF3085);
+    MD5_MB_P(B, C, D, A,  6, 23, 0x04881D05);
+    MD5_MB_P(A, B, C, D,  9,  4, 0xD9D4D039);
+    MD5_MB_P(D, A, B, C, 12, 11, 0xE6DB99E5);
+    MD5_MB_P(C, D, A, B, 15, 16, 0x1FA27CF8);
+    MD5_MB_P(B, C, D, A,  2, 23, 0xC4AC5665);
+
+#undef F
+
+#define F(x, y, z) MB_XOR(y, _mm256_or_si256(x, MB_XOR(z, ones)))
+
+    MD5_MB_P(A, B, C, D,  0,  6, 0xF4292244);
+    MD5_MB_P(D, A, B, C,  7, 10, 0x432AFF97);
+    MD5_MB_P(C, D, A, B, 14, 15, 0xAB9423A7);
+    MD5_MB_P(B, C, D, A,  5, 21, 0xFC93A039);
+    MD5_MB_P(A, B, C, D, 12,  6, 0x655B59C3);
+    MD5_MB_P(D, A, B, C,  3, 10, 0x8F0CCC92);
+    MD5_MB_P(C, D, A, B, 10, 15, 0xFFEFF47D);
+    MD5_MB_P(B, C, D, A,  1, 21, 0x85845DD1);
+    MD5_MB_P(A, B, C, D,  8,  6, 0x6FA87E4F);
+    MD5_MB_P(D, A, B, C, 15, 10, 0xFE2CE6E0);
+    MD5_MB_P(C, D, A, B,  6, 15, 0xA3014314);
+    MD5_MB_P(B, C, D, A, 13, 21, 0x4E0811A1);
+    MD5_MB_P(A, B, C, D,  4,  6, 0xF7537E82);
+    MD5_MB_P(D, A, B, C, 11, 10, 0xBD3AF235);
+    MD5_MB_P(C, D, A, B,  2, 15, 0x2AD7D2BB);
+    MD5_MB_P(B, C, D, A,  9, 21, 0xEB86D391);
+
+#undef F
+
+    MB_STORE(state[0], MB_ADD(MB_LOAD(state[0]), A));
+    MB_STORE(state[1], MB_ADD(MB_LOAD(state[1]), B));
+    MB_STORE(state[2], MB_ADD(MB_LOAD(state[2]), C));
+    MB_STORE(state[3], MB_ADD(MB_LOAD(state[3]), D));
+    _mm256_zeroupper();
+}
+
+AVX2_TARGET
+static void _sha1_mb(uint32_t state[8][8], uint32_t w[16][8])
+{
+    __m256i W[16], a, b, c, d, e, f, k, t;
+    int j;
+
+    for (j = 0; j < 16; j++) {
+        W[j] = MB_BSWAP(MB_LOAD(w[j]));
+    }
+    a = MB_LOAD(state[0]);
+    b = MB_LOAD(state[1]);
+    c = MB_LOAD(state[2]);
+    d = MB_LOAD(state[3]);
+    e = MB_LOAD(state[4]);
+
+    for (j = 0; j < 80; j++) {
+        if (j >= 16) {
+            t = MB_XOR(MB_XOR(W[(j + 13) & 15], W[(j + 8) & 15]), MB_XOR(W[(j + 2) & 15], W[j & 15]));
+            W[j & 15] = MB_ROTL(t, 1);
+        }
+        if (j < 20) {
+            f = MB_XOR(d, _mm256_and_si256(b, MB_XOR(c, d)));
+            k = MB_CONST(0x5A827999);
+        } else if (j < 40) {
+            f = MB_XOR(MB_XOR(b, c), d);
+            k = MB_CONST(0x6ED9EBA1);
+        } else if (j < 60) {
+            f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+            k = MB_CONST(0x8F1BBCDC);
+        } else {
+            f = MB_XOR(MB_XOR(b, c), d);
+            k = MB_CONST(0xCA62C1D6);
+        }
+        t = MB_ADD(MB_ADD(MB_ROTL(a, 5), f), MB_ADD(MB_ADD(e, k), W[j & 15]));
+        e = d;
+        d = c;
+        c = MB_ROTL(b, 30);
+        b = a;
+        a = t;
+    }
+
+    MB_STORE(state[0], MB_ADD(MB_LOAD(state[0]), a));
+    MB_STORE(state[1], MB_ADD(MB_LOAD(state[1]), b));
+    MB_STORE(state[2], MB_ADD(MB_LOAD(state[2]), c));
+    MB_STORE(state[3], MB_ADD(MB_LOAD(state[3]), d));
+    MB_STORE(state[4], MB_ADD(MB_LOAD(state[4]), e));
+    _mm256_zeroupper();
+}
+
+AVX2_TARGET
+static void _sha256_mb(uint32_t state[8][8], uint32_t w[16][8])
+{
+    __m256i W[16], s[8], a, b, c, d, e, f, g, h, s0, s1, t1, t2;
+    int j;
+
+    for (j = 0; j < 16; j++) {
+        W[j] = MB_BSWAP(MB_LOAD(w[j]));
+    }
+    for (j = 0; j < 8; j++) {
+        s[j] = MB_LOAD(state[j]);
+    }
+    a = s[0];
+    b = s[1];
+    c = s[2];
+    d = s[3];
+    e = s[4];
+    f = s[5];
+    g = s[6];
+    h = s[7];
+
+    for (j = 0; j < 64; j++) {
+        if (j >= 16) {
+            s0 = W[(j + 1) & 15];
+            s0 = MB_XOR(MB_XOR(MB_ROTR(s0, 7), MB_ROTR(s0, 18)), _mm256_srli_epi32(s0, 3));
+            s1 = W[(j + 14) & 15];
+            s1 = MB_XOR(MB_XOR(MB_ROTR(s1, 17), MB_ROTR(s1, 19)), _mm256_srli_epi32(s1, 10));
+            W[j & 15] = MB_ADD(MB_ADD(W[j & 15], s1), MB_ADD(W[(j + 9) & 15], s0));
+        }
+        t1 = MB_ADD(MB_ADD(h, MB_XOR(MB_XOR(MB_ROTR(e, 6), MB_ROTR(e, 11)), MB_ROTR(e, 25))),
+                    MB_ADD(MB_XOR(g, _mm256_and_si256(e, MB_XOR(f, g))),
+                           MB_ADD(MB_CONST(digest_k256[j]), W[j & 15])));
+        t2 = MB_ADD(MB_XOR(MB_XOR(MB_ROTR(a, 2), MB_ROTR(a, 13)), MB_ROTR(a, 22)),
+                    _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))));
+        h = g;
+        g = f;
+        f = e;
+        e = MB_ADD(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = MB_ADD(t1, t2);
+    }
+
+    MB_STORE(state[0], MB_ADD(s[0], a));
+    MB_STORE(state[1], MB_ADD(s[1], b));
+    MB_STORE(state[2], MB_ADD(s[2], c));
+    MB_STORE(state[3], MB_ADD(s[3], d));
+    MB_STORE(state[4], MB_ADD(s[4], e));
+    MB_STORE(state[5], MB_ADD(s[5], f));
+    MB_STORE(state[6], MB_ADD(s[6], g));
+    MB_STORE(state[7], MB_ADD(s[7], h));
+    _mm256_zeroupper();
+}
+
+typedef struct {
+    int             words;          /* state words, the digest is all of them */
+    int             big_endian;     /* SHA takes words and the bit count big endian, MD5 little */
+    const uint32_t *iv;
+    void          (*compress)(uint32_t state[8][8], uint32_t w[16][8]);
+} digest_mb_t;
+
+typedef struct {
+    int                     job;            /* index of the message hashed, -1 if the lane is idle */
+    const unsigned char    *data;           /* next block */
+    size_t                  blocks;         /* blocks left from 'data' */
+    int                     tail_blocks;    /* then blocks of 'tail' */
+    unsigned char           tail[128];      /* the last bytes, padded and followed by the bit count */
+} digest_lane_t;
+
+static const uint32_t md5_iv[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+static const uint32_t sha1_iv[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const digest_mb_t md5_mb = { 4, 0, md5_iv, _md5_mb };
+static const digest_mb_t sha1_mb = { 5, 1, sha1_iv, _sha1_mb };
+static const digest_mb_t sha256_mb = { 8, 1, sha256_iv, _sha256_mb };
+
+static void _digest_lane_start(const digest_mb_t *mb, digest_lane_t *lane, uint32_t state[8][8], int l,
+                               int job, const unsigned char *input, size_t ilen)
+{
+    size_t rem = ilen & 63;
+    uint64_t bits = (uint64_t)ilen << 3;
+    int i, end;
+
+    lane->job = job;
+    lane->data = input;
+    lane->blocks = ilen >> 6;
+    lane->tail_blocks = (rem < 56) ? 1 : 2;
+
+    end = lane->tail_blocks * 64;
+    if (rem > 0) {
+        memcpy(lane->tail, input + (ilen - rem), rem);
+    }
+    lane->tail[rem] = 0x80;
+    memset(lane->tail + rem + 1, 0, end - 8 - (rem + 1));
+    for (i = 0; i < 8; i++) {
+        lane->tail[mb->big_endian ? end - 1 - i : end - 8 + i] = (unsigned char)(bits >> (8 * i));
+    }
+
+    if (lane->blocks == 0) {
+        lane->data = lane->tail;
+        lane->blocks = lane->tail_blocks;
+        lane->tail_blocks = 0;
+    }
+    for (i = 0; i < mb->words; i++) {
+        state[i][l] = mb->iv[i];
+    }
+}
+
+static void _digest_mb(const digest_mb_t *mb, const unsigned char *const input[], const size_t ilen[],
+                       unsigned char *const output[], int num)
+{
+    digest_lane_t lane[8];
+    uint32_t state[8][8], w[16][8];
+    unsigned char *out;
+    int l, i, next = 0, active = 0;
+
+    memset(w, 0, sizeof(w));
+    for (l = 0; l < 8; l++) {
+        lane[l].job = -1;
+        if (next < num) {
+            _digest_lane_start(mb, &lane[l], state, l, next, input[next], ilen[next]);
+            next++;
+            active++;
+        }
+    }
+
+    while (active > 0) {
+        for (l = 0; l < 8; l++) {
+            if (lane[l].job < 0) {
+                continue;
+            }
+            for (i = 0; i < 16; i++) {
+                memcpy(&w[i][l], lane[l].data + 4 * i, 4);
+            }
+        }
+
+        mb->compress(state, w);
+
+        for (l = 0; l < 8; l++) {
+            if (lane[l].job < 0) {
+                continue;
+            }
+            lane[l].data += 64;
+            if (--lane[l].blocks > 0) {
+                continue;
+            }
+            if (lane[l].tail_blocks > 0) {
+                lane[l].data = lane[l].tail;
+                lane[l].blocks = lane[l].tail_blocks;
+                lane[l].tail_blocks = 0;
+                continue;
+            }
+
+            /* message done, the lane takes the next one */
+            out = output[lane[l].job];
+            for (i = 0; i < mb->words; i++) {
+                uint32_t v = state[i][l];
+                if (mb->big_endian) {
+                    v = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+                }
+                memcpy(out + 4 * i, &v, 4);
+            }
+            if (next < num) {
+                _digest_lane_start(mb, &lane[l], state, l, next, input[next], ilen[next]);
+                next++;
+            } else {
+                lane[l].job = -1;
+                active--;
+            }
+        }
+    }
+}
+
+#else
+
+static int _digest_accel_detect(void)
+{
+    return 0;
+}
+
+#endif
+
+int utils_digest_accel_get(void)
+{
+    if (g_digest_accel < 0) {
+        g_digest_accel = _digest_accel_detect();
+    }
+
+    return g_digest_accel;
+}
+
+int utils_digest_accel_set(int mask)
+{
+    g_digest_accel = _digest_accel_detect() & mask;
+
+    return g_digest_accel;
+}
+
+size_t utils_sha1_accel(uint32_t state[5], const unsigned char *data, size_t blocks)
+{
+#if defined(DIGEST_ACCEL_X86)
+    if (blocks > 0 && (utils_digest_accel_get() & UTILS_DIGEST_ACCEL_SHA)) {
+        _sha1_blocks_hw(state, data, blocks);
+        return blocks;
+    }
+#endif
+
+    return 0;
+}
+
+size_t utils_sha256_accel(uint32_t state[8], const unsigned char *data, size_t blocks)
+{
+#if defined(DIGEST_ACCEL_X86)
+    if (blocks > 0 && (utils_digest_accel_get() & UTILS_DIGEST_ACCEL_SHA)) {
+        _sha256_blocks_hw(state, data, blocks);
+        return blocks;
+    }
+#endif
+
+    return 0;
+}
+
+void utils_md5_batch(const unsigned char *const input[], const size_t ilen[], unsigned char *const output[], int num)
+{
+    int i;
+
+#if defined(DIGEST_ACCEL_X86)
+    if (num >= DIGEST_MB_MIN && (utils_digest_accel_get() & UTILS_DIGEST_ACCEL_AVX2)) {
+        _digest_mb(&md5_mb, input, ilen, output, num);
+        return;
+    }
+#endif
+
+    for (i = 0; i < num; i++) {
+        utils_md5(input[i], ilen[i], output[i]);
+    }
+}
+
+void utils_sha1_batch(const unsigned char *const input[], const size_t ilen[], unsigned char *const output[], int num)
+{
+    int i;
+
+#if defined(DIGEST_ACCEL_X86)
+    if (num >= DIGEST_MB_MIN && (utils_digest_accel_get() & UTILS_DIGEST_ACCEL_AVX2)) {
+        _digest_mb(&sha1_mb, input, ilen, output, num);
+        return;
+    }
+#endif
+
+    for (i = 0; i < num; i++) {
+        utils_sha1(input[i], ilen[i], output[i]);
+    }
+}
+
+void utils_sha256_batch(const unsigned char *const input[], const size_t ilen[], unsigned char *const output[], int num)
+{
+    int i;
+
+#if defined(DIGEST_ACCEL_X86)
+    /* SHA-NI on one message at a time keeps up with AVX2 on 8 from 256 bytes on, and beats it above */
+    if (num >= DIGEST_MB_MIN && !(utils_digest_accel_get() & UTILS_DIGEST_ACCEL_SHA)
+        && (utils_digest_accel_get() & UTILS_DIGEST_ACCEL_AVX2)) {
+        _digest_mb(&sha256_mb, input, ilen, output, num);
+        return;
+    }
+#endif
+
+    for (i = 0; i < num; i++) {
+        utils_sha256(input[i], ilen[i], output[i]);
+    }
+}
+
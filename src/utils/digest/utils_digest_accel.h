@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _IOTX_COMMON_DIGEST_ACCEL_H_
+#define _IOTX_COMMON_DIGEST_ACCEL_H_
+
+#include "iot_import.h"
+
+/* SHA-1 and SHA-256 instructions, SHA-NI on x86 */
+#define UTILS_DIGEST_ACCEL_SHA      (1 << 0)
+/* 8 messages hashed side by side in AVX2 registers, for the batch functions */
+#define UTILS_DIGEST_ACCEL_AVX2     (1 << 1)
+
+/* The UTILS_DIGEST_ACCEL_* features in use, found out from the CPU on first use */
+int utils_digest_accel_get(void);
+
+/* Use only the features in 'mask' the CPU has, 0 for plain C everywhere. Return those in use. */
+int utils_digest_accel_set(int mask);
+
+/*
+ * Process 'blocks' 64-byte blocks into the state of utils_sha1_process()
+ * or utils_sha256_process() with the SHA instructions. Return the number of
+ * blocks processed: all of them, or 0 if they are not available.
+ */
+size_t utils_sha1_accel(uint32_t state[5], const unsigned char *data, size_t blocks);
+size_t utils_sha256_accel(uint32_t state[8], const unsigned char *data, size_t blocks);
+
+/*
+ * Hash 'num' messages at once, output[i] = digest(input[i], ilen[i]). The
+ * result is the same as one call per message, only faster with
+ * UTILS_DIGEST_ACCEL_AVX2, which runs 8 of them at a time. SHA-256 prefers
+ * UTILS_DIGEST_ACCEL_SHA one message at a time where the CPU has both.
+ */
+void utils_md5_batch(const unsigned char *const input[], const size_t ilen[], unsigned char *const output[], int num);
+void utils_sha1_batch(const unsigned char *const input[], const size_t ilen[], unsigned char *const output[], int num);
+void utils_sha256_batch(const unsigned char *const input[], const size_t ilen[], unsigned char *const output[], int num);
+
+#endif
+
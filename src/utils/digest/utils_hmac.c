@@ -28,24 +28,22 @@
 #define MD5_DIGEST_SIZE 16
 #define SHA1_DIGEST_SIZE 20
 
-void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key, int key_len)
+int utils_hmac_init(utils_hmac_t *hmac, utils_hmac_type_t type, const char *key, int key_len)
 {
-    if((NULL == msg) || (NULL == digest) || (NULL == key)) {
+    unsigned char k_ipad[KEY_IOPAD_SIZE];    /* inner padding - key XORd with ipad  */
+    unsigned char k_opad[KEY_IOPAD_SIZE];    /* outer padding - key XORd with opad */
+    int i;
+
+    if ((NULL == hmac) || (NULL == key)) {
         log_err("parameter is Null,failed!");
-        return;
+        return -1;
     }
 
-    if(key_len > KEY_IOPAD_SIZE) {
-        log_err("key_len > size(%d) of array",KEY_IOPAD_SIZE);
-        return;
+    if ((key_len < 0) || (key_len > KEY_IOPAD_SIZE)) {
+        log_err("key_len > size(%d) of array", KEY_IOPAD_SIZE);
+        return -1;
     }
 
-    iot_md5_context context;
-    unsigned char k_ipad[KEY_IOPAD_SIZE];    /* inner padding - key XORd with ipad  */
-    unsigned char k_opad[KEY_IOPAD_SIZE];    /* outer padding - key XORd with opad */
-    unsigned char out[MD5_DIGEST_SIZE];
-    int i;
-
     /* start out by storing key in pads */
     memset(k_ipad, 0, sizeof(k_ipad));
     memset(k_opad, 0, sizeof(k_opad));
@@ -58,73 +56,115 @@ void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key,
         k_opad[i] ^= 0x5c;
     }
 
-    /* perform inner MD5 */
-    utils_md5_init(&context);                                      /* init context for 1st pass */
-    utils_md5_starts(&context);                                    /* setup context for 1st pass */
-    utils_md5_update(&context, k_ipad, KEY_IOPAD_SIZE);            /* start with inner pad */
-    utils_md5_update(&context, (unsigned char *) msg, msg_len);    /* then text of datagram */
-    utils_md5_finish(&context, out);                               /* finish up 1st pass */
-
-    /* perform outer MD5 */
-    utils_md5_init(&context);                              /* init context for 2nd pass */
-    utils_md5_starts(&context);                            /* setup context for 2nd pass */
-    utils_md5_update(&context, k_opad, KEY_IOPAD_SIZE);    /* start with outer pad */
-    utils_md5_update(&context, out, MD5_DIGEST_SIZE);      /* then results of 1st hash */
-    utils_md5_finish(&context, out);                       /* finish up 2nd pass */
-
-    for (i = 0; i < MD5_DIGEST_SIZE; ++i) {
+    /* hash the pads once, each sign goes on from here */
+    hmac->type = type;
+    if (UTILS_HMAC_SHA1 == type) {
+        utils_sha1_init(&hmac->inner.sha1);
+        utils_sha1_starts(&hmac->inner.sha1);
+        utils_sha1_update(&hmac->inner.sha1, k_ipad, KEY_IOPAD_SIZE);
+        utils_sha1_init(&hmac->outer.sha1);
+        utils_sha1_starts(&hmac->outer.sha1);
+        utils_sha1_update(&hmac->outer.sha1, k_opad, KEY_IOPAD_SIZE);
+    } else {
+        utils_md5_init(&hmac->inner.md5);
+        utils_md5_starts(&hmac->inner.md5);
+        utils_md5_update(&hmac->inner.md5, k_ipad, KEY_IOPAD_SIZE);
+        utils_md5_init(&hmac->outer.md5);
+        utils_md5_starts(&hmac->outer.md5);
+        utils_md5_update(&hmac->outer.md5, k_opad, KEY_IOPAD_SIZE);
+    }
+
+    memset(k_ipad, 0, sizeof(k_ipad));
+    memset(k_opad, 0, sizeof(k_opad));
+    return 0;
+}
+
+void utils_hmac_sign(const utils_hmac_t *hmac, const char *msg, int msg_len, char *digest)
+{
+    unsigned char out[SHA1_DIGEST_SIZE];
+    int i, size;
+
+    if ((NULL == hmac) || (NULL == msg) || (NULL == digest)) {
+        log_err("parameter is Null,failed!");
+        return;
+    }
+
+    if (UTILS_HMAC_SHA1 == hmac->type) {
+        iot_sha1_context context;
+
+        utils_sha1_clone(&context, &hmac->inner.sha1);                  /* inner pad already hashed */
+        utils_sha1_update(&context, (unsigned char *) msg, msg_len);    /* then text of datagram */
+        utils_sha1_finish(&context, out);                               /* finish up 1st pass */
+
+        utils_sha1_clone(&context, &hmac->outer.sha1);                  /* outer pad already hashed */
+        utils_sha1_update(&context, out, SHA1_DIGEST_SIZE);             /* then results of 1st hash */
+        utils_sha1_finish(&context, out);                               /* finish up 2nd pass */
+        utils_sha1_free(&context);
+        size = SHA1_DIGEST_SIZE;
+    } else {
+        iot_md5_context context;
+
+        utils_md5_clone(&context, &hmac->inner.md5);                    /* inner pad already hashed */
+        utils_md5_update(&context, (unsigned char *) msg, msg_len);     /* then text of datagram */
+        utils_md5_finish(&context, out);                                /* finish up 1st pass */
+
+        utils_md5_clone(&context, &hmac->outer.md5);                    /* outer pad already hashed */
+        utils_md5_update(&context, out, MD5_DIGEST_SIZE);               /* then results of 1st hash */
+        utils_md5_finish(&context, out);                                /* finish up 2nd pass */
+        utils_md5_free(&context);
+        size = MD5_DIGEST_SIZE;
+    }
+
+    for (i = 0; i < size; ++i) {
         digest[i * 2] = utils_hb2hex(out[i] >> 4);
         digest[i * 2 + 1] = utils_hb2hex(out[i]);
     }
 }
 
-void utils_hmac_sha1(const char *msg, int msg_len, char *digest, const char *key, int key_len)
+void utils_hmac_free(utils_hmac_t *hmac)
+{
+    if (NULL == hmac) {
+        return;
+    }
+
+    if (UTILS_HMAC_SHA1 == hmac->type) {
+        utils_sha1_free(&hmac->inner.sha1);
+        utils_sha1_free(&hmac->outer.sha1);
+    } else {
+        utils_md5_free(&hmac->inner.md5);
+        utils_md5_free(&hmac->outer.md5);
+    }
+}
+
+void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key, int key_len)
 {
+    utils_hmac_t hmac;
+
     if((NULL == msg) || (NULL == digest) || (NULL == key)) {
         log_err("parameter is Null,failed!");
         return;
     }
 
-    if(key_len > KEY_IOPAD_SIZE) {
-        log_err("key_len > size(%d) of array",KEY_IOPAD_SIZE);
+    if (0 != utils_hmac_init(&hmac, UTILS_HMAC_MD5, key, key_len)) {
         return;
     }
+    utils_hmac_sign(&hmac, msg, msg_len, digest);
+    utils_hmac_free(&hmac);
+}
 
-    iot_sha1_context context;
-    unsigned char k_ipad[KEY_IOPAD_SIZE];    /* inner padding - key XORd with ipad  */
-    unsigned char k_opad[KEY_IOPAD_SIZE];    /* outer padding - key XORd with opad */
-    unsigned char out[SHA1_DIGEST_SIZE];
-    int i;
-
-    /* start out by storing key in pads */
-    memset(k_ipad, 0, sizeof(k_ipad));
-    memset(k_opad, 0, sizeof(k_opad));
-    memcpy(k_ipad, key, key_len);
-    memcpy(k_opad, key, key_len);
+void utils_hmac_sha1(const char *msg, int msg_len, char *digest, const char *key, int key_len)
+{
+    utils_hmac_t hmac;
 
-    /* XOR key with ipad and opad values */
-    for (i = 0; i < KEY_IOPAD_SIZE; i++) {
-        k_ipad[i] ^= 0x36;
-        k_opad[i] ^= 0x5c;
+    if((NULL == msg) || (NULL == digest) || (NULL == key)) {
+        log_err("parameter is Null,failed!");
+        return;
     }
 
-    /* perform inner SHA */
-    utils_sha1_init(&context);                                      /* init context for 1st pass */
-    utils_sha1_starts(&context);                                    /* setup context for 1st pass */
-    utils_sha1_update(&context, k_ipad, KEY_IOPAD_SIZE);            /* start with inner pad */
-    utils_sha1_update(&context, (unsigned char *) msg, msg_len);    /* then text of datagram */
-    utils_sha1_finish(&context, out);                               /* finish up 1st pass */
-
-    /* perform outer SHA */
-    utils_sha1_init(&context);                              /* init context for 2nd pass */
-    utils_sha1_starts(&context);                            /* setup context for 2nd pass */
-    utils_sha1_update(&context, k_opad, KEY_IOPAD_SIZE);    /* start with outer pad */
-    utils_sha1_update(&context, out, SHA1_DIGEST_SIZE);     /* then results of 1st hash */
-    utils_sha1_finish(&context, out);                       /* finish up 2nd pass */
-
-    for (i = 0; i < SHA1_DIGEST_SIZE; ++i) {
-        digest[i * 2] = utils_hb2hex(out[i] >> 4);
-        digest[i * 2 + 1] = utils_hb2hex(out[i]);
+    if (0 != utils_hmac_init(&hmac, UTILS_HMAC_SHA1, key, key_len)) {
+        return;
     }
+    utils_hmac_sign(&hmac, msg, msg_len, digest);
+    utils_hmac_free(&hmac);
 }
 
@@ -22,6 +22,32 @@
 #define _IOTX_COMMON_HMAC_H_
 
 #include <string.h>
+#include "utils_md5.h"
+#include "utils_sha1.h"
+
+typedef enum {
+    UTILS_HMAC_MD5 = 0,
+    UTILS_HMAC_SHA1,
+} utils_hmac_type_t;
+
+/* The key schedule of one secret: the hash states past the inner and the
+ * outer key pad. Made once, it signs any number of messages. */
+typedef struct {
+    utils_hmac_type_t type;
+    union {
+        iot_md5_context     md5;
+        iot_sha1_context    sha1;
+    } inner, outer;
+} utils_hmac_t;
+
+/* Set up 'hmac' for 'key' of at most 64 bytes, return 0 or -1 if the parameters are invalid */
+int utils_hmac_init(utils_hmac_t *hmac, utils_hmac_type_t type, const char *key, int key_len);
+
+/* Sign 'msg' and write the lowercase hex digest to 'digest', 32 or 40 bytes, not terminated */
+void utils_hmac_sign(const utils_hmac_t *hmac, const char *msg, int msg_len, char *digest);
+
+/* Wipe the key schedule */
+void utils_hmac_free(utils_hmac_t *hmac);
 
 void utils_hmac_md5(const char *msg, int msg_len, char *digest, const char *key, int key_len);
 
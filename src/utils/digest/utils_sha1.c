@@ -23,6 +23,7 @@
 #include "iot_import.h"
 #include "lite-log.h"
 #include "utils_sha1.h"
+#include "utils_digest_accel.h"
 
 /* Implementation that should never be optimized out by the compiler */
 static void utils_sha1_zeroize(void *v, size_t n)
@@ -95,6 +96,10 @@ void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
 {
     uint32_t temp, W[16], A, B, C, D, E;
 
+    if (utils_sha1_accel(ctx->state, data, 1) > 0) {
+        return;
+    }
+
     IOT_SHA1_GET_UINT32_BE(W[ 0], data,  0);
     IOT_SHA1_GET_UINT32_BE(W[ 1], data,  4);
     IOT_SHA1_GET_UINT32_BE(W[ 2], data,  8);
@@ -252,7 +257,7 @@ void utils_sha1_process(iot_sha1_context *ctx, const unsigned char data[64])
  */
 void utils_sha1_update(iot_sha1_context *ctx, const unsigned char *input, size_t ilen)
 {
-    size_t fill;
+    size_t fill, done;
     uint32_t left;
 
     if (ilen == 0) {
@@ -277,6 +282,11 @@ void utils_sha1_update(iot_sha1_context *ctx, const unsigned char *input, size_t
         left = 0;
     }
 
+    /* whole blocks in one go, the SHA instructions keep the state in registers */
+    done = utils_sha1_accel(ctx->state, input, ilen / 64) * 64;
+    input += done;
+    ilen  -= done;
+
     while (ilen >= 64) {
         utils_sha1_process(ctx, input);
         input += 64;
@@ -9,6 +9,7 @@
 #include "iot_import.h"
 #include "lite-log.h"
 #include "utils_sha256.h"
+#include "utils_digest_accel.h"
 /* Shift-right (used in SHA-256, SHA-384, and SHA-512): */
 #define R(b,x)      ((x) >> (b))
 /* 32-bit Rotate-right (used in SHA-256): */
@@ -140,6 +141,10 @@ void utils_sha256_process(iot_sha256_context *ctx, const uint32_t *data)
     uint32_t T1, T2, *W256;
     int j;
 
+    if (utils_sha256_accel(ctx->state, (const unsigned char *) data, 1) > 0) {
+        return;
+    }
+
     W256 = (uint32_t *) ctx->buffer;
 
     /* Initialize registers with the prev. intermediate value */
@@ -212,6 +217,7 @@ void utils_sha256_process(iot_sha256_context *ctx, const uint32_t *data)
 void utils_sha256_update(iot_sha256_context *ctx, const unsigned char *input, size_t ilen)
 {
     unsigned int freespace, usedspace;
+    size_t done;
 
     if (ilen == 0) {
         /* Calling with no data is valid - we do nothing */
@@ -244,6 +250,12 @@ void utils_sha256_update(iot_sha256_context *ctx, const unsigned char *input, si
             return;
         }
     }
+    /* Whole blocks in one go, the SHA instructions keep the state in registers */
+    done = utils_sha256_accel(ctx->state, input, ilen / SHA256_BLOCK_LENGTH);
+    ctx->bitcount += (uint64_t) done * SHA256_BLOCK_LENGTH << 3;
+    ilen -= done * SHA256_BLOCK_LENGTH;
+    input += done * SHA256_BLOCK_LENGTH;
+
     while (ilen >= SHA256_BLOCK_LENGTH) {
         /* Process as many complete blocks as we can */
         utils_sha256_process(ctx, (uint32_t *) input);
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_bwriter.h"
+#include "lite-log.h"
+
+static int _bwriter_wait(utils_bwriter_t *writer)
+{
+    if (!writer->pending) {
+        return 0;
+    }
+
+    writer->pending = 0;
+    if (0 != writer->wait_cb(writer->user)) {
+        log_err("block write failed");
+        return -1;
+    }
+    return 0;
+}
+
+/* Hand the block filled to the storage and turn to the other one */
+static int _bwriter_submit(utils_bwriter_t *writer)
+{
+    /* the other block is filled next, so its write must be over */
+    if (0 != _bwriter_wait(writer)) {
+        return -1;
+    }
+
+    if (0 != writer->submit_cb(writer->user, writer->buf + writer->cur * writer->block_size, writer->fill)) {
+        log_err("block write failed to start");
+        return -1;
+    }
+    writer->pending = 1;
+    writer->cur ^= 1;
+    writer->fill = 0;
+    return 0;
+}
+
+void utils_bwriter_init(utils_bwriter_t *writer, char *buf, uint32_t block_size,
+                        utils_bwriter_submit_cb_t submit_cb, utils_bwriter_wait_cb_t wait_cb, void *user)
+{
+    memset(writer, 0, sizeof(utils_bwriter_t));
+    writer->buf = buf;
+    writer->block_size = block_size;
+    writer->submit_cb = submit_cb;
+    writer->wait_cb = wait_cb;
+    writer->user = user;
+}
+
+int utils_bwriter_write(utils_bwriter_t *writer, const char *data, uint32_t len)
+{
+    uint32_t n;
+
+    while (len > 0) {
+        n = writer->block_size - writer->fill;
+        n = (len < n) ? len : n;
+        memcpy(writer->buf + writer->cur * writer->block_size + writer->fill, data, n);
+        writer->fill += n;
+        data += n;
+        len -= n;
+
+        if (writer->fill == writer->block_size && 0 != _bwriter_submit(writer)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int utils_bwriter_flush(utils_bwriter_t *writer)
+{
+    if (writer->fill > 0 && 0 != _bwriter_submit(writer)) {
+        return -1;
+    }
+    return _bwriter_wait(writer);
+}
+
+void utils_bwriter_abort(utils_bwriter_t *writer)
+{
+    /* the storage must be done with the buffer before it is reused, its result no longer matters */
+    _bwriter_wait(writer);
+    writer->fill = 0;
+    writer->cur = 0;
+}
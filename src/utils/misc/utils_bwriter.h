@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+
+#ifndef _IOTX_COMMON_BWRITER_H_
+#define _IOTX_COMMON_BWRITER_H_
+
+#include "iot_import.h"
+
+/*
+ * Write a stream to storage in blocks of a fixed size, such as the erase size
+ * of a flash, with two buffers: one block is written by the storage while the
+ * next one is filled, so fetching and writing go on at the same time.
+ */
+
+/* Start writing 'len' bytes, 'buf' is left untouched until the wait callback returns */
+typedef int (*utils_bwriter_submit_cb_t)(void *user, char *buf, uint32_t len);
+
+/* Wait for the write submitted last, return its result, 0 or -1 */
+typedef int (*utils_bwriter_wait_cb_t)(void *user);
+
+typedef struct {
+    char                       *buf;            /* two blocks */
+    uint32_t                    block_size;
+    uint32_t                    fill;           /* bytes in the block being filled */
+    int                         cur;            /* the block being filled, 0 or 1 */
+    int                         pending;        /* a block is being written */
+    utils_bwriter_submit_cb_t   submit_cb;
+    utils_bwriter_wait_cb_t     wait_cb;
+    void                       *user;
+} utils_bwriter_t;
+
+/* 'buf' holds 2 * 'block_size' bytes, it is not freed */
+void utils_bwriter_init(utils_bwriter_t *writer, char *buf, uint32_t block_size,
+                        utils_bwriter_submit_cb_t submit_cb, utils_bwriter_wait_cb_t wait_cb, void *user);
+
+/* Write the next bytes, 0 or -1 if a block failed to be written */
+int utils_bwriter_write(utils_bwriter_t *writer, const char *data, uint32_t len);
+
+/* Write the last block, short if the stream is, and wait until all is written */
+int utils_bwriter_flush(utils_bwriter_t *writer);
+
+/* Give up the stream: wait for the block being written, drop the one being filled */
+void utils_bwriter_abort(utils_bwriter_t *writer);
+
+#endif /* _IOTX_COMMON_BWRITER_H_ */
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_delta.h"
+#include "utils_sha256.h"
+#include "lite-log.h"
+
+typedef enum {
+    UTILS_DELTA_STATE_HEADER = 0,
+    UTILS_DELTA_STATE_RAW,          /* a whole image */
+    UTILS_DELTA_STATE_OP,
+    UTILS_DELTA_STATE_OFFSET,       /* of a copy */
+    UTILS_DELTA_STATE_ADD,
+    UTILS_DELTA_STATE_DONE,
+    UTILS_DELTA_STATE_ERROR
+} utils_delta_state_t;
+
+static uint32_t _delta_le32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+
+    return u[0] | ((uint32_t)u[1] << 8) | ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+}
+
+/* 1 once the varint is complete, 0 if more bytes are needed, -1 if it is too long */
+static int _delta_varint(utils_delta_t *delta, unsigned char byte)
+{
+    if (delta->shift > 28 || (28 == delta->shift && byte > 0x0f)) {
+        return -1;
+    }
+
+    delta->varint |= (uint32_t)(byte & 0x7f) << delta->shift;
+    delta->shift += 7;
+    return (byte & 0x80) ? 0 : 1;
+}
+
+static void _delta_next(utils_delta_t *delta)
+{
+    delta->varint = 0;
+    delta->shift = 0;
+    delta->state = (delta->written == delta->new_size) ? UTILS_DELTA_STATE_DONE : UTILS_DELTA_STATE_OP;
+}
+
+/* 0 if the old image is the one the delta was made against */
+static int _delta_check_old(utils_delta_t *delta)
+{
+    iot_sha256_context ctx;
+    unsigned char digest[UTILS_DELTA_DIGEST_LEN];
+    uint32_t offset, n;
+
+    utils_sha256_init(&ctx);
+    utils_sha256_starts(&ctx);
+    for (offset = 0; offset < delta->old_size; offset += n) {
+        n = delta->old_size - offset;
+        n = (n < delta->buf_size) ? n : delta->buf_size;
+        if (delta->read_cb(delta->user, offset, delta->buf, n) != (int)n) {
+            log_err("read of the old image failed at %u", offset);
+            utils_sha256_free(&ctx);
+            return -1;
+        }
+        utils_sha256_update(&ctx, (const unsigned char *)delta->buf, n);
+    }
+    utils_sha256_finish(&ctx, digest);
+    utils_sha256_free(&ctx);
+
+    if (0 != memcmp(digest, delta->header + UTILS_DELTA_MAGIC_LEN + 8, UTILS_DELTA_DIGEST_LEN)) {
+        log_err("delta made against another image of %u bytes", delta->old_size);
+        return -1;
+    }
+    delta->old_checked = 1;
+    return 0;
+}
+
+static int _delta_copy(utils_delta_t *delta, int32_t move)
+{
+    int64_t pos = (int64_t)delta->old_pos + move;
+    uint32_t n;
+
+    if (!delta->old_checked && 0 != _delta_check_old(delta)) {
+        return -1;
+    }
+    if (pos < 0 || pos + delta->len > delta->old_size) {
+        log_err("copy of %u bytes at %d is out of the old image", delta->len, (int)pos);
+        return -1;
+    }
+
+    delta->old_pos = (uint32_t)pos;
+    while (delta->len > 0) {
+        n = (delta->len < delta->buf_size) ? delta->len : delta->buf_size;
+        if (delta->read_cb(delta->user, delta->old_pos, delta->buf, n) != (int)n) {
+            log_err("read of the old image failed at %u", delta->old_pos);
+            return -1;
+        }
+        if (0 != delta->write_cb(delta->user, delta->buf, n)) {
+            return -1;
+        }
+        delta->old_pos += n;
+        delta->written += n;
+        delta->len -= n;
+    }
+    return 0;
+}
+
+void utils_delta_init(utils_delta_t *delta, char *buf, uint32_t buf_size,
+                      utils_delta_read_cb_t read_cb, utils_delta_write_cb_t write_cb, void *user)
+{
+    memset(delta, 0, sizeof(utils_delta_t));
+    delta->state = UTILS_DELTA_STATE_HEADER;
+    delta->buf = buf;
+    delta->buf_size = buf_size;
+    delta->read_cb = read_cb;
+    delta->write_cb = write_cb;
+    delta->user = user;
+}
+
+int utils_delta_feed(utils_delta_t *delta, const char *data, uint32_t len)
+{
+    uint32_t n;
+    int ret;
+
+    while (len > 0) {
+        switch (delta->state) {
+            case UTILS_DELTA_STATE_HEADER:
+                n = UTILS_DELTA_HEADER_LEN - delta->header_len;
+                n = (len < n) ? len : n;
+                memcpy(delta->header + delta->header_len, data, n);
+                delta->header_len += n;
+                data += n;
+                len -= n;
+
+                if (delta->header_len >= UTILS_DELTA_MAGIC_LEN
+                    && 0 != memcmp(delta->header, UTILS_DELTA_MAGIC, UTILS_DELTA_MAGIC_LEN)) {
+                    delta->state = UTILS_DELTA_STATE_RAW;
+                    if (0 != delta->write_cb(delta->user, delta->header, delta->header_len)) {
+                        goto error;
+                    }
+                    delta->written += delta->header_len;
+                } else if (UTILS_DELTA_HEADER_LEN == delta->header_len) {
+                    delta->is_delta = 1;
+                    delta->new_size = _delta_le32(delta->header + UTILS_DELTA_MAGIC_LEN);
+                    delta->old_size = _delta_le32(delta->header + UTILS_DELTA_MAGIC_LEN + 4);
+                    log_info("delta of a %u bytes image against %u bytes", delta->new_size, delta->old_size);
+                    _delta_next(delta);
+                }
+                break;
+
+            case UTILS_DELTA_STATE_RAW:
+                if (0 != delta->write_cb(delta->user, data, len)) {
+                    goto error;
+                }
+                delta->written += len;
+                len = 0;
+                break;
+
+            case UTILS_DELTA_STATE_OP:
+            case UTILS_DELTA_STATE_OFFSET:
+                ret = _delta_varint(delta, (unsigned char)*data);
+                data++;
+                len--;
+                if (ret < 0) {
+                    log_err("malformed delta at %u bytes written", delta->written);
+                    goto error;
+                }
+                if (0 == ret) {
+                    break;
+                }
+
+                if (UTILS_DELTA_STATE_OP == delta->state) {
+                    delta->len = delta->varint >> 1;
+                    if (delta->len > delta->new_size - delta->written) {
+                        log_err("delta goes past the %u bytes image", delta->new_size);
+                        goto error;
+                    }
+                    if (UTILS_DELTA_OP_ADD == (delta->varint & 1)) {
+                        delta->state = UTILS_DELTA_STATE_ADD;
+                        if (0 == delta->len) {
+                            _delta_next(delta);
+                        }
+                    } else {
+                        delta->state = UTILS_DELTA_STATE_OFFSET;
+                        delta->varint = 0;
+                        delta->shift = 0;
+                    }
+                } else {
+                    /* zigzag, so a move back is as short as a move forward */
+                    if (0 != _delta_copy(delta, (int32_t)((delta->varint >> 1) ^ (0 - (delta->varint & 1))))) {
+                        goto error;
+                    }
+                    _delta_next(delta);
+                }
+                break;
+
+            case UTILS_DELTA_STATE_ADD:
+                n = (len < delta->len) ? len : delta->len;
+                if (0 != delta->write_cb(delta->user, data, n)) {
+                    goto error;
+                }
+                delta->written += n;
+                delta->len -= n;
+                data += n;
+                len -= n;
+                if (0 == delta->len) {
+                    _delta_next(delta);
+                }
+                break;
+
+            default:
+                log_err("%u bytes past the end of the delta", len);
+                goto error;
+        }
+    }
+    return 0;
+
+error:
+    delta->state = UTILS_DELTA_STATE_ERROR;
+    return -1;
+}
+
+int utils_delta_finish(utils_delta_t *delta)
+{
+    switch (delta->state) {
+        case UTILS_DELTA_STATE_HEADER:
+            /* too short for a delta, so a whole image */
+            if (delta->header_len < UTILS_DELTA_MAGIC_LEN) {
+                delta->state = UTILS_DELTA_STATE_DONE;
+                delta->written = delta->header_len;
+                return delta->write_cb(delta->user, delta->header, delta->header_len);
+            }
+            break;
+        case UTILS_DELTA_STATE_RAW:
+        case UTILS_DELTA_STATE_DONE:
+            return 0;
+        default:
+            break;
+    }
+
+    log_err("delta stopped at %u of %u bytes", delta->written, delta->new_size);
+    return -1;
+}
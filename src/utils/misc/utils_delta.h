@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+
+#ifndef _IOTX_COMMON_DELTA_H_
+#define _IOTX_COMMON_DELTA_H_
+
+#include "iot_import.h"
+
+/*
+ * Apply a delta to the running image as the delta arrives, in any pieces.
+ * A delta starts with UTILS_DELTA_MAGIC, the size of the new image, the
+ * size of the image it is made against and the SHA-256 of that image, then
+ * has operations until the new image is complete:
+ *
+ *     varint (len << 1 | UTILS_DELTA_OP_COPY), zigzag varint
+ *         copy len bytes of the old image, from where the last copy ended
+ *         moved by the zigzag value
+ *     varint (len << 1 | UTILS_DELTA_OP_ADD), len bytes
+ *         add the bytes as they are
+ *
+ * A varint is 7 bits a byte, the low bits first, the top bit set on all
+ * bytes but the last. Old bytes are copied through the buffer given, so
+ * applying needs no more memory than that whatever the size of the images.
+ * The old image is hashed the same way before the first copy, a delta made
+ * against another image stops there. Data not starting with the magic is a
+ * whole image, written as it is.
+ */
+
+#define UTILS_DELTA_MAGIC           "IOTXDLT1"
+#define UTILS_DELTA_MAGIC_LEN       (8)
+#define UTILS_DELTA_DIGEST_LEN      (32)
+#define UTILS_DELTA_HEADER_LEN      (UTILS_DELTA_MAGIC_LEN + 8 + UTILS_DELTA_DIGEST_LEN)
+
+#define UTILS_DELTA_OP_COPY         (0)
+#define UTILS_DELTA_OP_ADD          (1)
+
+/* Read 'len' bytes of the old image at 'offset', return the bytes read or -1 */
+typedef int (*utils_delta_read_cb_t)(void *user, uint32_t offset, char *buf, uint32_t len);
+
+/* Write the next 'len' bytes of the new image, return 0 or -1 */
+typedef int (*utils_delta_write_cb_t)(void *user, const char *buf, uint32_t len);
+
+typedef struct {
+    int                         state;
+    int                         is_delta;       /* known once UTILS_DELTA_MAGIC_LEN bytes are fed */
+    char                        header[UTILS_DELTA_HEADER_LEN];
+    uint32_t                    header_len;
+    uint32_t                    new_size;
+    uint32_t                    old_size;
+    int                         old_checked;    /* the old image matched the digest of the header */
+    uint32_t                    written;        /* bytes of the new image */
+    uint32_t                    varint;
+    int                         shift;
+    uint32_t                    len;            /* left to add */
+    uint32_t                    old_pos;        /* where the last copy ended */
+    char                       *buf;
+    uint32_t                    buf_size;
+    utils_delta_read_cb_t       read_cb;
+    utils_delta_write_cb_t      write_cb;
+    void                       *user;
+} utils_delta_t;
+
+/* 'buf' is used to copy from the old image, it is not freed */
+void utils_delta_init(utils_delta_t *delta, char *buf, uint32_t buf_size,
+                      utils_delta_read_cb_t read_cb, utils_delta_write_cb_t write_cb, void *user);
+
+/* Apply the next bytes of the delta, 0 or -1 if it is malformed or a callback failed */
+int utils_delta_feed(utils_delta_t *delta, const char *data, uint32_t len);
+
+/* 0 if the new image is complete, -1 if the delta stopped short of it */
+int utils_delta_finish(utils_delta_t *delta);
+
+#endif /* _IOTX_COMMON_DELTA_H_ */
@@ -40,6 +40,18 @@
 
 #define HTTP_RETRIEVE_MORE_DATA   (1)            /**< More data needs to be retrieved. */
 
+/* body decoder states of the streaming mode */
+#define HTTPCLIENT_STREAM_LENGTH        (0)     /* retrieve_len bytes of Content-Length body left */
+#define HTTPCLIENT_STREAM_CHUNK_SIZE    (1)
+#define HTTPCLIENT_STREAM_CHUNK_DATA    (2)     /* retrieve_len bytes of the chunk left */
+#define HTTPCLIENT_STREAM_CHUNK_CRLF    (3)
+#define HTTPCLIENT_STREAM_TRAILER       (4)
+#define HTTPCLIENT_STREAM_DONE          (5)
+
+#define HTTPCLIENT_LINE_LEN_MASK        (0xFFFF)
+#define HTTPCLIENT_LINE_CR              (0x10000)   /* CR of the line seen */
+#define HTTPCLIENT_LINE_EXT             (0x20000)   /* chunk extension seen */
+
 #if defined(MBEDTLS_DEBUG_C)
     #define DEBUG_LEVEL 2
 #endif
@@ -54,6 +66,11 @@ static int httpclient_retrieve_content(httpclient_t *client, char *data, int len
                                        httpclient_data_t *client_data);
 static int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_t timeout,
                                      httpclient_data_t *client_data);
+static int httpclient_recv_view(httpclient_t *client, char *buf, const char **data, int max_len, int *p_read_len,
+                                uint32_t timeout_ms);
+static void httpclient_save_carry(httpclient_t *client, const char *data, int len);
+static int httpclient_stream_content(httpclient_t *client, char *buf, int len, uint32_t timeout_ms,
+                                     httpclient_data_t *client_data);
 
 static void httpclient_base64enc(char *out, const char *in)
 {
@@ -249,7 +266,8 @@ int httpclient_send_auth(httpclient_t *client, char *send_buf, int *send_idx)
     return SUCCESS_RETURN;
 }
 
-int httpclient_send_header(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data)
+int httpclient_send_header(httpclient_t *client, const char *url, int method, httpclient_data_t *client_data,
+                           int *p_body_sent)
 {
     char scheme[8] = { 0 };
     char host[HTTPCLIENT_MAX_HOST_LEN] = { 0 };
@@ -262,6 +280,8 @@ int httpclient_send_header(httpclient_t *client, const char *url, int method, ht
                  (method == HTTPCLIENT_HEAD) ? "HEAD" : "";
     int ret;
     int port;
+    hal_iovec_t iov[2];
+    uint32_t iovcnt;
 
     /* First we need to parse the url (http[s]://host[:port][/[path]]) */
     /* int res = httpclient_parse_url(url, scheme, sizeof(scheme), host, sizeof(host), &(client->remote_port), path, sizeof(path)); */
@@ -316,8 +336,23 @@ int httpclient_send_header(httpclient_t *client, const char *url, int method, ht
 
     log_multi_line(LOG_DEBUG_LEVEL, "REQUEST", "%s", send_buf, ">");
 
+    /* The body goes out in the same write as the headers without being copied,
+     * writing it separately stalls on Nagle and delayed ACK until the server
+     * acknowledges the headers */
+    iov[0].buf = send_buf;
+    iov[0].len = len;
+    iovcnt = 1;
+    *p_body_sent = IOT_FALSE;
+    if ((method == HTTPCLIENT_POST || method == HTTPCLIENT_PUT)
+        && client_data->post_buf && client_data->post_buf_len) {
+        iov[1].buf = client_data->post_buf;
+        iov[1].len = client_data->post_buf_len;
+        iovcnt = 2;
+        *p_body_sent = IOT_TRUE;
+    }
+
     /* ret = httpclient_tcp_send_all(client->net.handle, send_buf, len); */
-    ret = client->net.write(&client->net, send_buf, len, 5000);
+    ret = client->net.writev(&client->net, iov, iovcnt, 5000);
     if (ret > 0) {
         log_debug("Written %d bytes", ret);
     } else if (ret == 0) {
@@ -366,6 +401,15 @@ int httpclient_recv(httpclient_t *client, char *buf, int min_len, int max_len, i
 
     *p_read_len = 0;
 
+    if (client->carry_len > 0) {
+        /* serve the bytes read past the previous response first */
+        *p_read_len = HTTPCLIENT_MIN(max_len, client->carry_len);
+        memcpy(buf, client->carry_buf, *p_read_len);
+        client->carry_len -= *p_read_len;
+        memmove(client->carry_buf, client->carry_buf + *p_read_len, client->carry_len);
+        return 0;
+    }
+
     ret = client->net.read(&client->net, buf, max_len, iotx_time_left(&timer));
     /* log_debug("Recv: | %s", buf); */
 
@@ -413,6 +457,36 @@ int httpclient_recv(httpclient_t *client, char *buf, int min_len, int max_len, i
     /*    return 0; */
 }
 
+/* As httpclient_recv(), but point 'data' at the bytes where the network holds them if it can lend them,
+ * 'buf' of HTTPCLIENT_CHUNK_SIZE bytes takes a copy otherwise */
+int httpclient_recv_view(httpclient_t *client, char *buf, const char **data, int max_len, int *p_read_len,
+                         uint32_t timeout_ms)
+{
+    int ret = 0;
+
+    if (client->carry_len > 0 || NULL == client->net.readview) {
+        *data = buf;
+        return httpclient_recv(client, buf, 1, HTTPCLIENT_MIN(max_len, HTTPCLIENT_CHUNK_SIZE - 1), p_read_len,
+                               timeout_ms);
+    }
+
+    *p_read_len = 0;
+    ret = client->net.readview(&client->net, data, max_len, timeout_ms);
+    if (ret > 0) {
+        *p_read_len = ret;
+    } else if (ret == 0) {
+        /* timeout */
+        return FAIL_RETURN;
+    } else if (-1 == ret) {
+        log_info("Connection closed.");
+        return ERROR_HTTP_CONN;
+    } else {
+        log_err("Connection error (recv returned %d)", ret);
+        return ERROR_HTTP_CONN;
+    }
+    return 0;
+}
+
 int httpclient_retrieve_content(httpclient_t *client, char *data, int len,
                                 uint32_t timeout_ms, httpclient_data_t *client_data)
 {
@@ -555,6 +629,7 @@ int httpclient_retrieve_content(httpclient_t *client, char *data, int len,
                 client_data->retrieve_len = 0;
             } else {
                 readLen -= len;
+                len = 0;
             }
 
             if (readLen) {
@@ -588,6 +663,8 @@ int httpclient_retrieve_content(httpclient_t *client, char *data, int len,
         } else {
             log_debug("no more (content-length)");
             client_data->is_more = IOT_FALSE;
+            /* the rest belongs to the next response on a keep-alive connection */
+            httpclient_save_carry(client, data, len);
             break;
         }
 
@@ -596,97 +673,572 @@ int httpclient_retrieve_content(httpclient_t *client, char *data, int len,
     return SUCCESS_RETURN;
 }
 
-int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_t timeout_ms,
+/* header parser states */
+#define HTTPCLIENT_PARSE_VERSION        (0)
+#define HTTPCLIENT_PARSE_STATUS         (1)
+#define HTTPCLIENT_PARSE_REASON         (2)
+#define HTTPCLIENT_PARSE_LINE_LF        (3)
+#define HTTPCLIENT_PARSE_FIELD_START    (4)
+#define HTTPCLIENT_PARSE_NAME           (5)
+#define HTTPCLIENT_PARSE_VALUE_WS       (6)
+#define HTTPCLIENT_PARSE_VALUE          (7)
+#define HTTPCLIENT_PARSE_END_LF         (8)
+#define HTTPCLIENT_PARSE_DONE           (9)
+
+/* header fields handled by the parser itself */
+#define HTTPCLIENT_FIELD_OTHER          (0)
+#define HTTPCLIENT_FIELD_CONTENT_LENGTH (1)
+#define HTTPCLIENT_FIELD_TRANSFER_ENC   (2)
+#define HTTPCLIENT_FIELD_CONNECTION     (3)
+
+/* tchar of RFC 7230, the characters allowed in a header field name */
+static const char httpclient_token_map[128] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 1, 0, 1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 1, 0,     /*  !"#$%&'()*+,-./ */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,     /* 0123456789:;<=>? */
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* @ABCDEFGHIJKLMNO */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 1,     /* PQRSTUVWXYZ[\]^_ */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,     /* `abcdefghijklmno */
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1, 0      /* pqrstuvwxyz{|}~  */
+};
+
+#define HTTPCLIENT_IS_TOKEN(c)          (!((c) & 0x80) && httpclient_token_map[(int)(c)])
+
+static int httpclient_strncasecmp(const char *s1, const char *s2, int len)
+{
+    int i;
+    char c1, c2;
+
+    for (i = 0; i < len; i++) {
+        c1 = (s1[i] >= 'A' && s1[i] <= 'Z') ? (s1[i] | 0x20) : s1[i];
+        c2 = (s2[i] >= 'A' && s2[i] <= 'Z') ? (s2[i] | 0x20) : s2[i];
+        if (c1 != c2) {
+            return c1 - c2;
+        }
+    }
+    return 0;
+}
+
+static int httpclient_field_kind(const char *name, int len)
+{
+    if (14 == len && 0 == httpclient_strncasecmp(name, "content-length", len)) {
+        return HTTPCLIENT_FIELD_CONTENT_LENGTH;
+    } else if (17 == len && 0 == httpclient_strncasecmp(name, "transfer-encoding", len)) {
+        return HTTPCLIENT_FIELD_TRANSFER_ENC;
+    } else if (10 == len && 0 == httpclient_strncasecmp(name, "connection", len)) {
+        return HTTPCLIENT_FIELD_CONNECTION;
+    }
+    return HTTPCLIENT_FIELD_OTHER;
+}
+
+static int httpclient_field_value(httpclient_parser_t *parser, const char *value, int len)
+{
+    switch (parser->field) {
+        case HTTPCLIENT_FIELD_CONTENT_LENGTH:
+            /* digits were checked while parsing */
+            if (0 == len) {
+                return -1;
+            }
+            break;
+        case HTTPCLIENT_FIELD_TRANSFER_ENC:
+            /* chunked must be the last transfer coding */
+            parser->is_chunked = (len >= 7 && 0 == httpclient_strncasecmp(value + len - 7, "chunked", 7));
+            break;
+        case HTTPCLIENT_FIELD_CONNECTION:
+            parser->conn_close = (5 == len && 0 == httpclient_strncasecmp(value, "close", 5));
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+/* Text up to the CR of the line is skipped with memchr instead of byte by byte, return the CR position,
+ * len if it is not there yet, or -1 for a bare LF */
+static int httpclient_skip_text(const char *buf, int pos, int len)
+{
+    const char *cr = memchr(buf + pos, '\r', len - pos);
+    int end = (NULL != cr) ? (int)(cr - buf) : len;
+
+    if (NULL != memchr(buf + pos, '\n', end - pos)) {
+        return -1;
+    }
+    return end;
+}
+
+void httpclient_parser_init(httpclient_parser_t *parser)
+{
+    memset(parser, 0, sizeof(httpclient_parser_t));
+    parser->state = HTTPCLIENT_PARSE_VERSION;
+    parser->content_length = -1;
+}
+
+int httpclient_parser_execute(httpclient_parser_t *parser, const char *buf, int len)
+{
+    const char version[] = "HTTP/1.";
+    int pos = parser->offset;
+    int end;
+    char c;
+    httpclient_header_t *header;
+
+    /* pos is the last byte consumed at the end of each round */
+    for (; pos < len; pos++) {
+        c = buf[pos];
+        switch (parser->state) {
+            case HTTPCLIENT_PARSE_VERSION:
+                /* "HTTP/1." DIGIT SP */
+                if (pos < (int)sizeof(version) - 1) {
+                    if (c != version[pos]) {
+                        return -1;
+                    }
+                } else if (pos == (int)sizeof(version) - 1) {
+                    if (c < '0' || c > '9') {
+                        return -1;
+                    }
+                } else if (' ' == c) {
+                    parser->state = HTTPCLIENT_PARSE_STATUS;
+                    parser->mark = pos + 1;
+                } else {
+                    return -1;
+                }
+                break;
+
+            case HTTPCLIENT_PARSE_STATUS:
+                if (c >= '0' && c <= '9' && pos - parser->mark < 3) {
+                    parser->status_code = parser->status_code * 10 + (c - '0');
+                } else if (pos - parser->mark == 3 && (' ' == c || '\r' == c)) {
+                    parser->state = ('\r' == c) ? HTTPCLIENT_PARSE_LINE_LF : HTTPCLIENT_PARSE_REASON;
+                } else {
+                    return -1;
+                }
+                break;
+
+            case HTTPCLIENT_PARSE_REASON:
+                if ((end = httpclient_skip_text(buf, pos, len)) < 0) {
+                    return -1;
+                }
+                if (end == len) {
+                    pos = len - 1;
+                    break;
+                }
+                pos = end;
+                parser->state = HTTPCLIENT_PARSE_LINE_LF;
+                break;
+
+            case HTTPCLIENT_PARSE_LINE_LF:
+                if ('\n' != c) {
+                    return -1;
+                }
+                parser->state = HTTPCLIENT_PARSE_FIELD_START;
+                break;
+
+            case HTTPCLIENT_PARSE_FIELD_START:
+                if ('\r' == c) {
+                    parser->state = HTTPCLIENT_PARSE_END_LF;
+                } else if (HTTPCLIENT_IS_TOKEN(c)) {
+                    parser->mark = pos;
+                    parser->state = HTTPCLIENT_PARSE_NAME;
+                } else {
+                    return -1;
+                }
+                break;
+
+            case HTTPCLIENT_PARSE_NAME:
+                while (pos < len && HTTPCLIENT_IS_TOKEN(buf[pos])) {
+                    pos++;
+                }
+                if (pos == len) {
+                    pos = len - 1;
+                    break;
+                }
+                c = buf[pos];
+                if (':' == c) {
+                    parser->field = httpclient_field_kind(buf + parser->mark, pos - parser->mark);
+                    if (parser->header_num < HTTPCLIENT_MAX_HEADERS) {
+                        header = &parser->headers[parser->header_num];
+                        header->name = parser->mark;
+                        header->name_len = pos - parser->mark;
+                    }
+                    if (HTTPCLIENT_FIELD_CONTENT_LENGTH == parser->field) {
+                        if (parser->content_length >= 0) {
+                            /* repeated Content-Length is a smuggling vector */
+                            return -1;
+                        }
+                        parser->content_length = 0;
+                    }
+                    parser->state = HTTPCLIENT_PARSE_VALUE_WS;
+                } else {
+                    return -1;
+                }
+                break;
+
+            case HTTPCLIENT_PARSE_VALUE_WS:
+                if (' ' == c || '\t' == c) {
+                    break;
+                }
+                parser->mark = pos;
+                parser->state = HTTPCLIENT_PARSE_VALUE;
+            /* fall through */
+            case HTTPCLIENT_PARSE_VALUE:
+                if (HTTPCLIENT_FIELD_CONTENT_LENGTH != parser->field) {
+                    if ((end = httpclient_skip_text(buf, pos, len)) < 0) {
+                        return -1;
+                    }
+                    if (end == len) {
+                        pos = len - 1;
+                        break;
+                    }
+                    pos = end;
+                    c = '\r';
+                }
+                if ('\r' == c) {
+                    /* drop trailing whitespace */
+                    for (end = pos; end > parser->mark && (' ' == buf[end - 1] || '\t' == buf[end - 1]); end--);
+                    if (0 != httpclient_field_value(parser, buf + parser->mark, end - parser->mark)) {
+                        return -1;
+                    }
+                    if (parser->header_num < HTTPCLIENT_MAX_HEADERS) {
+                        header = &parser->headers[parser->header_num];
+                        header->value = parser->mark;
+                        header->value_len = end - parser->mark;
+                    }
+                    parser->header_num++;
+                    parser->state = HTTPCLIENT_PARSE_LINE_LF;
+                } else if ('\n' == c) {
+                    return -1;
+                } else if (HTTPCLIENT_FIELD_CONTENT_LENGTH == parser->field && ' ' != c && '\t' != c) {
+                    /* whitespace may only trail the digits, "1 2" is not 12 */
+                    if (c < '0' || c > '9' || parser->content_length > (0x7FFFFFFF - 9) / 10
+                        || (pos > parser->mark && (' ' == buf[pos - 1] || '\t' == buf[pos - 1]))) {
+                        return -1;
+                    }
+                    parser->content_length = parser->content_length * 10 + (c - '0');
+                }
+                break;
+
+            case HTTPCLIENT_PARSE_END_LF:
+                if ('\n' != c) {
+                    return -1;
+                }
+                parser->state = HTTPCLIENT_PARSE_DONE;
+                parser->offset = pos + 1;
+                return parser->offset;
+
+            default:
+                return -1;
+        }
+    }
+
+    parser->offset = pos;
+    return 0;
+}
+
+int httpclient_parser_find(httpclient_parser_t *parser, const char *buf, const char *name, const char **value)
+{
+    int i;
+    int len = strlen(name);
+    int num = HTTPCLIENT_MIN(parser->header_num, HTTPCLIENT_MAX_HEADERS);
+
+    for (i = 0; i < num; i++) {
+        if (parser->headers[i].name_len == len
+            && 0 == httpclient_strncasecmp(buf + parser->headers[i].name, name, len)) {
+            *value = buf + parser->headers[i].value;
+            return parser->headers[i].value_len;
+        }
+    }
+    return -1;
+}
+
+static int httpclient_hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Bytes the body still has at least, the network read must not ask for more since it only returns
+ * early when the requested length is complete */
+static int httpclient_stream_need(httpclient_data_t *client_data)
+{
+    int line = client_data->stream_line;
+
+    switch (client_data->stream_state) {
+        case HTTPCLIENT_STREAM_LENGTH:
+            return client_data->retrieve_len;
+        case HTTPCLIENT_STREAM_CHUNK_SIZE:
+            /* "0\r\n" is the shortest chunk-size line */
+            return (line & HTTPCLIENT_LINE_CR) ? 1 : ((line & HTTPCLIENT_LINE_LEN_MASK) ? 2 : 3);
+        case HTTPCLIENT_STREAM_CHUNK_DATA:
+            return client_data->retrieve_len + 2 + 3;
+        case HTTPCLIENT_STREAM_CHUNK_CRLF:
+            return 2 - line + 3;
+        case HTTPCLIENT_STREAM_TRAILER:
+            return (line & HTTPCLIENT_LINE_CR) ? 1 : 2;
+        default:
+            return 0;
+    }
+}
+
+/* Decode the body incrementally and pass it to client_data->body_cb as views of the receive buffer,
+ * or of the network's own buffer where it lends it. Every byte is looked at once, chunked transfer
+ * coding is removed on the fly. */
+int httpclient_stream_content(httpclient_t *client, char *buf, int len, uint32_t timeout_ms,
                               httpclient_data_t *client_data)
 {
-    int crlf_pos;
+    int pos = 0;
+    int n, ret, value;
+    char c;
+    const char *data = buf;
     iotx_time_t timer;
-    char *tmp_ptr, *ptr_body_end;
-    
-    int new_trf_len, ret;
 
     iotx_time_init(&timer);
     utils_time_countdown_ms(&timer, timeout_ms);
 
-    client_data->response_content_len = -1;
+    client_data->is_more = IOT_TRUE;
 
-    /* http client response */
-    /* <status-line> HTTP/1.1 200 OK(CRLF)
+    if (HTTPCLIENT_STREAM_LENGTH == client_data->stream_state && 0 == client_data->retrieve_len) {
+        /* Content-Length: 0, 204 or 304, there is no body to wait for */
+        client_data->stream_state = HTTPCLIENT_STREAM_DONE;
+    }
 
-       <headers> ...(CRLF)
+    while (1) {
+        while (pos < len && HTTPCLIENT_STREAM_DONE != client_data->stream_state) {
+            switch (client_data->stream_state) {
+                case HTTPCLIENT_STREAM_LENGTH:
+                case HTTPCLIENT_STREAM_CHUNK_DATA:
+                    n = HTTPCLIENT_MIN(len - pos, client_data->retrieve_len);
+                    if (n > 0 && client_data->body_cb(client_data->body_user, data + pos, n) < 0) {
+                        log_err("body aborted by the receiver");
+                        return ERROR_HTTP;
+                    }
+                    pos += n;
+                    client_data->retrieve_len -= n;
+                    client_data->response_received_len += n;
+                    if (0 == client_data->retrieve_len) {
+                        client_data->stream_state = (HTTPCLIENT_STREAM_LENGTH == client_data->stream_state)
+                                                    ? HTTPCLIENT_STREAM_DONE : HTTPCLIENT_STREAM_CHUNK_CRLF;
+                        client_data->stream_line = 0;
+                    }
+                    break;
+
+                case HTTPCLIENT_STREAM_CHUNK_SIZE:
+                    c = data[pos++];
+                    if (client_data->stream_line & HTTPCLIENT_LINE_CR) {
+                        if ('\n' != c) {
+                            log_err("Format error, chunk-size line");
+                            return ERROR_HTTP;
+                        }
+                        client_data->response_content_len += client_data->retrieve_len;
+                        client_data->stream_state = client_data->retrieve_len
+                                                    ? HTTPCLIENT_STREAM_CHUNK_DATA : HTTPCLIENT_STREAM_TRAILER;
+                        client_data->stream_line = 0;
+                    } else if ('\r' == c) {
+                        if (0 == (client_data->stream_line & HTTPCLIENT_LINE_LEN_MASK)) {
+                            log_err("Format error, empty chunk-size");
+                            return ERROR_HTTP;
+                        }
+                        client_data->stream_line |= HTTPCLIENT_LINE_CR;
+                    } else if (!(client_data->stream_line & HTTPCLIENT_LINE_EXT)
+                               && (value = httpclient_hex_value(c)) >= 0) {
+                        if (client_data->retrieve_len >= (0x7FFFFFFF >> 4)) {
+                            log_err("Chunk too large");
+                            return ERROR_HTTP;
+                        }
+                        client_data->retrieve_len = (client_data->retrieve_len << 4) | value;
+                        client_data->stream_line++;
+                    } else {
+                        /* chunk extension, ignored up to the CR */
+                        if (0 == (client_data->stream_line & HTTPCLIENT_LINE_LEN_MASK)) {
+                            log_err("Format error, chunk-size expected");
+                            return ERROR_HTTP;
+                        }
+                        client_data->stream_line |= HTTPCLIENT_LINE_EXT;
+                    }
+                    break;
 
-       <blank line> (CRLF)
+                case HTTPCLIENT_STREAM_CHUNK_CRLF:
+                    c = data[pos++];
+                    if (c != (client_data->stream_line ? '\n' : '\r')) {
+                        log_err("Format error, CRLF expected after chunk");
+                        return ERROR_HTTP;
+                    }
+                    if (2 == ++client_data->stream_line) {
+                        client_data->stream_state = HTTPCLIENT_STREAM_CHUNK_SIZE;
+                        client_data->stream_line = 0;
+                        client_data->retrieve_len = 0;
+                    }
+                    break;
+
+                case HTTPCLIENT_STREAM_TRAILER:
+                    c = data[pos++];
+                    if (client_data->stream_line & HTTPCLIENT_LINE_CR) {
+                        if ('\n' != c) {
+                            log_err("Format error, trailer line");
+                            return ERROR_HTTP;
+                        }
+                        /* an empty line ends the trailer */
+                        client_data->stream_state = (client_data->stream_line & HTTPCLIENT_LINE_LEN_MASK)
+                                                    ? HTTPCLIENT_STREAM_TRAILER : HTTPCLIENT_STREAM_DONE;
+                        client_data->stream_line = 0;
+                    } else if ('\r' == c) {
+                        client_data->stream_line |= HTTPCLIENT_LINE_CR;
+                    } else {
+                        client_data->stream_line++;
+                    }
+                    break;
 
-      [<response-body>] */
-    char *crlf_ptr = strstr(data, "\r\n");
-    if (crlf_ptr == NULL) {
-        log_err("\r\n not found");
-        return ERROR_HTTP_UNRESOLVED_DNS;
-    }
+                default:
+                    break;
+            }
+        }
 
-    crlf_pos = crlf_ptr - data;
-    data[crlf_pos] = '\0';
+        if (HTTPCLIENT_STREAM_DONE == client_data->stream_state) {
+            log_debug("no more (stream)");
+            client_data->is_more = IOT_FALSE;
+            httpclient_save_carry(client, data + pos, len - pos);
+            return SUCCESS_RETURN;
+        }
 
-    /* Parse HTTP response */
-#if 0
-    if (sscanf(data, "HTTP/%*d.%*d %d %*[^\r\n]", &(client->response_code)) != 1) {
-        /* Cannot match string, error */
-        log_err("Not a correct HTTP answer : %s\n", data);
-        return ERROR_HTTP_UNRESOLVED_DNS;
+        ret = httpclient_recv_view(client, buf, &data, httpclient_stream_need(client_data), &len,
+                                   iotx_time_left(&timer));
+        pos = 0;
+        if (ret == ERROR_HTTP_CONN) {
+            return ret;
+        }
+        if (0 == len) {
+            /* timeout, the decoder state is kept for the next httpclient_recv_response() */
+            return HTTP_RETRIEVE_MORE_DATA;
+        }
+    }
+}
+
+void httpclient_save_carry(httpclient_t *client, const char *data, int len)
+{
+    if (len <= 0) {
+        return;
     }
-#endif
 
-    client->response_code = atoi(data + 9);
+    if (NULL == client->carry_buf) {
+        client->carry_buf = HAL_Malloc(HTTPCLIENT_CHUNK_SIZE);
+        if (NULL == client->carry_buf) {
+            log_err("allocate carry buffer failed, %d bytes dropped", len);
+            return;
+        }
+        client->carry_len = 0;
+    }
 
-    if ((client->response_code < 200) || (client->response_code >= 400)) {
-        /* Did not return a 2xx code; TODO fetch headers/(&data?) anyway and implement a mean of writing/reading headers */
-        log_warning("Response code %d", client->response_code);
+    /* carry data is only left when nothing was read from the network, so it fits */
+    if (client->carry_len + len > HTTPCLIENT_CHUNK_SIZE) {
+        log_err("carry buffer overflow, %d bytes dropped", len);
+        return;
     }
 
-    log_debug("Reading headers: %s", data);
+    /* these bytes were read from the carry data, put them back in front of it */
+    memmove(client->carry_buf + len, client->carry_buf, client->carry_len);
+    memcpy(client->carry_buf, data, len);
+    client->carry_len += len;
+}
 
-    memmove(data, &data[crlf_pos + 2], len - (crlf_pos + 2) + 1); /* Be sure to move NULL-terminating char as well */
-    len -= (crlf_pos + 2);       /* remove status_line length */
+int httpclient_response_parse(httpclient_t *client, char *data, int len, uint32_t timeout_ms,
+                              httpclient_data_t *client_data)
+{
+    int header_len;
+    int new_trf_len, ret;
+    iotx_time_t timer;
+    httpclient_parser_t parser;
 
-    client_data->is_chunked = IOT_FALSE;
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
+
+    client_data->response_content_len = -1;
+
+    /* http client response */
+    /* <status-line> HTTP/1.1 200 OK(CRLF)
+
+       <headers> ...(CRLF)
+
+       <blank line> (CRLF)
+
+      [<response-body>] */
+    httpclient_parser_init(&parser);
+    while (0 == (header_len = httpclient_parser_execute(&parser, data, len))) {
+        if (len >= HTTPCLIENT_CHUNK_SIZE - 1) {
+            log_err("Response header too long");
+            return ERROR_HTTP;
+        }
 
-    /*If not ending of response body*/
-    /* try to read more header again until find response head ending "\r\n\r\n" */
-    while(NULL == (ptr_body_end = strstr(data, "\r\n\r\n"))) {
         /* try to read more header */
-        ret = httpclient_recv(client, data + len, 1, HTTPCLIENT_RAED_HEAD_SIZE, &new_trf_len, iotx_time_left(&timer));
+        ret = httpclient_recv(client, data + len, 1,
+                              HTTPCLIENT_MIN(HTTPCLIENT_RAED_HEAD_SIZE, HTTPCLIENT_CHUNK_SIZE - 1 - len),
+                              &new_trf_len, iotx_time_left(&timer));
         if (ret == ERROR_HTTP_CONN) {
             return ret;
         }
+        if (0 == new_trf_len) {
+            log_err("Response header timeout");
+            return FAIL_RETURN;
+        }
         len += new_trf_len;
         data[len] = '\0';
     }
+    if (header_len < 0) {
+        log_err("Not a correct HTTP answer");
+        return ERROR_HTTP_UNRESOLVED_DNS;
+    }
+
+    client->response_code = parser.status_code;
+    client->conn_close = parser.conn_close;
+
+    if ((client->response_code < 200) || (client->response_code >= 400)) {
+        /* Did not return a 2xx code; TODO fetch headers/(&data?) anyway and implement a mean of writing/reading headers */
+        log_warning("Response code %d", client->response_code);
+    }
+
+    log_debug("Reading headers: %d bytes, %d fields", header_len, parser.header_num);
 
     /* parse response_content_len */
-    if (NULL != (tmp_ptr = strstr(data, "Content-Length"))) {
-        client_data->response_content_len = atoi(tmp_ptr + strlen("Content-Length: "));
+    client_data->is_chunked = IOT_FALSE;
+    if (parser.is_chunked) {
+        /* Transfer-Encoding overrides Content-Length */
+        client_data->is_chunked = IOT_TRUE;
+        client_data->response_content_len = 0;
+        client_data->retrieve_len = 0;
+    } else if (parser.content_length >= 0) {
+        client_data->response_content_len = parser.content_length;
         client_data->retrieve_len = client_data->response_content_len;
-    } else if (NULL != (tmp_ptr = strstr(data, "Transfer-Encoding"))) {
-        int len_chunk = strlen("Chunked");
-        char *chunk_value = data + strlen("Transfer-Encoding: ");
-
-        if ((! memcmp(chunk_value, "Chunked", len_chunk))
-            || (! memcmp(chunk_value, "chunked", len_chunk))) {
-            client_data->is_chunked = IOT_TRUE;
-            client_data->response_content_len = 0;
-            client_data->retrieve_len = 0;
-        }
+    } else if (204 == client->response_code || 304 == client->response_code) {
+        client_data->response_content_len = 0;
+        client_data->retrieve_len = 0;
     } else {
         log_err("Could not parse header");
         return ERROR_HTTP;
     }
-    
+
     /* remove header length */
     /* len is Had read body's length */
     /* if client_data->response_content_len != 0, it is know response length */
     /* the remain length is client_data->response_content_len - len */
-    len = len - (ptr_body_end + 4 - data);   
-    memmove(data, ptr_body_end + 4, len + 1);
+    len -= header_len;
+    memmove(data, data + header_len, len + 1);
+
+    if (NULL != client_data->body_cb) {
+        client_data->stream_line = 0;
+        if (client_data->is_chunked) {
+            client_data->stream_state = HTTPCLIENT_STREAM_CHUNK_SIZE;
+        } else {
+            client_data->stream_state = HTTPCLIENT_STREAM_LENGTH;
+        }
+        return httpclient_stream_content(client, data, len, client_data->body_timeout_ms
+                                         ? HTTPCLIENT_MIN(client_data->body_timeout_ms, iotx_time_left(&timer))
+                                         : iotx_time_left(&timer), client_data);
+    }
+
     client_data->response_received_len += len;
     return httpclient_retrieve_content(client, data, len, iotx_time_left(&timer), client_data);
 }
@@ -710,19 +1262,20 @@ int httpclient_send_request(httpclient_t *client, const char *url, HTTPCLIENT_RE
                             httpclient_data_t *client_data)
 {
     int ret = ERROR_HTTP_CONN;
+    int body_sent = IOT_FALSE;
 
     if (0 == client->net.handle) {
         log_debug("not connection have been established");
         return ret;
     }
 
-    ret = httpclient_send_header(client, url, method, client_data);
+    ret = httpclient_send_header(client, url, method, client_data, &body_sent);
     if (ret != 0) {
         log_err("httpclient_send_header is error,ret = %d", ret);
         return ret;
     }
 
-    if (method == HTTPCLIENT_POST || method == HTTPCLIENT_PUT) {
+    if (!body_sent && (method == HTTPCLIENT_POST || method == HTTPCLIENT_PUT)) {
         ret = httpclient_send_userdata(client, client_data);
     }
 
@@ -744,8 +1297,12 @@ int httpclient_recv_response(httpclient_t *client, uint32_t timeout_ms, httpclie
     }
 
     if (client_data->is_more) {
-        client_data->response_buf[0] = '\0';
-        ret = httpclient_retrieve_content(client, buf, reclen, iotx_time_left(&timer), client_data);
+        if (NULL != client_data->body_cb) {
+            ret = httpclient_stream_content(client, buf, reclen, iotx_time_left(&timer), client_data);
+        } else {
+            client_data->response_buf[0] = '\0';
+            ret = httpclient_retrieve_content(client, buf, reclen, iotx_time_left(&timer), client_data);
+        }
     } else {
         client_data->is_more = 1;
         /* try to read header */
@@ -771,6 +1328,11 @@ void httpclient_close(httpclient_t *client)
         client->net.disconnect(&client->net);
     }
     client->net.handle = 0;
+    if (NULL != client->carry_buf) {
+        HAL_Free(client->carry_buf);
+        client->carry_buf = NULL;
+    }
+    client->carry_len = 0;
     log_debug("client disconnected");
 }
 
@@ -813,8 +1375,8 @@ int httpclient_common(httpclient_t *client, const char *url, int port, const cha
     iotx_time_init(&timer);
     utils_time_countdown_ms(&timer, timeout_ms);
 
-    if ((NULL != client_data->response_buf)
-        && (0 != client_data->response_buf_len)) {
+    if (((NULL != client_data->response_buf) && (0 != client_data->response_buf_len))
+        || (NULL != client_data->body_cb)) {
         ret = httpclient_recv_response(client, iotx_time_left(&timer), client_data);
         if (ret < 0) {
             log_err("httpclient_recv_response is error,ret = %d", ret);
@@ -84,8 +84,15 @@ typedef struct {
     char               *header;         /**< Custom header. */
     char               *auth_user;      /**< Username for basic authentication. */
     char               *auth_password;  /**< Password for basic authentication. */
+    int                 conn_close;     /**< Server sent "Connection: close" with the last response. */
+    char               *carry_buf;      /**< Bytes read past the end of the last response, the start of the next pipelined one. */
+    int                 carry_len;      /**< Length of the data in carry_buf. */
 } httpclient_t;
 
+/** @brief   This callback receives a piece of the response body, it points into the receive buffer or the
+ *           connection's own and is only valid during the call. Return a negative value to abort the response. */
+typedef int (*httpclient_body_cb_t)(void *user, const char *data, int len);
+
 /** @brief   This structure defines the HTTP data structure.  */
 typedef struct {
     int     is_more;                /**< Indicates if more data needs to be retrieved. */
@@ -98,8 +105,54 @@ typedef struct {
     char   *post_content_type;      /**< Content type of the post data. */
     char   *post_buf;               /**< User data to be posted. */
     char   *response_buf;           /**< Buffer to store the response data. */
+    httpclient_body_cb_t body_cb;   /**< Streaming mode if set, the body is passed to it instead of response_buf. */
+    void   *body_user;              /**< User data of body_cb. */
+    int     stream_state;           /**< Body decoder state in streaming mode. */
+    int     stream_line;            /**< Progress in the current chunk-size, CRLF or trailer line. */
+    uint32_t body_timeout_ms;       /**< Streaming mode: time left to read the body in the call that read the
+                                         header, 0 for all of its timeout. */
 } httpclient_data_t;
 
+/** @brief   Max header fields recorded by the response header parser, the rest are parsed but not kept. */
+#define HTTPCLIENT_MAX_HEADERS      (16)
+
+/** @brief   This structure records one header field as offsets into the header block. */
+typedef struct {
+    uint16_t    name;
+    uint16_t    name_len;
+    uint16_t    value;
+    uint16_t    value_len;
+} httpclient_header_t;
+
+/** @brief   This structure defines the resumable response header parser. */
+typedef struct {
+    int                 state;
+    int                 offset;             /**< Bytes of the header block consumed so far. */
+    int                 mark;               /**< Start of the token being parsed. */
+    int                 field;              /**< Kind of the header field being parsed. */
+    int                 status_code;
+    int                 content_length;     /**< -1 if there is no Content-Length. */
+    int                 is_chunked;
+    int                 conn_close;
+    int                 header_num;
+    httpclient_header_t headers[HTTPCLIENT_MAX_HEADERS];
+} httpclient_parser_t;
+
+void httpclient_parser_init(httpclient_parser_t *parser);
+
+/**
+ * @brief   Parse the response header block in buf, which holds all bytes received so far.
+ *          Only the bytes added since the last call are looked at, each of them once.
+ *
+ * @retval  >0 : Length of the header block, the body starts after it.
+ * @retval   0 : Incomplete, call again when more bytes are appended to buf.
+ * @retval  <0 : Not a valid HTTP/1.x response header.
+ */
+int httpclient_parser_execute(httpclient_parser_t *parser, const char *buf, int len);
+
+/** @brief   Find a recorded header field by name (case-insensitive), return its value length or -1. */
+int httpclient_parser_find(httpclient_parser_t *parser, const char *buf, const char *name, const char **value);
+
 int iotx_post(httpclient_t *client,
               const char *url,
               int port,
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "json_parser.h"
+#include "utils_jsondiff.h"
+#include "lite-log.h"
+
+typedef struct {
+    const char         *key;
+    int                 key_len;
+    const char         *value;
+    int                 value_len;
+    int                 value_type;
+    int                 seen;           /* in the new object too */
+} utils_json_kv_t;
+
+static int _json_key_cmp(const char *a, int a_len, const char *b, int b_len)
+{
+    int ret = memcmp(a, b, (a_len < b_len) ? a_len : b_len);
+
+    return ret ? ret : (a_len - b_len);
+}
+
+static int _json_kv_cmp(const void *a, const void *b)
+{
+    const utils_json_kv_t *x = a, *y = b;
+
+    return _json_key_cmp(x->key, x->key_len, y->key, y->key_len);
+}
+
+/* The top level keys of the object sorted, so each key of the other one is found by bisection */
+static utils_json_kv_t *_json_index(const char *json, int len, int *num)
+{
+    char *pos, *key, *val;
+    int klen, vlen, vtype, n = 0;
+    utils_json_kv_t *kv;
+
+    *num = 0;
+    json_object_for_each_kv((char *)json, len, pos, key, klen, val, vlen, vtype) {
+        n++;
+    }
+    if (0 == n) {
+        return NULL;
+    }
+
+    kv = HAL_Malloc(n * sizeof(utils_json_kv_t));
+    if (NULL == kv) {
+        return NULL;
+    }
+
+    json_object_for_each_kv((char *)json, len, pos, key, klen, val, vlen, vtype) {
+        if (*num >= n) {
+            break;
+        }
+        kv[*num].key = key;
+        kv[*num].key_len = klen;
+        kv[*num].value = val;
+        kv[*num].value_len = vlen;
+        kv[*num].value_type = vtype;
+        kv[*num].seen = 0;
+        (*num)++;
+    }
+
+    qsort(kv, *num, sizeof(utils_json_kv_t), _json_kv_cmp);
+    return kv;
+}
+
+static utils_json_kv_t *_json_find(utils_json_kv_t *kv, int num, const char *key, int key_len)
+{
+    int low = 0, high = num - 1, mid, ret;
+
+    while (low <= high) {
+        mid = low + (high - low) / 2;
+        ret = _json_key_cmp(kv[mid].key, kv[mid].key_len, key, key_len);
+        if (0 == ret) {
+            return &kv[mid];
+        }
+        if (ret < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return NULL;
+}
+
+int utils_json_diff(const char *old_json, int old_len, const char *new_json, int new_len,
+                    utils_json_diff_cb_t cb, void *user)
+{
+    char *pos, *key, *val;
+    int klen, vlen, vtype, i, num = 0, changed = 0;
+    utils_json_kv_t *old_kv = NULL, *found;
+
+    if (NULL == new_json || NULL == json_get_object(JOBJECT, (char *)new_json, (char *)new_json + new_len)) {
+        return -1;
+    }
+
+    if (NULL != old_json) {
+        old_kv = _json_index(old_json, old_len, &num);
+    }
+
+    json_object_for_each_kv((char *)new_json, new_len, pos, key, klen, val, vlen, vtype) {
+        found = _json_find(old_kv, num, key, klen);
+        if (NULL != found) {
+            found->seen = 1;
+            if (found->value_type == vtype && found->value_len == vlen && 0 == memcmp(found->value, val, vlen)) {
+                continue;
+            }
+        }
+        cb(user, key, klen, val, vlen);
+        changed++;
+    }
+
+    for (i = 0; i < num; i++) {
+        if (!old_kv[i].seen) {
+            cb(user, old_kv[i].key, old_kv[i].key_len, NULL, 0);
+            changed++;
+        }
+    }
+
+    if (NULL != old_kv) {
+        HAL_Free(old_kv);
+    }
+    return changed;
+}
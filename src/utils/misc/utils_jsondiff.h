@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+
+#ifndef _IOTX_COMMON_JSONDIFF_H_
+#define _IOTX_COMMON_JSONDIFF_H_
+
+/* Called for a key added or changed, 'value' is NULL if the key is removed.
+ * A string value is passed without its quotes, any other value as it is. */
+typedef void (*utils_json_diff_cb_t)(void *user, const char *key, int key_len, const char *value, int value_len);
+
+/*
+ * Compare the top level keys of two JSON objects, each ended by a '\0'.
+ * 'old_json' may be NULL, then all keys of 'new_json' are added.
+ * Return the number of keys passed to 'cb', -1 if 'new_json' is not an object.
+ */
+int utils_json_diff(const char *old_json, int old_len, const char *new_json, int new_len,
+                    utils_json_diff_cb_t cb, void *user);
+
+#endif /* _IOTX_COMMON_JSONDIFF_H_ */
@@ -20,20 +20,117 @@
 
 #include "iot_import.h"
 #include "utils_net.h"
+#include "utils_timer.h"
 #include "lite-log.h"
 
+#define UTILS_NET_GATHER_SIZE       (1024)  /* largest message joined when the HAL cannot gather */
+#define UTILS_NET_READ_AHEAD_SIZE   (1024)  /* bytes taken per refill, reads this large bypass it */
+
 /*** TCP connection ***/
+
+/* Serve small reads from the read-ahead buffer. It is refilled with one
+ * non-blocking receive of whatever has arrived, so a fixed header, the
+ * remaining length and a short payload cost one syscall together. Waiting
+ * is left to HAL_TCP_Read(), so the call still blocks until 'len' bytes
+ * arrive or 'timeout_ms' expires, and 0 still means poll once. */
 int read_tcp(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms)
 {
-    return HAL_TCP_Read(pNetwork->handle, buffer, len, timeout_ms);
+    int ret = 0;
+    uint32_t copied = 0, n;
+    iotx_time_t timer;
+
+    if (NULL == pNetwork->rbuf) {
+        return HAL_TCP_Read(pNetwork->handle, buffer, len, timeout_ms);
+    }
+
+    iotx_time_init(&timer);
+    utils_time_countdown_ms(&timer, timeout_ms);
+
+    while (copied < len) {
+        if (pNetwork->rbuf_len > 0) {
+            n = (len - copied < pNetwork->rbuf_len) ? len - copied : pNetwork->rbuf_len;
+            memcpy(buffer + copied, pNetwork->rbuf + pNetwork->rbuf_off, n);
+            pNetwork->rbuf_off += n;
+            pNetwork->rbuf_len -= n;
+            copied += n;
+            continue;
+        }
+
+        if (0 != timeout_ms && (pNetwork->rbuf_drained || len - copied >= UTILS_NET_READ_AHEAD_SIZE)) {
+            /* nothing to take ahead, wait for the missing bytes in place */
+            ret = HAL_TCP_Read(pNetwork->handle, buffer + copied, len - copied, iotx_time_left(&timer));
+            pNetwork->rbuf_drained = 0;
+            if (ret > 0) {
+                copied += ret;
+            }
+            break;
+        }
+
+        ret = HAL_TCP_Read(pNetwork->handle, pNetwork->rbuf, UTILS_NET_READ_AHEAD_SIZE, 0);
+        if (0 == ret && 0 != timeout_ms) {
+            pNetwork->rbuf_drained = 1;
+            continue;
+        } else if (ret <= 0) {
+            break;
+        }
+        pNetwork->rbuf_drained = (ret < UTILS_NET_READ_AHEAD_SIZE);
+        pNetwork->rbuf_off = 0;
+        pNetwork->rbuf_len = ret;
+    }
+
+    /* as HAL_TCP_Read(), data first, an error is reported by the next call */
+    return (0 != copied) ? (int)copied : ret;
 }
 
+/* Lend the data from the read-ahead buffer. It is refilled as in read_tcp(),
+ * or when nothing has arrived, by waiting for one byte and taking whatever
+ * else has arrived with it. */
+static int readview_tcp(utils_network_pt pNetwork, const char **data, uint32_t len, uint32_t timeout_ms)
+{
+    int ret = 0;
+
+    if (0 == pNetwork->rbuf_len) {
+        if (!pNetwork->rbuf_drained || 0 == timeout_ms) {
+            ret = HAL_TCP_Read(pNetwork->handle, pNetwork->rbuf, UTILS_NET_READ_AHEAD_SIZE, 0);
+        }
+        if (0 == ret && 0 != timeout_ms) {
+            ret = HAL_TCP_Read(pNetwork->handle, pNetwork->rbuf, 1, timeout_ms);
+            if (ret > 0) {
+                ret = HAL_TCP_Read(pNetwork->handle, pNetwork->rbuf + 1, UTILS_NET_READ_AHEAD_SIZE - 1, 0);
+                /* an error is reported by the next call */
+                ret = (ret > 0) ? ret + 1 : 1;
+            }
+        }
+        if (ret <= 0) {
+            pNetwork->rbuf_drained = 1;
+            return ret;
+        }
+        pNetwork->rbuf_drained = (ret < UTILS_NET_READ_AHEAD_SIZE);
+        pNetwork->rbuf_off = 0;
+        pNetwork->rbuf_len = ret;
+    }
+
+    if (len > pNetwork->rbuf_len) {
+        len = pNetwork->rbuf_len;
+    }
+    *data = pNetwork->rbuf + pNetwork->rbuf_off;
+    pNetwork->rbuf_off += len;
+    pNetwork->rbuf_len -= len;
+    return len;
+}
 
 static int write_tcp(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
 {
     return HAL_TCP_Write(pNetwork->handle, buffer, len, timeout_ms);
 }
 
+#ifdef IOTX_WRITEV_SUPPORT
+static int writev_tcp(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    return HAL_TCP_Writev(pNetwork->handle, iov, iovcnt, timeout_ms);
+}
+#endif
+
 static int disconnect_tcp(utils_network_pt pNetwork)
 {
     if (0 == pNetwork->handle) {
@@ -42,6 +139,13 @@ static int disconnect_tcp(utils_network_pt pNetwork)
 
     HAL_TCP_Destroy(pNetwork->handle);
     pNetwork->handle = 0;
+
+    /* whatever was read ahead belongs to the closed connection */
+    if (NULL != pNetwork->rbuf) {
+        HAL_Free(pNetwork->rbuf);
+        pNetwork->rbuf = NULL;
+    }
+    pNetwork->rbuf_len = 0;
     return 0;
 }
 
@@ -57,6 +161,15 @@ static int connect_tcp(utils_network_pt pNetwork)
         return -1;
     }
 
+    /* reads are left unbuffered if there is no memory for it */
+    if (NULL == pNetwork->rbuf) {
+        pNetwork->rbuf = HAL_Malloc(UTILS_NET_READ_AHEAD_SIZE);
+    }
+    pNetwork->rbuf_off = 0;
+    pNetwork->rbuf_len = 0;
+    pNetwork->rbuf_drained = 1;
+    pNetwork->readview = (NULL != pNetwork->rbuf) ? utils_net_readview : NULL;
+
     return 0;
 }
 
@@ -82,6 +195,30 @@ static int write_ssl(utils_network_pt pNetwork, const char *buffer, uint32_t len
     return HAL_SSL_Write((uintptr_t)pNetwork->handle, buffer, len, timeout_ms);
 }
 
+#ifdef IOTX_WRITEV_SUPPORT
+static int writev_ssl(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        log_err("network is null");
+        return -1;
+    }
+
+    return HAL_SSL_Writev((uintptr_t)pNetwork->handle, iov, iovcnt, timeout_ms);
+}
+#endif
+
+#ifdef IOTX_READ_VIEW_SUPPORT
+static int readview_ssl(utils_network_pt pNetwork, const char **data, uint32_t len, uint32_t timeout_ms)
+{
+    if (NULL == pNetwork) {
+        log_err("network is null");
+        return -1;
+    }
+
+    return HAL_SSL_ReadView((uintptr_t)pNetwork->handle, data, len, timeout_ms);
+}
+#endif
+
 static int disconnect_ssl(utils_network_pt pNetwork)
 {
     if (NULL == pNetwork) {
@@ -199,6 +336,28 @@ int utils_net_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32
     return ret;
 }
 
+/* Read at most 'len' bytes, fewer than asked if that is what is at hand, and point
+ * '*data' at them in place. They stay valid until the next read on 'pNetwork'. */
+int utils_net_readview(utils_network_pt pNetwork, const char **data, uint32_t len, uint32_t timeout_ms)
+{
+    int     ret = 0;
+
+    if (NULL == pNetwork->ca_crt && NULL == pNetwork->product_key && NULL != pNetwork->rbuf) {
+        ret = readview_tcp(pNetwork, data, len, timeout_ms);
+    }
+#if !defined(IOTX_WITHOUT_TLS) && defined(IOTX_READ_VIEW_SUPPORT)
+    else if (NULL != pNetwork->ca_crt && NULL == pNetwork->product_key) {
+        ret = readview_ssl(pNetwork, data, len, timeout_ms);
+    }
+#endif
+    else {
+        ret = -1;
+        log_err("no method match!");
+    }
+
+    return ret;
+}
+
 int utils_net_write(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms)
 {
     int     ret = 0;
@@ -224,6 +383,61 @@ int utils_net_write(utils_network_pt pNetwork, const char *buffer, uint32_t len,
     return ret;
 }
 
+/* Without a gathering HAL, join small messages so that a header and its
+ * payload still leave in one segment instead of waiting on delayed ACK */
+static int writev_copy(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    int ret = 0;
+    uint32_t i, len = 0, sent = 0;
+    char buf[UTILS_NET_GATHER_SIZE];
+
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+
+    if (len <= sizeof(buf)) {
+        for (i = 0; i < iovcnt; i++) {
+            memcpy(buf + sent, iov[i].buf, iov[i].len);
+            sent += iov[i].len;
+        }
+        return utils_net_write(pNetwork, buf, len, timeout_ms);
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        ret = utils_net_write(pNetwork, iov[i].buf, iov[i].len, timeout_ms);
+        if (ret <= 0) {
+            return (sent > 0) ? (int)sent : ret;
+        }
+        sent += ret;
+        if (ret < (int)iov[i].len) {
+            break;
+        }
+    }
+    return sent;
+}
+
+int utils_net_writev(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms)
+{
+    int     ret = 0;
+
+#ifdef IOTX_WRITEV_SUPPORT
+    if (NULL == pNetwork->ca_crt && NULL == pNetwork->product_key) {
+        ret = writev_tcp(pNetwork, iov, iovcnt, timeout_ms);
+    }
+#ifndef IOTX_WITHOUT_TLS
+    else if (NULL != pNetwork->ca_crt && NULL == pNetwork->product_key) {
+        ret = writev_ssl(pNetwork, iov, iovcnt, timeout_ms);
+    }
+#endif
+    else
+#endif
+    {
+        ret = writev_copy(pNetwork, iov, iovcnt, timeout_ms);
+    }
+
+    return ret;
+}
+
 int iotx_net_disconnect(utils_network_pt pNetwork)
 {
     int     ret = 0;
@@ -296,8 +510,20 @@ int iotx_net_init(utils_network_pt pNetwork, const char *host, uint16_t port, co
     }
 
     pNetwork->handle = 0;
+    pNetwork->rbuf = NULL;
+    pNetwork->rbuf_off = 0;
+    pNetwork->rbuf_len = 0;
+    pNetwork->rbuf_drained = 0;
     pNetwork->read = utils_net_read;
+    /* a TCP connection lends from its read-ahead buffer, set when connected */
+    pNetwork->readview = NULL;
+#if !defined(IOTX_WITHOUT_TLS) && defined(IOTX_READ_VIEW_SUPPORT)
+    if (NULL != ca_crt && NULL == pNetwork->product_key) {
+        pNetwork->readview = utils_net_readview;
+    }
+#endif
     pNetwork->write = utils_net_write;
+    pNetwork->writev = utils_net_writev;
     pNetwork->disconnect = iotx_net_disconnect;
     pNetwork->connect = iotx_net_connect;
 
@@ -44,12 +44,25 @@ struct utils_network {
     /**< connection handle: 0, NOT connection; NOT 0, handle of the connection */
     uintptr_t handle;
 
+    /**< bytes received ahead of the reader, TCP connection only */
+    char *rbuf;
+    uint16_t rbuf_off;
+    uint16_t rbuf_len;
+    /**< the last refill emptied the socket, wait in the HAL before polling again */
+    uint8_t rbuf_drained;
+
     /**< Read data from server function pointer. */
     int (*read)(utils_network_pt, char *, uint32_t, uint32_t);
 
+    /**< Borrow received data instead of copying it function pointer, NULL if the connection can not lend it. */
+    int (*readview)(utils_network_pt, const char **, uint32_t, uint32_t);
+
     /**< Send data to server function pointer. */
     int (*write)(utils_network_pt, const char *, uint32_t, uint32_t);
 
+    /**< Send several buffers to server as one message function pointer. */
+    int (*writev)(utils_network_pt, const hal_iovec_t *, uint32_t, uint32_t);
+
     /**< Disconnect the network */
     int (*disconnect)(utils_network_pt);
 
@@ -59,7 +72,9 @@ struct utils_network {
 
 
 int utils_net_read(utils_network_pt pNetwork, char *buffer, uint32_t len, uint32_t timeout_ms);
+int utils_net_readview(utils_network_pt pNetwork, const char **data, uint32_t len, uint32_t timeout_ms);
 int utils_net_write(utils_network_pt pNetwork, const char *buffer, uint32_t len, uint32_t timeout_ms);
+int utils_net_writev(utils_network_pt pNetwork, const hal_iovec_t *iov, uint32_t iovcnt, uint32_t timeout_ms);
 int iotx_net_disconnect(utils_network_pt pNetwork);
 int iotx_net_connect(utils_network_pt pNetwork);
 int iotx_net_init(utils_network_pt pNetwork, const char *host, uint16_t port, const char *ca_crt, char *product_key);
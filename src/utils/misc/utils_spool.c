@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#ifdef IOTX_SPOOL_SUPPORT
+
+#include <stdio.h>
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_spool.h"
+#include "utils_crc32.h"
+#include "lite-log.h"
+
+#define UTILS_SPOOL_MAGIC               (0x53504F4C)    /* "SPOL" */
+#define UTILS_SPOOL_SEG_MAX             (256)           /* segments of a spool */
+#define UTILS_SPOOL_SEGMENT_DEFAULT     (64 * 1024)
+#define UTILS_SPOOL_BATCH_MAX           (64)            /* records passed to one callback */
+#define UTILS_SPOOL_IOV_MAX             (8)             /* buffers of one record */
+#define UTILS_SPOOL_HDR_LEN             (8)             /* length and CRC */
+#define UTILS_SPOOL_NAME_LEN            (20)            /* "/spool.4294967295" */
+#define UTILS_SPOOL_INDEX_SEG           (0xFFFFFFFF)    /* names the index in _spool_path() */
+
+/* The positions, stored to the mapped index file as they change */
+typedef struct {
+    uint32_t                    magic;
+    uint32_t                    segment_size;
+    uint32_t                    head_seg;       /* the oldest segment */
+    uint32_t                    head_off;       /* its first record not replayed */
+    uint32_t                    head_rec;       /* its records replayed */
+    uint32_t                    tail_seg;       /* the segment appended to */
+    uint32_t                    tail_off;       /* the end of its last record */
+    uint32_t                    dropped;
+    uint32_t                    seg_records[UTILS_SPOOL_SEG_MAX];   /* records by segment modulo UTILS_SPOOL_SEG_MAX */
+} utils_spool_index_t;
+
+struct utils_spool_st {
+    utils_spool_index_t        *index;
+    void                       *index_fp;
+    void                       *tail_fp;
+    void                       *head_fp;        /* open while the head is not the tail */
+    uint32_t                    head_fp_seg;
+    uint32_t                    seg_num;        /* segments kept at most */
+    uint32_t                    segment_size;
+    utils_spool_policy_t        policy;
+    char                       *buf;            /* 'segment_size' bytes, to read records */
+    char                       *path;           /* the directory, a file name is printed after it */
+    uint32_t                    dir_len;
+};
+
+static const char *_spool_path(utils_spool_t *spool, uint32_t seg)
+{
+    if (UTILS_SPOOL_INDEX_SEG == seg) {
+        HAL_Snprintf(spool->path + spool->dir_len, UTILS_SPOOL_NAME_LEN, "/spool.idx");
+    } else {
+        HAL_Snprintf(spool->path + spool->dir_len, UTILS_SPOOL_NAME_LEN, "/spool.%u", (unsigned int)seg);
+    }
+    return spool->path;
+}
+
+/* Length of the record at 'p' with its header, 0 if it is incomplete or corrupted */
+static uint32_t _spool_record_len(const char *p, uint32_t avail)
+{
+    uint32_t len, crc;
+
+    if (avail < UTILS_SPOOL_HDR_LEN) {
+        return 0;
+    }
+    memcpy(&len, p, sizeof(len));
+    memcpy(&crc, p + sizeof(len), sizeof(crc));
+    if (len > avail - UTILS_SPOOL_HDR_LEN
+        || crc != utils_crc32(utils_crc32(0, p, sizeof(len)), p + UTILS_SPOOL_HDR_LEN, len)) {
+        return 0;
+    }
+    return UTILS_SPOOL_HDR_LEN + len;
+}
+
+/* Count the records of the tail segment again and cut what follows them. The
+ * segment is not longer than a buffer, so this is one read. */
+static int _spool_recover(utils_spool_t *spool)
+{
+    utils_spool_index_t *idx = spool->index;
+    uint32_t pos = 0, len, records = 0, head_rec = 0;
+    int32_t size;
+
+    size = HAL_File_Read(spool->tail_fp, 0, spool->buf, spool->segment_size);
+    if (size < 0) {
+        return -1;
+    }
+    while (0 != (len = _spool_record_len(spool->buf + pos, size - pos))) {
+        if (idx->head_seg == idx->tail_seg && pos < idx->head_off) {
+            head_rec++;
+        }
+        pos += len;
+        records++;
+    }
+    if (HAL_File_Size(spool->tail_fp) != (int32_t)pos && 0 != HAL_File_Truncate(spool->tail_fp, pos)) {
+        return -1;
+    }
+    if (pos != idx->tail_off) {
+        log_info("spool recovered %u records of segment %u", records, idx->tail_seg);
+    }
+
+    idx->seg_records[idx->tail_seg % UTILS_SPOOL_SEG_MAX] = records;
+    idx->tail_off = pos;
+    if (idx->head_seg == idx->tail_seg) {
+        idx->head_rec = head_rec;
+        if (idx->head_off > pos) {
+            idx->head_off = pos;
+        }
+    }
+    return 0;
+}
+
+utils_spool_t *utils_spool_open(const utils_spool_param_t *param)
+{
+    utils_spool_t *spool;
+    utils_spool_index_t *idx;
+    uint32_t dir_len;
+    int fresh;
+
+    if (NULL == param || NULL == param->dir) {
+        return NULL;
+    }
+    dir_len = strlen(param->dir);
+
+    spool = HAL_Malloc(sizeof(utils_spool_t) + dir_len + UTILS_SPOOL_NAME_LEN);
+    if (NULL == spool) {
+        return NULL;
+    }
+    memset(spool, 0, sizeof(utils_spool_t));
+    spool->path = (char *)(spool + 1);
+    memcpy(spool->path, param->dir, dir_len);
+    spool->dir_len = dir_len;
+    spool->policy = param->policy;
+    spool->segment_size = param->segment_size ? param->segment_size : UTILS_SPOOL_SEGMENT_DEFAULT;
+    spool->seg_num = param->max_size / spool->segment_size;
+    spool->seg_num = (spool->seg_num < 2) ? 2 : (spool->seg_num > UTILS_SPOOL_SEG_MAX) ? UTILS_SPOOL_SEG_MAX : spool->seg_num;
+
+    spool->buf = HAL_Malloc(spool->segment_size);
+    spool->index_fp = HAL_File_Open(_spool_path(spool, UTILS_SPOOL_INDEX_SEG), 0);
+    if (NULL == spool->buf || NULL == spool->index_fp
+        || NULL == (spool->index = HAL_File_Map(spool->index_fp, sizeof(utils_spool_index_t)))) {
+        goto failed;
+    }
+
+    idx = spool->index;
+    fresh = (UTILS_SPOOL_MAGIC != idx->magic || spool->segment_size != idx->segment_size
+             || idx->tail_seg - idx->head_seg >= UTILS_SPOOL_SEG_MAX);
+    if (fresh) {
+        memset(idx, 0, sizeof(utils_spool_index_t));
+        idx->segment_size = spool->segment_size;
+        idx->magic = UTILS_SPOOL_MAGIC;
+    }
+
+    spool->tail_fp = HAL_File_Open(_spool_path(spool, idx->tail_seg), fresh);
+    if (NULL == spool->tail_fp || 0 != _spool_recover(spool)) {
+        goto failed;
+    }
+    return spool;
+
+failed:
+    log_err("open spool in %s failed", param->dir);
+    utils_spool_close(spool);
+    return NULL;
+}
+
+void utils_spool_close(utils_spool_t *spool)
+{
+    if (NULL == spool) {
+        return;
+    }
+    if (NULL != spool->head_fp) {
+        HAL_File_Close(spool->head_fp);
+    }
+    if (NULL != spool->tail_fp) {
+        HAL_File_Close(spool->tail_fp);
+    }
+    if (NULL != spool->index) {
+        HAL_File_Unmap(spool->index, sizeof(utils_spool_index_t));
+    }
+    if (NULL != spool->index_fp) {
+        HAL_File_Close(spool->index_fp);
+    }
+    HAL_Free(spool->buf);
+    HAL_Free(spool);
+}
+
+/* Remove the head segment, replayed or not */
+static void _spool_next_head(utils_spool_t *spool)
+{
+    utils_spool_index_t *idx = spool->index;
+
+    if (NULL != spool->head_fp) {
+        HAL_File_Close(spool->head_fp);
+        spool->head_fp = NULL;
+    }
+    HAL_File_Remove(_spool_path(spool, idx->head_seg));
+
+    idx->head_off = 0;
+    idx->head_rec = 0;
+    idx->seg_records[idx->head_seg % UTILS_SPOOL_SEG_MAX] = 0;
+    idx->head_seg++;
+}
+
+/* Start a new tail segment, making room for it by the policy */
+static int _spool_next_tail(utils_spool_t *spool)
+{
+    utils_spool_index_t *idx = spool->index;
+    void *fp;
+
+    if (idx->tail_seg - idx->head_seg + 1 >= spool->seg_num) {
+        if (UTILS_SPOOL_DROP_NEWEST == spool->policy) {
+            return -1;
+        }
+        idx->dropped += idx->seg_records[idx->head_seg % UTILS_SPOOL_SEG_MAX] - idx->head_rec;
+        _spool_next_head(spool);
+    }
+
+    /* a file left by an earlier spool is emptied */
+    fp = HAL_File_Open(_spool_path(spool, idx->tail_seg + 1), 1);
+    if (NULL == fp) {
+        return -1;
+    }
+    HAL_File_Close(spool->tail_fp);
+    spool->tail_fp = fp;
+
+    idx->seg_records[(idx->tail_seg + 1) % UTILS_SPOOL_SEG_MAX] = 0;
+    idx->tail_off = 0;
+    idx->tail_seg++;
+    return 0;
+}
+
+int utils_spool_append(utils_spool_t *spool, const hal_iovec_t *iov, uint32_t iovcnt)
+{
+    utils_spool_index_t *idx = spool->index;
+    hal_iovec_t vec[UTILS_SPOOL_IOV_MAX + 1];
+    char hdr[UTILS_SPOOL_HDR_LEN];
+    uint32_t i, len = 0, crc;
+
+    if (iovcnt > UTILS_SPOOL_IOV_MAX) {
+        return -1;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        len += iov[i].len;
+    }
+    if (len > spool->segment_size - UTILS_SPOOL_HDR_LEN) {
+        log_err("record of %u bytes exceeds the spool segment", len);
+        return -1;
+    }
+
+    if (idx->tail_off + UTILS_SPOOL_HDR_LEN + len > spool->segment_size && 0 != _spool_next_tail(spool)) {
+        idx->dropped++;
+        return -1;
+    }
+
+    memcpy(hdr, &len, sizeof(len));
+    crc = utils_crc32(0, hdr, sizeof(len));
+    for (i = 0; i < iovcnt; i++) {
+        crc = utils_crc32(crc, iov[i].buf, iov[i].len);
+        vec[i + 1] = iov[i];
+    }
+    memcpy(hdr + sizeof(len), &crc, sizeof(crc));
+    vec[0].buf = hdr;
+    vec[0].len = UTILS_SPOOL_HDR_LEN;
+
+    if (HAL_File_Append(spool->tail_fp, vec, iovcnt + 1) != (int32_t)(UTILS_SPOOL_HDR_LEN + len)) {
+        HAL_File_Truncate(spool->tail_fp, idx->tail_off);
+        return -1;
+    }
+
+    /* a crash before these stores is repaired by _spool_recover() */
+    idx->seg_records[idx->tail_seg % UTILS_SPOOL_SEG_MAX]++;
+    idx->tail_off += UTILS_SPOOL_HDR_LEN + len;
+    return 0;
+}
+
+int utils_spool_replay(utils_spool_t *spool, utils_spool_cb_t cb, void *user)
+{
+    utils_spool_index_t *idx = spool->index;
+    hal_iovec_t records[UTILS_SPOOL_BATCH_MAX];
+    uint32_t lens[UTILS_SPOOL_BATCH_MAX];
+    uint32_t pos, end, len, count, i;
+    int32_t size;
+    int total = 0, done;
+    void *fp;
+
+    for (;;) {
+        if (idx->head_seg == idx->tail_seg) {
+            fp = spool->tail_fp;
+            end = idx->tail_off;
+        } else {
+            if (NULL == spool->head_fp || spool->head_fp_seg != idx->head_seg) {
+                if (NULL != spool->head_fp) {
+                    HAL_File_Close(spool->head_fp);
+                }
+                spool->head_fp = HAL_File_Open(_spool_path(spool, idx->head_seg), 0);
+                spool->head_fp_seg = idx->head_seg;
+                if (NULL == spool->head_fp) {
+                    return total ? total : -1;
+                }
+            }
+            fp = spool->head_fp;
+            size = HAL_File_Size(fp);
+            end = (size < 0) ? 0 : (size > (int32_t)spool->segment_size) ? spool->segment_size : (uint32_t)size;
+        }
+
+        if (idx->head_off >= end) {
+            if (idx->head_seg != idx->tail_seg) {
+                _spool_next_head(spool);
+                continue;
+            }
+            /* all replayed, the tail segment is reused. Cut first, so a crash
+             * between the two finds no records rather than replayed ones. */
+            if (0 != idx->tail_off && 0 == HAL_File_Truncate(spool->tail_fp, 0)) {
+                idx->seg_records[idx->tail_seg % UTILS_SPOOL_SEG_MAX] = 0;
+                idx->head_off = 0;
+                idx->head_rec = 0;
+                idx->tail_off = 0;
+            }
+            return total;
+        }
+
+        size = HAL_File_Read(fp, idx->head_off, spool->buf, end - idx->head_off);
+        if (size < 0) {
+            return total ? total : -1;
+        }
+
+        for (pos = 0; ;) {
+            for (count = 0; count < UTILS_SPOOL_BATCH_MAX; count++) {
+                len = _spool_record_len(spool->buf + pos, size - pos);
+                if (0 == len) {
+                    break;
+                }
+                records[count].buf = spool->buf + pos + UTILS_SPOOL_HDR_LEN;
+                records[count].len = len - UTILS_SPOOL_HDR_LEN;
+                lens[count] = len;
+                pos += len;
+            }
+            if (0 == count) {
+                break;
+            }
+
+            done = cb(records, count, user);
+            done = (done < 0) ? 0 : ((uint32_t)done > count) ? (int)count : done;
+            for (i = 0; i < (uint32_t)done; i++) {
+                idx->head_off += lens[i];
+            }
+            idx->head_rec += done;
+            total += done;
+            if ((uint32_t)done < count) {
+                return total;
+            }
+        }
+
+        if (0 == pos) {
+            /* nothing after a corrupted record of the segment can be trusted */
+            log_err("spool segment %u is corrupted at %u", idx->head_seg, idx->head_off);
+            idx->dropped += idx->seg_records[idx->head_seg % UTILS_SPOOL_SEG_MAX] - idx->head_rec;
+            idx->head_rec = idx->seg_records[idx->head_seg % UTILS_SPOOL_SEG_MAX];
+            idx->head_off = end;
+            if (idx->head_seg == idx->tail_seg) {
+                idx->tail_off = end;
+            }
+        }
+    }
+}
+
+int utils_spool_sync(utils_spool_t *spool)
+{
+    if (0 != HAL_File_Sync(spool->tail_fp)) {
+        return -1;
+    }
+    return HAL_File_SyncMap(spool->index, sizeof(utils_spool_index_t));
+}
+
+uint32_t utils_spool_count(utils_spool_t *spool)
+{
+    utils_spool_index_t *idx = spool->index;
+    uint32_t seg, count = 0;
+
+    for (seg = idx->head_seg; seg != idx->tail_seg + 1; seg++) {
+        count += idx->seg_records[seg % UTILS_SPOOL_SEG_MAX];
+    }
+    return count - idx->head_rec;
+}
+
+uint32_t utils_spool_dropped(utils_spool_t *spool)
+{
+    return spool->index->dropped;
+}
+
+#endif  /* IOTX_SPOOL_SUPPORT */
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+
+#ifndef _IOTX_COMMON_SPOOL_H_
+#define _IOTX_COMMON_SPOOL_H_
+
+#ifdef IOTX_SPOOL_SUPPORT
+
+#include "iot_import.h"
+
+/*
+ * A spool keeps records on disk in the order appended until they are replayed.
+ * Records are appended to segment files, each with its length and CRC, and a
+ * segment is removed once all its records are replayed. The positions are
+ * kept in an index file mapped to memory, so opening after a crash only
+ * reads the segment appended to again.
+ */
+typedef struct utils_spool_st utils_spool_t;
+
+typedef enum {
+    UTILS_SPOOL_DROP_OLDEST = 0,    /* a full spool removes its oldest segment */
+    UTILS_SPOOL_DROP_NEWEST,        /* a full spool refuses the record */
+} utils_spool_policy_t;
+
+typedef struct {
+    const char                 *dir;            /* the directory of the files, it must exist */
+    uint32_t                    max_size;       /* bytes of all the segments, kept to 2 to 256 segments */
+    uint32_t                    segment_size;   /* bytes of a segment, the largest record is a little smaller */
+    utils_spool_policy_t        policy;
+} utils_spool_param_t;
+
+/* Called with 'count' records in the order appended, return how many of them
+ * are consumed. The rest are passed again by the next utils_spool_replay(). */
+typedef int (*utils_spool_cb_t)(const hal_iovec_t *records, uint32_t count, void *user);
+
+/* The records left by a previous spool in 'dir' are kept if it had the same segment size */
+utils_spool_t *utils_spool_open(const utils_spool_param_t *param);
+
+void utils_spool_close(utils_spool_t *spool);
+
+/* Append the buffers as one record. 0 on success, -1 if refused or on write error. */
+int utils_spool_append(utils_spool_t *spool, const hal_iovec_t *iov, uint32_t iovcnt);
+
+/* Pass the records to 'cb' in batches until it consumes fewer than passed.
+ * Return the number of records consumed, -1 on read error. */
+int utils_spool_replay(utils_spool_t *spool, utils_spool_cb_t cb, void *user);
+
+/* Make the appended records and the positions durable, not only crash safe */
+int utils_spool_sync(utils_spool_t *spool);
+
+/* Records not replayed yet */
+uint32_t utils_spool_count(utils_spool_t *spool);
+
+/* Records dropped as the spool was full or corrupted */
+uint32_t utils_spool_dropped(utils_spool_t *spool);
+
+#endif  /* IOTX_SPOOL_SUPPORT */
+
+#endif /* _IOTX_COMMON_SPOOL_H_ */
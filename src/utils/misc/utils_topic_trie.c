@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+#include <string.h>
+
+#include "iot_import.h"
+#include "utils_topic_trie.h"
+#include "lite-log.h"
+
+#define UTILS_TOPIC_TRIE_TABLE_MIN  (16)    /* buckets, doubled when nodes outnumber them */
+
+typedef struct utils_topic_trie_node_st utils_topic_trie_node_t;
+
+/* Every node but the root is in the hash table, keyed by its parent and
+ * level, so a child is found without scanning its siblings. The wildcard
+ * children are also linked from the parent as they are tried for any level. */
+struct utils_topic_trie_node_st {
+    utils_topic_trie_node_t    *parent;
+    utils_topic_trie_node_t    *hnext;          /* next in the same bucket */
+    utils_topic_trie_node_t    *plus;           /* '+' child */
+    utils_topic_trie_node_t    *hash;           /* '#' child */
+    uint32_t                    hval;
+    uint32_t                    children;
+    void                      **values;
+    uint32_t                    value_num;
+    uint32_t                    value_cap;
+    uint32_t                    len;
+    char                        level[1];       /* 'len' bytes, not terminated */
+};
+
+struct utils_topic_trie_st {
+    utils_topic_trie_node_t     root;
+    utils_topic_trie_node_t   **table;
+    uint32_t                    table_size;     /* a power of 2 */
+    uint32_t                    node_num;
+};
+
+static uint32_t _trie_hash(const utils_topic_trie_node_t *parent, const char *level, uint32_t len)
+{
+    uint32_t h = 2166136261u ^ (uint32_t)((uintptr_t)parent >> 4);
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)level[i]) * 16777619u;
+    }
+    return h;
+}
+
+static utils_topic_trie_node_t *_trie_find(utils_topic_trie_t *trie, const utils_topic_trie_node_t *parent,
+        const char *level, uint32_t len)
+{
+    uint32_t hval = _trie_hash(parent, level, len);
+    utils_topic_trie_node_t *node = trie->table[hval & (trie->table_size - 1)];
+
+    for (; NULL != node; node = node->hnext) {
+        if (node->hval == hval && node->parent == parent && node->len == len && 0 == memcmp(node->level, level, len)) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+static int _trie_grow(utils_topic_trie_t *trie)
+{
+    utils_topic_trie_node_t **table, *node, *next;
+    uint32_t i, size = trie->table_size * 2;
+
+    table = HAL_Malloc(size * sizeof(utils_topic_trie_node_t *));
+    if (NULL == table) {
+        return -1;
+    }
+    memset(table, 0, size * sizeof(utils_topic_trie_node_t *));
+
+    for (i = 0; i < trie->table_size; i++) {
+        for (node = trie->table[i]; NULL != node; node = next) {
+            next = node->hnext;
+            node->hnext = table[node->hval & (size - 1)];
+            table[node->hval & (size - 1)] = node;
+        }
+    }
+    HAL_Free(trie->table);
+    trie->table = table;
+    trie->table_size = size;
+    return 0;
+}
+
+static utils_topic_trie_node_t *_trie_add(utils_topic_trie_t *trie, utils_topic_trie_node_t *parent,
+        const char *level, uint32_t len)
+{
+    utils_topic_trie_node_t *node;
+    uint32_t bucket;
+
+    /* a larger table only makes the chains shorter, so carry on without it */
+    if (trie->node_num >= trie->table_size) {
+        _trie_grow(trie);
+    }
+
+    node = HAL_Malloc(sizeof(utils_topic_trie_node_t) + len);
+    if (NULL == node) {
+        return NULL;
+    }
+    memset(node, 0, sizeof(utils_topic_trie_node_t));
+    node->parent = parent;
+    node->hval = _trie_hash(parent, level, len);
+    node->len = len;
+    memcpy(node->level, level, len);
+
+    bucket = node->hval & (trie->table_size - 1);
+    node->hnext = trie->table[bucket];
+    trie->table[bucket] = node;
+    trie->node_num++;
+    parent->children++;
+
+    if (1 == len && '+' == level[0]) {
+        parent->plus = node;
+    } else if (1 == len && '#' == level[0]) {
+        parent->hash = node;
+    }
+    return node;
+}
+
+/* Unlink empty nodes from 'node' up */
+static void _trie_prune(utils_topic_trie_t *trie, utils_topic_trie_node_t *node)
+{
+    utils_topic_trie_node_t **pp, *parent;
+
+    while (node != &trie->root && 0 == node->value_num && 0 == node->children) {
+        for (pp = &trie->table[node->hval & (trie->table_size - 1)]; *pp != node; pp = &(*pp)->hnext) {
+        }
+        *pp = node->hnext;
+        trie->node_num--;
+
+        parent = node->parent;
+        parent->children--;
+        if (parent->plus == node) {
+            parent->plus = NULL;
+        } else if (parent->hash == node) {
+            parent->hash = NULL;
+        }
+        HAL_Free(node->values);
+        HAL_Free(node);
+        node = parent;
+    }
+}
+
+/* Length of the level at 'p', -1 if it misuses a wildcard */
+static int _trie_level_len(const char *p)
+{
+    const char *end = strchr(p, '/');
+    int len = end ? (int)(end - p) : (int)strlen(p);
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if ('+' == p[i] || '#' == p[i]) {
+            if (1 != len || ('#' == p[i] && NULL != end)) {
+                return -1;
+            }
+        }
+    }
+    return len;
+}
+
+utils_topic_trie_t *utils_topic_trie_new(void)
+{
+    utils_topic_trie_t *trie = HAL_Malloc(sizeof(utils_topic_trie_t));
+
+    if (NULL == trie) {
+        return NULL;
+    }
+    memset(trie, 0, sizeof(utils_topic_trie_t));
+    trie->table_size = UTILS_TOPIC_TRIE_TABLE_MIN;
+    trie->table = HAL_Malloc(trie->table_size * sizeof(utils_topic_trie_node_t *));
+    if (NULL == trie->table) {
+        HAL_Free(trie);
+        return NULL;
+    }
+    memset(trie->table, 0, trie->table_size * sizeof(utils_topic_trie_node_t *));
+    return trie;
+}
+
+void utils_topic_trie_free(utils_topic_trie_t *trie)
+{
+    utils_topic_trie_node_t *node, *next;
+    uint32_t i;
+
+    if (NULL == trie) {
+        return;
+    }
+    for (i = 0; i < trie->table_size; i++) {
+        for (node = trie->table[i]; NULL != node; node = next) {
+            next = node->hnext;
+            HAL_Free(node->values);
+            HAL_Free(node);
+        }
+    }
+    HAL_Free(trie->root.values);
+    HAL_Free(trie->table);
+    HAL_Free(trie);
+}
+
+int utils_topic_trie_insert(utils_topic_trie_t *trie, const char *filter, void *value)
+{
+    utils_topic_trie_node_t *node = &trie->root, *child;
+    const char *p = filter;
+    void **values;
+    int len;
+
+    for (;;) {
+        len = _trie_level_len(p);
+        if (len < 0) {
+            log_err("invalid topic filter: %s", filter);
+            _trie_prune(trie, node);
+            return -1;
+        }
+        child = _trie_find(trie, node, p, len);
+        if (NULL == child) {
+            child = _trie_add(trie, node, p, len);
+            if (NULL == child) {
+                _trie_prune(trie, node);
+                return -1;
+            }
+        }
+        node = child;
+        if ('\0' == p[len]) {
+            break;
+        }
+        p += len + 1;
+    }
+
+    if (node->value_num == node->value_cap) {
+        values = HAL_Malloc((node->value_cap ? node->value_cap * 2 : 1) * sizeof(void *));
+        if (NULL == values) {
+            _trie_prune(trie, node);
+            return -1;
+        }
+        if (node->value_num > 0) {
+            memcpy(values, node->values, node->value_num * sizeof(void *));
+        }
+        HAL_Free(node->values);
+        node->values = values;
+        node->value_cap = node->value_cap ? node->value_cap * 2 : 1;
+    }
+    node->values[node->value_num++] = value;
+    return 0;
+}
+
+int utils_topic_trie_remove(utils_topic_trie_t *trie, const char *filter, void *value)
+{
+    utils_topic_trie_node_t *node = &trie->root;
+    const char *p = filter;
+    uint32_t i;
+    int len;
+
+    for (;;) {
+        len = _trie_level_len(p);
+        if (len < 0 || NULL == (node = _trie_find(trie, node, p, len))) {
+            return -1;
+        }
+        if ('\0' == p[len]) {
+            break;
+        }
+        p += len + 1;
+    }
+
+    for (i = 0; i < node->value_num; i++) {
+        if (node->values[i] == value) {
+            /* keep the order values were inserted in */
+            memmove(&node->values[i], &node->values[i + 1], (node->value_num - i - 1) * sizeof(void *));
+            node->value_num--;
+            _trie_prune(trie, node);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int _trie_report(const utils_topic_trie_node_t *node, utils_topic_trie_cb_t cb, void *user, int *count)
+{
+    uint32_t i;
+
+    for (i = 0; i < node->value_num; i++) {
+        (*count)++;
+        if (0 != cb(node->values[i], user)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Match the levels from 'p' below 'node', 'p' is NULL once all are consumed */
+static int _trie_match(utils_topic_trie_t *trie, const utils_topic_trie_node_t *node, const char *p,
+                       const char *end, utils_topic_trie_cb_t cb, void *user, int *count)
+{
+    const utils_topic_trie_node_t *child;
+    const char *next;
+    uint32_t len;
+    /* a filter starting with a wildcard does not match a topic starting with '$', MQTT 3.1.1 section 4.7.2 */
+    int dollar = (node == &trie->root && NULL != p && p < end && '$' == *p);
+
+    /* '#' also matches the parent level */
+    if (!dollar && NULL != node->hash && _trie_report(node->hash, cb, user, count)) {
+        return 1;
+    }
+    if (NULL == p) {
+        return _trie_report(node, cb, user, count);
+    }
+
+    next = memchr(p, '/', end - p);
+    len = next ? (uint32_t)(next - p) : (uint32_t)(end - p);
+    next = next ? next + 1 : NULL;
+
+    child = _trie_find(trie, node, p, len);
+    if (NULL != child && _trie_match(trie, child, next, end, cb, user, count)) {
+        return 1;
+    }
+    if (!dollar && NULL != node->plus && _trie_match(trie, node->plus, next, end, cb, user, count)) {
+        return 1;
+    }
+    return 0;
+}
+
+int utils_topic_trie_match(utils_topic_trie_t *trie, const char *topic, uint32_t topic_len,
+                           utils_topic_trie_cb_t cb, void *user)
+{
+    int count = 0;
+
+    _trie_match(trie, &trie->root, topic, topic + topic_len, cb, user, &count);
+    return count;
+}
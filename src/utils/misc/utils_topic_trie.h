@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2014-2016 Alibaba Group. All rights reserved.
+ * License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+
+
+#ifndef _IOTX_COMMON_TOPIC_TRIE_H_
+#define _IOTX_COMMON_TOPIC_TRIE_H_
+
+#include "iot_import.h"
+
+/*
+ * Topic filters split at '/' into levels, one trie node per level. '+'
+ * matches one level and '#', as the last level, matches the rest including
+ * none, so a topic is matched in time of its levels, not of the filters.
+ */
+typedef struct utils_topic_trie_st utils_topic_trie_t;
+
+/* Called for each value whose filter matches, return non-zero to stop */
+typedef int (*utils_topic_trie_cb_t)(void *value, void *user);
+
+utils_topic_trie_t *utils_topic_trie_new(void);
+
+/* The values are not freed */
+void utils_topic_trie_free(utils_topic_trie_t *trie);
+
+/* Add 'value' to 'filter', a filter may hold several values. 0 on success, -1 on invalid filter or no memory. */
+int utils_topic_trie_insert(utils_topic_trie_t *trie, const char *filter, void *value);
+
+/* Remove 'value' from 'filter'. 0 on success, -1 if not found. */
+int utils_topic_trie_remove(utils_topic_trie_t *trie, const char *filter, void *value);
+
+/* Call 'cb' for the values of the filters matching 'topic', return the number of calls */
+int utils_topic_trie_match(utils_topic_trie_t *trie, const char *topic, uint32_t topic_len,
+                           utils_topic_trie_cb_t cb, void *user);
+
+#endif /* _IOTX_COMMON_TOPIC_TRIE_H_ */